@@ -0,0 +1,341 @@
+//==============================================================
+// Copyright © 2020 Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+// =============================================================
+
+// oneDPL headers should be included before the standard headers
+#include <oneapi/dpl/algorithm>
+#include <oneapi/dpl/execution>
+
+#include "BarnesHut.hpp"
+
+#include <algorithm>
+
+#include "Particle.hpp"
+
+using namespace sycl;
+
+// Number of bits of each coordinate in a Morton code
+constexpr int kMortonBits = 10;
+
+/* Spread the 10 low bits of "v" so that there are two zeros between
+ * each of them */
+static inline uint32_t ExpandBits(uint32_t v) {
+  v = (v * 0x00010001u) & 0xFF0000FFu;
+  v = (v * 0x00000101u) & 0x0F00F00Fu;
+  v = (v * 0x00000011u) & 0xC30C30C3u;
+  v = (v * 0x00000005u) & 0x49249249u;
+  return v;
+}
+
+/* Allocate the tree of n particles on the device of the queue "q" */
+BarnesHut::BarnesHut(queue &q, int n) : q_(q), n_(n) {
+  int nodes = 2 * n - 1;
+  bounds_ = malloc_shared<RealType>(6, q_);
+  codes_ = malloc_device<uint32_t>(n, q_);
+  order_ = malloc_device<int>(n, q_);
+  left_ = malloc_device<int>(n - 1, q_);
+  right_ = malloc_device<int>(n - 1, q_);
+  parent_ = malloc_device<int>(nodes, q_);
+  visits_ = malloc_device<int>(n - 1, q_);
+  node_mass_ = malloc_device<RealType>(nodes, q_);
+  com_x_ = malloc_device<RealType>(nodes, q_);
+  com_y_ = malloc_device<RealType>(nodes, q_);
+  com_z_ = malloc_device<RealType>(nodes, q_);
+  min_x_ = malloc_device<RealType>(nodes, q_);
+  min_y_ = malloc_device<RealType>(nodes, q_);
+  min_z_ = malloc_device<RealType>(nodes, q_);
+  max_x_ = malloc_device<RealType>(nodes, q_);
+  max_y_ = malloc_device<RealType>(nodes, q_);
+  max_z_ = malloc_device<RealType>(nodes, q_);
+}
+
+BarnesHut::~BarnesHut() {
+  free(bounds_, q_);
+  free(codes_, q_);
+  free(order_, q_);
+  free(left_, q_);
+  free(right_, q_);
+  free(parent_, q_);
+  free(visits_, q_);
+  free(node_mass_, q_);
+  free(com_x_, q_);
+  free(com_y_, q_);
+  free(com_z_, q_);
+  free(min_x_, q_);
+  free(min_y_, q_);
+  free(min_z_, q_);
+  free(max_x_, q_);
+  free(max_y_, q_);
+  free(max_z_, q_);
+}
+
+/* Compute the Morton code of each particle in the bounding cube of all the
+ * particles, and sort the particles by their codes. Particles that are
+ * close in space are then close in the order, so each subtree of the radix
+ * tree is a compact cluster of particles. */
+void BarnesHut::ComputeMortonCodes(const RealType *pos_x,
+                                   const RealType *pos_y,
+                                   const RealType *pos_z) {
+  int n = n_;
+  RealType *bounds = bounds_;
+  uint32_t *codes = codes_;
+  int *order = order_;
+
+  // Bounding box of the particles
+  q_.submit([&](handler &h) {
+     auto min_x = reduction(bounds + 0, minimum<RealType>(),
+                            property::reduction::initialize_to_identity());
+     auto min_y = reduction(bounds + 1, minimum<RealType>(),
+                            property::reduction::initialize_to_identity());
+     auto min_z = reduction(bounds + 2, minimum<RealType>(),
+                            property::reduction::initialize_to_identity());
+     auto max_x = reduction(bounds + 3, maximum<RealType>(),
+                            property::reduction::initialize_to_identity());
+     auto max_y = reduction(bounds + 4, maximum<RealType>(),
+                            property::reduction::initialize_to_identity());
+     auto max_z = reduction(bounds + 5, maximum<RealType>(),
+                            property::reduction::initialize_to_identity());
+     h.parallel_for(range<1>(n), min_x, min_y, min_z, max_x, max_y, max_z,
+                    [=](id<1> i, auto &min_x, auto &min_y, auto &min_z,
+                        auto &max_x, auto &max_y, auto &max_z) {
+       min_x.combine(pos_x[i]);
+       min_y.combine(pos_y[i]);
+       min_z.combine(pos_z[i]);
+       max_x.combine(pos_x[i]);
+       max_y.combine(pos_y[i]);
+       max_z.combine(pos_z[i]);
+     });
+   }).wait_and_throw();
+
+  // The codes are computed in the bounding cube, so that the cells of the
+  // tree are cubes
+  RealType origin_x = bounds[0];
+  RealType origin_y = bounds[1];
+  RealType origin_z = bounds[2];
+  RealType size = std::max({bounds[3] - bounds[0], bounds[4] - bounds[1],
+                            bounds[5] - bounds[2]});
+  RealType scale = size > 0.f ? (1 << kMortonBits) / size : 1.f;
+
+  q_.submit([&](handler &h) {
+     h.parallel_for(range<1>(n), [=](id<1> i) {
+       const RealType kMax = (1 << kMortonBits) - 1;
+       uint32_t x = static_cast<uint32_t>(
+           clamp((pos_x[i] - origin_x) * scale, 0.f, kMax));
+       uint32_t y = static_cast<uint32_t>(
+           clamp((pos_y[i] - origin_y) * scale, 0.f, kMax));
+       uint32_t z = static_cast<uint32_t>(
+           clamp((pos_z[i] - origin_z) * scale, 0.f, kMax));
+       codes[i] = (ExpandBits(x) << 2) | (ExpandBits(y) << 1) | ExpandBits(z);
+       order[i] = i;
+     });
+   }).wait_and_throw();
+
+  auto policy = oneapi::dpl::execution::make_device_policy(q_);
+  oneapi::dpl::sort_by_key(policy, codes, codes + n, order);
+}
+
+/* Build the binary radix tree of the sorted Morton codes. Each internal
+ * node covers a range of leaves whose codes share a prefix, and is split
+ * where the next bit of the codes changes, so every node can find its
+ * range and its split from the codes alone, independently of the others.
+ * Equal codes are told apart by the index of their leaves. */
+void BarnesHut::BuildTree() {
+  int n = n_;
+  const uint32_t *codes = codes_;
+  int *left = left_;
+  int *right = right_;
+  int *parent = parent_;
+
+  q_.submit([&](handler &h) {
+     h.parallel_for(range<1>(n - 1), [=](id<1> idx) {
+       // Length of the common prefix of the codes of leaves i and j, or -1
+       // if j is not a leaf
+       auto delta = [=](int i, int j) -> int {
+         if (j < 0 || j > n - 1) return -1;
+         uint32_t code_i = codes[i];
+         uint32_t code_j = codes[j];
+         if (code_i == code_j)
+           return 32 + static_cast<int>(clz(static_cast<uint32_t>(i ^ j)));
+         return static_cast<int>(clz(code_i ^ code_j));
+       };
+
+       int i = idx;
+       // Direction of the range of the node: towards the neighbor that
+       // shares the longest prefix with leaf i
+       int d = (delta(i, i + 1) - delta(i, i - 1)) >= 0 ? 1 : -1;
+
+       // Find the other end j of the range, whose leaves all share a
+       // longer prefix than the neighbor on the other side
+       int delta_min = delta(i, i - d);
+       int l_max = 2;
+       while (delta(i, i + l_max * d) > delta_min) l_max *= 2;
+       int l = 0;
+       for (int t = l_max / 2; t >= 1; t /= 2) {
+         if (delta(i, i + (l + t) * d) > delta_min) l += t;
+       }
+       int j = i + l * d;
+
+       // Find the split: the last leaf that shares a longer prefix with
+       // leaf i than the whole range
+       int delta_node = delta(i, j);
+       int s = 0;
+       for (int div = 2;; div *= 2) {
+         int t = (l + div - 1) / div;
+         if (delta(i, i + (s + t) * d) > delta_node) s += t;
+         if (t == 1) break;
+       }
+       int gamma = i + s * d + sycl::min(d, 0);
+
+       // A child that covers a single leaf is that leaf
+       int child_left = sycl::min(i, j) == gamma ? n - 1 + gamma : gamma;
+       int child_right =
+           sycl::max(i, j) == gamma + 1 ? n - 1 + gamma + 1 : gamma + 1;
+       left[i] = child_left;
+       right[i] = child_right;
+       parent[child_left] = i;
+       parent[child_right] = i;
+       if (i == 0) parent[0] = -1;
+     });
+   }).wait_and_throw();
+}
+
+/* Compute the mass, the center of mass and the bounding box of all the
+ * nodes. There is one work-item per leaf, which walks up the tree: the
+ * first work-item to reach a node stops there, and the second, which knows
+ * that both children are done, computes the node and goes on to its
+ * parent. So each node is computed once, as soon as it can be. */
+void BarnesHut::SummarizeNodes(const RealType *pos_x, const RealType *pos_y,
+                               const RealType *pos_z, const RealType *mass) {
+  int n = n_;
+  const int *order = order_;
+  const int *left = left_;
+  const int *right = right_;
+  const int *parent = parent_;
+  int *visits = visits_;
+  RealType *node_mass = node_mass_;
+  RealType *com_x = com_x_, *com_y = com_y_, *com_z = com_z_;
+  RealType *min_x = min_x_, *min_y = min_y_, *min_z = min_z_;
+  RealType *max_x = max_x_, *max_y = max_y_, *max_z = max_z_;
+
+  q_.memset(visits, 0, (n - 1) * sizeof(int)).wait_and_throw();
+
+  q_.submit([&](handler &h) {
+     h.parallel_for(range<1>(n), [=](id<1> k) {
+       int leaf = n - 1 + k;
+       int p = order[k];
+       node_mass[leaf] = mass[p];
+       com_x[leaf] = min_x[leaf] = max_x[leaf] = pos_x[p];
+       com_y[leaf] = min_y[leaf] = max_y[leaf] = pos_y[p];
+       com_z[leaf] = min_z[leaf] = max_z[leaf] = pos_z[p];
+
+       int node = parent[leaf];
+       while (node >= 0) {
+         // The counter orders the writes of the child of the first
+         // work-item before the reads of the second one
+         atomic_ref<int, memory_order::acq_rel, memory_scope::device,
+                    access::address_space::global_space>
+             count(visits[node]);
+         if (count.fetch_add(1) == 0) break;
+
+         int a = left[node];
+         int b = right[node];
+         RealType m = node_mass[a] + node_mass[b];
+         node_mass[node] = m;
+         if (m > 0.f) {
+           com_x[node] =
+               (node_mass[a] * com_x[a] + node_mass[b] * com_x[b]) / m;
+           com_y[node] =
+               (node_mass[a] * com_y[a] + node_mass[b] * com_y[b]) / m;
+           com_z[node] =
+               (node_mass[a] * com_z[a] + node_mass[b] * com_z[b]) / m;
+         } else {
+           com_x[node] = 0.5f * (com_x[a] + com_x[b]);
+           com_y[node] = 0.5f * (com_y[a] + com_y[b]);
+           com_z[node] = 0.5f * (com_z[a] + com_z[b]);
+         }
+         min_x[node] = fmin(min_x[a], min_x[b]);
+         min_y[node] = fmin(min_y[a], min_y[b]);
+         min_z[node] = fmin(min_z[a], min_z[b]);
+         max_x[node] = fmax(max_x[a], max_x[b]);
+         max_y[node] = fmax(max_y[a], max_y[b]);
+         max_z[node] = fmax(max_z[a], max_z[b]);
+
+         node = parent[node];
+       }
+     });
+   }).wait_and_throw();
+}
+
+/* Rebuild the tree and compute the acceleration of all the particles */
+void BarnesHut::ComputeAccelerations(const RealType *pos_x,
+                                     const RealType *pos_y,
+                                     const RealType *pos_z,
+                                     const RealType *mass, RealType *acc_x,
+                                     RealType *acc_y, RealType *acc_z,
+                                     RealType theta) {
+  ComputeMortonCodes(pos_x, pos_y, pos_z);
+  BuildTree();
+  SummarizeNodes(pos_x, pos_y, pos_z, mass);
+
+  int n = n_;
+  const int *order = order_;
+  const int *left = left_;
+  const int *right = right_;
+  const RealType *node_mass = node_mass_;
+  const RealType *com_x = com_x_, *com_y = com_y_, *com_z = com_z_;
+  const RealType *min_x = min_x_, *min_y = min_y_, *min_z = min_z_;
+  const RealType *max_x = max_x_, *max_y = max_y_, *max_z = max_z_;
+  RealType theta_sqr = theta * theta;
+
+  q_.submit([&](handler &h) {
+     // The work-items take the particles in the Morton order, so that the
+     // neighboring work-items visit mostly the same nodes
+     h.parallel_for(range<1>(n), [=](id<1> k) {
+       int i = order[k];
+       RealType pos0 = pos_x[i];
+       RealType pos1 = pos_y[i];
+       RealType pos2 = pos_z[i];
+       RealType acc0 = 0.f;
+       RealType acc1 = 0.f;
+       RealType acc2 = 0.f;
+
+       int stack[kBarnesHutStackSize];
+       int top = 0;
+       stack[top++] = 0;  // the root
+       while (top > 0) {
+         int node = stack[--top];
+         RealType dx = com_x[node] - pos0;
+         RealType dy = com_y[node] - pos1;
+         RealType dz = com_z[node] - pos2;
+         RealType distance_sqr = dx * dx + dy * dy + dz * dz;
+
+         // Open the internal nodes that are too close for their size.
+         // If the stack is full, the node is used as it is.
+         if (node < n - 1 && top + 2 <= kBarnesHutStackSize) {
+           RealType size = fmax(max_x[node] - min_x[node],
+                                fmax(max_y[node] - min_y[node],
+                                     max_z[node] - min_z[node]));
+           if (size * size >= theta_sqr * distance_sqr) {
+             stack[top++] = right[node];
+             stack[top++] = left[node];
+             continue;
+           }
+         }
+
+         // Interaction with a particle, or with the center of mass of a
+         // node, with the same softening as the direct sum
+         distance_sqr += kSofteningSquared;
+         RealType distance_inv = 1.0f / sycl::sqrt(distance_sqr);
+         RealType m = node_mass[node];
+         acc0 += dx * kG * m * distance_inv * distance_inv * distance_inv;
+         acc1 += dy * kG * m * distance_inv * distance_inv * distance_inv;
+         acc2 += dz * kG * m * distance_inv * distance_inv * distance_inv;
+       }
+       acc_x[i] = acc0;
+       acc_y[i] = acc1;
+       acc_z[i] = acc2;
+     });
+   }).wait_and_throw();
+}
@@ -0,0 +1,80 @@
+//==============================================================
+// Copyright © 2020 Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+// =============================================================
+
+#ifndef _BARNESHUT_HPP
+#define _BARNESHUT_HPP
+
+#include <CL/sycl.hpp>
+#include <cstdint>
+
+#include "type.hpp"
+
+// Maximum depth of the tree that the traversal can handle. The tree is
+// built over 30-bit Morton codes, with the index of the particle as a tie
+// breaker, so this is enough for a few million particles.
+constexpr int kBarnesHutStackSize = 64;
+
+// Computes the accelerations of the particles with the Barnes-Hut
+// approximation, in O(N log N) operations per step instead of O(N^2).
+//
+// All the arrays are in USM device memory of the queue. Each call rebuilds
+// the tree from the current positions, on the device:
+//  1. the bounding box of the particles (reduction)
+//  2. the Morton code of each particle in the bounding box
+//  3. sort the particles by Morton code (oneDPL)
+//  4. a binary radix tree over the sorted codes, one internal node per
+//     work-item (Karras, "Maximizing Parallelism in the Construction of
+//     BVHs, Octrees, and k-d Trees", HPG 2012)
+//  5. the mass, center of mass and bounding box of each node, from the
+//     leaves up to the root
+//  6. a traversal of the tree for each particle: a node that looks smaller
+//     than the opening angle theta from the particle (size / distance <
+//     theta) is used as a single particle at its center of mass, otherwise
+//     its children are visited
+class BarnesHut {
+ public:
+  BarnesHut(sycl::queue &q, int n);
+  ~BarnesHut();
+
+  BarnesHut(const BarnesHut &) = delete;
+  BarnesHut &operator=(const BarnesHut &) = delete;
+
+  // Compute acc_x, acc_y and acc_z of the n particles. With theta = 0, all
+  // the nodes are opened, so this is the direct sum (in a different order).
+  void ComputeAccelerations(const RealType *pos_x, const RealType *pos_y,
+                            const RealType *pos_z, const RealType *mass,
+                            RealType *acc_x, RealType *acc_y, RealType *acc_z,
+                            RealType theta);
+
+ private:
+  void ComputeMortonCodes(const RealType *pos_x, const RealType *pos_y,
+                          const RealType *pos_z);
+  void BuildTree();
+  void SummarizeNodes(const RealType *pos_x, const RealType *pos_y,
+                      const RealType *pos_z, const RealType *mass);
+
+  sycl::queue &q_;
+  int n_;  // number of particles, and leaves of the tree
+
+  RealType *bounds_;  // min x, y, z and max x, y, z of the particles (shared)
+
+  uint32_t *codes_;  // Morton code of the particles, sorted
+  int *order_;       // index of the particle of each leaf
+
+  // The n - 1 internal nodes are numbered 0 .. n - 2, with the root at 0,
+  // and leaf k is node n - 1 + k
+  int *left_, *right_;  // children of the internal nodes
+  int *parent_;         // parent of all the nodes (-1 for the root)
+  int *visits_;         // number of children summarized, per internal node
+
+  // Summary of all the nodes
+  RealType *node_mass_;
+  RealType *com_x_, *com_y_, *com_z_;  // center of mass
+  RealType *min_x_, *min_y_, *min_z_;  // bounding box
+  RealType *max_x_, *max_y_, *max_z_;
+};
+
+#endif
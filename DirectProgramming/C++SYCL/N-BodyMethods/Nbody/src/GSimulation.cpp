@@ -6,12 +6,28 @@
 
 #include "GSimulation.hpp"
 
+#include "BarnesHut.hpp"
+
 // dpc_common.hpp can be found in the dev-utilities include folder.
 // e.g., $ONEAPI_ROOT/dev-utilities/latest/include/dpc_common.hpp
 #include "dpc_common.hpp"
 
 using namespace sycl;
 
+/* Name of a storage layout, as given on the command line */
+static const char* LayoutName(Layout layout) {
+  switch (layout) {
+    case Layout::kSoA:
+      return "soa";
+    case Layout::kCpu:
+      return "cpu";
+    case Layout::kBarnesHut:
+      return "bh";
+    default:
+      return "aos";
+  }
+}
+
 /* Default Constructor for the GSimulation class which sets up the default
  * values for number of particles, number of integration steps, time steo and
  * sample frequency */
@@ -24,6 +40,8 @@ GSimulation::GSimulation() {
   set_nsteps(10);
   set_tstep(0.1);
   set_sfreq(1);
+  SetLayout(Layout::kAoS);
+  SetTheta(0.5);
 }
 
 /* Set the number of particles */
@@ -32,6 +50,12 @@ void GSimulation::SetNumberOfParticles(int N) { set_npart(N); }
 /* Set the number of integration steps */
 void GSimulation::SetNumberOfSteps(int N) { set_nsteps(N); }
 
+/* Set the storage layout of the particles */
+void GSimulation::SetLayout(Layout layout) { layout_ = layout; }
+
+/* Set the opening angle of the Barnes-Hut layout */
+void GSimulation::SetTheta(RealType theta) { theta_ = theta; }
+
 /* Initialize the position of all the particles using random number generator
  * between 0 and 1.0 */
 void GSimulation::InitPos() {
@@ -84,7 +108,6 @@ void GSimulation::InitMass() {
 
 /* This function does the simulation logic for Nbody */
 void GSimulation::Start() {
-  RealType dt = get_tstep();
   int n = get_npart();
   particles_.resize(n);
 
@@ -96,13 +119,75 @@ void GSimulation::Start() {
   PrintHeader();
 
   total_time_ = 0.;
+  nf_ = 0;
+  av_ = 0.0;
+  dev_ = 0.0;
+  energies_.clear();
+
+  switch (layout_) {
+    case Layout::kAoS:
+      StartAoS();
+      break;
+    case Layout::kSoA:
+      StartSoA();
+      break;
+    case Layout::kCpu:
+      StartCpu();
+      break;
+    case Layout::kBarnesHut:
+      StartBarnesHut();
+      break;
+  }
+
+  total_flops_ = StepGflops() * get_nsteps();
+  av_ /= (double)(nf_ - 2);
+  dev_ = sqrt(dev_ / (double)(nf_ - 2) - av_ * av_);
+
+  std::cout << "\n";
+  std::cout << "# Total Time (s)     : " << total_time_ << "\n";
+  std::cout << "# Average Time/Step (s) : " << total_time_ / get_nsteps()
+            << "\n";
+  std::cout << "# Average Performance : " << av_ << " +- " << dev_ << "\n";
+  if (layout_ == Layout::kBarnesHut) {
+    ValidateBarnesHut();
+  }
+  std::cout << "==============================="
+            << "\n";
+}
+
+/* Number of GFLOP of one integration step */
+double GSimulation::StepGflops() const {
+  double n = get_npart();
+  return 1e-9 * ((11. + 18.) * n * n + n * 19.);
+}
+
+/* Print the stats of the integration step "s", which took "elapsed_seconds",
+ * and add its performance to the average */
+void GSimulation::ReportStep(int s, double elapsed_seconds) {
+  double gflops = StepGflops();
+  energies_.push_back(kenergy_);
+  if ((s % get_sfreq()) == 0) {
+    nf_ += 1;
+    std::cout << " " << std::left << std::setw(8) << s << std::left
+              << std::setprecision(5) << std::setw(8) << s * get_tstep()
+              << std::left << std::setprecision(5) << std::setw(12)
+              << kenergy_ << std::left << std::setprecision(5)
+              << std::setw(12) << elapsed_seconds << std::left
+              << std::setprecision(5) << std::setw(12)
+              << gflops * get_sfreq() / elapsed_seconds << "\n";
+    if (nf_ > 2) {
+      av_ += gflops * get_sfreq() / elapsed_seconds;
+      dev_ += gflops * get_sfreq() * gflops * get_sfreq() /
+             (elapsed_seconds * elapsed_seconds);
+    }
+  }
+}
 
-  constexpr float kSofteningSquared = 1e-3f;
-  // prevents explosion in the case the particles are really close to each other
-  constexpr float kG = 6.67259e-11f;
-  double gflops = 1e-9 * ((11. + 18.) * n * n + n * 19.);
-  int nf = 0;
-  double av = 0.0, dev = 0.0;
+/* Integration steps with the particles in an array of structs (Particle),
+ * with the forces computed by a SYCL kernel */
+void GSimulation::StartAoS() {
+  RealType dt = get_tstep();
+  int n = get_npart();
   // Create global range
   auto r = range<1>(n);
   // Create local range
@@ -185,40 +270,395 @@ void GSimulation::Start() {
     kenergy_ = 0.5 * (*energy);
     *energy = 0.f;
     double elapsed_seconds = ts0.Elapsed();
-    if ((s % get_sfreq()) == 0) {
-      nf += 1;
-      std::cout << " " << std::left << std::setw(8) << s << std::left
-                << std::setprecision(5) << std::setw(8) << s * get_tstep()
-                << std::left << std::setprecision(5) << std::setw(12)
-                << kenergy_ << std::left << std::setprecision(5)
-                << std::setw(12) << elapsed_seconds << std::left
-                << std::setprecision(5) << std::setw(12)
-                << gflops * get_sfreq() / elapsed_seconds << "\n";
-      if (nf > 2) {
-        av += gflops * get_sfreq() / elapsed_seconds;
-        dev += gflops * get_sfreq() * gflops * get_sfreq() /
-               (elapsed_seconds * elapsed_seconds);
+    ReportStep(s, elapsed_seconds);
+
+  }  // end of the time step loop
+  total_time_ = t0.Elapsed();
+}
+
+/* Integration steps with the particles in a structure of arrays
+ * (ParticleSoA), with the forces computed by a SYCL kernel that is tiled in
+ * local memory: each work-group loads the positions and masses of a tile of
+ * kTileSize particles into local memory, and all its work-items compute
+ * their interactions with the tile from there. So each particle is read
+ * from global memory once per work-group instead of once per work-item. */
+void GSimulation::StartSoA() {
+  RealType dt = get_tstep();
+  int n = get_npart();
+  ParticleSoA soa(particles_);
+
+  // One work-item per particle, rounded up to a whole number of tiles
+  int n_tiles = (n + kTileSize - 1) / kTileSize;
+  auto r = range<1>(n);
+  auto ndrange =
+      nd_range<1>(range<1>(n_tiles * kTileSize), range<1>(kTileSize));
+  // Create a queue to the selected device and enabled asynchronous exception
+  // handling for that queue
+  queue q(default_selector_v);
+  // Allocate energy using USM allocator shared
+  RealType *energy = malloc_shared<RealType>(1, q);
+  *energy = 0.f;
+
+  {  // Begin buffer scope
+    // Create a SYCL buffer for each field of the particles
+    buffer pos_x_buf(soa.pos_x.data(), r), pos_y_buf(soa.pos_y.data(), r),
+        pos_z_buf(soa.pos_z.data(), r);
+    buffer vel_x_buf(soa.vel_x.data(), r), vel_y_buf(soa.vel_y.data(), r),
+        vel_z_buf(soa.vel_z.data(), r);
+    buffer acc_x_buf(soa.acc_x.data(), r), acc_y_buf(soa.acc_y.data(), r),
+        acc_z_buf(soa.acc_z.data(), r);
+    buffer mass_buf(soa.mass.data(), r);
+
+    dpc_common::TimeInterval t0;
+    int nsteps = get_nsteps();
+    // Looping across integration steps
+    for (int s = 1; s <= nsteps; ++s) {
+      dpc_common::TimeInterval ts0;
+      // Submitting first kernel to device which computes acceleration of all
+      // particles
+      q.submit([&](handler& h) {
+         accessor pos_x(pos_x_buf, h, read_only),
+             pos_y(pos_y_buf, h, read_only), pos_z(pos_z_buf, h, read_only),
+             mass(mass_buf, h, read_only);
+         accessor acc_x(acc_x_buf, h, write_only, no_init),
+             acc_y(acc_y_buf, h, write_only, no_init),
+             acc_z(acc_z_buf, h, write_only, no_init);
+         // The tile of particles in local memory
+         local_accessor<RealType, 1> tile_x(kTileSize, h), tile_y(kTileSize, h),
+             tile_z(kTileSize, h), tile_mass(kTileSize, h);
+         h.parallel_for(ndrange, [=](nd_item<1> it) {
+           int i = it.get_global_id(0);
+           int li = it.get_local_id(0);
+           // The work-items past the last particle only help load the tiles
+           RealType pos0 = i < n ? pos_x[i] : 0.f;
+           RealType pos1 = i < n ? pos_y[i] : 0.f;
+           RealType pos2 = i < n ? pos_z[i] : 0.f;
+           RealType acc0 = 0.f;
+           RealType acc1 = 0.f;
+           RealType acc2 = 0.f;
+           for (int tile = 0; tile < n_tiles; tile++) {
+             // Each work-item loads one particle of the tile. The particles
+             // past the last one get no mass, so they add no acceleration.
+             int j = tile * kTileSize + li;
+             tile_x[li] = j < n ? pos_x[j] : 0.f;
+             tile_y[li] = j < n ? pos_y[j] : 0.f;
+             tile_z[li] = j < n ? pos_z[j] : 0.f;
+             tile_mass[li] = j < n ? mass[j] : 0.f;
+             group_barrier(it.get_group());
+
+             for (int k = 0; k < kTileSize; k++) {
+               RealType dx, dy, dz;
+               RealType distance_sqr = 0.0f;
+               RealType distance_inv = 0.0f;
+
+               dx = tile_x[k] - pos0;  // 1flop
+               dy = tile_y[k] - pos1;  // 1flop
+               dz = tile_z[k] - pos2;  // 1flop
+
+               distance_sqr =
+                   dx * dx + dy * dy + dz * dz + kSofteningSquared;  // 6flops
+               distance_inv = 1.0f / sycl::sqrt(distance_sqr);  // 1div+1sqrt
+
+               acc0 += dx * kG * tile_mass[k] * distance_inv * distance_inv *
+                       distance_inv;  // 6flops
+               acc1 += dy * kG * tile_mass[k] * distance_inv * distance_inv *
+                       distance_inv;  // 6flops
+               acc2 += dz * kG * tile_mass[k] * distance_inv * distance_inv *
+                       distance_inv;  // 6flops
+             }
+             // Wait for all the work-items before loading the next tile
+             group_barrier(it.get_group());
+           }
+           if (i < n) {
+             acc_x[i] = acc0;
+             acc_y[i] = acc1;
+             acc_z[i] = acc2;
+           }
+         });
+       }).wait_and_throw();
+      // Second kernel updates the velocity and position for all particles
+      q.submit([&](handler& h) {
+         accessor pos_x(pos_x_buf, h), pos_y(pos_y_buf, h), pos_z(pos_z_buf, h);
+         accessor vel_x(vel_x_buf, h), vel_y(vel_y_buf, h), vel_z(vel_z_buf, h);
+         accessor acc_x(acc_x_buf, h, read_only),
+             acc_y(acc_y_buf, h, read_only), acc_z(acc_z_buf, h, read_only),
+             mass(mass_buf, h, read_only);
+         h.parallel_for(r, reduction(energy, 0.f, std::plus<RealType>()),
+                        [=](id<1> i, auto& energy) {
+           vel_x[i] += acc_x[i] * dt;  // 2flops
+           vel_y[i] += acc_y[i] * dt;  // 2flops
+           vel_z[i] += acc_z[i] * dt;  // 2flops
+
+           pos_x[i] += vel_x[i] * dt;  // 2flops
+           pos_y[i] += vel_y[i] * dt;  // 2flops
+           pos_z[i] += vel_z[i] * dt;  // 2flops
+
+           energy += (mass[i] * (vel_x[i] * vel_x[i] + vel_y[i] * vel_y[i] +
+                                 vel_z[i] * vel_z[i]));  // 7flops
+         });
+       }).wait_and_throw();
+      kenergy_ = 0.5 * (*energy);
+      *energy = 0.f;
+      double elapsed_seconds = ts0.Elapsed();
+      ReportStep(s, elapsed_seconds);
+
+    }  // end of the time step loop
+    total_time_ = t0.Elapsed();
+  }  // end buffer scope
+  free(energy, q);
+
+  // Copy the particles back to the array of structs
+  soa.CopyTo(particles_);
+}
+
+/* Integration steps with the particles in a structure of arrays
+ * (ParticleSoA), computed on the host. The loops over the particles are
+ * split between the threads (OpenMP), and the inner loops run on the SIMD
+ * lanes: with the structure of arrays, the lanes load consecutive
+ * elements of each field. */
+void GSimulation::StartCpu() {
+  RealType dt = get_tstep();
+  int n = get_npart();
+  ParticleSoA soa(particles_);
+
+  RealType* pos_x = soa.pos_x.data();
+  RealType* pos_y = soa.pos_y.data();
+  RealType* pos_z = soa.pos_z.data();
+  RealType* vel_x = soa.vel_x.data();
+  RealType* vel_y = soa.vel_y.data();
+  RealType* vel_z = soa.vel_z.data();
+  RealType* acc_x = soa.acc_x.data();
+  RealType* acc_y = soa.acc_y.data();
+  RealType* acc_z = soa.acc_z.data();
+  RealType* mass = soa.mass.data();
+
+  dpc_common::TimeInterval t0;
+  int nsteps = get_nsteps();
+  // Looping across integration steps
+  for (int s = 1; s <= nsteps; ++s) {
+    dpc_common::TimeInterval ts0;
+    // Compute the acceleration of all particles
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < n; i++) {
+      RealType acc0 = 0.f;
+      RealType acc1 = 0.f;
+      RealType acc2 = 0.f;
+#pragma omp simd reduction(+ : acc0, acc1, acc2)
+      for (int j = 0; j < n; j++) {
+        RealType dx, dy, dz;
+        RealType distance_sqr = 0.0f;
+        RealType distance_inv = 0.0f;
+
+        dx = pos_x[j] - pos_x[i];  // 1flop
+        dy = pos_y[j] - pos_y[i];  // 1flop
+        dz = pos_z[j] - pos_z[i];  // 1flop
+
+        distance_sqr =
+            dx * dx + dy * dy + dz * dz + kSofteningSquared;  // 6flops
+        distance_inv = 1.0f / std::sqrt(distance_sqr);       // 1div+1sqrt
+
+        acc0 += dx * kG * mass[j] * distance_inv * distance_inv *
+                distance_inv;  // 6flops
+        acc1 += dy * kG * mass[j] * distance_inv * distance_inv *
+                distance_inv;  // 6flops
+        acc2 += dz * kG * mass[j] * distance_inv * distance_inv *
+                distance_inv;  // 6flops
       }
+      acc_x[i] = acc0;
+      acc_y[i] = acc1;
+      acc_z[i] = acc2;
     }
 
+    // Update the velocity and position for all particles
+    RealType energy = 0.f;
+#pragma omp parallel for simd schedule(static) reduction(+ : energy)
+    for (int i = 0; i < n; i++) {
+      vel_x[i] += acc_x[i] * dt;  // 2flops
+      vel_y[i] += acc_y[i] * dt;  // 2flops
+      vel_z[i] += acc_z[i] * dt;  // 2flops
+
+      pos_x[i] += vel_x[i] * dt;  // 2flops
+      pos_y[i] += vel_y[i] * dt;  // 2flops
+      pos_z[i] += vel_z[i] * dt;  // 2flops
+
+      energy += (mass[i] * (vel_x[i] * vel_x[i] + vel_y[i] * vel_y[i] +
+                            vel_z[i] * vel_z[i]));  // 7flops
+    }
+    kenergy_ = 0.5 * energy;
+    double elapsed_seconds = ts0.Elapsed();
+    ReportStep(s, elapsed_seconds);
+
   }  // end of the time step loop
   total_time_ = t0.Elapsed();
-  total_flops_ = gflops * get_nsteps();
-  av /= (double)(nf - 2);
-  dev = sqrt(dev / (double)(nf - 2) - av * av);
 
+  // Copy the particles back to the array of structs
+  soa.CopyTo(particles_);
+}
+
+/* Integration steps with the particles in a structure of arrays in device
+ * memory (USM), with the forces computed by the Barnes-Hut approximation
+ * (BarnesHut.hpp) instead of the direct sum. The tree is rebuilt from the
+ * positions at each step. The GFLOPS column is the rate that the direct sum
+ * would need to take the same time. */
+void GSimulation::StartBarnesHut() {
+  RealType dt = get_tstep();
+  int n = get_npart();
+  RealType theta = theta_;
+  ParticleSoA soa(particles_);
+
+  auto r = range<1>(n);
+  // Create a queue to the selected device and enabled asynchronous exception
+  // handling for that queue
+  queue q(default_selector_v);
+  // Allocate energy using USM allocator shared
+  RealType *energy = malloc_shared<RealType>(1, q);
+  *energy = 0.f;
+
+  // Copy each field of the particles to the device
+  auto to_device = [&](std::vector<RealType>& field) {
+    RealType* data = malloc_device<RealType>(n, q);
+    q.memcpy(data, field.data(), n * sizeof(RealType)).wait();
+    return data;
+  };
+  RealType* pos_x = to_device(soa.pos_x);
+  RealType* pos_y = to_device(soa.pos_y);
+  RealType* pos_z = to_device(soa.pos_z);
+  RealType* vel_x = to_device(soa.vel_x);
+  RealType* vel_y = to_device(soa.vel_y);
+  RealType* vel_z = to_device(soa.vel_z);
+  RealType* acc_x = to_device(soa.acc_x);
+  RealType* acc_y = to_device(soa.acc_y);
+  RealType* acc_z = to_device(soa.acc_z);
+  RealType* mass = to_device(soa.mass);
+
+  {  // Begin tree scope
+    BarnesHut tree(q, n);
+
+    dpc_common::TimeInterval t0;
+    int nsteps = get_nsteps();
+    // Looping across integration steps
+    for (int s = 1; s <= nsteps; ++s) {
+      dpc_common::TimeInterval ts0;
+      // Build the tree and compute the acceleration of all particles
+      tree.ComputeAccelerations(pos_x, pos_y, pos_z, mass, acc_x, acc_y,
+                                acc_z, theta);
+      // Second kernel updates the velocity and position for all particles
+      q.submit([&](handler& h) {
+         h.parallel_for(r, reduction(energy, 0.f, std::plus<RealType>()),
+                        [=](id<1> i, auto& energy) {
+           vel_x[i] += acc_x[i] * dt;  // 2flops
+           vel_y[i] += acc_y[i] * dt;  // 2flops
+           vel_z[i] += acc_z[i] * dt;  // 2flops
+
+           pos_x[i] += vel_x[i] * dt;  // 2flops
+           pos_y[i] += vel_y[i] * dt;  // 2flops
+           pos_z[i] += vel_z[i] * dt;  // 2flops
+
+           energy += (mass[i] * (vel_x[i] * vel_x[i] + vel_y[i] * vel_y[i] +
+                                 vel_z[i] * vel_z[i]));  // 7flops
+         });
+       }).wait_and_throw();
+      kenergy_ = 0.5 * (*energy);
+      *energy = 0.f;
+      double elapsed_seconds = ts0.Elapsed();
+      ReportStep(s, elapsed_seconds);
+
+    }  // end of the time step loop
+    total_time_ = t0.Elapsed();
+  }  // end tree scope
+
+  // Copy the particles back to the host
+  auto to_host = [&](RealType* data, std::vector<RealType>& field) {
+    q.memcpy(field.data(), data, n * sizeof(RealType)).wait();
+    free(data, q);
+  };
+  to_host(pos_x, soa.pos_x);
+  to_host(pos_y, soa.pos_y);
+  to_host(pos_z, soa.pos_z);
+  to_host(vel_x, soa.vel_x);
+  to_host(vel_y, soa.vel_y);
+  to_host(vel_z, soa.vel_z);
+  to_host(acc_x, soa.acc_x);
+  to_host(acc_y, soa.acc_y);
+  to_host(acc_z, soa.acc_z);
+  to_host(mass, soa.mass);
+  free(energy, q);
+
+  soa.CopyTo(particles_);
+}
+
+/* Run the same steps with the direct sum (soa), from the same initial
+ * state, and compare the kinetic energy of each step with the one of the
+ * Barnes-Hut steps */
+void GSimulation::ValidateBarnesHut() {
   std::cout << "\n";
-  std::cout << "# Total Time (s)     : " << total_time_ << "\n";
-  std::cout << "# Average Performance : " << av << " +- " << dev << "\n";
-  std::cout << "==============================="
+  if (get_npart() > kMaxValidationParticles) {
+    std::cout << "# Validation skipped: more than " << kMaxValidationParticles
+              << " particles\n";
+    return;
+  }
+
+  // The direct sum runs on the same members, so save the state of the
+  // Barnes-Hut run and restore it afterwards
+  std::vector<Particle> bh_particles = particles_;
+  std::vector<double> bh_energies = energies_;
+  RealType bh_kenergy = kenergy_;
+  double bh_time = total_time_;
+  double bh_flops = total_flops_;
+  int bh_nf = nf_;
+  double bh_av = av_;
+  double bh_dev = dev_;
+
+  InitPos();
+  InitVel();
+  InitAcc();
+  InitMass();
+
+  nf_ = 0;
+  av_ = 0.0;
+  dev_ = 0.0;
+  energies_.clear();
+
+  std::cout << " Validation with the direct sum\n";
+  layout_ = Layout::kSoA;
+  PrintHeader();
+  StartSoA();
+  layout_ = Layout::kBarnesHut;
+
+  double max_error = 0.0;
+  for (size_t s = 0; s < energies_.size(); s++) {
+    double error = std::abs(bh_energies[s] - energies_[s]) /
+                   std::abs(energies_[s]);
+    max_error = std::max(max_error, error);
+  }
+  double direct_time = total_time_;
+
+  particles_ = std::move(bh_particles);
+  energies_ = std::move(bh_energies);
+  kenergy_ = bh_kenergy;
+  total_time_ = bh_time;
+  total_flops_ = bh_flops;
+  nf_ = bh_nf;
+  av_ = bh_av;
+  dev_ = bh_dev;
+
+  std::cout << "\n";
+  std::cout << "# Direct Time/Step (s) : " << direct_time / get_nsteps()
             << "\n";
+  std::cout << "# Speedup over Direct  : " << direct_time / bh_time << "\n";
+  std::cout << "# Max Relative Error of kenergy : " << max_error << "\n";
 }
 
 /* Print the headers for the output */
 void GSimulation::PrintHeader() {
   std::cout << " nPart = " << get_npart() << "; "
             << "nSteps = " << get_nsteps() << "; "
-            << "dt = " << get_tstep() << "\n";
+            << "dt = " << get_tstep() << "; "
+            << "layout = " << LayoutName(layout_);
+  if (layout_ == Layout::kBarnesHut) {
+    std::cout << "; theta = " << theta_;
+  }
+  std::cout << "\n";
 
   std::cout << "------------------------------------------------"
             << "\n";
@@ -8,6 +8,7 @@
 #define _GSIMULATION_HPP
 
 #include <CL/sycl.hpp>
+#include <algorithm>
 #include <cstdlib>
 #include <fstream>
 #include <iomanip>
@@ -19,6 +20,22 @@
 
 #include "Particle.hpp"
 
+// Storage layout of the particles, and where the forces are computed
+enum class Layout {
+  kAoS,  // array of structs, SYCL kernel
+  kSoA,  // structure of arrays, SYCL kernel tiled in local memory
+  kCpu,  // structure of arrays, vectorized loops on the host
+  kBarnesHut  // structure of arrays, Barnes-Hut tree built on the device
+};
+
+// Number of particles per tile (and work-items per work-group) of the
+// tiled SoA kernel
+constexpr int kTileSize = 128;
+
+// The Barnes-Hut layout is checked against the direct sum (soa) up to this
+// number of particles
+constexpr int kMaxValidationParticles = 65536;
+
 class GSimulation {
  public:
   GSimulation();
@@ -26,6 +43,8 @@ class GSimulation {
   void Init();
   void SetNumberOfParticles(int N);
   void SetNumberOfSteps(int N);
+  void SetLayout(Layout layout);
+  void SetTheta(RealType theta);
   void Start();
 
  private:
@@ -37,11 +56,20 @@ class GSimulation {
 
   int sfreq_;  // sample frequency
 
+  Layout layout_;   // storage layout of the particles
+  RealType theta_;  // opening angle of the Barnes-Hut layout
+
   RealType kenergy_;  // kinetic energy
 
   double total_time_;   // total time of the simulation
   double total_flops_;  // total number of FLOPS
 
+  int nf_;       // number of sampled steps
+  double av_;    // average performance of the sampled steps
+  double dev_;   // standard deviation of the performance
+
+  std::vector<double> energies_;  // kinetic energy of each step
+
   void InitPos();
   void InitVel();
   void InitAcc();
@@ -59,6 +87,16 @@ class GSimulation {
   void set_sfreq(const int &sf) { sfreq_ = sf; }
   int get_sfreq() const { return sfreq_; }
 
+  void StartAoS();
+  void StartSoA();
+  void StartCpu();
+  void StartBarnesHut();
+
+  void ValidateBarnesHut();
+
+  double StepGflops() const;
+  void ReportStep(int s, double elapsed_seconds);
+
   void PrintHeader();
 };
 
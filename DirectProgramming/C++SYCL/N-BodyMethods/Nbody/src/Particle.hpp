@@ -1,9 +1,14 @@
 #ifndef _PARTICLE_HPP
 #define _PARTICLE_HPP
 #include <cmath>
+#include <vector>
 
 #include "type.hpp"
 
+// prevents explosion in the case the particles are really close to each other
+constexpr float kSofteningSquared = 1e-3f;
+constexpr float kG = 6.67259e-11f;
+
 struct Particle {
  public:
   Particle() : pos{}, vel{}, acc{}, mass{} {};
@@ -13,4 +18,45 @@ struct Particle {
   RealType mass;
 };
 
+// The particles as a structure of arrays: each field of Particle is
+// stored in its own array, so neighboring work-items (or SIMD lanes) read
+// neighboring elements.
+struct ParticleSoA {
+ public:
+  ParticleSoA(const std::vector<Particle> &particles) {
+    for (const Particle &p : particles) {
+      pos_x.push_back(p.pos[0]);
+      pos_y.push_back(p.pos[1]);
+      pos_z.push_back(p.pos[2]);
+      vel_x.push_back(p.vel[0]);
+      vel_y.push_back(p.vel[1]);
+      vel_z.push_back(p.vel[2]);
+      acc_x.push_back(p.acc[0]);
+      acc_y.push_back(p.acc[1]);
+      acc_z.push_back(p.acc[2]);
+      mass.push_back(p.mass);
+    }
+  }
+
+  void CopyTo(std::vector<Particle> &particles) const {
+    for (size_t i = 0; i < particles.size(); i++) {
+      particles[i].pos[0] = pos_x[i];
+      particles[i].pos[1] = pos_y[i];
+      particles[i].pos[2] = pos_z[i];
+      particles[i].vel[0] = vel_x[i];
+      particles[i].vel[1] = vel_y[i];
+      particles[i].vel[2] = vel_z[i];
+      particles[i].acc[0] = acc_x[i];
+      particles[i].acc[1] = acc_y[i];
+      particles[i].acc[2] = acc_z[i];
+      particles[i].mass = mass[i];
+    }
+  }
+
+  std::vector<RealType> pos_x, pos_y, pos_z;
+  std::vector<RealType> vel_x, vel_y, vel_z;
+  std::vector<RealType> acc_x, acc_y, acc_z;
+  std::vector<RealType> mass;
+};
+
 #endif
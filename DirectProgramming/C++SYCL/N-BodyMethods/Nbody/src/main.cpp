@@ -5,12 +5,14 @@
 // =============================================================
 
 #include <iostream>
+#include <string>
 
 #include "GSimulation.hpp"
 
 int main(int argc, char** argv) {
-  int n;      // number of particles
-  int nstep;  // number ot integration steps
+  int n;        // number of particles
+  int nstep;    // number ot integration steps
+  float theta;  // opening angle of the Barnes-Hut layout
 
   GSimulation sim;
 
@@ -22,10 +24,38 @@ int main(int argc, char** argv) {
   if (argc > 1) {
     n = std::atoi(argv[1]);
     sim.SetNumberOfParticles(n);
-    if (argc == 3) {
+    if (argc > 2) {
       nstep = std::atoi(argv[2]);
       sim.SetNumberOfSteps(nstep);
     }
+    if (argc > 3) {
+      std::string layout = argv[3];
+      if (layout == "aos") {
+        sim.SetLayout(Layout::kAoS);
+      } else if (layout == "soa") {
+        sim.SetLayout(Layout::kSoA);
+      } else if (layout == "cpu") {
+        sim.SetLayout(Layout::kCpu);
+      } else if (layout == "bh") {
+        sim.SetLayout(Layout::kBarnesHut);
+        if (n < 2) {
+          std::cerr << "ERROR: the bh layout needs at least 2 particles\n";
+          return 1;
+        }
+      } else {
+        std::cerr << "ERROR: unknown layout " << layout
+                  << ", use aos, soa, cpu or bh\n";
+        return 1;
+      }
+    }
+    if (argc > 4) {
+      theta = std::atof(argv[4]);
+      if (theta < 0) {
+        std::cerr << "ERROR: the opening angle must not be negative\n";
+        return 1;
+      }
+      sim.SetTheta(theta);
+    }
   }
 
   sim.Start();
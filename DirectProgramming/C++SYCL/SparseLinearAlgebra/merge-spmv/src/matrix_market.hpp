@@ -0,0 +1,335 @@
+//==============================================================
+// A parallel reader of sparse matrices in the Matrix Market exchange format
+// (https://math.nist.gov/MatrixMarket/formats.html), for the merge based
+// sparse matrix and vector multiplication sample.
+//==============================================================
+// Copyright © Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+// =============================================================
+
+#ifndef MATRIX_MARKET_HPP
+#define MATRIX_MARKET_HPP
+
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// A sparse matrix in compressed sparse row format, in host memory. See
+// CompressedSparseRow in spmv.cpp for the format.
+struct MatrixMarketCsr {
+  int num_rows = 0;
+  int num_columns = 0;
+  std::vector<int> row_offsets;
+  std::vector<int> column_indices;
+  std::vector<float> values;
+};
+
+// The entries of one chunk of the file, in coordinate format.
+struct MatrixMarketChunk {
+  std::vector<int> rows;
+  std::vector<int> columns;
+  std::vector<float> values;
+  bool valid = true;
+  bool in_range = true;  // false if an index is outside of the matrix
+};
+
+// Parse the entries on the lines of [begin, end) into 'chunk'. The indices
+// are 1-based in the file and 0-based in 'chunk'. Each line is parsed on its
+// own, and 'chunk' is only marked valid if every line is blank, a comment,
+// or holds exactly the fields of one entry of a 'num_rows' x 'num_columns'
+// matrix.
+inline void ParseMatrixMarketChunk(const char *begin, const char *end,
+                                   bool pattern, long long num_rows,
+                                   long long num_columns,
+                                   MatrixMarketChunk &chunk) {
+  chunk.valid = false;
+
+  for (const char *p = begin; p < end; p++) {
+    const char *line_end = std::find(p, end, '\n');
+
+    // Skip blank lines and comments.
+    while (p < line_end && isspace(static_cast<unsigned char>(*p))) p++;
+    if (p == line_end || *p == '%') {
+      p = line_end;
+      continue;
+    }
+
+    // strtol and strtof skip any whitespace, including new lines, so a
+    // field must also end before the end of the line.
+    char *next;
+    long row = strtol(p, &next, 10);
+    if (next == p || next > line_end) return;
+    p = next;
+
+    long column = strtol(p, &next, 10);
+    if (next == p || next > line_end) return;
+    p = next;
+
+    float value = 1;
+    if (!pattern) {
+      value = strtof(p, &next);
+      if (next == p || next > line_end) return;
+      p = next;
+    }
+
+    // Nothing else may follow on the line.
+    while (p < line_end && isspace(static_cast<unsigned char>(*p))) p++;
+    if (p != line_end) return;
+
+    // Check the indices before they are narrowed to an int.
+    if (row < 1 || row > num_rows || column < 1 || column > num_columns) {
+      chunk.in_range = false;
+      return;
+    }
+
+    chunk.rows.push_back(static_cast<int>(row - 1));
+    chunk.columns.push_back(static_cast<int>(column - 1));
+    chunk.values.push_back(value);
+  }
+
+  chunk.valid = true;
+}
+
+// Read the Matrix Market file 'path' into 'matrix'. Only coordinate
+// matrices of real, integer or pattern entries are supported. The missing
+// half of symmetric and skew-symmetric matrices is filled in, so 'matrix'
+// is always general. Returns false, and prints the reason, if the file
+// cannot be read.
+//
+// The whole file is read into memory and split into one chunk of lines per
+// thread. The chunks are parsed in parallel, and the entries are then
+// counted and scattered into the rows in parallel as well. The columns of
+// each row are sorted, so the result does not depend on the number of
+// threads.
+inline bool ReadMatrixMarket(const std::string &path,
+                             MatrixMarketCsr &matrix) {
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file) {
+    std::cerr << "Error: cannot open " << path << "\n";
+    return false;
+  }
+
+  std::vector<char> data(static_cast<size_t>(file.tellg()) + 1, '\0');
+  file.seekg(0);
+  if (!file.read(data.data(), data.size() - 1)) {
+    std::cerr << "Error: cannot read " << path << "\n";
+    return false;
+  }
+
+  const char *p = data.data();
+  const char *end = data.data() + data.size() - 1;
+
+  // Banner: %%MatrixMarket matrix <format> <field> <symmetry>
+  const char *line_end = std::find(p, end, '\n');
+  std::string banner(p, line_end);
+  std::transform(banner.begin(), banner.end(), banner.begin(),
+                 [](unsigned char c) { return tolower(c); });
+
+  std::istringstream banner_stream(banner);
+  std::string tag, object, format, field, symmetry;
+  banner_stream >> tag >> object >> format >> field >> symmetry;
+
+  if (tag != "%%matrixmarket" || object != "matrix") {
+    std::cerr << "Error: " << path << " is not a Matrix Market file\n";
+    return false;
+  }
+  if (format != "coordinate") {
+    std::cerr << "Error: " << path << " is a dense matrix, only sparse "
+              << "(coordinate) matrices are supported\n";
+    return false;
+  }
+  if (field != "real" && field != "integer" && field != "double" &&
+      field != "pattern") {
+    std::cerr << "Error: " << path << " has " << field << " entries, only "
+              << "real, integer and pattern entries are supported\n";
+    return false;
+  }
+  if (symmetry != "general" && symmetry != "symmetric" &&
+      symmetry != "skew-symmetric") {
+    std::cerr << "Error: " << path << " is " << symmetry << ", only "
+              << "general, symmetric and skew-symmetric matrices are "
+              << "supported\n";
+    return false;
+  }
+
+  bool pattern = (field == "pattern");
+  bool symmetric = (symmetry != "general");
+  float mirror_sign = (symmetry == "skew-symmetric") ? -1 : 1;
+
+  // Skip the comments, then read the size line: <rows> <columns> <entries>
+  p = line_end;
+  long long rows = 0, columns = 0, entries = -1;
+  while (p < end) {
+    p++;
+    line_end = std::find(p, end, '\n');
+    std::string line(p, line_end);
+    p = line_end;
+
+    if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+    if (line[0] == '%') continue;
+
+    std::istringstream size_stream(line);
+    if (!(size_stream >> rows >> columns >> entries)) entries = -1;
+    break;
+  }
+
+  if (entries < 0 || rows <= 0 || columns <= 0) {
+    std::cerr << "Error: " << path << " has no valid size line\n";
+    return false;
+  }
+
+  long long max_nonzero = symmetric ? 2 * entries : entries;
+  if (rows > INT_MAX || columns > INT_MAX ||
+      rows + max_nonzero > INT_MAX) {
+    std::cerr << "Error: " << path << " is too large, the number of rows "
+              << "and non zero values must fit in an int\n";
+    return false;
+  }
+
+  // Split the entries into chunks of whole lines, one per thread.
+  int chunk_count = 1;
+#ifdef _OPENMP
+  chunk_count = omp_get_max_threads();
+#endif
+
+  std::vector<const char *> bounds(chunk_count + 1, end);
+  bounds[0] = std::min(p + 1, end);
+  for (int c = 1; c < chunk_count; c++) {
+    const char *split = bounds[0] + (end - bounds[0]) * c / chunk_count;
+    split = std::max(split, bounds[c - 1]);
+    bounds[c] = std::min(std::find(split, end, '\n') + 1, end);
+  }
+
+  std::vector<MatrixMarketChunk> chunks(chunk_count);
+
+#pragma omp parallel for schedule(static, 1)
+  for (int c = 0; c < chunk_count; c++) {
+    ParseMatrixMarketChunk(bounds[c], bounds[c + 1], pattern, rows, columns,
+                           chunks[c]);
+  }
+
+  // Check the entries.
+  long long entry_count = 0;
+  bool valid = true;
+  bool in_range = true;
+  for (auto &chunk : chunks) {
+    entry_count += chunk.rows.size();
+    valid = valid && chunk.valid;
+    in_range = in_range && chunk.in_range;
+  }
+
+  if (!in_range) {
+    std::cerr << "Error: " << path << " has entries outside of the " << rows
+              << " x " << columns << " matrix\n";
+    return false;
+  }
+
+  if (!valid || entry_count != entries) {
+    std::cerr << "Error: " << path << " has " << entry_count
+              << (valid ? "" : " readable") << " entries, expected "
+              << entries << "\n";
+    return false;
+  }
+
+  matrix.num_rows = static_cast<int>(rows);
+  matrix.num_columns = static_cast<int>(columns);
+  matrix.row_offsets.assign(matrix.num_rows + 1, 0);
+
+  // Count the non zero values of each row.
+  int *row_counts = matrix.row_offsets.data() + 1;
+
+#pragma omp parallel for schedule(static, 1)
+  for (int c = 0; c < chunk_count; c++) {
+    const MatrixMarketChunk &chunk = chunks[c];
+
+    for (size_t k = 0; k < chunk.rows.size(); k++) {
+      int i = chunk.rows[k];
+      int j = chunk.columns[k];
+
+#pragma omp atomic
+      row_counts[i]++;
+
+      if (symmetric && i != j) {
+#pragma omp atomic
+        row_counts[j]++;
+      }
+    }
+  }
+
+  for (int i = 0; i < matrix.num_rows; i++) {
+    matrix.row_offsets[i + 1] += matrix.row_offsets[i];
+  }
+
+  // Scatter the entries into their rows.
+  int nonzero = matrix.row_offsets[matrix.num_rows];
+  matrix.column_indices.resize(nonzero);
+  matrix.values.resize(nonzero);
+
+  std::vector<int> next(matrix.row_offsets.begin(),
+                        matrix.row_offsets.end() - 1);
+
+#pragma omp parallel for schedule(static, 1)
+  for (int c = 0; c < chunk_count; c++) {
+    const MatrixMarketChunk &chunk = chunks[c];
+
+    for (size_t k = 0; k < chunk.rows.size(); k++) {
+      int i = chunk.rows[k];
+      int j = chunk.columns[k];
+      int offset;
+
+#pragma omp atomic capture
+      offset = next[i]++;
+
+      matrix.column_indices[offset] = j;
+      matrix.values[offset] = chunk.values[k];
+
+      if (symmetric && i != j) {
+#pragma omp atomic capture
+        offset = next[j]++;
+
+        matrix.column_indices[offset] = i;
+        matrix.values[offset] = mirror_sign * chunk.values[k];
+      }
+    }
+  }
+
+  // Sort the columns of each row.
+#pragma omp parallel
+  {
+    std::vector<std::pair<int, float>> row;
+
+#pragma omp for schedule(dynamic, 1024)
+    for (int i = 0; i < matrix.num_rows; i++) {
+      int begin = matrix.row_offsets[i];
+      int end = matrix.row_offsets[i + 1];
+
+      row.clear();
+      for (int k = begin; k < end; k++) {
+        row.emplace_back(matrix.column_indices[k], matrix.values[k]);
+      }
+
+      std::sort(row.begin(), row.end());
+
+      for (int k = begin; k < end; k++) {
+        matrix.column_indices[k] = row[k - begin].first;
+        matrix.values[k] = row[k - begin].second;
+      }
+    }
+  }
+
+  return true;
+}
+
+#endif  // MATRIX_MARKET_HPP
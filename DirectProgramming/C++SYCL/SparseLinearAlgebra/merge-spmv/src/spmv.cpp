@@ -1,7 +1,8 @@
 //==============================================================
 // This sample provides a parallel implementation of a merge based sparse matrix
 // and vector multiplication algorithm using SYCL. The input matrix is in
-// compressed sparse row format.
+// compressed sparse row format. It is either a random matrix, or read from
+// Matrix Market (.mtx) files.
 //==============================================================
 // Copyright © Intel Corporation
 //
@@ -9,21 +10,29 @@
 // =============================================================
 
 #include <CL/sycl.hpp>
+#include <algorithm>
+#include <cfloat>
+#include <filesystem>
+#include <iomanip>
 #include <iostream>
 #include <map>
 #include <set>
+#include <string>
+#include <vector>
 
 // dpc_common.hpp can be found in the dev-utilities include folder.
 // e.g., $ONEAPI_ROOT/dev-utilities/<version>/include/dpc_common.hpp
 #include "dpc_common.hpp"
 
+#include "matrix_market.hpp"
+
 using namespace std;
 using namespace sycl;
 
-// n x n sparse matrix.
+// n x n random sparse matrix, used when no matrix file is given.
 constexpr int n = 100 * 1000;
 
-// Number of non zero values in sparse matrix.
+// Number of non zero values in the random sparse matrix.
 constexpr int nonzero = 2 * 1000 * 1000;
 
 // Maximum value of an element in the matrix.
@@ -69,23 +78,27 @@ constexpr int repetitions = 16;
 //     3         2                    4
 //     -         -                    6
 typedef struct {
+  int num_rows;
+  int num_columns;
+  int nonzero;
   int *row_offsets;
   int *column_indices;
   float *values;
 } CompressedSparseRow;
 
 // Allocate unified shared memory for storing matrix and vectors so that they
-// are accessible from both the CPU and the device (e.g., a GPU).
+// are accessible from both the CPU and the device (e.g., a GPU). The size of
+// the matrix is given by num_rows, num_columns and nonzero of 'matrix'.
 bool AllocateMemory(queue &q, int thread_count, CompressedSparseRow *matrix,
                     float **x, float **y_sequential, float **y_parallel,
                     int **carry_row, float **carry_value) {
-  matrix->row_offsets = malloc_shared<int>(n + 1, q);
-  matrix->column_indices = malloc_shared<int>(nonzero, q);
-  matrix->values = malloc_shared<float>(nonzero, q);
+  matrix->row_offsets = malloc_shared<int>(matrix->num_rows + 1, q);
+  matrix->column_indices = malloc_shared<int>(matrix->nonzero, q);
+  matrix->values = malloc_shared<float>(matrix->nonzero, q);
 
-  *x = malloc_shared<float>(n, q);
-  *y_sequential = malloc_shared<float>(n, q);
-  *y_parallel = malloc_shared<float>(n, q);
+  *x = malloc_shared<float>(matrix->num_columns, q);
+  *y_sequential = malloc_shared<float>(matrix->num_rows, q);
+  *y_parallel = malloc_shared<float>(matrix->num_rows, q);
 
   *carry_row = malloc_shared<int>(thread_count, q);
   *carry_value = malloc_shared<float>(thread_count, q);
@@ -113,7 +126,8 @@ void FreeMemory(queue &q, CompressedSparseRow *matrix, float *x,
   if (carry_value != nullptr) free(carry_value, q);
 }
 
-// Initialize inputs: sparse matrix and vector.
+// Initialize inputs: random n x n sparse matrix and vector. The matrix must be
+// allocated for n rows and columns and 'nonzero' non zero values.
 void InitializeSparseMatrixAndVector(CompressedSparseRow *matrix, float *x) {
   map<int, set<int>> indices;
 
@@ -158,6 +172,22 @@ void InitializeSparseMatrixAndVector(CompressedSparseRow *matrix, float *x) {
   }
 }
 
+// Initialize inputs: sparse matrix read from a Matrix Market file, and
+// vector. The matrix must be allocated for the size of 'source'.
+void InitializeSparseMatrixAndVector(const MatrixMarketCsr &source,
+                                     CompressedSparseRow *matrix, float *x) {
+  copy(source.row_offsets.begin(), source.row_offsets.end(),
+       matrix->row_offsets);
+  copy(source.column_indices.begin(), source.column_indices.end(),
+       matrix->column_indices);
+  copy(source.values.begin(), source.values.end(), matrix->values);
+
+  // Initialize input vector.
+  for (int i = 0; i < matrix->num_columns; i++) {
+    x[i] = 1;
+  }
+}
+
 // A sequential implementation of merge based sparse matrix and vector
 // multiplication algorithm.
 //
@@ -193,7 +223,7 @@ void MergeSparseMatrixVector(CompressedSparseRow *matrix, float *x, float *y) {
 
   y[row_index] = 0;
 
-  while (val_index < nonzero) {
+  while (val_index < matrix->nonzero) {
     if (val_index < matrix->row_offsets[row_index + 1]) {
       // Accumulate and move down.
       y[row_index] +=
@@ -207,7 +237,7 @@ void MergeSparseMatrixVector(CompressedSparseRow *matrix, float *x, float *y) {
     }
   }
 
-  for (row_index++; row_index < n; row_index++) {
+  for (row_index++; row_index < matrix->num_rows; row_index++) {
     y[row_index] = 0;
   }
 }
@@ -220,7 +250,12 @@ typedef struct {
 
 // Given linear position on the merge path, find two dimensional merge
 // coordinate (row index and value index pair) on the path.
-MergeCoordinate MergePathBinarySearch(int diagonal, int *row_offsets) {
+MergeCoordinate MergePathBinarySearch(int diagonal,
+                                      const CompressedSparseRow &matrix) {
+  int n = matrix.num_rows;
+  int nonzero = matrix.nonzero;
+  int *row_offsets = matrix.row_offsets;
+
   // Diagonal search range (in row index space).
   int row_min = (diagonal - nonzero > 0) ? (diagonal - nonzero) : 0;
   int row_max = (diagonal < n) ? diagonal : n;
@@ -260,7 +295,7 @@ void MergeSparseMatrixVectorThread(int thread_count, int tid,
                                    CompressedSparseRow matrix, float *x,
                                    float *y, int *carry_row,
                                    float *carry_value) {
-  int path_length = n + nonzero;  // Merge path length.
+  int path_length = matrix.num_rows + matrix.nonzero;  // Merge path length.
   int items_per_thread = (path_length + thread_count - 1) /
                          thread_count;  // Merge items per thread.
 
@@ -272,14 +307,14 @@ void MergeSparseMatrixVectorThread(int thread_count, int tid,
                          ? (diagonal + items_per_thread)
                          : path_length;
 
-  MergeCoordinate path = MergePathBinarySearch(diagonal, matrix.row_offsets);
-  MergeCoordinate path_end =
-      MergePathBinarySearch(diagonal_end, matrix.row_offsets);
+  MergeCoordinate path = MergePathBinarySearch(diagonal, matrix);
+  MergeCoordinate path_end = MergePathBinarySearch(diagonal_end, matrix);
 
-  // Consume items-per-thread merge items.
+  // Consume the merge items up to the end coordinate, which is less than
+  // items-per-thread merge items for the last threads.
   float dot_product = 0;
 
-  for (int i = 0; i < items_per_thread; i++) {
+  for (int i = diagonal; i < diagonal_end; i++) {
     if (path.val_index < matrix.row_offsets[path.row_index + 1]) {
       // Accumulate and move down.
       dot_product += matrix.values[path.val_index] *
@@ -314,6 +349,7 @@ void MergeSparseMatrixVector(queue &q, int compute_units, int work_group_size,
                              CompressedSparseRow matrix, float *x, float *y,
                              int *carry_row, float *carry_value) {
   int thread_count = compute_units * work_group_size;
+  int n = matrix.num_rows;
 
   // Initialize output vector.
   q.parallel_for<class InitializeVector>(
@@ -350,10 +386,53 @@ void MergeSparseMatrixVector(queue &q, int compute_units, int work_group_size,
   }
 }
 
-// Check if two input vectors are equal.
-bool VerifyVectorsAreEqual(float *u, float *v) {
+// The same parallel implementation on the host, with OpenMP threads in place
+// of the work-items. This is the original form of the algorithm (Merrill and
+// Garland, "Merge-based Parallel Sparse Matrix-Vector Multiplication", SC16).
+void MergeSparseMatrixVector(int thread_count, CompressedSparseRow matrix,
+                             float *x, float *y, int *carry_row,
+                             float *carry_value) {
+  int n = matrix.num_rows;
+
+  // Initialize output vector.
+#pragma omp parallel for schedule(static) num_threads(thread_count)
   for (int i = 0; i < n; i++) {
-    if (fabs(u[i] - v[i]) > 1E-06) {
+    y[i] = 0;
+  }
+
+  // Multiply sparse matrix and vector.
+#pragma omp parallel for schedule(static, 1) num_threads(thread_count)
+  for (int tid = 0; tid < thread_count; tid++) {
+    MergeSparseMatrixVectorThread(thread_count, tid, matrix, x, y, carry_row,
+                                  carry_value);
+  }
+
+  // Carry fix up for rows spanning multiple threads.
+  for (int tid = 0; tid < thread_count - 1; tid++) {
+    if (carry_row[tid] < n) {
+      y[carry_row[tid]] += carry_value[tid];
+    }
+  }
+}
+
+// Check if two results of the multiplication of 'matrix' and 'x' are equal.
+// The implementations add up the rows in different orders, so the results
+// can differ by rounding errors, which grow with the length of the row and
+// the magnitude of its terms.
+bool VerifyVectorsAreEqual(const CompressedSparseRow &matrix, float *x,
+                           float *u, float *v) {
+  for (int i = 0; i < matrix.num_rows; i++) {
+    int begin = matrix.row_offsets[i];
+    int end = matrix.row_offsets[i + 1];
+    float magnitude = 0;
+
+    for (int k = begin; k < end; k++) {
+      magnitude += fabs(matrix.values[k] * x[matrix.column_indices[k]]);
+    }
+
+    float tolerance = 2 * (end - begin) * FLT_EPSILON * magnitude + 1E-06;
+
+    if (fabs(u[i] - v[i]) > tolerance) {
       return false;
     }
   }
@@ -361,20 +440,213 @@ bool VerifyVectorsAreEqual(float *u, float *v) {
   return true;
 }
 
-int main() {
+// Performance of one multiplication of 'matrix' that took 'time' seconds, in
+// GFLOPS: a multiplication and an addition per non zero value.
+double Gflops(const CompressedSparseRow &matrix, double time) {
+  return 2.0 * matrix.nonzero / time * 1E-09;
+}
+
+// Effective bandwidth of one multiplication of 'matrix' that took 'time'
+// seconds, in GB/s: the bytes of the matrix and of both vectors, each read or
+// written once.
+double Bandwidth(const CompressedSparseRow &matrix, double time) {
+  double bytes = (double)matrix.nonzero * (sizeof(int) + sizeof(float)) +
+                 (matrix.num_rows + 1.0) * sizeof(int) +
+                 (double)matrix.num_columns * sizeof(float) +
+                 (double)matrix.num_rows * sizeof(float);
+
+  return bytes / time * 1E-09;
+}
+
+// Average run times of the three implementations on one matrix.
+typedef struct {
+  string name;
+  CompressedSparseRow matrix;  // Size only, the arrays are freed.
+  double elapsed_s;            // Sequential.
+  double elapsed_t;            // Threads on the host.
+  double elapsed_p;            // Parallel on the device.
+} BenchmarkResult;
+
+// Multiply a sparse matrix and a vector 'repetitions' times with each
+// implementation, check that the results are equal, and print the run times.
+// The matrix is read from 'source', or random if 'source' is null. Returns
+// false if the memory cannot be allocated or the results differ.
+bool RunBenchmark(queue &q, int compute_units, int work_group_size,
+                  int host_thread_count, const string &name,
+                  const MatrixMarketCsr *source, BenchmarkResult *result) {
   // Sparse matrix.
   CompressedSparseRow matrix;
 
+  if (source != nullptr) {
+    matrix.num_rows = source->num_rows;
+    matrix.num_columns = source->num_columns;
+    matrix.nonzero = source->row_offsets[source->num_rows];
+  } else {
+    matrix.num_rows = n;
+    matrix.num_columns = n;
+    matrix.nonzero = nonzero;
+  }
+
   // Input vector.
   float *x;
 
   // Vector: result of sparse matrix and vector multiplication.
   float *y_sequential;
   float *y_parallel;
+  vector<float> y_thread(matrix.num_rows);
 
   // Auxiliary storage for parallel computation.
   int *carry_row;
   float *carry_value;
+  vector<int> host_carry_row(host_thread_count);
+  vector<float> host_carry_value(host_thread_count);
+
+  cout << "\nMatrix: " << name << " (" << matrix.num_rows << " x "
+       << matrix.num_columns << ", " << matrix.nonzero
+       << " non zero values)\n";
+
+  // Allocate memory.
+  if (!AllocateMemory(q, compute_units * work_group_size, &matrix, &x,
+                      &y_sequential, &y_parallel, &carry_row, &carry_value)) {
+    cout << "Memory allocation failure.\n";
+    FreeMemory(q, &matrix, x, y_sequential, y_parallel, carry_row,
+               carry_value);
+    return false;
+  }
+
+  // Initialize.
+  if (source != nullptr) {
+    InitializeSparseMatrixAndVector(*source, &matrix, x);
+  } else {
+    InitializeSparseMatrixAndVector(&matrix, x);
+  }
+
+  // Warm up the JIT and the thread pool.
+  MergeSparseMatrixVector(q, compute_units, work_group_size, matrix, x,
+                          y_parallel, carry_row, carry_value);
+  MergeSparseMatrixVector(host_thread_count, matrix, x, y_thread.data(),
+                          host_carry_row.data(), host_carry_value.data());
+
+  // Time executions.
+  double elapsed_s = 0;
+  double elapsed_t = 0;
+  double elapsed_p = 0;
+  int i;
+
+  cout << "Repeating " << repetitions << " times to measure run time ...\n";
+
+  for (i = 0; i < repetitions; i++) {
+    // Sequential compute.
+    dpc_common::TimeInterval timer_s;
+
+    MergeSparseMatrixVector(&matrix, x, y_sequential);
+    elapsed_s += timer_s.Elapsed();
+
+    // Parallel compute on the host.
+    dpc_common::TimeInterval timer_t;
+
+    MergeSparseMatrixVector(host_thread_count, matrix, x, y_thread.data(),
+                            host_carry_row.data(), host_carry_value.data());
+    elapsed_t += timer_t.Elapsed();
+
+    // Parallel compute.
+    dpc_common::TimeInterval timer_p;
+
+    MergeSparseMatrixVector(q, compute_units, work_group_size, matrix, x,
+                            y_parallel, carry_row, carry_value);
+    elapsed_p += timer_p.Elapsed();
+
+    // Verify the results are equal.
+    if (!VerifyVectorsAreEqual(matrix, x, y_sequential, y_thread.data()) ||
+        !VerifyVectorsAreEqual(matrix, x, y_sequential, y_parallel)) {
+      cout << "Failed to correctly compute!\n";
+      break;
+    }
+  }
+
+  if (i == repetitions) {
+    cout << "Successfully completed sparse matrix and vector "
+            "multiplication!\n";
+
+    elapsed_s /= repetitions;
+    elapsed_t /= repetitions;
+    elapsed_p /= repetitions;
+
+    cout << "Time sequential: " << elapsed_s << " sec ("
+         << Gflops(matrix, elapsed_s) << " GFLOPS, "
+         << Bandwidth(matrix, elapsed_s) << " GB/s)\n";
+    cout << "Time threads: " << elapsed_t << " sec ("
+         << Gflops(matrix, elapsed_t) << " GFLOPS, "
+         << Bandwidth(matrix, elapsed_t) << " GB/s)\n";
+    cout << "Time parallel: " << elapsed_p << " sec ("
+         << Gflops(matrix, elapsed_p) << " GFLOPS, "
+         << Bandwidth(matrix, elapsed_p) << " GB/s)\n";
+
+    *result = {name, matrix, elapsed_s, elapsed_t, elapsed_p};
+  }
+
+  FreeMemory(q, &matrix, x, y_sequential, y_parallel, carry_row, carry_value);
+
+  return i == repetitions;
+}
+
+// Print the GFLOPS and the effective bandwidth of the three implementations
+// on all the matrices.
+void PrintSummary(const vector<BenchmarkResult> &results) {
+  cout << "\n"
+       << left << setw(24) << "Matrix" << right << setw(10) << "Rows"
+       << setw(12) << "Nonzeros" << setw(20) << "Sequential" << setw(20)
+       << "Threads" << setw(20) << "Parallel"
+       << "\n"
+       << setw(46) << ""
+       << "   GFLOPS      GB/s   GFLOPS      GB/s   GFLOPS      GB/s\n";
+
+  cout << fixed << setprecision(2);
+
+  for (auto &result : results) {
+    cout << left << setw(24) << result.name.substr(0, 23) << right
+         << setw(10) << result.matrix.num_rows << setw(12)
+         << result.matrix.nonzero;
+
+    for (double elapsed : {result.elapsed_s, result.elapsed_t,
+                           result.elapsed_p}) {
+      cout << setw(9) << Gflops(result.matrix, elapsed) << setw(11)
+           << Bandwidth(result.matrix, elapsed);
+    }
+
+    cout << "\n";
+  }
+
+  cout << defaultfloat;
+}
+
+int main(int argc, char *argv[]) {
+  // Matrix Market files to multiply. A random matrix is used if there are
+  // none.
+  vector<string> paths;
+
+  if (argc > 1) {
+    error_code error;
+
+    if (filesystem::is_directory(argv[1], error)) {
+      for (auto &entry : filesystem::directory_iterator(argv[1], error)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".mtx") {
+          paths.push_back(entry.path().string());
+        }
+      }
+
+      sort(paths.begin(), paths.end());
+
+      if (paths.empty()) {
+        cout << "No Matrix Market (.mtx) files in " << argv[1] << ".\n";
+        return -1;
+      }
+    } else {
+      paths.push_back(argv[1]);
+    }
+  }
+
+  bool success = true;
 
   try {
     queue q{default_selector_v};
@@ -395,71 +667,56 @@ int main() {
         work_group_size /= 2;
     }
 
+    // Number of threads of the parallel computation on the host.
+    int host_thread_count = 1;
+#ifdef _OPENMP
+    host_thread_count = omp_get_max_threads();
+#endif
+
     cout << "Compute units: " << compute_units << "\n";
     cout << "Work group size: " << work_group_size << "\n";
+    cout << "Host threads: " << host_thread_count << "\n";
 
-    // Allocate memory.
-    if (!AllocateMemory(q, compute_units * work_group_size, &matrix, &x,
-                        &y_sequential, &y_parallel, &carry_row, &carry_value)) {
-      cout << "Memory allocation failure.\n";
-      FreeMemory(q, &matrix, x, y_sequential, y_parallel, carry_row,
-                 carry_value);
-      return -1;
-    }
-
-    // Initialize.
-    InitializeSparseMatrixAndVector(&matrix, x);
-
-    // Warm up the JIT.
-    MergeSparseMatrixVector(q, compute_units, work_group_size, matrix, x,
-                            y_parallel, carry_row, carry_value);
-
-    // Time executions.
-    double elapsed_s = 0;
-    double elapsed_p = 0;
-    int i;
-
-    cout << "Repeating " << repetitions << " times to measure run time ...\n";
+    vector<BenchmarkResult> results;
+    BenchmarkResult result;
 
-    for (i = 0; i < repetitions; i++) {
-      cout << "Iteration: " << (i + 1) << "\n";
+    if (paths.empty()) {
+      if (RunBenchmark(q, compute_units, work_group_size, host_thread_count,
+                       "random", nullptr, &result)) {
+        results.push_back(result);
+      } else {
+        success = false;
+      }
+    }
 
-      // Sequential compute.
-      dpc_common::TimeInterval timer_s;
+    for (auto &path : paths) {
+      MatrixMarketCsr source;
+      dpc_common::TimeInterval timer;
 
-      MergeSparseMatrixVector(&matrix, x, y_sequential);
-      elapsed_s += timer_s.Elapsed();
+      if (!ReadMatrixMarket(path, source)) {
+        success = false;
+        continue;
+      }
 
-      // Parallel compute.
-      dpc_common::TimeInterval timer_p;
+      cout << "\nRead " << path << " in " << timer.Elapsed() << " sec\n";
 
-      MergeSparseMatrixVector(q, compute_units, work_group_size, matrix, x,
-                              y_parallel, carry_row, carry_value);
-      elapsed_p += timer_p.Elapsed();
+      string name = filesystem::path(path).stem().string();
 
-      // Verify two results are equal.
-      if (!VerifyVectorsAreEqual(y_sequential, y_parallel)) {
-        cout << "Failed to correctly compute!\n";
-        break;
+      if (RunBenchmark(q, compute_units, work_group_size, host_thread_count,
+                       name, &source, &result)) {
+        results.push_back(result);
+      } else {
+        success = false;
       }
     }
 
-    if (i == repetitions) {
-      cout << "Successfully completed sparse matrix and vector "
-              "multiplication!\n";
-
-      elapsed_s /= repetitions;
-      elapsed_p /= repetitions;
-
-      cout << "Time sequential: " << elapsed_s << " sec\n";
-      cout << "Time parallel: " << elapsed_p << " sec\n";
+    if (paths.size() > 1) {
+      PrintSummary(results);
     }
-
-    FreeMemory(q, &matrix, x, y_sequential, y_parallel, carry_row, carry_value);
   } catch (std::exception const &e) {
     cout << "An exception is caught while computing on device.\n";
     terminate();
   }
 
-  return 0;
+  return success ? 0 : -1;
 }
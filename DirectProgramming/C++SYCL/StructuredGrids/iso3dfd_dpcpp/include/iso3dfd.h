@@ -29,17 +29,28 @@ constexpr unsigned int kHalfLength = 8;
  */
 constexpr unsigned int kPad = 0;
 
+class SnapshotWriter;
+
 bool Iso3dfdDevice(sycl::queue &q, float *ptr_next, float *ptr_prev,
                      float *ptr_vel, float *ptr_coeff, size_t n1, size_t n2,
                      size_t n3, size_t n1_block, size_t n2_block,
-                     size_t n3_block, size_t end_z, unsigned int num_iterations);
+                     size_t n3_block, size_t end_z, unsigned int num_iterations,
+                     SnapshotWriter *snapshots = nullptr,
+                     unsigned int first_iteration = 0);
+
+bool Iso3dfdDeviceTemporal(sycl::queue &q, float *ptr_next, float *ptr_prev,
+                           float *ptr_vel, float *ptr_coeff, size_t n1,
+                           size_t n2, size_t n3, size_t n1_block,
+                           size_t n2_block, size_t n3_block, size_t end_z,
+                           unsigned int num_iterations,
+                           unsigned int time_block, size_t slab_z);
 
 void PrintTargetInfo(sycl::queue &q, unsigned int dim_x, unsigned int dim_y);
 
 void Usage(const std::string &program_name);
 
 void PrintStats(double time, size_t n1, size_t n2, size_t n3,
-                unsigned int num_iterations);
+                unsigned int num_iterations, double baseline_time = 0.0);
 
 bool WithinEpsilon(float *output, float *reference, const size_t dim_x,
                     const size_t dim_y, const size_t dim_z,
@@ -0,0 +1,365 @@
+//==============================================================
+// Copyright © 2020 Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+// =============================================================
+
+#ifndef SNAPSHOTWRITER_HPP
+#define SNAPSHOTWRITER_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sycl/sycl.hpp>
+
+// Header of the snapshot and checkpoint files. It is followed by 'fields'
+// wavefields of n1 * n2 * n3 floats: the newest wavefield, then (for
+// checkpoints) the one from the timestep before it.
+struct SnapshotHeader {
+  char magic[8];
+  uint64_t n1, n2, n3;
+  uint32_t iterations;  // number of timesteps done
+  uint32_t fields;      // 1 for snapshots, 2 for checkpoints
+};
+
+constexpr char kSnapshotMagic[8] = "ISO3DFD";
+
+// This class writes snapshots and checkpoints of the wavefields on a
+// background thread, while the next timesteps are computed.
+//
+// Snapshots ('<prefix>_snapshot_<timestep>.bin') hold the newest wavefield,
+// every snapshot_every timesteps, e.g. for imaging.
+// Checkpoints ('<prefix>_checkpoint.bin') hold both wavefields, every
+// checkpoint_every timesteps, so that the run can be resumed from them with
+// LoadCheckpoint. A checkpoint is written to a temporary file first, so a
+// run that is stopped while writing keeps the previous checkpoint.
+//
+// Save copies the wavefields to one of num_buffers staging buffers, and only
+// waits if all of them are still being written.
+class SnapshotWriter {
+ public:
+  SnapshotWriter(const std::string &prefix, size_t n1, size_t n2, size_t n3,
+                 unsigned int snapshot_every, unsigned int checkpoint_every,
+                 unsigned int num_buffers = 2)
+      : prefix_(prefix),
+        n1_(n1),
+        n2_(n2),
+        n3_(n3),
+        grid_size_(n1 * n2 * n3),
+        snapshot_every_(snapshot_every),
+        checkpoint_every_(checkpoint_every),
+        slots_(num_buffers) {
+    for (auto &slot : slots_) {
+      slot.data.resize(grid_size_ * (checkpoint_every_ ? 2 : 1));
+      free_.push_back(&slot);
+    }
+    writer_thread_ = std::thread(&SnapshotWriter::WriterThread, this);
+  }
+
+  SnapshotWriter(const SnapshotWriter &) = delete;
+  SnapshotWriter &operator=(const SnapshotWriter &) = delete;
+
+  ~SnapshotWriter() {
+    Wait();
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      stop_ = true;
+    }
+    cv_.notify_all();
+    writer_thread_.join();
+  }
+
+  // True if a snapshot or a checkpoint is due after the timestep 'it'
+  // (counting from 0)
+  bool Due(unsigned int it) const {
+    return IsSnapshot(it) || IsCheckpoint(it);
+  }
+
+  // Saves the wavefields after the timestep 'it' from host memory.
+  // The timestep 'it' wrote 'next' if 'it' is even, 'prev' otherwise.
+  void Save(unsigned int it, const float *next, const float *prev) {
+    auto start = std::chrono::steady_clock::now();
+    Slot *slot = Acquire(it);
+    const float *newest = it % 2 == 0 ? next : prev;
+    const float *older = it % 2 == 0 ? prev : next;
+    std::memcpy(slot->data.data(), newest, grid_size_ * sizeof(float));
+    if (slot->checkpoint)
+      std::memcpy(slot->data.data() + grid_size_, older,
+                  grid_size_ * sizeof(float));
+    Launch(slot);
+    host_time_ += Elapsed(start);
+  }
+
+  // Saves the wavefields after the timestep 'it' from SYCL buffers.
+  // The copies are submitted to 'q' after the kernel of the timestep, and
+  // the writer thread waits for them, so the caller can submit the next
+  // timesteps right away.
+  void Save(sycl::queue &q, unsigned int it, sycl::buffer<float, 1> &next,
+            sycl::buffer<float, 1> &prev) {
+    auto start = std::chrono::steady_clock::now();
+    Slot *slot = Acquire(it);
+    auto &newest = it % 2 == 0 ? next : prev;
+    auto &older = it % 2 == 0 ? prev : next;
+    slot->copies.push_back(q.submit([&](auto &h) {
+      sycl::accessor field(newest, h, sycl::read_only);
+      h.copy(field, slot->data.data());
+    }));
+    if (slot->checkpoint)
+      slot->copies.push_back(q.submit([&](auto &h) {
+        sycl::accessor field(older, h, sycl::read_only);
+        h.copy(field, slot->data.data() + grid_size_);
+      }));
+    slot->profiling =
+        q.has_property<sycl::property::queue::enable_profiling>();
+    Launch(slot);
+    host_time_ += Elapsed(start);
+  }
+
+  // Waits for all the saved wavefields to be written
+  void Wait() {
+    auto start = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(mtx_);
+    cv_.wait(lock, [&] { return free_.size() == slots_.size(); });
+    host_time_ += Elapsed(start);
+  }
+
+  bool Failed() const { return failed_; }
+
+  // Prints the snapshot stats of a run of 'num_iterations' timesteps that
+  // took 'time' ms. The overhead is the time the timesteps were held up by
+  // the snapshots: the time spent in Save and Wait, and the device time of
+  // the copies.
+  void PrintStats(double time, unsigned int num_iterations) {
+    double overhead = host_time_ + copy_time_;
+    double step_time = time / num_iterations;
+
+    std::cout << "snapshots    : " << snapshots_ << " snapshots, "
+              << checkpoints_ << " checkpoints\n";
+    if (snapshots_ + checkpoints_ == 0) return;
+    std::cout << "written      : " << bytes_ / 1e9 << " GBytes at "
+              << bytes_ / (write_time_ * 1e6) << " GBytes/s (background)\n";
+    std::cout << "overhead     : " << overhead / 1e3 << " secs, "
+              << 100.0 * overhead / time << "% of the step time\n";
+    std::cout << "per save     : " << overhead / saves_ << " ms, "
+              << 100.0 * overhead / saves_ / step_time
+              << "% of a timestep\n";
+  }
+
+  // Loads the checkpoint '<prefix>_checkpoint.bin' into the wavefields and
+  // sets 'iterations' to the number of timesteps it was taken after.
+  // Returns false if there is no valid checkpoint for this grid.
+  static bool LoadCheckpoint(const std::string &prefix, size_t n1, size_t n2,
+                             size_t n3, float *next, float *prev,
+                             unsigned int &iterations) {
+    std::string file_name = prefix + "_checkpoint.bin";
+    FILE *file = std::fopen(file_name.c_str(), "rb");
+    if (file == nullptr) {
+      std::cerr << "ERROR: could not open the checkpoint " << file_name
+                << "\n";
+      return false;
+    }
+
+    SnapshotHeader header;
+    bool valid = std::fread(&header, sizeof(header), 1, file) == 1 &&
+                 std::memcmp(header.magic, kSnapshotMagic,
+                             sizeof(kSnapshotMagic)) == 0 &&
+                 header.fields == 2;
+    if (!valid) {
+      std::cerr << "ERROR: " << file_name << " is not a checkpoint\n";
+      std::fclose(file);
+      return false;
+    }
+    if (header.n1 != n1 || header.n2 != n2 || header.n3 != n3) {
+      std::cerr << "ERROR: the checkpoint " << file_name
+                << " is for a different grid size\n";
+      std::fclose(file);
+      return false;
+    }
+
+    // The timestep 'iterations - 1' wrote 'next' if it is even
+    size_t grid_size = n1 * n2 * n3;
+    float *newest = header.iterations % 2 ? next : prev;
+    float *older = header.iterations % 2 ? prev : next;
+    valid = std::fread(newest, sizeof(float), grid_size, file) == grid_size &&
+            std::fread(older, sizeof(float), grid_size, file) == grid_size;
+    std::fclose(file);
+    if (!valid) {
+      std::cerr << "ERROR: the checkpoint " << file_name << " is truncated\n";
+      return false;
+    }
+
+    iterations = header.iterations;
+    std::cout << " Restarting from " << file_name << " after timestep "
+              << iterations << "\n";
+    return true;
+  }
+
+ private:
+  // A staging buffer for the wavefields of one timestep
+  struct Slot {
+    std::vector<float> data;  // newest wavefield, then the older one
+    unsigned int iterations;
+    bool snapshot, checkpoint;
+    std::vector<sycl::event> copies;  // device to host copies to wait for
+    bool profiling;
+  };
+
+  bool IsSnapshot(unsigned int it) const {
+    return snapshot_every_ && (it + 1) % snapshot_every_ == 0;
+  }
+
+  bool IsCheckpoint(unsigned int it) const {
+    return checkpoint_every_ && (it + 1) % checkpoint_every_ == 0;
+  }
+
+  static double Elapsed(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+  }
+
+  // Waits for a free staging buffer for the timestep 'it'
+  Slot *Acquire(unsigned int it) {
+    Slot *slot;
+    {
+      std::unique_lock<std::mutex> lock(mtx_);
+      cv_.wait(lock, [&] { return !free_.empty(); });
+      slot = free_.front();
+      free_.pop_front();
+    }
+    slot->iterations = it + 1;
+    slot->snapshot = IsSnapshot(it);
+    slot->checkpoint = IsCheckpoint(it);
+    slot->profiling = false;
+    saves_++;
+    return slot;
+  }
+
+  // Hands a staging buffer over to the writer thread
+  void Launch(Slot *slot) {
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      pending_.push_back(slot);
+    }
+    cv_.notify_all();
+  }
+
+  // Writes 'fields' wavefields of 'slot' to 'file_name'
+  bool WriteFile(const std::string &file_name, const Slot *slot,
+                 uint32_t fields) {
+    SnapshotHeader header;
+    std::memcpy(header.magic, kSnapshotMagic, sizeof(kSnapshotMagic));
+    header.n1 = n1_;
+    header.n2 = n2_;
+    header.n3 = n3_;
+    header.iterations = slot->iterations;
+    header.fields = fields;
+
+    FILE *file = std::fopen(file_name.c_str(), "wb");
+    if (file == nullptr) {
+      std::cerr << "ERROR: could not open " << file_name << "\n";
+      return false;
+    }
+    size_t count = grid_size_ * fields;
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+              std::fwrite(slot->data.data(), sizeof(float), count, file) ==
+                  count;
+    ok = std::fclose(file) == 0 && ok;
+    if (!ok) {
+      std::cerr << "ERROR: could not write " << file_name << "\n";
+      return false;
+    }
+    bytes_ += sizeof(header) + count * sizeof(float);
+    return true;
+  }
+
+  // Writes the staging buffers in the order they were saved
+  void WriterThread() {
+    while (true) {
+      Slot *slot;
+      {
+        std::unique_lock<std::mutex> lock(mtx_);
+        cv_.wait(lock, [&] { return !pending_.empty() || stop_; });
+        if (pending_.empty()) return;
+        slot = pending_.front();
+        pending_.pop_front();
+      }
+
+      // Wait for the wavefields to be copied from the device
+      sycl::event::wait(slot->copies);
+      if (slot->profiling) {
+        for (auto &e : slot->copies) {
+          auto start = e.get_profiling_info<
+              sycl::info::event_profiling::command_start>();
+          auto end =
+              e.get_profiling_info<sycl::info::event_profiling::command_end>();
+          copy_time_ += (end - start) / 1e6;
+        }
+      }
+      slot->copies.clear();
+
+      auto start = std::chrono::steady_clock::now();
+      bool ok = true;
+      if (slot->snapshot) {
+        ok = WriteFile(prefix_ + "_snapshot_" +
+                           std::to_string(slot->iterations) + ".bin",
+                       slot, 1);
+        snapshots_ += ok;
+      }
+      if (slot->checkpoint) {
+        std::string file_name = prefix_ + "_checkpoint.bin";
+        bool written = WriteFile(file_name + ".tmp", slot, 2);
+#ifdef _WIN32
+        // rename does not replace an existing file on Windows
+        if (written) std::remove(file_name.c_str());
+#endif
+        written =
+            written &&
+            std::rename((file_name + ".tmp").c_str(), file_name.c_str()) == 0;
+        checkpoints_ += written;
+        ok = ok && written;
+      }
+      write_time_ += Elapsed(start);
+      if (!ok) failed_ = true;
+
+      {
+        std::lock_guard<std::mutex> lock(mtx_);
+        free_.push_back(slot);
+      }
+      cv_.notify_all();
+    }
+  }
+
+  std::string prefix_;
+  size_t n1_, n2_, n3_, grid_size_;
+  unsigned int snapshot_every_, checkpoint_every_;
+  std::vector<Slot> slots_;
+
+  // Stats, the times are in ms. The writer thread updates the ones below
+  // host_time_, which are only read after Wait.
+  double host_time_ = 0.0;
+  unsigned int saves_ = 0;
+  double copy_time_ = 0.0;
+  double write_time_ = 0.0;
+  size_t bytes_ = 0;
+  unsigned int snapshots_ = 0, checkpoints_ = 0;
+  bool failed_ = false;
+
+  // The free staging buffers, and the ones waiting to be written, in order
+  std::mutex mtx_;
+  std::condition_variable cv_;
+  std::deque<Slot *> free_;
+  std::deque<Slot *> pending_;
+  bool stop_ = false;
+  std::thread writer_thread_;
+};
+
+#endif
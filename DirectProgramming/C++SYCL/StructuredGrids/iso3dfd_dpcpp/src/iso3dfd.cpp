@@ -32,10 +32,12 @@
 //
 #include "iso3dfd.h"
 #include <iostream>
+#include <memory>
 #include <string>
 #include <CL/sycl.hpp>
 #include "device_selector.hpp"
 #include "dpc_common.hpp"
+#include "snapshot_writer.hpp"
 
 /*
  * Host-Code
@@ -131,24 +133,139 @@ void Iso3dfdIteration(float* ptr_next_base, float* ptr_prev_base,
  * Driver function for ISO3DFD OpenMP code
  * Uses ptr_next and ptr_prev as ping-pong buffers to achieve
  * accelerated wave propogation
+ * If snapshots is set, the wavefields are saved with it when a snapshot
+ * or a checkpoint is due. The run starts at the timestep first_iteration
+ * when it resumes from a checkpoint.
  */
 void Iso3dfd(float* ptr_next, float* ptr_prev, float* ptr_vel, float* coeff,
              const size_t n1, const size_t n2, const size_t n3,
              const unsigned int nreps, const size_t n1_block,
-             const size_t n2_block, const size_t n3_block) {
-  for (unsigned int it = 0; it < nreps; it += 1) {
-    Iso3dfdIteration(ptr_next, ptr_prev, ptr_vel, coeff, n1, n2, n3, n1_block,
-                     n2_block, n3_block);
+             const size_t n2_block, const size_t n3_block,
+             SnapshotWriter* snapshots, const unsigned int first_iteration) {
+  for (unsigned int it = first_iteration; it < nreps; it += 1) {
+    // Swap previous & next between iterations
+    if (it % 2 == 0)
+      Iso3dfdIteration(ptr_next, ptr_prev, ptr_vel, coeff, n1, n2, n3,
+                       n1_block, n2_block, n3_block);
+    else
+      Iso3dfdIteration(ptr_prev, ptr_next, ptr_vel, coeff, n1, n2, n3,
+                       n1_block, n2_block, n3_block);
 
     // here's where boundary conditions and halo exchanges happen
-    // Swap previous & next between iterations
-    it++;
-    if (it < nreps)
-      Iso3dfdIteration(ptr_prev, ptr_next, ptr_vel, coeff, n1, n2, n3, n1_block,
-                       n2_block, n3_block);
+    if (snapshots && snapshots->Due(it))
+      snapshots->Save(it, ptr_next, ptr_prev);
+  }  // time loop
+}
+
+/*
+ * Host-Code
+ * OpenMP implementation of iso3dfd with temporal blocking.
+ * Each pass over the grid advances time_block timesteps as a wavefront in
+ * the z-dimension: a plane is updated to timestep t + 1 as soon as the
+ * planes it depends on reach timestep t, i.e. kHalfLength planes behind the
+ * front of timestep t, while those planes are still in the cache.
+ * The threads share the cache blocks of each plane and move through the
+ * wavefront together.
+ * Like Iso3dfd, next and prev are updated in place.
+ */
+void Iso3dfdTemporal(float* ptr_next_base, float* ptr_prev_base,
+                     float* ptr_vel_base, float* coeff, const size_t n1,
+                     const size_t n2, const size_t n3,
+                     const unsigned int nreps, const size_t n1_block,
+                     const size_t n2_block, const unsigned int time_block) {
+  size_t dimn1n2 = n1 * n2;
+  size_t n3End = n3 - kHalfLength;
+  size_t n2End = n2 - kHalfLength;
+  size_t n1End = n1 - kHalfLength;
+
+  for (unsigned int it = 0; it < nreps; it += time_block) {
+    unsigned int steps = std::min(time_block, nreps - it);
+
+#pragma omp parallel default(shared)
+    for (size_t wz = kHalfLength; wz < n3End + (steps - 1) * kHalfLength;
+         wz++) {  // start of wavefront
+      for (unsigned int s = 0; s < steps; s++) {
+        // timestep it + s updates the plane s * kHalfLength behind the front
+        if (wz < (s + 1) * kHalfLength || wz - s * kHalfLength >= n3End)
+          continue;
+        size_t iz = wz - s * kHalfLength;
+
+        // Swap previous & next between timesteps
+        float* ptr_out_base = (it + s) % 2 ? ptr_prev_base : ptr_next_base;
+        float* ptr_in_base = (it + s) % 2 ? ptr_next_base : ptr_prev_base;
+
+#pragma omp for schedule(static) collapse(2)
+        for (size_t by = kHalfLength; by < n2End; by += n2_block) {
+          for (size_t bx = kHalfLength; bx < n1End; bx += n1_block) {
+            int iyEnd = std::min(by + n2_block, n2End);
+            int ixEnd = std::min(n1_block, n1End - bx);
+            for (size_t iy = by; iy < iyEnd; iy++) {
+              float* ptr_next = ptr_out_base + iz * dimn1n2 + iy * n1 + bx;
+              float* ptr_prev = ptr_in_base + iz * dimn1n2 + iy * n1 + bx;
+              float* ptr_vel = ptr_vel_base + iz * dimn1n2 + iy * n1 + bx;
+#pragma omp simd
+              for (size_t ix = 0; ix < ixEnd; ix++) {
+                float value = 0.0;
+                value += ptr_prev[ix] * coeff[0];
+#pragma unroll(kHalfLength)
+                for (unsigned int ir = 1; ir <= kHalfLength; ir++) {
+                  value += coeff[ir] *
+                           ((ptr_prev[ix + ir] + ptr_prev[ix - ir]) +
+                            (ptr_prev[ix + ir * n1] + ptr_prev[ix - ir * n1]) +
+                            (ptr_prev[ix + ir * dimn1n2] +
+                             ptr_prev[ix - ir * dimn1n2]));
+                }
+                ptr_next[ix] =
+                    2.0f * ptr_prev[ix] - ptr_next[ix] + value * ptr_vel[ix];
+              }
+            }
+          }
+        }  // implicit barrier: the plane is done before the next timestep
+      }
+    }  // end of wavefront
   }  // time loop
 }
 
+/*
+ * Host-Code
+ * Compares the final wavefield of a run with temporal blocking with the
+ * one of the run with one timestep per pass
+ */
+bool CheckTemporalBlocking(float* output, float* reference, const size_t n1,
+                           const size_t n2, const size_t n3,
+                           const std::string& variant) {
+  bool error =
+      WithinEpsilon(output, reference, n1, n2, n3, kHalfLength, 0, 0.1f);
+  if (error) {
+    std::cout << "Final wavefields from " << variant << " with and without "
+              << "temporal blocking are not equivalent: Fail\n";
+  } else {
+    std::cout << "Final wavefields from " << variant << " with and without "
+              << "temporal blocking are equivalent: Success\n";
+  }
+  std::cout << "--------------------------------------\n";
+  return error;
+}
+
+/*
+ * Host-Code
+ * Loads the last checkpoint of a variant to resume the run from it
+ */
+bool Restart(const std::string& prefix, float* next, float* prev,
+             const size_t n1, const size_t n2, const size_t n3,
+             const unsigned int num_iterations, unsigned int& first_iteration) {
+  if (!SnapshotWriter::LoadCheckpoint(prefix, n1, n2, n3, next, prev,
+                                      first_iteration))
+    return false;
+  if (first_iteration >= num_iterations) {
+    std::cerr << "ERROR: the checkpoint is after timestep " << first_iteration
+              << ", there is nothing left to run of the " << num_iterations
+              << " timesteps\n";
+    return false;
+  }
+  return true;
+}
+
 /*
  * Host-Code
  * Main function to drive the sample application
@@ -161,6 +278,8 @@ int main(int argc, char* argv[]) {
   float* vel_base;
   // Array to store results for comparison
   float* temp;
+  // Array to store the per-step results when using temporal blocking
+  float* reference = nullptr;
 
   bool sycl = true;
   bool omp = true;
@@ -171,6 +290,17 @@ int main(int argc, char* argv[]) {
   size_t n1_block, n2_block, n3_block;
   unsigned int num_iterations;
 
+  // Timesteps per pass over the grid with temporal blocking (0 to disable)
+  // and the size of the SYCL slabs in the z-dimension
+  unsigned int time_block = 0;
+  size_t slab_z = 2 * kHalfLength;
+
+  // Timesteps between snapshots and between checkpoints (0 for none), and
+  // whether to resume from the last checkpoint
+  unsigned int snapshot_every = 0;
+  unsigned int checkpoint_every = 0;
+  bool restart = false;
+
   // Read Input Parameters
   try {
     n1 = std::stoi(argv[1]) + (2 * kHalfLength);
@@ -202,12 +332,53 @@ int main(int argc, char* argv[]) {
       is_gpu = true;
     } else if (arg_value == "cpu") {
       is_gpu = false;
+    } else if (arg_value.rfind("tb=", 0) == 0) {
+      int steps = 0, slab = slab_z;
+      try {
+        size_t comma = arg_value.find(',');
+        steps = std::stoi(arg_value.substr(3, comma - 3));
+        if (comma != std::string::npos)
+          slab = std::stoi(arg_value.substr(comma + 1));
+      } catch (...) {
+        steps = 0;
+      }
+      if (steps < 1 || slab < 1) {
+        Usage(argv[0]);
+        return 1;
+      }
+      time_block = steps;
+      slab_z = slab;
+    } else if (arg_value.rfind("snap=", 0) == 0 ||
+               arg_value.rfind("ckpt=", 0) == 0) {
+      int every = 0;
+      try {
+        every = std::stoi(arg_value.substr(5));
+      } catch (...) {
+        every = 0;
+      }
+      if (every < 1) {
+        Usage(argv[0]);
+        return 1;
+      }
+      if (arg_value[0] == 's')
+        snapshot_every = every;
+      else
+        checkpoint_every = every;
+    } else if (arg_value == "restart") {
+      restart = true;
     } else {
       Usage(argv[0]);
       return 1;
     }
   }
 
+  if (time_block && (snapshot_every || checkpoint_every || restart)) {
+    std::cout << " ERROR: snapshots, checkpoints and restart are not supported"
+              << " with temporal blocking\n";
+    Usage(argv[0]);
+    return 1;
+  }
+
   // Validate input sizes for the grid and block dimensions
   if (CheckGridDimension(n1 - 2 * kHalfLength, n2 - 2 * kHalfLength,
                          n3 - 2 * kHalfLength, n1_block, n2_block, n3_block)) {
@@ -249,15 +420,52 @@ int main(int argc, char* argv[]) {
     // Initialize arrays and introduce initial conditions (source)
     Initialize(prev_base, next_base, vel_base, n1, n2, n3);
 
+    // Resume from the last checkpoint of the OpenMP variant
+    unsigned int first_iteration = 0;
+    if (restart && !Restart("iso3dfd_omp", next_base, prev_base, n1, n2, n3,
+                            num_iterations, first_iteration))
+      return 1;
+
+    std::unique_ptr<SnapshotWriter> snapshots;
+    if (snapshot_every || checkpoint_every)
+      snapshots = std::make_unique<SnapshotWriter>(
+          "iso3dfd_omp", n1, n2, n3, snapshot_every, checkpoint_every);
+
     // Start timer
     dpc_common::TimeInterval t_ser;
     // Invoke the driver function to perform 3D wave propogation
     // using OpenMP/Serial version
     Iso3dfd(next_base, prev_base, vel_base, coeff, n1, n2, n3, num_iterations,
-            n1_block, n2_block, n3_block);
+            n1_block, n2_block, n3_block, snapshots.get(), first_iteration);
+    // Wait for the last snapshots to be written
+    if (snapshots) snapshots->Wait();
 
     // End timer
-    PrintStats(t_ser.Elapsed() * 1e3, n1, n2, n3, num_iterations);
+    double time_ser = t_ser.Elapsed() * 1e3;
+    PrintStats(time_ser, n1, n2, n3, num_iterations - first_iteration);
+    if (snapshots) {
+      snapshots->PrintStats(time_ser, num_iterations - first_iteration);
+      error |= snapshots->Failed();
+    }
+
+    if (time_block) {
+      // Keep the per-step output to validate the temporal blocking
+      reference = new float[nsize];
+      memcpy(reference, num_iterations % 2 ? next_base : prev_base,
+             nsize * sizeof(float));
+
+      std::cout << " ***** Running OpenMP variant with temporal blocking ("
+                << time_block << " timesteps per pass) *****\n";
+      Initialize(prev_base, next_base, vel_base, n1, n2, n3);
+
+      dpc_common::TimeInterval t_tb;
+      Iso3dfdTemporal(next_base, prev_base, vel_base, coeff, n1, n2, n3,
+                      num_iterations, n1_block, n2_block, time_block);
+      PrintStats(t_tb.Elapsed() * 1e3, n1, n2, n3, num_iterations, time_ser);
+
+      error |= CheckTemporalBlocking(num_iterations % 2 ? next_base : prev_base,
+                                     reference, n1, n2, n3, "CPU");
+    }
   }
 
   // Check if running both OpenMP/Serial and SYCL version
@@ -277,6 +485,17 @@ int main(int argc, char* argv[]) {
     // Initialize arrays and introduce initial conditions (source)
     Initialize(prev_base, next_base, vel_base, n1, n2, n3);
 
+    // Resume from the last checkpoint of the SYCL variant
+    unsigned int first_iteration = 0;
+    if (restart && !Restart("iso3dfd_sycl", next_base, prev_base, n1, n2, n3,
+                            num_iterations, first_iteration))
+      return 1;
+
+    std::unique_ptr<SnapshotWriter> snapshots;
+    if (snapshot_every || checkpoint_every)
+      snapshots = std::make_unique<SnapshotWriter>(
+          "iso3dfd_sycl", n1, n2, n3, snapshot_every, checkpoint_every);
+
     // Initializing a string pattern to allow a custom device selector
     // pick a SYCL device as per user's preference and available devices
     // Default value of pattern is set to CPU
@@ -293,7 +512,10 @@ int main(int argc, char* argv[]) {
 
     // Create a device queue using SYCL class queue with a custom
     // device selector
-    queue q(device_sel);
+    // Profiling is enabled with snapshots to measure the time of the copies
+    queue q(device_sel,
+            snapshots ? property_list{property::queue::enable_profiling()}
+                      : property_list{});
 
     // Validate if the block sizes selected are
     // within range for the selected SYCL device
@@ -309,24 +531,55 @@ int main(int argc, char* argv[]) {
     // using SYCL version on the selected device
     Iso3dfdDevice(q, next_base, prev_base, vel_base, coeff, n1, n2, n3,
                   n1_block, n2_block, n3_block, n3 - kHalfLength,
-                  num_iterations);
+                  num_iterations, snapshots.get(), first_iteration);
     // Wait for the commands to complete. Enforce synchronization on the command
     // queue
     q.wait_and_throw();
+    // Wait for the last snapshots to be written
+    if (snapshots) snapshots->Wait();
 
     // End timer
-    PrintStats(t_dpc.Elapsed() * 1e3, n1, n2, n3, num_iterations);
+    double time_dpc = t_dpc.Elapsed() * 1e3;
+    PrintStats(time_dpc, n1, n2, n3, num_iterations - first_iteration);
+    if (snapshots) {
+      snapshots->PrintStats(time_dpc, num_iterations - first_iteration);
+      error |= snapshots->Failed();
+    }
+
+    if (time_block) {
+      // Keep the per-step output to validate the temporal blocking
+      if (!reference) reference = new float[nsize];
+      memcpy(reference, num_iterations % 2 ? next_base : prev_base,
+             nsize * sizeof(float));
+
+      std::cout << " ***** Running SYCL variant with temporal blocking ("
+                << time_block << " timesteps per pass) *****\n";
+      Initialize(prev_base, next_base, vel_base, n1, n2, n3);
+
+      dpc_common::TimeInterval t_tb;
+      Iso3dfdDeviceTemporal(q, next_base, prev_base, vel_base, coeff, n1, n2,
+                            n3, n1_block, n2_block, n3_block, n3 - kHalfLength,
+                            num_iterations, time_block, slab_z);
+      q.wait_and_throw();
+      PrintStats(t_tb.Elapsed() * 1e3, n1, n2, n3, num_iterations, time_dpc);
+
+      error |= CheckTemporalBlocking(num_iterations % 2 ? next_base : prev_base,
+                                     reference, n1, n2, n3, "SYCL device");
+    }
   }
 
   // If running both OpenMP/Serial and SYCL version
   // Comparing results
   if (omp && sycl) {
+    bool mismatch;
     if (num_iterations % 2) {
-      error = WithinEpsilon(next_base, temp, n1, n2, n3, kHalfLength, 0, 0.1f);
+      mismatch =
+          WithinEpsilon(next_base, temp, n1, n2, n3, kHalfLength, 0, 0.1f);
     } else {
-      error = WithinEpsilon(prev_base, temp, n1, n2, n3, kHalfLength, 0, 0.1f);
+      mismatch =
+          WithinEpsilon(prev_base, temp, n1, n2, n3, kHalfLength, 0, 0.1f);
     }
-    if (error) {
+    if (mismatch) {
       std::cout << "Final wavefields from SYCL device and CPU are not "
                 << "equivalent: Fail\n";
     } else {
@@ -334,12 +587,14 @@ int main(int argc, char* argv[]) {
                 << " Success\n";
     }
     std::cout << "--------------------------------------\n";
+    error |= mismatch;
     delete[] temp;
   }
 
   delete[] prev_base;
   delete[] next_base;
   delete[] vel_base;
+  delete[] reference;
 
   return error ? 1 : 0;
 }
@@ -32,6 +32,7 @@
 // SYCL Basic synchronization (barrier function)
 //
 #include "iso3dfd.h"
+#include "snapshot_writer.hpp"
 
 /*
  * Device-Code - Optimized for GPU
@@ -50,7 +51,7 @@
 void Iso3dfdIterationSLM(sycl::nd_item<3> it, float *next, float *prev,
                          float *vel, const float *coeff, float *tab, size_t nx,
                          size_t nxy, size_t bx, size_t by, size_t z_offset,
-                         int full_end_z) {
+                         int start_z, int full_end_z) {
   // Compute local-id for each work-item
   auto id0 = it.get_local_id(2);
   auto id1 = it.get_local_id(1);
@@ -67,8 +68,9 @@ void Iso3dfdIterationSLM(sycl::nd_item<3> it, float *next, float *prev,
   // current cell/grid point it is working with.
   // This position is calculated with the help of slice-ID and number of
   // grid points each work-item will process.
-  // Offset of kHalfLength is also used to account for HALO
-  auto begin_z = it.get_global_id(0) * z_offset + kHalfLength;
+  // The slices start at start_z, which is kHalfLength (to account for
+  // the HALO) unless only a part of the grid is computed
+  auto begin_z = it.get_global_id(0) * z_offset + start_z;
   auto end_z = begin_z + z_offset;
   if (end_z > full_end_z) end_z = full_end_z;
 
@@ -187,15 +189,17 @@ void Iso3dfdIterationSLM(sycl::nd_item<3> it, float *next, float *prev,
  */
 void Iso3dfdIterationGlobal(sycl::nd_item<3> it, float *next, float *prev,
                             float *vel, const float *coeff, int nx, int nxy,
-                            int bx, int by, int z_offset, int full_end_z) {
+                            int bx, int by, int z_offset, int start_z,
+                            int full_end_z) {
   // We compute the start and the end position in the grid
   // for each work-item.
   // Each work-items local value gid is updated to track the
   // current cell/grid point it is working with.
   // This position is calculated with the help of slice-ID and number of
   // grid points each work-item will process.
-  // Offset of kHalfLength is also used to account for HALO
-  auto begin_z = it.get_global_id(0) * z_offset + kHalfLength;
+  // The slices start at start_z, which is kHalfLength (to account for
+  // the HALO) unless only a part of the grid is computed
+  auto begin_z = it.get_global_id(0) * z_offset + start_z;
   auto end_z = begin_z + z_offset;
   if (end_z > full_end_z) end_z = full_end_z;
 
@@ -273,6 +277,134 @@ void Iso3dfdIterationGlobal(sycl::nd_item<3> it, float *next, float *prev,
   }
 }
 
+/*
+ * Host-side SYCL Code
+ *
+ * Submits a single iteration of the iso3dfd kernel that updates
+ * the planes begin_z to end_z - 1 of the grid
+ *
+ * Even iterations compute 'next' from 'prev', odd iterations compute
+ * 'prev' from 'next', which effectively swaps their content at
+ * every iteration.
+ */
+void SubmitIso3dfdIteration(sycl::queue &q, buffer<float, 1> &b_ptr_next,
+                            buffer<float, 1> &b_ptr_prev,
+                            buffer<float, 1> &b_ptr_vel,
+                            buffer<float, 1> &b_ptr_coeff, size_t n1,
+                            size_t n2, size_t n1_block, size_t n2_block,
+                            size_t n3_block, size_t begin_z, size_t end_z,
+                            unsigned int i) {
+  auto nx = n1;
+  auto nxy = n1 * n2;
+
+  auto bx = kHalfLength;
+  auto by = kHalfLength;
+
+  // Submit command group for execution
+  q.submit([&](auto &h) {
+    // Create accessors
+    accessor next(b_ptr_next, h);
+    accessor prev(b_ptr_prev, h);
+    accessor vel(b_ptr_vel, h, read_only);
+    accessor coeff(b_ptr_coeff, h, read_only);
+
+    // Define local and global range
+
+    // Define local ND range of work-items
+    // Size of each SYCL work-group selected here is a product of
+    // n2_block and n1_block which can be controlled by the input
+    // command line arguments
+    auto local_nd_range = range(1, n2_block, n1_block);
+
+    // Define global ND range of work-items
+    // Size of total number of work-items is selected based on the
+    // total grid size in first and second dimensions (XY-plane)
+    //
+    // Each of the work-item then works on computing
+    // one or more grid points. This value can be controlled by the
+    // input command line argument n3_block
+    //
+    // Effectively this implementation enables slicing of the full
+    // grid into smaller grid slices which can be computed in parallel
+    // to allow auto-scaling of the total number of work-items
+    // spawned to achieve full occupancy for small or larger accelerator
+    // devices
+    auto global_nd_range =
+        range((end_z - begin_z + n3_block - 1) / n3_block,
+              (n2 - 2 * kHalfLength), (n1 - 2 * kHalfLength));
+
+#ifdef USE_SHARED
+    // Using 3D-stencil kernel with Shared Local Memory (SLM)
+    // optimizations (SYCL) to improve effective FLOPS to BYTES
+    // ratio. By default, SLM code path is disabled in this
+    // code sample.
+    // SLM code path can be enabled by recompiling the SYCL source
+    // as follows:
+    // cmake -DSHARED_KERNEL=1 ..
+    // make -j`nproc`
+
+    // Define a range for SLM Buffer
+    // Padding can be used to avoid SLM bank conflicts
+    // By default padding is disabled in the sample code
+    auto local_range = range((n1_block + (2 * kHalfLength) + kPad) *
+                             (n2_block + (2 * kHalfLength)));
+
+    //  Create an accessor for SLM buffer
+    accessor<float, 1, access::mode::read_write, access::target::local> tab(
+        local_range, h);
+
+    // Send a SYCL kernel (lambda) for parallel execution
+    // The function that executes a single iteration is called
+    // "Iso3dfdIterationSLM"
+    // alternating the 'next' and 'prev' parameters which effectively
+    // swaps their content at every iteration.
+    if (i % 2 == 0)
+      h.parallel_for(
+          nd_range(global_nd_range, local_nd_range), [=](auto it) {
+            Iso3dfdIterationSLM(it, next.get_pointer(), prev.get_pointer(),
+                                vel.get_pointer(), coeff.get_pointer(),
+                                tab.get_pointer(), nx, nxy, bx, by,
+                                n3_block, begin_z, end_z);
+          });
+    else
+      h.parallel_for(
+          nd_range(global_nd_range, local_nd_range), [=](auto it) {
+            Iso3dfdIterationSLM(it, prev.get_pointer(), next.get_pointer(),
+                                vel.get_pointer(), coeff.get_pointer(),
+                                tab.get_pointer(), nx, nxy, bx, by,
+                                n3_block, begin_z, end_z);
+          });
+
+#else
+
+    // Use Global Memory version of the 3D-Stencil kernel.
+    // This code path is enabled by default
+
+    // Send a SYCL kernel (lambda) for parallel execution
+    // The function that executes a single iteration is called
+    // "Iso3dfdIterationGlobal"
+    // alternating the 'next' and 'prev' parameters which effectively
+    // swaps their content at every iteration.
+    if (i % 2 == 0)
+      h.parallel_for(
+          nd_range(global_nd_range, local_nd_range), [=](auto it) {
+            Iso3dfdIterationGlobal(it, next.get_pointer(),
+                                   prev.get_pointer(), vel.get_pointer(),
+                                   coeff.get_pointer(), nx, nxy, bx, by,
+                                   n3_block, begin_z, end_z);
+          });
+    else
+      h.parallel_for(
+          nd_range(global_nd_range, local_nd_range), [=](auto it) {
+            Iso3dfdIterationGlobal(it, prev.get_pointer(),
+                                   next.get_pointer(), vel.get_pointer(),
+                                   coeff.get_pointer(), nx, nxy, bx, by,
+                                   n3_block, begin_z, end_z);
+          });
+#endif
+  });
+}
+
 /*
  * Host-side SYCL Code
  *
@@ -283,22 +415,21 @@ void Iso3dfdIterationGlobal(sycl::nd_item<3> it, float *next, float *prev,
  * This function uses SYCL buffers to facilitate host to device
  * buffer copies
  *
+ * If snapshots is set, the wavefields are saved with it when a snapshot
+ * or a checkpoint is due. The run starts at the timestep first_iteration
+ * when it resumes from a checkpoint.
+ *
  */
 
 bool Iso3dfdDevice(sycl::queue &q, float *ptr_next, float *ptr_prev,
                    float *ptr_vel, float *ptr_coeff, size_t n1, size_t n2,
                    size_t n3, size_t n1_block, size_t n2_block, size_t n3_block,
-                   size_t end_z, unsigned int nIterations) {
-  auto nx = n1;
-  auto nxy = n1 * n2;
-
-  auto bx = kHalfLength;
-  auto by = kHalfLength;
-
+                   size_t end_z, unsigned int nIterations,
+                   SnapshotWriter *snapshots, unsigned int first_iteration) {
   // Display information about the selected device
   PrintTargetInfo(q, n1_block, n2_block);
 
-  auto grid_size = nxy * n3;
+  auto grid_size = n1 * n2 * n3;
 
   {  // Begin buffer scope
     // Create buffers using SYCL class buffer
@@ -308,110 +439,83 @@ bool Iso3dfdDevice(sycl::queue &q, float *ptr_next, float *ptr_prev,
     buffer b_ptr_coeff(ptr_coeff, range(kHalfLength + 1));
 
     // Iterate over time steps
-    for (auto i = 0; i < nIterations; i += 1) {
-      // Submit command group for execution
-      q.submit([&](auto &h) {
-        // Create accessors
-        accessor next(b_ptr_next, h);
-        accessor prev(b_ptr_prev, h);
-        accessor vel(b_ptr_vel, h, read_only);
-        accessor coeff(b_ptr_coeff, h, read_only);
-
-        // Define local and global range
-
-        // Define local ND range of work-items
-        // Size of each SYCL work-group selected here is a product of
-        // n2_block and n1_block which can be controlled by the input
-        // command line arguments
-        auto local_nd_range = range(1, n2_block, n1_block);
-
-        // Define global ND range of work-items
-        // Size of total number of work-items is selected based on the
-        // total grid size in first and second dimensions (XY-plane)
-        //
-        // Each of the work-item then works on computing
-        // one or more grid points. This value can be controlled by the
-        // input command line argument n3_block
-        //
-        // Effectively this implementation enables slicing of the full
-        // grid into smaller grid slices which can be computed in parallel
-        // to allow auto-scaling of the total number of work-items
-        // spawned to achieve full occupancy for small or larger accelerator
-        // devices
-        auto global_nd_range =
-            range((n3 - 2 * kHalfLength) / n3_block, (n2 - 2 * kHalfLength),
-                  (n1 - 2 * kHalfLength));
+    for (auto i = first_iteration; i < nIterations; i += 1) {
+      SubmitIso3dfdIteration(q, b_ptr_next, b_ptr_prev, b_ptr_vel, b_ptr_coeff,
+                             n1, n2, n1_block, n2_block, n3_block, kHalfLength,
+                             end_z, i);
+
+      // The copies of the snapshot are queued after the kernel, and only
+      // the writer thread waits for them
+      if (snapshots && snapshots->Due(i))
+        snapshots->Save(q, i, b_ptr_next, b_ptr_prev);
+    }
+  }  // end buffer scope
+  return true;
+}
 
-#ifdef USE_SHARED
-        // Using 3D-stencil kernel with Shared Local Memory (SLM)
-        // optimizations (SYCL) to improve effective FLOPS to BYTES
-        // ratio. By default, SLM code path is disabled in this
-        // code sample.
-        // SLM code path can be enabled by recompiling the SYCL source
-        // as follows:
-        // cmake -DSHARED_KERNEL=1 ..
-        // make -j`nproc`
-
-        // Define a range for SLM Buffer
-        // Padding can be used to avoid SLM bank conflicts
-        // By default padding is disabled in the sample code
-        auto local_range = range((n1_block + (2 * kHalfLength) + kPad) *
-                                 (n2_block + (2 * kHalfLength)));
-
-        //  Create an accessor for SLM buffer
-        accessor<float, 1, access::mode::read_write, access::target::local> tab(
-            local_range, h);
-
-        // Send a SYCL kernel (lambda) for parallel execution
-        // The function that executes a single iteration is called
-        // "Iso3dfdIterationSLM"
-        // alternating the 'next' and 'prev' parameters which effectively
-        // swaps their content at every iteration.
-        if (i % 2 == 0)
-          h.parallel_for(
-              nd_range(global_nd_range, local_nd_range), [=](auto it) {
-                Iso3dfdIterationSLM(it, next.get_pointer(), prev.get_pointer(),
-                                    vel.get_pointer(), coeff.get_pointer(),
-                                    tab.get_pointer(), nx, nxy, bx, by,
-                                    n3_block, end_z);
-              });
-        else
-          h.parallel_for(
-              nd_range(global_nd_range, local_nd_range), [=](auto it) {
-                Iso3dfdIterationSLM(it, prev.get_pointer(), next.get_pointer(),
-                                    vel.get_pointer(), coeff.get_pointer(),
-                                    tab.get_pointer(), nx, nxy, bx, by,
-                                    n3_block, end_z);
-              });
+/*
+ * Host-side SYCL Code
+ *
+ * Driver function for ISO3DFD SYCL code with temporal blocking
+ *
+ * Each pass over the grid advances time_block timesteps. The grid is cut
+ * into slabs of slab_z planes in the z-dimension, and the timesteps of a
+ * pass sweep over the slabs as a wavefront: timestep t + 1 of a slab is
+ * computed right after timestep t of the slab kHalfLength planes ahead of
+ * it, while the planes both of them use are still in the device cache.
+ * So each pass reads and writes the wavefields from device memory about
+ * once, instead of once per timestep.
+ *
+ * The timesteps update next and prev in place like Iso3dfdDevice does. A
+ * timestep runs at least kHalfLength planes behind the one before it, so
+ * it only reads planes that the timestep before it has computed, and only
+ * overwrites planes that the timestep before it does not need anymore.
+ * The kernels of a pass are submitted in wavefront order and are ordered
+ * by their accessors to the same buffers.
+ *
+ */
+bool Iso3dfdDeviceTemporal(sycl::queue &q, float *ptr_next, float *ptr_prev,
+                           float *ptr_vel, float *ptr_coeff, size_t n1,
+                           size_t n2, size_t n3, size_t n1_block,
+                           size_t n2_block, size_t n3_block, size_t end_z,
+                           unsigned int nIterations, unsigned int time_block,
+                           size_t slab_z) {
+  // Display information about the selected device
+  PrintTargetInfo(q, n1_block, n2_block);
+  std::cout << " Temporal blocking: " << time_block
+            << " timesteps per pass, " << slab_z << " planes per slab\n";
 
-#else
+  auto grid_size = n1 * n2 * n3;
 
-        // Use Global Memory version of the 3D-Stencil kernel.
-        // This code path is enabled by default
-
-        // Send a SYCL kernel (lambda) for parallel execution
-        // The function that executes a single iteration is called
-        // "Iso3dfdIterationGlobal"
-        // alternating the 'next' and 'prev' parameters which effectively
-        // swaps their content at every iteration.
-        if (i % 2 == 0)
-          h.parallel_for(
-              nd_range(global_nd_range, local_nd_range), [=](auto it) {
-                Iso3dfdIterationGlobal(it, next.get_pointer(),
-                                       prev.get_pointer(), vel.get_pointer(),
-                                       coeff.get_pointer(), nx, nxy, bx, by,
-                                       n3_block, end_z);
-              });
-        else
-          h.parallel_for(
-              nd_range(global_nd_range, local_nd_range), [=](auto it) {
-                Iso3dfdIterationGlobal(it, prev.get_pointer(),
-                                       next.get_pointer(), vel.get_pointer(),
-                                       coeff.get_pointer(), nx, nxy, bx, by,
-                                       n3_block, end_z);
-              });
-#endif
-      });
+  // Number of slabs in the z-dimension, and the distance in slabs
+  // between consecutive timesteps of the wavefront
+  size_t num_slabs = (end_z - kHalfLength + slab_z - 1) / slab_z;
+  size_t lag = (kHalfLength + slab_z - 1) / slab_z;
+
+  {  // Begin buffer scope
+    // Create buffers using SYCL class buffer
+    buffer b_ptr_next(ptr_next, range(grid_size));
+    buffer b_ptr_prev(ptr_prev, range(grid_size));
+    buffer b_ptr_vel(ptr_vel, range(grid_size));
+    buffer b_ptr_coeff(ptr_coeff, range(kHalfLength + 1));
+
+    // Iterate over passes of time_block time steps
+    for (unsigned int i = 0; i < nIterations; i += time_block) {
+      unsigned int steps = std::min(time_block, nIterations - i);
+
+      // Sweep the wavefront over the slabs, the timestep s computes the slab
+      // w - s * lag
+      for (size_t w = 0; w < num_slabs + (steps - 1) * lag; w++) {
+        for (unsigned int s = 0; s < steps; s++) {
+          if (w < s * lag || w - s * lag >= num_slabs) continue;
+
+          size_t begin_z = kHalfLength + (w - s * lag) * slab_z;
+          size_t slab_end_z = std::min(begin_z + slab_z, end_z);
+          SubmitIso3dfdIteration(q, b_ptr_next, b_ptr_prev, b_ptr_vel,
+                                 b_ptr_coeff, n1, n2, n1_block, n2_block,
+                                 n3_block, begin_z, slab_end_z, i + s);
+        }
+      }
     }
   }  // end buffer scope
   return true;
@@ -86,7 +86,8 @@ void Usage(const std::string& programName) {
   std::cout << " Incorrect parameters \n";
   std::cout << " Usage: ";
   std::cout << programName
-            << " n1 n2 n3 b1 b2 b3 Iterations [omp|sycl] [gpu|cpu] \n\n";
+            << " n1 n2 n3 b1 b2 b3 Iterations [omp|sycl] [gpu|cpu]"
+            << " [tb=steps[,slab]] [snap=k] [ckpt=k] [restart] \n\n";
   std::cout << " n1 n2 n3      : Grid sizes for the stencil \n";
   std::cout << " b1 b2 b3      : cache block sizes for cpu openmp version.\n";
   std::cout << " Iterations    : No. of timesteps. \n";
@@ -94,7 +95,17 @@ void Usage(const std::string& programName) {
             << " Default is to use both for validation \n";
   std::cout
       << " [gpu|cpu]     : Optional: Device to run the SYCL version"
-      << " Default is to use the GPU if available, if not fallback to CPU \n\n";
+      << " Default is to use the GPU if available, if not fallback to CPU \n";
+  std::cout
+      << " [tb=steps[,slab]] : Optional: Temporal blocking, advance 'steps'"
+      << " timesteps per pass over the grid (SYCL: in slabs of 'slab' planes,"
+      << " default " << 2 * kHalfLength << ") and compare with one timestep"
+      << " per pass \n";
+  std::cout << " [snap=k]      : Optional: Write a snapshot of the wavefield"
+            << " every k timesteps \n";
+  std::cout << " [ckpt=k]      : Optional: Write a checkpoint every k"
+            << " timesteps \n";
+  std::cout << " [restart]     : Optional: Resume from the last checkpoint \n\n";
 }
 
 /*
@@ -102,7 +113,7 @@ void Usage(const std::string& programName) {
  * Utility function to print stats
  */
 void PrintStats(double time, size_t n1, size_t n2, size_t n3,
-                unsigned int nIterations) {
+                unsigned int nIterations, double baseline_time) {
   float throughput_mpoints = 0.0f, mflops = 0.0f, normalized_time = 0.0f;
   double mbytes = 0.0f;
 
@@ -118,6 +129,14 @@ void PrintStats(double time, size_t n1, size_t n2, size_t n3,
   std::cout << "throughput   : " << throughput_mpoints << " Mpts/s\n";
   std::cout << "flops        : " << mflops / 1e3f << " GFlops\n";
   std::cout << "bytes        : " << mbytes / 1e3f << " GBytes/s\n";
+
+  // With temporal blocking, the throughput is the effective one, compared
+  // with the run that advances one timestep per pass (baseline_time)
+  if (baseline_time > 0.0) {
+    std::cout << "per-step     : " << throughput_mpoints * time / baseline_time
+              << " Mpts/s\n";
+    std::cout << "speedup      : " << baseline_time / time << "x\n";
+  }
   std::cout << "\n--------------------------------------\n";
   std::cout << "\n--------------------------------------\n";
 }
@@ -275,14 +275,16 @@ struct HorizontalFunctor {
 };
 
 //
-// Submit all of the ANR kernels (vertical and horizontal)
+// Submit all of the ANR kernels (vertical and horizontal). Both kernels wait
+// for the events in 'deps', e.g., the previous launch of the ANR kernels.
 //
 template <typename IndexT, typename InPipe, typename OutPipe,
           unsigned filter_size, unsigned pixels_per_cycle,
           unsigned max_cols>
 std::vector<event> SubmitANRKernels(queue& q, int cols, int rows,
                                     ANRParams params,
-                                    float* sig_i_lut_data_ptr) {
+                                    float* sig_i_lut_data_ptr,
+                                    const std::vector<event>& deps = {}) {
   // the internal pipe between the vertical and horizontal kernels
   using IntraPipeT =
       fpga_tools::DataBundle<DataForwardStruct, pixels_per_cycle>;
@@ -345,7 +347,7 @@ std::vector<event> SubmitANRKernels(queue& q, int cols, int rows,
   auto horizontal_func = HorizontalFunctor<filter_size>();
 
   // submit the vertical kernel using a column stencil
-  auto vertical_kernel = q.single_task<VerticalKernelID>([=] {
+  auto vertical_kernel = q.single_task<VerticalKernelID>(deps, [=] {
     // copy host side intensity sigma LUT to the device
     // For testing the kernel system as an IP and checking the area and Fmax,
     // we allow the user to turn off connections to device memory. In this case
@@ -373,7 +375,7 @@ std::vector<event> SubmitANRKernels(queue& q, int cols, int rows,
   });
 
   // submit the horizontal kernel using a row stencil
-  auto horizontal_kernel = q.single_task<HorizontalKernelID>([=] {
+  auto horizontal_kernel = q.single_task<HorizontalKernelID>(deps, [=] {
     // build the constexpr exp() and inverse LUT ROMs
     constexpr ExpLUT exp_lut;
     constexpr InvLUT inv_lut;
@@ -87,4 +87,12 @@ namespace std {
 // https://en.wikipedia.org/wiki/Peak_signal-to-noise_ratio
 constexpr double kPSNRDefaultThreshold = 30.0;
 
+// the default number of frames and frame buffers for the video mode
+#ifdef FPGA_EMULATOR
+constexpr int kDefaultVideoFrames = 4;
+#else
+constexpr int kDefaultVideoFrames = 256;
+#endif
+constexpr int kDefaultVideoBuffers = 3;
+
 #endif /* __CONSTANTS_HPP__ */
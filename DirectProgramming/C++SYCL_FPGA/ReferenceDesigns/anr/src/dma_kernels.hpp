@@ -9,6 +9,7 @@
 
 #include <sycl/sycl.hpp>
 #include <sycl/ext/intel/fpga_extensions.hpp>
+#include <vector>
 
 #include "data_bundle.hpp"
 
@@ -17,9 +18,11 @@ using namespace fpga_tools;
 
 //
 // Kernel to read data from device memory and write it into the ANR input pipe.
+// The kernel starts once the events in 'deps' are complete.
 //
 template <typename KernelId, typename T, typename Pipe, int pixels_per_cycle>
-event SubmitInputDMA(queue &q, T *in_ptr, int rows, int cols, int frames) {
+event SubmitInputDMA(queue &q, T *in_ptr, int rows, int cols, int frames,
+                     const std::vector<event> &deps = {}) {
   using PipeType = DataBundle<T, pixels_per_cycle>;
 
   // LSU attribute to  turn off caching
@@ -40,30 +43,35 @@ event SubmitInputDMA(queue &q, T *in_ptr, int rows, int cols, int frames) {
   const int iterations = cols * rows / pixels_per_cycle;
 
   // Using device memory
-  return q.single_task<KernelId>([=]() [[intel::kernel_args_restrict]] {
-    device_ptr<T> in(in_ptr);
+  return q.submit([&](handler &h) {
+    h.depends_on(deps);
+    h.single_task<KernelId>([=]() [[intel::kernel_args_restrict]] {
+      device_ptr<T> in(in_ptr);
 
-    // coalesce the following two loops into a single for-loop using the
-    // loop_coalesce attribute
-    [[intel::loop_coalesce(2)]]
-    for (int f = 0; f < frames; f++) {
-      for (int i = 0; i < iterations; i++) {
-        PipeType pipe_data;
-        #pragma unroll
-        for (int k = 0; k < pixels_per_cycle; k++) {
-          pipe_data[k] = NonCachingLSU::load(in + i * pixels_per_cycle + k);
+      // coalesce the following two loops into a single for-loop using the
+      // loop_coalesce attribute
+      [[intel::loop_coalesce(2)]]
+      for (int f = 0; f < frames; f++) {
+        for (int i = 0; i < iterations; i++) {
+          PipeType pipe_data;
+          #pragma unroll
+          for (int k = 0; k < pixels_per_cycle; k++) {
+            pipe_data[k] = NonCachingLSU::load(in + i * pixels_per_cycle + k);
+          }
+          Pipe::write(pipe_data);
         }
-        Pipe::write(pipe_data);
       }
-    }
+    });
   });
 }
 
 //
 // Kernel to pull data out of the ANR output pipe and writes to device memory.
+// The kernel starts once the events in 'deps' are complete.
 //
 template <typename KernelId, typename T, typename Pipe, int pixels_per_cycle>
-event SubmitOutputDMA(queue &q, T *out_ptr, int rows, int cols, int frames) {
+event SubmitOutputDMA(queue &q, T *out_ptr, int rows, int cols, int frames,
+                      const std::vector<event> &deps = {}) {
   // validate the number of columns
   if ((cols % pixels_per_cycle) != 0) {
     std::cerr << "ERROR: the number of columns is not a multiple of the pixels "
@@ -76,22 +84,25 @@ event SubmitOutputDMA(queue &q, T *out_ptr, int rows, int cols, int frames) {
   const int iterations = cols * rows / pixels_per_cycle;
 
   // Using device memory
-  return q.single_task<KernelId>([=]() [[intel::kernel_args_restrict]] {
-    device_ptr<T> out(out_ptr);
+  return q.submit([&](handler &h) {
+    h.depends_on(deps);
+    h.single_task<KernelId>([=]() [[intel::kernel_args_restrict]] {
+      device_ptr<T> out(out_ptr);
 
-    // coalesce the following two loops into a single for-loop using the
-    // loop_coalesce attribute
-    [[intel::loop_coalesce(2)]]
-    for (int f = 0; f < frames; f++) {
-      for (int i = 0; i < iterations; i++) {
-        auto pipe_data = Pipe::read();
-        #pragma unroll
-        for (int k = 0; k < pixels_per_cycle; k++) {
-          out[i * pixels_per_cycle + k] = pipe_data[k];
+      // coalesce the following two loops into a single for-loop using the
+      // loop_coalesce attribute
+      [[intel::loop_coalesce(2)]]
+      for (int f = 0; f < frames; f++) {
+        for (int i = 0; i < iterations; i++) {
+          auto pipe_data = Pipe::read();
+          #pragma unroll
+          for (int k = 0; k < pixels_per_cycle; k++) {
+            out[i * pixels_per_cycle + k] = pipe_data[k];
+          }
         }
       }
-    }
-});
+    });
+  });
 }
 
 #endif /* __DMA_KERNELS_HPP__ */
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <array>
 #include <chrono>
 #include <limits>
+#include <memory>
 #include <numeric>
 #include <sstream>
 #include <string>
@@ -17,6 +18,7 @@
 #include "data_bundle.hpp"
 #include "dma_kernels.hpp"
 #include "exception_handler.hpp"
+#include "video_io.hpp"
 
 using namespace sycl;
 using namespace std::chrono;
@@ -27,6 +29,8 @@ void ParseFiles(std::string data_dir, std::vector<PixelT>& in_pixels,
                 std::vector<PixelT>& ref_pixels, int& cols, int& rows,
                 ANRParams& params);
 
+void ParseParamsFile(std::string data_dir, ANRParams& params);
+
 void WriteOutputFile(std::string data_dir, std::vector<PixelT>& pixels,
                      int cols, int rows);
 
@@ -35,6 +39,10 @@ double RunANR(queue& q, PixelT* in_ptr, PixelT* out_ptr, int cols, int rows,
 
 bool Validate(PixelT* val, PixelT* ref, int rows, int cols,
               double psnr_thresh = kPSNRDefaultThreshold);
+
+bool RunANRVideo(queue& q, FrameSource& source, FrameSink* sink, int buffers,
+                 ANRParams params, float* sig_i_lut_data_ptr,
+                 const std::vector<PixelT>* ref_pixels);
 ////////////////////////////////////////////////////////////////////////////////
 
 int main(int argc, char* argv[]) {
@@ -50,19 +58,56 @@ int main(int argc, char* argv[]) {
   int frames = 8;
 #endif
 
+  // video mode options (see RunANRVideo)
+  bool video = false;
+  std::string video_file, video_out_file;
+  int video_cols = 0, video_rows = 0;
+  int video_frames = -1;
+  int video_buffers = kDefaultVideoBuffers;
+
+  // the optional '--' arguments can be anywhere, the rest are positional
+  std::vector<std::string> positional_args;
+  for (int i = 1; i < argc; i++) {
+    std::string arg(argv[i]);
+    if (arg == "--video") {
+      video = true;
+    } else if (arg.rfind("--video=", 0) == 0) {
+      video = true;
+      video_file = arg.substr(8);
+    } else if (arg.rfind("--video-out=", 0) == 0) {
+      video_out_file = arg.substr(12);
+    } else if (arg.rfind("--video-frames=", 0) == 0) {
+      video_frames = atoi(arg.substr(15).c_str());
+    } else if (arg.rfind("--buffers=", 0) == 0) {
+      video_buffers = atoi(arg.substr(10).c_str());
+    } else if (arg.rfind("--size=", 0) == 0) {
+      char x;
+      std::stringstream size_ss(arg.substr(7));
+      if (!(size_ss >> video_cols >> x >> video_rows) || x != 'x') {
+        std::cerr << "ERROR: the frame size must be <cols>x<rows>\n";
+        std::terminate();
+      }
+    } else if (arg.rfind("--", 0) == 0) {
+      std::cerr << "ERROR: unknown argument '" << arg << "'\n";
+      std::terminate();
+    } else {
+      positional_args.push_back(arg);
+    }
+  }
+
   // get the input data directory
-  if (argc > 1) {
-    data_dir = std::string(argv[1]);
+  if (positional_args.size() > 0) {
+    data_dir = positional_args[0];
   }
 
   // get the number of runs as the second command line argument
-  if (argc > 2) {
-    runs = atoi(argv[2]);
+  if (positional_args.size() > 1) {
+    runs = atoi(positional_args[1].c_str());
   }
 
   // get the number of frames as the third command line argument
-  if (argc > 3) {
-    frames = atoi(argv[3]);
+  if (positional_args.size() > 2) {
+    frames = atoi(positional_args[2].c_str());
   }
 
   // enforce at least two runs
@@ -96,6 +141,79 @@ int main(int argc, char* argv[]) {
     std::terminate();
   }
 
+  if (video) {
+    // enforce at least two buffers, so that frames can be pipelined
+    if (video_buffers < 2) {
+      std::cerr << "ERROR: '--buffers' must be 2 or more\n";
+      std::terminate();
+    }
+
+    // pick the source of the frames
+    ANRParams params;
+    std::vector<PixelT> in_pixels, ref_pixels;
+    std::unique_ptr<FrameSource> source;
+    if (!video_file.empty()) {
+      // a raw video file or pipe (all frames, unless limited)
+      if (video_cols <= 0 || video_rows <= 0) {
+        std::cerr << "ERROR: '--size' is required when reading a video\n";
+        std::terminate();
+      }
+      ParseParamsFile(data_dir, params);
+      source = std::make_unique<FrameSource>(FrameSource::FromFile(
+          video_file, video_cols, video_rows, video_frames));
+    } else {
+      if (video_frames < 0) {
+        video_frames = kDefaultVideoFrames;
+      }
+      if (video_cols > 0 && video_rows > 0) {
+        // synthetic frames of the given size (e.g., 1080p or 4K)
+        ParseParamsFile(data_dir, params);
+        source = std::make_unique<FrameSource>(
+            FrameSource::Synthetic(video_cols, video_rows, video_frames));
+      } else {
+        // repeat the test image, so that every frame can be validated
+        ParseFiles(data_dir, in_pixels, ref_pixels, video_cols, video_rows,
+                   params);
+        source = std::make_unique<FrameSource>(FrameSource::Repeat(
+            in_pixels, video_cols, video_rows, video_frames));
+      }
+    }
+
+    // the maximum frame size is set at compile time
+    if (video_cols > int(kMaxCols) || video_rows > int(kMaxRows)) {
+      std::cerr << "ERROR: the frame size (" << video_cols << "x"
+                << video_rows << ") exceeds the maximum (" << kMaxCols << "x"
+                << kMaxRows << "). Compile with a larger MAX_COLS (e.g., "
+                << "-DMAX_COLS=3840 for 4K)\n";
+      std::terminate();
+    }
+
+    std::unique_ptr<FrameSink> sink;
+    if (!video_out_file.empty()) {
+      sink = std::make_unique<FrameSink>(video_out_file, video_cols,
+                                         video_rows);
+    }
+
+    // create and copy the intensity sigma LUT to the device
+    float* sig_i_lut_data_ptr = IntensitySigmaLUT::AllocateDevice(q);
+    IntensitySigmaLUT sig_i_lut_host(params);
+    sig_i_lut_host.CopyDataToDevice(q, sig_i_lut_data_ptr).wait();
+
+    try {
+      passed = RunANRVideo(q, *source, sink.get(), video_buffers, params,
+                           sig_i_lut_data_ptr,
+                           ref_pixels.empty() ? nullptr : &ref_pixels);
+    } catch (exception const& e) {
+      std::cout << "Caught a synchronous SYCL exception: " << e.what() << "\n";
+      std::terminate();
+    }
+
+    sycl::free(sig_i_lut_data_ptr, q);
+
+    std::cout << (passed ? "PASSED\n" : "FAILED\n");
+    return passed ? 0 : 1;
+  }
+
   // parse the input files
   int cols, rows, pixel_count;
   ANRParams params;
@@ -246,6 +364,157 @@ double RunANR(queue& q, PixelT* in_ptr, PixelT* out_ptr, int cols, int rows,
   return diff.count();
 }
 
+//
+// Run ANR on a video stream. Each frame from 'source' goes through one of
+// 'buffers' sets of host and device buffers, so that the upload of frame N+1
+// and the download of frame N-1 overlap with the filtering of frame N on the
+// device. Each filtered frame is written to 'sink' (if not null) as soon as
+// its download completes and, if 'ref_pixels' is not null, validated against
+// it. Prints the sustained frame rate and the per-frame latency. Returns false
+// if the validation of any frame fails.
+//
+bool RunANRVideo(queue& q, FrameSource& source, FrameSink* sink, int buffers,
+                 ANRParams params, float* sig_i_lut_data_ptr,
+                 const std::vector<PixelT>* ref_pixels) {
+  // the same pipes as RunANR, so the video mode uses the same kernels
+  using PipeType = DataBundle<PixelT, kPixelsPerCycle>;
+  using ANRInPipe = sycl::ext::intel::pipe<ANRInPipeID, PipeType>;
+  using ANROutPipe = sycl::ext::intel::pipe<ANROutPipeID, PipeType>;
+
+  const int cols = source.Cols();
+  const int rows = source.Rows();
+  const size_t pixel_count = source.PixelCount();
+  const size_t frame_bytes = pixel_count * sizeof(PixelT);
+
+  // the buffers for one frame in flight
+  struct FrameSlot {
+    PixelT *host_in, *host_out;  // pinned host memory, for fast DMA
+    PixelT *dev_in, *dev_out;
+    event download;
+    bool busy = false;
+    high_resolution_clock::time_point start;
+  };
+
+  std::vector<FrameSlot> slots(buffers);
+  for (auto& slot : slots) {
+    slot.host_in = malloc_host<PixelT>(pixel_count, q);
+    slot.host_out = malloc_host<PixelT>(pixel_count, q);
+    slot.dev_in = malloc_device<PixelT>(pixel_count, q);
+    slot.dev_out = malloc_device<PixelT>(pixel_count, q);
+    if (slot.host_in == nullptr || slot.host_out == nullptr ||
+        slot.dev_in == nullptr || slot.dev_out == nullptr) {
+      std::cerr << "ERROR: could not allocate space for the frame buffers\n";
+      std::terminate();
+    }
+  }
+
+  std::cout << "Video Mode\n";
+  std::cout << "Columns:          " << cols << "\n";
+  std::cout << "Rows:             " << rows << "\n";
+  std::cout << "Buffers:          " << buffers << "\n";
+  std::cout << "Filter Size:      " << kFilterSize << "\n";
+  std::cout << "Pixels Per Cycle: " << kPixelsPerCycle << "\n";
+  std::cout << "Maximum Columns:  " << kMaxCols << "\n";
+  std::cout << "\n";
+
+  // wait for a frame to finish, then write and validate it
+  bool passed = true;
+  std::vector<double> latency_ms;
+  auto finish_frame = [&](FrameSlot& slot) {
+    slot.download.wait();
+    slot.busy = false;
+    if (sink != nullptr) {
+      sink->Write(slot.host_out);
+    }
+    if (ref_pixels != nullptr) {
+      passed &= Validate(slot.host_out, const_cast<PixelT*>(ref_pixels->data()),
+                         rows, cols);
+    }
+    duration<double, std::milli> l = high_resolution_clock::now() - slot.start;
+    latency_ms.push_back(l.count());
+  };
+
+  // The kernels of consecutive frames must run in order, since they share
+  // the ANR pipes, so each launch depends on the previous launch of the same
+  // kernels. The kernels of one frame stream to each other through the
+  // pipes, so they must not depend on each other.
+  event input_dma_event, output_dma_event;
+  std::vector<event> anr_events;
+
+  auto start = high_resolution_clock::now();
+  int frame = 0;
+  for (;; frame++) {
+    FrameSlot& slot = slots[frame % buffers];
+
+    // the frame that used this slot 'buffers' frames ago must be done before
+    // the slot can be reused
+    if (slot.busy) {
+      finish_frame(slot);
+    }
+
+    // get the next frame
+    slot.start = high_resolution_clock::now();
+    if (!source.Read(slot.host_in)) {
+      break;
+    }
+
+    // upload the frame, filter it and download the result
+    auto upload = q.memcpy(slot.dev_in, slot.host_in, frame_bytes);
+    input_dma_event =
+        SubmitInputDMA<InputKernelID, PixelT, ANRInPipe, kPixelsPerCycle>(q,
+                       slot.dev_in, rows, cols, 1, {upload, input_dma_event});
+    anr_events =
+        SubmitANRKernels<IndexT, ANRInPipe, ANROutPipe, kFilterSize,
+                         kPixelsPerCycle, kMaxCols>(q, cols, rows, params,
+                         sig_i_lut_data_ptr, anr_events);
+    output_dma_event =
+        SubmitOutputDMA<OutputKernelID, PixelT, ANROutPipe, kPixelsPerCycle>(q,
+                        slot.dev_out, rows, cols, 1, {output_dma_event});
+    slot.download =
+        q.memcpy(slot.host_out, slot.dev_out, frame_bytes, output_dma_event);
+    slot.busy = true;
+  }
+
+  // drain the remaining frames, oldest first
+  for (int i = 1; i < buffers; i++) {
+    FrameSlot& slot = slots[(frame + i) % buffers];
+    if (slot.busy) {
+      finish_frame(slot);
+    }
+  }
+  auto end = high_resolution_clock::now();
+
+  for (auto& slot : slots) {
+    sycl::free(slot.host_in, q);
+    sycl::free(slot.host_out, q);
+    sycl::free(slot.dev_in, q);
+    sycl::free(slot.dev_out, q);
+  }
+
+  if (frame == 0) {
+    std::cerr << "ERROR: the video did not contain any frames\n";
+    return false;
+  }
+
+  // print the performance results
+  // NOTE: when run in emulation, these results do not accurately represent
+  // the performance of the kernels in actual FPGA hardware
+  duration<double> total = end - start;
+  double fps = frame / total.count();
+  double avg_latency_ms =
+      std::accumulate(latency_ms.begin(), latency_ms.end(), 0.0) / frame;
+  std::cout << "Frames:           " << frame << "\n";
+  std::cout << "Frame rate:       " << fps << " frames/s ("
+            << (fps * pixel_count * sizeof(PixelT) * 1e-6) << " MB/s)\n";
+  std::cout << "Frame latency:    "
+            << *std::min_element(latency_ms.begin(), latency_ms.end())
+            << " ms min, " << avg_latency_ms << " ms avg, "
+            << *std::max_element(latency_ms.begin(), latency_ms.end())
+            << " ms max\n";
+
+  return passed;
+}
+
 //
 // Helper to parse pixel data files
 //
@@ -342,6 +611,13 @@ void ParseFiles(std::string data_dir, std::vector<PixelT>& in_pixels,
   rows = ref_h;
 
   // parse the ANR config parameters file
+  ParseParamsFile(data_dir, params);
+}
+
+//
+// Function that parses and validates the ANR config parameters file
+//
+void ParseParamsFile(std::string data_dir, ANRParams& params) {
   params = ANRParams::FromFile(data_dir + "/param_config.data");
 
   // ensure the parsed filter size matches the compile time constant
@@ -0,0 +1,175 @@
+#ifndef __VIDEO_IO_HPP__
+#define __VIDEO_IO_HPP__
+
+//
+// This file contains the host-side classes that read and write the raw video
+// frames for the video mode of the design (see RunANRVideo in main.cpp).
+//
+// A raw video is a sequence of frames with no header. Each frame is
+// rows*cols pixels in row-major order, and each pixel is stored in
+// kBytesPerPixel bytes (little-endian). For the default 8-bit pixels, this is
+// the 'gray' pixel format of FFmpeg, e.g.:
+//    ffmpeg -i in.mp4 -f rawvideo -pix_fmt gray -s 1920x1080 - | ./anr.fpga ...
+//
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <istream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "constants.hpp"
+
+// the number of bytes used to store a pixel in a raw video frame
+constexpr int kBytesPerPixel = (kPixelBits + 7) / 8;
+
+//
+// A source of video frames. The frames come from one of:
+//    1. a raw video file, or a pipe (use "-" for stdin)
+//    2. a set of frames in memory that is repeated (e.g., the test image)
+//    3. a set of synthetic noisy frames that is repeated
+//
+class FrameSource {
+ public:
+  // read the frames from a raw video file, or from stdin if 'filename' is "-"
+  static FrameSource FromFile(const std::string& filename, int cols, int rows,
+                              int max_frames) {
+    FrameSource src(cols, rows, max_frames);
+    if (filename == "-") {
+      src.is_ = &std::cin;
+    } else {
+      src.ifs_ = std::make_unique<std::ifstream>(filename, std::ios::binary);
+      if (!src.ifs_->is_open() || src.ifs_->fail()) {
+        std::cerr << "ERROR: failed to open " << filename << " for reading\n";
+        std::terminate();
+      }
+      src.is_ = src.ifs_.get();
+    }
+    src.bytes_.resize(src.PixelCount() * kBytesPerPixel);
+    return src;
+  }
+
+  // repeat the frame 'pixels' 'frames' times
+  static FrameSource Repeat(const std::vector<PixelT>& pixels, int cols,
+                            int rows, int frames) {
+    FrameSource src(cols, rows, frames);
+    src.frames_.push_back(pixels);
+    return src;
+  }
+
+  // Generate 'frames' synthetic frames: a moving gradient with Gaussian noise.
+  // To keep the host from limiting the frame rate, only a few distinct frames
+  // are generated, and they are repeated.
+  static FrameSource Synthetic(int cols, int rows, int frames) {
+    constexpr int kDistinctFrames = 4;
+    constexpr double kMaxPixel = std::numeric_limits<PixelT>::max();
+    FrameSource src(cols, rows, frames);
+
+    std::default_random_engine rnd(7);
+    std::normal_distribution<double> noise(0.0, kMaxPixel / 16.0);
+    for (int f = 0; f < std::min(frames, kDistinctFrames); f++) {
+      std::vector<PixelT> pixels(src.PixelCount());
+      for (int r = 0; r < rows; r++) {
+        for (int c = 0; c < cols; c++) {
+          double base = kMaxPixel * ((c + r + f * 16) % (cols + rows)) /
+                        double(cols + rows);
+          double val = std::clamp(base + noise(rnd), 0.0, kMaxPixel);
+          pixels[size_t(r) * cols + c] = static_cast<TmpT>(val);
+        }
+      }
+      src.frames_.push_back(std::move(pixels));
+    }
+    return src;
+  }
+
+  int Cols() const { return cols_; }
+  int Rows() const { return rows_; }
+  size_t PixelCount() const { return size_t(cols_) * rows_; }
+
+  // Read the next frame into 'pixels', which must have space for
+  // PixelCount() pixels. Returns false if there are no more frames.
+  bool Read(PixelT* pixels) {
+    if (frame_ == max_frames_) {
+      return false;
+    }
+
+    if (is_ != nullptr) {
+      // read a frame of raw bytes and convert them to pixels
+      if (!is_->read(reinterpret_cast<char*>(bytes_.data()), bytes_.size())) {
+        if (is_->gcount() != 0) {
+          std::cerr << "WARNING: ignoring a partial frame of " << is_->gcount()
+                    << " bytes at the end of the video\n";
+        }
+        return false;
+      }
+      for (size_t i = 0; i < PixelCount(); i++) {
+        TmpT x = 0;
+        for (int b = 0; b < kBytesPerPixel; b++) {
+          x |= TmpT(bytes_[i * kBytesPerPixel + b]) << (8 * b);
+        }
+        // clamp values that do not fit in the pixel type
+        pixels[i] = std::min<TmpT>(x, std::numeric_limits<PixelT>::max());
+      }
+    } else {
+      const auto& frame = frames_[frame_ % frames_.size()];
+      std::copy(frame.begin(), frame.end(), pixels);
+    }
+
+    frame_++;
+    return true;
+  }
+
+ private:
+  FrameSource(int cols, int rows, int max_frames)
+      : cols_(cols), rows_(rows), max_frames_(max_frames) {}
+
+  int cols_, rows_;
+  int max_frames_;  // negative for no limit
+  int frame_ = 0;
+
+  // the raw video stream (file or pipe mode)
+  std::unique_ptr<std::ifstream> ifs_;
+  std::istream* is_ = nullptr;
+  std::vector<unsigned char> bytes_;
+
+  // the frames to repeat (in memory and synthetic modes)
+  std::vector<std::vector<PixelT>> frames_;
+};
+
+//
+// Writes frames to a raw video file (or pipe)
+//
+class FrameSink {
+ public:
+  FrameSink(const std::string& filename, int cols, int rows)
+      : pixel_count_(size_t(cols) * rows),
+        bytes_(pixel_count_ * kBytesPerPixel),
+        ofs_(filename, std::ios::binary) {
+    if (!ofs_.is_open() || ofs_.fail()) {
+      std::cerr << "ERROR: failed to open " << filename << " for writing\n";
+      std::terminate();
+    }
+  }
+
+  void Write(const PixelT* pixels) {
+    for (size_t i = 0; i < pixel_count_; i++) {
+      TmpT x = static_cast<TmpT>(pixels[i]);
+      for (int b = 0; b < kBytesPerPixel; b++) {
+        bytes_[i * kBytesPerPixel + b] = (x >> (8 * b)) & 0xFF;
+      }
+    }
+    ofs_.write(reinterpret_cast<const char*>(bytes_.data()), bytes_.size());
+    ofs_.flush();
+  }
+
+ private:
+  size_t pixel_count_;
+  std::vector<unsigned char> bytes_;
+  std::ofstream ofs_;
+};
+
+#endif /* __VIDEO_IO_HPP__ */
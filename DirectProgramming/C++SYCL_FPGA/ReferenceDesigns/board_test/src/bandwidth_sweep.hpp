@@ -0,0 +1,603 @@
+// Header file to accompany the host-to-device bandwidth sweep (test 7)
+// This file uses kKB, kMB and SyclGetQStExecTimeNs from helper.hpp, which is
+// included through host_speed.hpp
+#include <sycl/sycl.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <unistd.h>
+#endif
+
+// Pre-declare kernel names to prevent name mangling
+class SweepUSMHostToDevice;
+class SweepDeviceToUSMHost;
+
+// Options of the bandwidth sweep, set from the command line by
+// ParseSweepOption
+struct SweepOptions {
+  size_t min_bytes = 4 * kKB;
+#if defined(FPGA_EMULATOR)
+  size_t max_bytes = 4 * kMB;
+  size_t reps = 4;
+#else
+  size_t max_bytes = 64 * kMB;
+  size_t reps = 16;
+#endif
+  size_t max_queues = 4;
+  std::string json_file;
+  std::string csv_file;
+};
+
+// The device side of a transfer
+enum class SweepMemory { kBuffer, kUSMDevice, kUSMShared, kUSMHost };
+
+// The host side of a transfer
+enum class SweepHost { kPageable, kPinned };
+
+// struct used to store the result of one point of the sweep
+struct SweepResult {
+  std::string memory;     // buffer, usm_device, usm_shared or usm_host
+  std::string host;       // pageable or pinned
+  std::string direction;  // write (host to device) or read (device to host)
+  size_t queues;          // number of concurrent queues
+  size_t bytes;           // bytes per transfer
+  size_t transfers;       // number of timed transfers (over all queues)
+  double bandwidth;       // aggregate bandwidth of all the queues (MB/s)
+  double min_us, p50_us, p90_us, p99_us, max_us;  // transfer latency (us)
+};
+
+/////////////////////////////////////////
+// **** ParseSweepOption function **** //
+/////////////////////////////////////////
+
+// Inputs:
+// 1. const std::string &arg - a command line argument
+// 2. SweepOptions &opts - options to update
+// Returns:
+// true if 'arg' is a valid bandwidth sweep option
+
+// The function does the following task:
+// Parses one of the options below, where sizes may have a K, M or G suffix:
+//   -sweep_min=<bytes>    smallest transfer size
+//   -sweep_max=<bytes>    largest transfer size
+//   -sweep_reps=<n>       timed transfers per queue at each point
+//   -sweep_queues=<n>     sweep 1..n concurrent queues
+//   -json=<file>          write the results to a JSON file
+//   -csv=<file>           write the results to a CSV file
+
+bool ParseSweepOption(const std::string &arg, SweepOptions &opts) {
+  auto eq = arg.find('=');
+  if (eq == std::string::npos || eq + 1 == arg.size()) return false;
+  std::string name = arg.substr(0, eq);
+  std::string value = arg.substr(eq + 1);
+
+  if (name == "-json") {
+    opts.json_file = value;
+    return true;
+  }
+  if (name == "-csv") {
+    opts.csv_file = value;
+    return true;
+  }
+
+  // the remaining options are numbers, with an optional size suffix
+  size_t pos = 0;
+  size_t num = 0;
+  try {
+    num = std::stoull(value, &pos);
+  } catch (...) {
+    return false;
+  }
+  if (pos + 1 == value.size()) {
+    switch (value[pos]) {
+      case 'K': case 'k': num *= kKB; break;
+      case 'M': case 'm': num *= kMB; break;
+      case 'G': case 'g': num *= kGB; break;
+      default: return false;
+    }
+  } else if (pos != value.size()) {
+    return false;
+  }
+
+  if (name == "-sweep_min") {
+    opts.min_bytes = num;
+  } else if (name == "-sweep_max") {
+    opts.max_bytes = num;
+  } else if (name == "-sweep_reps") {
+    opts.reps = num;
+  } else if (name == "-sweep_queues") {
+    opts.max_queues = num;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+////////////////////////////////
+// **** SweepSlot struct **** //
+////////////////////////////////
+
+// The memory used by one queue of the sweep. Each queue transfers to and from
+// its own memory so that the queues do not depend on each other.
+struct SweepSlot {
+  explicit SweepSlot(sycl::queue queue) : q(queue) {}
+
+  sycl::queue q;
+  char *host_src = nullptr;  // data to write to the device
+  char *host_dst = nullptr;  // data read back from the device
+  char *usm = nullptr;       // USM device, shared or host allocation
+  char *staging = nullptr;   // device memory for the USM host transfers
+  std::unique_ptr<sycl::buffer<char, 1>> buf;
+};
+
+////////////////////////////////////////////
+// **** SubmitSweepTransfer function **** //
+////////////////////////////////////////////
+
+// Inputs:
+// 1. SweepSlot &s - the queue and memory to use
+// 2. SweepMemory mem - the device side of the transfer
+// 3. bool write - true for a host to device transfer, false for device to host
+// 4. size_t bytes - size of the transfer (in bytes)
+// Returns:
+// The SYCL event of the transfer
+
+// The function does the following task:
+// Submits one transfer. For buffers, this is an explicit copy to or from an
+// accessor. For USM device and shared allocations, it is a memcpy. A USM host
+// allocation is already in host memory, so the transfer is a kernel that
+// copies it to or from device memory (which is how a kernel would stream
+// its input and output through host memory).
+
+sycl::event SubmitSweepTransfer(SweepSlot &s, SweepMemory mem, bool write,
+                                size_t bytes) {
+  if (mem == SweepMemory::kBuffer) {
+    return s.q.submit([&](sycl::handler &h) {
+      if (write) {
+        sycl::accessor<char, 1, sycl::access::mode::write> acc(
+            *s.buf, h, sycl::range<1>(bytes));
+        h.copy(s.host_src, acc);
+      } else {
+        sycl::accessor<char, 1, sycl::access::mode::read> acc(
+            *s.buf, h, sycl::range<1>(bytes));
+        h.copy(acc, s.host_dst);
+      }
+    });
+  } else if (mem == SweepMemory::kUSMHost) {
+    // sizes are a multiple of 64 bytes (see BandwidthSweep)
+    size_t words = bytes / sizeof(sycl::ulong8);
+    if (write) {
+      auto src = reinterpret_cast<const sycl::ulong8 *>(s.usm);
+      auto dst = reinterpret_cast<sycl::ulong8 *>(s.staging);
+      return s.q.single_task<SweepUSMHostToDevice>([=
+      ]() [[intel::kernel_args_restrict]] {  // NO-FORMAT: Attribute
+        for (size_t i = 0; i < words; i++) dst[i] = src[i];
+      });
+    } else {
+      auto src = reinterpret_cast<const sycl::ulong8 *>(s.staging);
+      auto dst = reinterpret_cast<sycl::ulong8 *>(s.usm);
+      return s.q.single_task<SweepDeviceToUSMHost>([=
+      ]() [[intel::kernel_args_restrict]] {  // NO-FORMAT: Attribute
+        for (size_t i = 0; i < words; i++) dst[i] = src[i];
+      });
+    }
+  } else {
+    return write ? s.q.memcpy(s.usm, s.host_src, bytes)
+                 : s.q.memcpy(s.host_dst, s.usm, bytes);
+  }
+}
+
+//////////////////////////////////////////
+// **** MeasureSweepPoint function **** //
+//////////////////////////////////////////
+
+// Inputs:
+// 1. std::vector<SweepSlot> &slots - the queues to use, concurrently
+// 2. SweepMemory mem - the device side of the transfers
+// 3. bool write - direction of the transfers
+// 4. size_t bytes - size of each transfer (in bytes)
+// 5. size_t reps - number of transfers per queue
+// 6. SweepResult &res - result to fill in
+// Returns:
+// None
+
+// The function does the following tasks:
+// 1. Submits 'reps' transfers to each queue, so that the queues run
+// concurrently
+// 2. Calculates the aggregate bandwidth from the wall clock time of all the
+// transfers, and the latency percentiles from the profiling information of
+// each transfer
+
+void MeasureSweepPoint(std::vector<SweepSlot> &slots, SweepMemory mem,
+                       bool write, size_t bytes, size_t reps,
+                       SweepResult &res) {
+  std::vector<sycl::event> evts;
+  evts.reserve(slots.size() * reps);
+
+  auto start = std::chrono::steady_clock::now();
+  for (size_t r = 0; r < reps; r++) {
+    for (auto &s : slots) {
+      evts.push_back(SubmitSweepTransfer(s, mem, write, bytes));
+    }
+  }
+  for (auto &s : slots) s.q.wait();
+  auto end = std::chrono::steady_clock::now();
+
+  std::vector<double> latency_us;
+  latency_us.reserve(evts.size());
+  for (auto &e : evts) {
+    latency_us.push_back(SyclGetQStExecTimeNs(e) * 1e-3);
+  }
+  std::sort(latency_us.begin(), latency_us.end());
+
+  // nearest-rank percentile
+  auto percentile = [&](double p) {
+    size_t rank = (size_t)(p / 100.0 * latency_us.size() + 0.5);
+    return latency_us[std::min(std::max<size_t>(rank, 1),
+                               latency_us.size()) - 1];
+  };
+
+  double seconds = std::chrono::duration<double>(end - start).count();
+  res.direction = write ? "write" : "read";
+  res.queues = slots.size();
+  res.bytes = bytes;
+  res.transfers = evts.size();
+  res.bandwidth = ((double)bytes * evts.size() / kMB) / seconds;
+  res.min_us = latency_us.front();
+  res.p50_us = percentile(50);
+  res.p90_us = percentile(90);
+  res.p99_us = percentile(99);
+  res.max_us = latency_us.back();
+}
+
+//////////////////////////////////////
+// **** Sweep output functions **** //
+//////////////////////////////////////
+
+// The functions below write the results of the sweep, with information
+// about the system and device so that results from different nodes, drivers
+// and dates can be compared.
+
+std::string SweepHostname() {
+  char name[256] = {0};
+#if defined(_WIN32) || defined(_WIN64)
+  const char *env = std::getenv("COMPUTERNAME");
+  if (env) strncpy(name, env, sizeof(name) - 1);
+#else
+  gethostname(name, sizeof(name) - 1);
+#endif
+  return name;
+}
+
+std::string SweepTimestamp() {
+  std::time_t now = std::time(nullptr);
+  char buf[32];
+  std::strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+  return buf;
+}
+
+// escapes a string for a JSON string value or a quoted CSV field
+std::string SweepEscape(const std::string &str, bool json) {
+  std::string out;
+  for (char c : str) {
+    if (c == '"') {
+      out += json ? "\\\"" : "\"\"";
+    } else if (json && c == '\\') {
+      out += "\\\\";
+    } else if (json && (unsigned char)c < 0x20) {
+      out += ' ';
+    } else {
+      out += c;
+    }
+  }
+  return out;
+}
+
+bool WriteSweepJSON(const std::string &filename, sycl::queue &q,
+                    const std::vector<SweepResult> &results) {
+  std::ofstream ofs(filename);
+  if (!ofs.is_open()) {
+    std::cerr << "Error: could not open " << filename << " for writing\n";
+    return false;
+  }
+
+  auto dev = q.get_device();
+  ofs << std::fixed << std::setprecision(3);
+  ofs << "{\n"
+      << "  \"test\": \"host_bandwidth_sweep\",\n"
+      << "  \"hostname\": \"" << SweepEscape(SweepHostname(), true) << "\",\n"
+      << "  \"timestamp\": \"" << SweepTimestamp() << "\",\n"
+      << "  \"platform\": \""
+      << SweepEscape(dev.get_platform().get_info<sycl::info::platform::name>(),
+                     true)
+      << "\",\n"
+      << "  \"device\": \""
+      << SweepEscape(dev.get_info<sycl::info::device::name>(), true)
+      << "\",\n"
+      << "  \"driver\": \""
+      << SweepEscape(dev.get_info<sycl::info::device::driver_version>(), true)
+      << "\",\n"
+      << "  \"bandwidth_units\": \"MB/s\",\n"
+      << "  \"latency_units\": \"us\",\n"
+      << "  \"results\": [\n";
+  for (size_t i = 0; i < results.size(); i++) {
+    const auto &r = results[i];
+    ofs << "    {\"memory\": \"" << r.memory << "\", \"host\": \"" << r.host
+        << "\", \"direction\": \"" << r.direction
+        << "\", \"queues\": " << r.queues << ", \"bytes\": " << r.bytes
+        << ", \"transfers\": " << r.transfers
+        << ", \"bandwidth\": " << r.bandwidth << ", \"latency\": {\"min\": "
+        << r.min_us << ", \"p50\": " << r.p50_us << ", \"p90\": " << r.p90_us
+        << ", \"p99\": " << r.p99_us << ", \"max\": " << r.max_us << "}}"
+        << (i + 1 < results.size() ? "," : "") << "\n";
+  }
+  ofs << "  ]\n}\n";
+  return ofs.good();
+}
+
+bool WriteSweepCSV(const std::string &filename, sycl::queue &q,
+                   const std::vector<SweepResult> &results) {
+  std::ofstream ofs(filename);
+  if (!ofs.is_open()) {
+    std::cerr << "Error: could not open " << filename << " for writing\n";
+    return false;
+  }
+
+  // the system information is repeated on each row, so that the files from
+  // several runs can simply be concatenated
+  auto dev = q.get_device();
+  std::string sys_info =
+      "\"" + SweepEscape(SweepHostname(), false) + "\",\"" +
+      SweepEscape(dev.get_info<sycl::info::device::name>(), false) + "\",\"" +
+      SweepEscape(dev.get_info<sycl::info::device::driver_version>(), false) +
+      "\"," + SweepTimestamp();
+
+  ofs << std::fixed << std::setprecision(3);
+  ofs << "hostname,device,driver,timestamp,memory,host,direction,queues,"
+      << "bytes,transfers,bandwidth_MBps,latency_min_us,latency_p50_us,"
+      << "latency_p90_us,latency_p99_us,latency_max_us\n";
+  for (const auto &r : results) {
+    ofs << sys_info << "," << r.memory << "," << r.host << "," << r.direction
+        << "," << r.queues << "," << r.bytes << "," << r.transfers << ","
+        << r.bandwidth << "," << r.min_us << "," << r.p50_us << ","
+        << r.p90_us << "," << r.p99_us << "," << r.max_us << "\n";
+  }
+  return ofs.good();
+}
+
+///////////////////////////////////////
+// **** BandwidthSweep function **** //
+///////////////////////////////////////
+
+// Inputs:
+// 1. queue &q - queue of the device to test (a new queue is created for each
+// of the concurrent queues)
+// 2. const SweepOptions &opts - the range of the sweep and the output files
+// Returns:
+// 0 if test passes, 1 if test fails
+
+// The function does the following tasks:
+// For each combination of:
+//   - the device memory (buffer, USM device, USM shared, USM host)
+//   - the host memory (pageable from new[], or pinned from malloc_host)
+//   - 1 to opts.max_queues concurrent queues
+//   - transfer sizes from opts.min_bytes to opts.max_bytes, doubling each step
+// 1. Measure the write and read bandwidth and transfer latencies
+// 2. Verify the data read back matches the data written
+// 3. Print the results, and write them to the JSON and/or CSV file
+// Memory types that the device does not support are skipped.
+
+int BandwidthSweep(sycl::queue &q, const SweepOptions &opts) {
+  if (opts.min_bytes < sizeof(sycl::ulong8) ||
+      opts.min_bytes % sizeof(sycl::ulong8) != 0 ||
+      opts.max_bytes < opts.min_bytes) {
+    std::cerr << "Error: the sweep sizes must be multiples of "
+              << sizeof(sycl::ulong8) << " bytes, with sweep_min <= "
+              << "sweep_max\n";
+    return 1;
+  }
+  if (opts.reps == 0 || opts.max_queues == 0) {
+    std::cerr << "Error: sweep_reps and sweep_queues must be at least 1\n";
+    return 1;
+  }
+
+  auto dev = q.get_device();
+  bool has_usm_host = dev.has(sycl::aspect::usm_host_allocations);
+  bool has_usm_shared = dev.has(sycl::aspect::usm_shared_allocations);
+
+  struct Config {
+    SweepMemory mem;
+    SweepHost host;
+    const char *mem_name;
+    const char *host_name;
+  };
+  // USM host memory is always pinned, it has no pageable variant
+  const Config configs[] = {
+      {SweepMemory::kBuffer, SweepHost::kPageable, "buffer", "pageable"},
+      {SweepMemory::kBuffer, SweepHost::kPinned, "buffer", "pinned"},
+      {SweepMemory::kUSMDevice, SweepHost::kPageable, "usm_device",
+       "pageable"},
+      {SweepMemory::kUSMDevice, SweepHost::kPinned, "usm_device", "pinned"},
+      {SweepMemory::kUSMShared, SweepHost::kPageable, "usm_shared",
+       "pageable"},
+      {SweepMemory::kUSMShared, SweepHost::kPinned, "usm_shared", "pinned"},
+      {SweepMemory::kUSMHost, SweepHost::kPinned, "usm_host", "pinned"},
+  };
+
+  std::cout << "Sweeping transfers of " << opts.min_bytes << " to "
+            << opts.max_bytes << " bytes with 1 to " << opts.max_queues
+            << " queues (" << opts.reps << " transfers per queue)\n";
+
+  std::ios old_state(nullptr);
+  old_state.copyfmt(std::cout);
+
+  std::vector<SweepResult> results;
+  bool result = true;
+
+  for (const auto &cfg : configs) {
+    bool pinned = cfg.host == SweepHost::kPinned;
+    if ((pinned || cfg.mem == SweepMemory::kUSMHost) && !has_usm_host) {
+      std::cout << "\nSkipping " << cfg.mem_name << " with " << cfg.host_name
+                << " host memory: no USM host allocations on this device\n";
+      continue;
+    }
+    if (cfg.mem == SweepMemory::kUSMShared && !has_usm_shared) {
+      std::cout << "\nSkipping " << cfg.mem_name << " with " << cfg.host_name
+                << " host memory: no USM shared allocations on this device\n";
+      continue;
+    }
+
+    std::cout << "\n--- " << cfg.mem_name << " with " << cfg.host_name
+              << " host memory\n";
+    std::cout << "Queues Block_Size Direction  MB/s      Latency (us): "
+              << "Min P50 P90 P99 Max\n";
+
+    for (size_t num_queues = 1; num_queues <= opts.max_queues; num_queues++) {
+      // **** Allocate the memory of each queue **** //
+      std::vector<SweepSlot> slots;
+      slots.reserve(num_queues);
+      for (size_t i = 0; i < num_queues; i++) {
+        slots.emplace_back(sycl::queue(
+            q.get_context(), dev,
+            sycl::property_list{sycl::property::queue::enable_profiling(),
+                                sycl::property::queue::in_order()}));
+      }
+
+      bool alloc_ok = true;
+      for (auto &s : slots) {
+        if (pinned) {
+          s.host_src = sycl::malloc_host<char>(opts.max_bytes, s.q);
+          s.host_dst = sycl::malloc_host<char>(opts.max_bytes, s.q);
+        } else {
+          s.host_src = new char[opts.max_bytes];
+          s.host_dst = new char[opts.max_bytes];
+        }
+        if (cfg.mem == SweepMemory::kBuffer) {
+          s.buf = std::make_unique<sycl::buffer<char, 1>>(
+              sycl::range<1>(opts.max_bytes));
+        } else if (cfg.mem == SweepMemory::kUSMDevice) {
+          s.usm = sycl::malloc_device<char>(opts.max_bytes, s.q);
+        } else if (cfg.mem == SweepMemory::kUSMShared) {
+          s.usm = sycl::malloc_shared<char>(opts.max_bytes, s.q);
+        } else {
+          s.usm = sycl::malloc_host<char>(opts.max_bytes, s.q);
+          s.staging = sycl::malloc_device<char>(opts.max_bytes, s.q);
+          if (s.staging == nullptr) alloc_ok = false;
+        }
+        if (s.host_src == nullptr || s.host_dst == nullptr ||
+            (cfg.mem != SweepMemory::kBuffer && s.usm == nullptr)) {
+          alloc_ok = false;
+        }
+        if (alloc_ok) {
+          for (size_t j = 0; j < opts.max_bytes; j++) {
+            s.host_src[j] = (char)(rand() ^ j);
+          }
+        }
+      }
+
+      if (!alloc_ok) {
+        std::cerr << "Error: could not allocate " << num_queues << " x "
+                  << opts.max_bytes << " bytes of " << cfg.mem_name
+                  << " memory, skipping\n";
+      }
+
+      for (size_t bytes = opts.min_bytes; alloc_ok && bytes <= opts.max_bytes;
+           bytes *= 2) {
+        // the USM host transfers copy from and to the USM host allocation
+        if (cfg.mem == SweepMemory::kUSMHost) {
+          for (auto &s : slots) memcpy(s.usm, s.host_src, bytes);
+        }
+
+        // warm up the link and the queues
+        for (auto &s : slots) {
+          SubmitSweepTransfer(s, cfg.mem, true, bytes);
+          SubmitSweepTransfer(s, cfg.mem, false, bytes);
+          s.q.wait();
+        }
+
+        SweepResult wr, rd;
+        wr.memory = rd.memory = cfg.mem_name;
+        wr.host = rd.host = cfg.host_name;
+        MeasureSweepPoint(slots, cfg.mem, true, bytes, opts.reps, wr);
+
+        // clear the destination, so the check fails if the read is lost
+        for (auto &s : slots) {
+          memset(cfg.mem == SweepMemory::kUSMHost ? s.usm : s.host_dst, 0,
+                 bytes);
+        }
+        MeasureSweepPoint(slots, cfg.mem, false, bytes, opts.reps, rd);
+
+        // Verify value read back matches value that was written to device
+        for (auto &s : slots) {
+          char *read_back =
+              cfg.mem == SweepMemory::kUSMHost ? s.usm : s.host_dst;
+          if (memcmp(read_back, s.host_src, bytes) != 0) {
+            std::cerr << "Error! Data mismatch for " << cfg.mem_name << " with "
+                      << cfg.host_name << " host memory, " << num_queues
+                      << " queues, " << bytes << " bytes\n";
+            result = false;
+          }
+        }
+
+        for (const auto *r : {&wr, &rd}) {
+          std::cout << std::setw(6) << r->queues << " " << std::setw(10)
+                    << r->bytes << " " << std::setw(9) << std::left
+                    << r->direction << std::right << " " << std::setw(9)
+                    << std::setprecision(2) << std::fixed << r->bandwidth
+                    << " " << r->min_us << " " << r->p50_us << " "
+                    << r->p90_us << " " << r->p99_us << " " << r->max_us
+                    << "\n";
+          std::cout.copyfmt(old_state);
+        }
+        results.push_back(wr);
+        results.push_back(rd);
+      }
+
+      // **** Free the memory of each queue **** //
+      for (auto &s : slots) {
+        s.q.wait();
+        if (pinned) {
+          if (s.host_src) sycl::free(s.host_src, s.q);
+          if (s.host_dst) sycl::free(s.host_dst, s.q);
+        } else {
+          delete[] s.host_src;
+          delete[] s.host_dst;
+        }
+        if (s.usm) sycl::free(s.usm, s.q);
+        if (s.staging) sycl::free(s.staging, s.q);
+      }
+      if (!alloc_ok) break;
+    }
+  }
+
+  // **** Write the results **** //
+  if (!opts.json_file.empty()) {
+    if (WriteSweepJSON(opts.json_file, q, results)) {
+      std::cout << "\nWrote the sweep results to " << opts.json_file << "\n";
+    } else {
+      result = false;
+    }
+  }
+  if (!opts.csv_file.empty()) {
+    if (WriteSweepCSV(opts.csv_file, q, results)) {
+      std::cout << "\nWrote the sweep results to " << opts.csv_file << "\n";
+    } else {
+      result = false;
+    }
+  }
+
+  if (result) std::cout << "\nHOST BANDWIDTH SWEEP PASSED\n";
+  else std::cerr << "\nFAILURE!\n";
+
+  return (result) ? 0 : 1;
+}
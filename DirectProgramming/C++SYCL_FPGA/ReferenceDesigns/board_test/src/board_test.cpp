@@ -14,11 +14,14 @@ int main(int argc, char* argv[]) {
   // Default is to run all tests
   int test_to_run = 0;
 
+  // Options of the host-to-device bandwidth sweep (test 7)
+  SweepOptions sweep_opts;
+
   // test_to_run value changed according to user selection if user has provided
   // an input using "-test=<test_number>" option (see PrintHelp function for
   // test details)
-  if (argc == 2) {
-    std::string tmp_test(argv[1]);
+  for (int i = 1; i < argc; i++) {
+    std::string tmp_test(argv[i]);
     if ((tmp_test.compare(0, 6, "-test=")) == 0) {
       test_to_run = std::stoi(tmp_test.substr(6));
       if (test_to_run < 0 || test_to_run > 7) {
@@ -30,7 +33,7 @@ int main(int argc, char* argv[]) {
     } else if ((tmp_test.compare(0, 5, "-help")) == 0) {
       PrintHelp(1);
       return 0;
-    } else {
+    } else if (!ParseSweepOption(tmp_test, sweep_opts)) {
       std::cerr << "Incorrect argument passed to ./board_test.fpga! Cannot run "
                 << "test\n, please refer to usage information above for "
                 << "correct command.\nTerminating test!\n";
@@ -120,8 +123,7 @@ int main(int argc, char* argv[]) {
     // Test 2 - Kernel clock frequency (this is measured before all tests except
     // 1)
     if (test_to_run == 0 || test_to_run == 5 || test_to_run == 2 ||
-        test_to_run == 3 || test_to_run == 4 || test_to_run == 6 ||
-        test_to_run == 7) {
+        test_to_run == 3 || test_to_run == 4 || test_to_run == 6) {
       std::cout << "\n*****************************************************************\n"
                 << "*******************  Kernel Clock Frequency Test  ***************\n"
                 << "*****************************************************************\n\n";
@@ -200,6 +202,17 @@ int main(int argc, char* argv[]) {
 
       ret |= hldshim.KernelMemBW(q);
     }
+
+    // Test 7 - Host-to-Device Bandwidth Sweep
+    // This test is not part of the default run (test 0) as it can take a long
+    // time, it only runs when selected
+    if (test_to_run == 7) {
+      std::cout << "\n*****************************************************************\n"
+                << "***************  Host-to-Device Bandwidth Sweep  ***************\n"
+                << "*****************************************************************\n\n";
+
+      ret |= BandwidthSweep(q, sweep_opts);
+    }
   }  // End of try block
 
   catch (sycl::exception const& e) {
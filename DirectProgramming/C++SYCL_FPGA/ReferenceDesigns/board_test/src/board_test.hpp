@@ -2,6 +2,7 @@
 #include <vector>
 
 #include "host_speed.hpp"
+#include "bandwidth_sweep.hpp"
 
 // Pre-declare kernel name to prevent name mangling
 // This is an FPGA best practice that makes it easier to identify the kernel in
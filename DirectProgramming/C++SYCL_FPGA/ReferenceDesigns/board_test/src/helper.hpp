@@ -45,8 +45,11 @@ void PrintHelp(int details) {
               << "  4. Kernel Latency Measurement\n"
               << "  5. Kernel-to-Memory Read Write Test\n"
               << "  6. Kernel-to-Memory Bandwidth Test\n"
+              << "  7. Host-to-Device Bandwidth Sweep (only run when selected)"
+              << "\n"
               << "Note: Kernel Clock Frequency is run along with all tests "
-              << "except 1 (Host Speed and Host Read Write test)\n\n";
+              << "except 1 (Host Speed and Host Read Write test) and 7 (Host-to-"
+              << "Device Bandwidth Sweep)\n\n";
   } else {
     std::cout
         << "*** Board_test test details ***\n"
@@ -86,6 +89,24 @@ void PrintHelp(int details) {
         << "bandwidth defined in board_spec.xml file in the oneAPI shim/BSP.\n\n"
         << "    Note: This test assumes that design was compiled with "
         << "-Xsno-interleaving option\n\n"
+        << "  * 7. Host-to-Device Bandwidth Sweep *\n"
+        << "    Host-to-Device Bandwidth Sweep measures the write and read "
+        << "bandwidth and the transfer latency percentiles for buffers and USM "
+        << "device, shared and host memory, from pageable and pinned host "
+        << "memory, with 1 to N concurrent queues, over a range of transfer "
+        << "sizes. The data read back is verified. This test is not run by "
+        << "default. Options:\n"
+        << "      -sweep_min=<bytes>  smallest transfer (default 4K)\n"
+        << "      -sweep_max=<bytes>  largest transfer (default 64M, 4M in "
+        << "emulation)\n"
+        << "      -sweep_reps=<n>     transfers per queue at each size "
+        << "(default 16, 4 in emulation)\n"
+        << "      -sweep_queues=<n>   sweep 1 to n concurrent queues "
+        << "(default 4)\n"
+        << "      -json=<file>        write the results to a JSON file\n"
+        << "      -csv=<file>         write the results to a CSV file\n"
+        << "    e.g. ./board_test.fpga -test=7 -sweep_max=16M -json=sweep.json"
+        << "\n\n"
         << "Please use the commands shown at the beginning of this help to run "
         << "all or one of the above tests\n\n";
   }
@@ -37,6 +37,11 @@ constexpr size_t kMaxNSteps1 = 8190;
 constexpr size_t kMaxNSteps2 = 8191;
 constexpr size_t kMaxNSteps3 = 8192;
 
+// The number of time steps is set per option (see InputData). The kernel
+// terminates early for options with fewer than kMaxNSteps steps. The Greeks
+// need at least kMinNSteps steps.
+constexpr size_t kMinNSteps = 3;
+
 // Increment by a small epsilon in order to compute derivative 
 // of option price with respect to Vol or Interest. The derivatives
 // are then used to compute Vega and Rho. 
@@ -92,11 +92,15 @@
 
 #include <sycl/sycl.hpp>
 #include <sycl/ext/intel/fpga_extensions.hpp>
+#include <algorithm>
+#include <chrono>
 #include <cstddef>
 #include <cstdlib>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <limits>
+#include <numeric>
 #include <regex>
 #include <sstream>
 #include <string>
@@ -109,259 +113,360 @@ using namespace std;
 using namespace sycl;
 
 class CRRSolver;
-double CrrSolver(const int n_items, vector<CRRMeta> &in_params,
-                  vector<CRRResParams> &res_params,
-                  vector<CRRPerStepMeta> &in_params2, queue &q) {
-  auto start = std::chrono::steady_clock::now();
 
-  constexpr int steps = kMaxNSteps2;
+// The default premium tolerance, and the smallest number of time steps tried,
+// for the adaptive mode
+constexpr double kDefaultAdaptiveTolerance = 1e-3;
+constexpr int kMinAdaptiveNSteps = 32;
 
-  const int n_crr =
-      (((n_items + (OUTER_UNROLL - 1)) / OUTER_UNROLL) * OUTER_UNROLL) * 3;
+// The default number of options in each batch of the streaming mode
+#if defined(FPGA_EMULATOR)
+constexpr int kDefaultStreamBatch = OUTER_UNROLL;
+#else
+constexpr int kDefaultStreamBatch = 16 * OUTER_UNROLL;
+#endif
 
-  {
-    buffer<CRRMeta, 1> i_params(in_params.size());
-    buffer<CRRPerStepMeta, 1> a_params(in_params2.size());
-    buffer<CRRResParams, 1> r_params(res_params.size());
-    r_params.set_final_data(res_params.data());
-
-    event e;
-    {
-      // copy the input buffers
-      q.submit([&](handler& h) {
-        auto accessor_v =
-          i_params.template get_access<access::mode::discard_write>(h);
-        h.copy(in_params.data(), accessor_v);
-      });
-
-      q.submit([&](handler& h) {
-        auto accessor_v2 =
-          a_params.template get_access<access::mode::discard_write>(h);
-        h.copy(in_params2.data(), accessor_v2);
-      });
-
-      // start the main kernel
-      e = q.submit([&](handler &h) {
-        auto accessor_v =
-            i_params.template get_access<access::mode::read_write>(h);
-
-        auto accessor_v2 =
-            a_params.template get_access<access::mode::read_write>(h);
-
-        auto accessor_r =
-            r_params.template get_access<access::mode::discard_write>(h);
-
-        h.single_task<CRRSolver>([=]() [[intel::kernel_args_restrict]] {
-          // Kernel requires n_crr to be a multiple of OUTER_UNROLL.
-          // This is taken care of by the host.
-          const int n_crr_div = n_crr / OUTER_UNROLL;
-
-          // Outerloop counter. Use while-loop for better timing-closure
-          // characteristics because it tells the compiler the loop body will
-          // never be skipped.
-          int oc = 0;
-          do {
-            // Metadata of CRR problems
-            [[intel::fpga_register]] double u[OUTER_UNROLL];
-            [[intel::fpga_register]] double c1[OUTER_UNROLL];
-            [[intel::fpga_register]] double c2[OUTER_UNROLL];
-            [[intel::fpga_register]] double param_1[OUTER_UNROLL];
-            [[intel::fpga_register]] double param_2[OUTER_UNROLL];
-            [[intel::fpga_register]] short n_steps[OUTER_UNROLL];
-
-            // Current values in binomial tree.  We only need to keep track of
-            // one level worth of data, not the entire tree.
-            [[intel::fpga_memory, intel::singlepump,
-              intel::bankwidth(sizeof(double)),
-              intel::numbanks(INNER_UNROLL * OUTER_UNROLL_POW2),
-              intel::private_copies(
-                  8)]] double optval[kMaxNSteps3][OUTER_UNROLL_POW2];
-
-            // Initial values in binomial tree, which correspond to the last
-            // level of the binomial tree.
-            [[intel::fpga_memory, intel::singlepump,
-              intel::bankwidth(sizeof(double)),
-              intel::numbanks(INNER_UNROLL * OUTER_UNROLL_POW2),
-              intel::private_copies(
-                  8)]] double init_optval[kMaxNSteps3][OUTER_UNROLL_POW2];
-
-            // u2_array precalculates the power function of u2.
-            [[intel::fpga_memory, intel::singlepump,
-              intel::bankwidth(sizeof(double)),
-              intel::numbanks(INNER_UNROLL * OUTER_UNROLL_POW2),
-              intel::private_copies(
-                  8)]] double u2_array[kMaxNSteps3][OUTER_UNROLL_POW2];
-
-            // p1powu_array precalculates p1 multipy the power of u.
-            [[intel::fpga_memory, intel::singlepump,
-              intel::bankwidth(sizeof(double)),
-              intel::numbanks(INNER_UNROLL * OUTER_UNROLL_POW2),
-              intel::private_copies(
-                  8)]] double p1powu_array[kMaxNSteps3][OUTER_UNROLL_POW2];
-
-            // n0_optval stores the binomial tree value corresponding to node 0
-            // of a level. This is the same as what's stored in
-            // optval/init_optval, but replicating this data allows us to have
-            // only one read port for optval and init_optval, thereby removing
-            // the need of double-pumping or replication. n0_optval_2 is a copy
-            // of n0_optval that stores the node 0 value for a specific layer of
-            // the tree. pgreek is the array saving values for post-calculating
-            // Greeks.
-            [[intel::fpga_register]] double n0_optval[OUTER_UNROLL];
-            [[intel::fpga_register]] double n0_optval_2[OUTER_UNROLL];
-            [[intel::fpga_register]] double pgreek[4][OUTER_UNROLL];
-
-            // L1 + L2:
-            // Populate init_optval -- calculate the last level of the binomial
-            // tree.
-            for (short ic = 0; ic < OUTER_UNROLL; ++ic) {
-              // Transfer data from DRAM to local memory or registers
-              const int c = oc * OUTER_UNROLL + ic;
-              const CRRMeta param = accessor_v[c];
-
-              u[ic] = param.u;
-              c1[ic] = param.c1;
-              c2[ic] = param.c2;
-              param_1[ic] = param.param_1;
-              param_2[ic] = param.param_2;
-              n_steps[ic] = param.n_steps;
-
-              for (short t = steps; t >= 0; --t) {
-                const ArrayEle param_array = accessor_v2[c].array_eles[t];
-
-                const double init_val = param_array.init_optval;
-
-                init_optval[t][ic] = init_val;
-
-                // n0_optval intends to store the node value at t == 0.
-                // Instead of qualifying this statement by an "if (t == 0)",
-                // which couples the loop counter to the timing path of the
-                // assignment, we reverse the loop direction so the last value
-                // stored corresponds to t == 0.
-                n0_optval[ic] = init_val;
-
-                // Transfer data from DRAM to local memory or registers
-                u2_array[t][ic] = param_array.u2;
-                p1powu_array[t][ic] = param_array.p1powu;
-              }
-            }
+// Submits the CRR kernel, which solves the 'n_crr' CRR problems in the device
+// memory pointed to by 'in_params' and 'in_params2' and writes the results to
+// 'res_params'. The kernel starts once the events in 'deps' are complete.
+// Both CrrSolver and CrrStreamSolver use this function, so that there is only
+// one copy of the kernel in the FPGA image.
+event SubmitCRRKernel(queue &q, const CRRMeta *in_params,
+                      const CRRPerStepMeta *in_params2,
+                      CRRResParams *res_params, const int n_crr,
+                      const vector<event> &deps = {}) {
+  return q.submit([&](handler &h) {
+    h.depends_on(deps);
+
+    h.single_task<CRRSolver>([=]() [[intel::kernel_args_restrict]] {
+      // Kernel requires n_crr to be a multiple of OUTER_UNROLL.
+      // This is taken care of by the host.
+      const int n_crr_div = n_crr / OUTER_UNROLL;
+
+      // Outerloop counter. Use while-loop for better timing-closure
+      // characteristics because it tells the compiler the loop body will
+      // never be skipped.
+      int oc = 0;
+      do {
+        // Metadata of CRR problems
+        [[intel::fpga_register]] double u[OUTER_UNROLL];
+        [[intel::fpga_register]] double c1[OUTER_UNROLL];
+        [[intel::fpga_register]] double c2[OUTER_UNROLL];
+        [[intel::fpga_register]] double param_1[OUTER_UNROLL];
+        [[intel::fpga_register]] double param_2[OUTER_UNROLL];
+        [[intel::fpga_register]] short n_steps[OUTER_UNROLL];
+
+        // Current values in binomial tree.  We only need to keep track of
+        // one level worth of data, not the entire tree.
+        [[intel::fpga_memory, intel::singlepump,
+          intel::bankwidth(sizeof(double)),
+          intel::numbanks(INNER_UNROLL * OUTER_UNROLL_POW2),
+          intel::private_copies(
+              8)]] double optval[kMaxNSteps3][OUTER_UNROLL_POW2];
+
+        // Initial values in binomial tree, which correspond to the last
+        // level of the binomial tree.
+        [[intel::fpga_memory, intel::singlepump,
+          intel::bankwidth(sizeof(double)),
+          intel::numbanks(INNER_UNROLL * OUTER_UNROLL_POW2),
+          intel::private_copies(
+              8)]] double init_optval[kMaxNSteps3][OUTER_UNROLL_POW2];
+
+        // u2_array precalculates the power function of u2.
+        [[intel::fpga_memory, intel::singlepump,
+          intel::bankwidth(sizeof(double)),
+          intel::numbanks(INNER_UNROLL * OUTER_UNROLL_POW2),
+          intel::private_copies(
+              8)]] double u2_array[kMaxNSteps3][OUTER_UNROLL_POW2];
+
+        // p1powu_array precalculates p1 multipy the power of u.
+        [[intel::fpga_memory, intel::singlepump,
+          intel::bankwidth(sizeof(double)),
+          intel::numbanks(INNER_UNROLL * OUTER_UNROLL_POW2),
+          intel::private_copies(
+              8)]] double p1powu_array[kMaxNSteps3][OUTER_UNROLL_POW2];
+
+        // n0_optval stores the binomial tree value corresponding to node 0
+        // of a level. This is the same as what's stored in
+        // optval/init_optval, but replicating this data allows us to have
+        // only one read port for optval and init_optval, thereby removing
+        // the need of double-pumping or replication. n0_optval_2 is a copy
+        // of n0_optval that stores the root of each CRR's own tree. pgreek
+        // is the array saving values for post-calculating Greeks.
+        [[intel::fpga_register]] double n0_optval[OUTER_UNROLL];
+        [[intel::fpga_register]] double n0_optval_2[OUTER_UNROLL];
+        [[intel::fpga_register]] double pgreek[4][OUTER_UNROLL];
+
+        // L1:
+        // Transfer the metadata from DRAM to registers. The CRRs that are
+        // processed together are all computed with the depth of the deepest
+        // of their trees, so shallow trees terminate early.
+        short steps = 0;
+        #pragma unroll
+        for (short ic = 0; ic < OUTER_UNROLL; ++ic) {
+          const int c = oc * OUTER_UNROLL + ic;
+          const CRRMeta param = in_params[c];
+
+          u[ic] = param.u;
+          c1[ic] = param.c1;
+          c2[ic] = param.c2;
+          param_1[ic] = param.param_1;
+          param_2[ic] = param.param_2;
+          n_steps[ic] = param.n_steps;
+          steps = (param.n_steps > steps) ? param.n_steps : steps;
+        }
+
+        // L2:
+        // Populate init_optval -- calculate the last level of the binomial
+        // tree.
+        for (short ic = 0; ic < OUTER_UNROLL; ++ic) {
+          // Transfer data from DRAM to local memory or registers
+          const int c = oc * OUTER_UNROLL + ic;
+
+          for (short t = steps; t >= 0; --t) {
+            const ArrayEle param_array = in_params2[c].array_eles[t];
+
+            const double init_val = param_array.init_optval;
+
+            init_optval[t][ic] = init_val;
+
+            // n0_optval intends to store the node value at t == 0.
+            // Instead of qualifying this statement by an "if (t == 0)",
+            // which couples the loop counter to the timing path of the
+            // assignment, we reverse the loop direction so the last value
+            // stored corresponds to t == 0.
+            n0_optval[ic] = init_val;
+
+            // Transfer data from DRAM to local memory or registers
+            u2_array[t][ic] = param_array.u2;
+            p1powu_array[t][ic] = param_array.p1powu;
+          }
+        }
+
+        // L3:
+        // Update optval[] -- calculate each level of the binomial tree.
+        // reg[] helps to achieve updating INNER_UNROLL elements in optval[]
+        // simultaneously.
+        [[intel::disable_loop_pipelining]] for (short t = 0;
+                                                    t <= steps - 1; ++t) {
+          [[intel::fpga_register]] double reg[INNER_UNROLL + 1][OUTER_UNROLL];
+
+          double val_1, val_2;
 
-            // L3:
-            // Update optval[] -- calculate each level of the binomial tree.
-            // reg[] helps to achieve updating INNER_UNROLL elements in optval[]
-            // simultaneously.
-            [[intel::disable_loop_pipelining]] for (short t = 0;
-                                                        t <= steps - 1; ++t) {
-              [[intel::fpga_register]] double reg[INNER_UNROLL + 1][OUTER_UNROLL];
+          #pragma unroll
+          for (short ic = 0; ic < OUTER_UNROLL; ++ic) {
+            reg[0][ic] = n0_optval[ic];
+          }
 
-              double val_1, val_2;
+          // L4:
+          // Calculate all the elements in optval[] -- all the tree nodes
+          // for one level of the tree
+          [[intel::ivdep]] for (int n = 0; n <= steps - 1 - t;
+                                    n += INNER_UNROLL) {
+
+            #pragma unroll
+            for (short ic = 0; ic < OUTER_UNROLL; ++ic) {
 
               #pragma unroll
-              for (short ic = 0; ic < OUTER_UNROLL; ++ic) {
-                reg[0][ic] = n0_optval[ic];
+              for (short ri = 1; ri <= INNER_UNROLL; ++ri) {
+                reg[ri][ic] =
+                    (t == 0) ? init_optval[n + ri][ic] : optval[n + ri][ic];
               }
 
-              // L4:
-              // Calculate all the elements in optval[] -- all the tree nodes
-              // for one level of the tree
-              [[intel::ivdep]] for (int n = 0; n <= steps - 1 - t;
-                                        n += INNER_UNROLL) {
-
-                #pragma unroll
-                for (short ic = 0; ic < OUTER_UNROLL; ++ic) {
-
-                  #pragma unroll
-                  for (short ri = 1; ri <= INNER_UNROLL; ++ri) {
-                    reg[ri][ic] =
-                        (t == 0) ? init_optval[n + ri][ic] : optval[n + ri][ic];
-                  }
-
-                  #pragma unroll
-                  for (short ri = 0; ri < INNER_UNROLL; ++ri) {
-                    const double val = sycl::fmax(
-                        c1[ic] * reg[ri][ic] + c2[ic] * reg[ri + 1][ic],
-                        p1powu_array[t][ic] * u2_array[n + ri][ic] -
-                            param_2[ic]);
-
-                    optval[n + ri][ic] = val;
-                    if (n + ri == 0) {
-                      n0_optval[ic] = val;
-                    }
-                    if (n + ri == 1) {
-                      val_1 = val;
-                    }
-                    if (n + ri == 2) {
-                      val_2 = val;
-                    }
-                  }
-
-                  reg[0][ic] = reg[INNER_UNROLL][ic];
-
-                  if (t == steps - 5) {
-                    pgreek[3][ic] = val_2;
-                  }
-                  if (t == steps - 3) {
-                    pgreek[0][ic] = n0_optval[ic];
-                    pgreek[1][ic] = val_1;
-                    pgreek[2][ic] = val_2;
-                    n0_optval_2[ic] = n0_optval[ic];
-                  }
+              #pragma unroll
+              for (short ri = 0; ri < INNER_UNROLL; ++ri) {
+                const double val = sycl::fmax(
+                    c1[ic] * reg[ri][ic] + c2[ic] * reg[ri + 1][ic],
+                    p1powu_array[t][ic] * u2_array[n + ri][ic] -
+                        param_2[ic]);
+
+                optval[n + ri][ic] = val;
+                if (n + ri == 0) {
+                  n0_optval[ic] = val;
+                }
+                if (n + ri == 1) {
+                  val_1 = val;
+                }
+                if (n + ri == 2) {
+                  val_2 = val;
                 }
               }
-            }
 
-            // L5: transfer crr_res_paramss to DRAM
-            #pragma unroll
-            for (short ic = 0; ic < OUTER_UNROLL; ++ic) {
-              const int c = oc * OUTER_UNROLL + ic;
-              if (n_steps[ic] < steps) {
-                accessor_r[c].optval0 = n0_optval_2[ic];
-              } else {
-                accessor_r[c].optval0 = n0_optval[ic];
+              reg[0][ic] = reg[INNER_UNROLL][ic];
+
+              // A tree that is shallower than 'steps' is embedded in the
+              // top of the deeper tree, so the nodes of each CRR are captured
+              // relative to the depth of its own tree.
+              if (t == n_steps[ic] - 5) {
+                pgreek[3][ic] = val_2;
+              }
+              if (t == n_steps[ic] - 3) {
+                pgreek[0][ic] = n0_optval[ic];
+                pgreek[1][ic] = val_1;
+                pgreek[2][ic] = val_2;
+              }
+              if (t == n_steps[ic] - 1) {
+                n0_optval_2[ic] = n0_optval[ic];
               }
-              accessor_r[c].pgreek[0] = pgreek[0][ic];
-              accessor_r[c].pgreek[1] = pgreek[1][ic];
-              accessor_r[c].pgreek[2] = pgreek[2][ic];
-              accessor_r[c].pgreek[3] = pgreek[3][ic];
             }
-            // Increment counters
-            oc += 1;
-          } while (oc < n_crr_div);
-        });
-      });
-    }
+          }
+        }
+
+        // L5: transfer crr_res_paramss to DRAM
+        #pragma unroll
+        for (short ic = 0; ic < OUTER_UNROLL; ++ic) {
+          const int c = oc * OUTER_UNROLL + ic;
+          res_params[c].optval0 = n0_optval_2[ic];
+          res_params[c].pgreek[0] = pgreek[0][ic];
+          res_params[c].pgreek[1] = pgreek[1][ic];
+          res_params[c].pgreek[2] = pgreek[2][ic];
+          res_params[c].pgreek[3] = pgreek[3][ic];
+        }
+        // Increment counters
+        oc += 1;
+      } while (oc < n_crr_div);
+    });
+  });
+}
+
+// Allocates device memory for 'n_crr' CRR problems, terminating on failure
+void AllocateCRRDeviceMemory(queue &q, const int n_crr, CRRMeta *&in_params,
+                             CRRPerStepMeta *&in_params2,
+                             CRRResParams *&res_params) {
+  if ((in_params = malloc_device<CRRMeta>(n_crr, q)) == nullptr) {
+    std::cerr << "ERROR: could not allocate space for 'in_params'\n";
+    std::terminate();
+  }
+  if ((in_params2 = malloc_device<CRRPerStepMeta>(n_crr, q)) == nullptr) {
+    std::cerr << "ERROR: could not allocate space for 'in_params2'\n";
+    std::terminate();
+  }
+  if ((res_params = malloc_device<CRRResParams>(n_crr, q)) == nullptr) {
+    std::cerr << "ERROR: could not allocate space for 'res_params'\n";
+    std::terminate();
   }
+}
+
+void FreeCRRDeviceMemory(queue &q, CRRMeta *in_params,
+                         CRRPerStepMeta *in_params2, CRRResParams *res_params) {
+  free(in_params, q);
+  free(in_params2, q);
+  free(res_params, q);
+}
+
+double CrrSolver(const int n_items, vector<CRRMeta> &in_params,
+                  vector<CRRResParams> &res_params,
+                  vector<CRRPerStepMeta> &in_params2, queue &q) {
+  auto start = std::chrono::steady_clock::now();
+
+  const int n_crr =
+      (((n_items + (OUTER_UNROLL - 1)) / OUTER_UNROLL) * OUTER_UNROLL) * 3;
+
+  CRRMeta *i_params;
+  CRRPerStepMeta *a_params;
+  CRRResParams *r_params;
+  AllocateCRRDeviceMemory(q, n_crr, i_params, a_params, r_params);
+
+  // copy the inputs to the device
+  auto copy_in = q.memcpy(i_params, in_params.data(),
+                          in_params.size() * sizeof(CRRMeta));
+  auto copy_in2 = q.memcpy(a_params, in_params2.data(),
+                           in_params2.size() * sizeof(CRRPerStepMeta));
+
+  // start the main kernel
+  auto e = SubmitCRRKernel(q, i_params, a_params, r_params, n_crr,
+                           {copy_in, copy_in2});
+
+  // copy the results back to the host
+  q.submit([&](handler &h) {
+    h.depends_on(e);
+    h.memcpy(res_params.data(), r_params,
+             res_params.size() * sizeof(CRRResParams));
+  }).wait();
+
+  FreeCRRDeviceMemory(q, i_params, a_params, r_params);
 
   auto end = std::chrono::steady_clock::now();
   double diff = std::chrono::duration_cast<std::chrono::duration<double>>(end - start).count();
   return diff;
 }
 
+// Parses one line of the input file, which holds one option
+InputData ParseInputLine(const string &line_of_args) {
+  InputData temp;
+  istringstream line_of_args_ss(line_of_args);
+  line_of_args_ss >> temp.n_steps;
+  line_of_args_ss.ignore(1, ',');
+  line_of_args_ss >> temp.cp;
+  line_of_args_ss.ignore(1, ',');
+  line_of_args_ss >> temp.spot;
+  line_of_args_ss.ignore(1, ',');
+  line_of_args_ss >> temp.fwd;
+  line_of_args_ss.ignore(1, ',');
+  line_of_args_ss >> temp.strike;
+  line_of_args_ss.ignore(1, ',');
+  line_of_args_ss >> temp.vol;
+  line_of_args_ss.ignore(1, ',');
+  line_of_args_ss >> temp.df;
+  line_of_args_ss.ignore(1, ',');
+  line_of_args_ss >> temp.t;
+
+  return temp;
+}
+
+// Sets the number of time steps of an option to 'n_steps', unless 'n_steps'
+// is 0, and checks that the kernel supports the option's number of time steps
+void SetNSteps(InputData &inp, const int n_steps) {
+  if (n_steps != 0) {
+    inp.n_steps = n_steps;
+  }
+  if (inp.n_steps != floor(inp.n_steps) || inp.n_steps < kMinNSteps ||
+      inp.n_steps > kMaxNSteps) {
+    std::cerr << "ERROR: the number of time steps (" << inp.n_steps
+              << ") must be an integer between " << kMinNSteps << " and "
+              << kMaxNSteps << "\n";
+    std::terminate();
+  }
+}
+
 void ReadInputFromFile(ifstream &input_file, vector<InputData> &inp) {
   string line_of_args;
   while (getline(input_file, line_of_args)) {
-    InputData temp;
-    istringstream line_of_args_ss(line_of_args);
-    line_of_args_ss >> temp.n_steps;
-    line_of_args_ss.ignore(1, ',');
-    line_of_args_ss >> temp.cp;
-    line_of_args_ss.ignore(1, ',');
-    line_of_args_ss >> temp.spot;
-    line_of_args_ss.ignore(1, ',');
-    line_of_args_ss >> temp.fwd;
-    line_of_args_ss.ignore(1, ',');
-    line_of_args_ss >> temp.strike;
-    line_of_args_ss.ignore(1, ',');
-    line_of_args_ss >> temp.vol;
-    line_of_args_ss.ignore(1, ',');
-    line_of_args_ss >> temp.df;
-    line_of_args_ss.ignore(1, ',');
-    line_of_args_ss >> temp.t;
-
-    inp.push_back(temp);
+    inp.push_back(ParseInputLine(line_of_args));
   }
 }
 
+// Reads the options from the input file a batch at a time, so that the
+// streaming mode can start pricing before the whole file has been read (or
+// before the rest of the options have even been written to it).
+class OptionReader {
+ public:
+  OptionReader(ifstream &input_file, size_t max_options, int n_steps)
+      : input_file_(input_file), remaining_(max_options), n_steps_(n_steps) {}
+
+  // Reads up to 'max_count' options into 'inp'. Returns the number of options
+  // read, which is 0 once the end of the input has been reached.
+  size_t ReadBatch(vector<InputData> &inp, size_t max_count) {
+    inp.clear();
+    string line_of_args;
+    while (inp.size() < max_count && remaining_ > 0 &&
+           getline(input_file_, line_of_args)) {
+      if (line_of_args.empty()) {
+        continue;
+      }
+      inp.push_back(ParseInputLine(line_of_args));
+      SetNSteps(inp.back(), n_steps_);
+      remaining_--;
+    }
+    return inp.size();
+  }
+
+ private:
+  ifstream &input_file_;
+  size_t remaining_;
+  int n_steps_;
+};
+
 static string ToStringWithPrecision(const double value, const int p = 6) {
   ostringstream out;
   out.precision(p);
@@ -505,7 +610,8 @@ void PrepareKernelData(vector<CRRInParams> &in_params,
       } else {
         dst_crr_meta.n_steps = src_crr_params.n_steps;
       }
-      for (int i = 0; i <= kMaxNSteps2; ++i) {
+      // the kernel only uses the elements of the CRR's own tree
+      for (int i = 0; i <= src_crr_params.n_steps + kOpt0; ++i) {
         dst_crr_per_step_meta.array_eles[i].u2 =
             src_crr_eles.array_eles[i][inner_func_index].u2;
         dst_crr_per_step_meta.array_eles[i].p1powu =
@@ -561,18 +667,10 @@ OutputRes ComputeOutput(const InputData &inp, const CRRInParams &in_params,
   return res;
 }
 
-// Perform CRR solving using the CPU and compare FPGA resutls with CPU results
-// to test correctness.
-void TestCorrectness(int k, int n_crrs, bool &pass, const InputData &inp,
-                     CRRInParams &vals, const OutputRes &fpga_res) {
-  if (k == 0) {
-    std::cout << "\n============= Correctness Test ============= \n";
-    std::cout << "Running analytical correctness checks... \n";
-  }
-
-  // This CRR benchmark ensures a minimum 4 decimal points match between FPGA and CPU
-  // "threshold" is chosen to enforce this guarantee
-  float threshold = 0.00001;
+// Perform CRR solving using the CPU. This is the golden result used by
+// TestCorrectness and the adaptive mode.
+// NOTE: 'vals' is modified by this function.
+OutputRes ComputeReference(const InputData &inp, CRRInParams &vals) {
   int i, j, q;
   double x;
   int n_steps = vals.n_steps;
@@ -582,7 +680,6 @@ void TestCorrectness(int k, int n_crrs, bool &pass, const InputData &inp,
   vector<double> pvalue_2(kMaxNSteps1);
   vector<double> pgreek(5);
   InterRes cpu_res_params;
-  OutputRes cpu_res;
 
   // option value computed at each final node
   x = vals.umin[0];
@@ -648,7 +745,22 @@ void TestCorrectness(int k, int n_crrs, bool &pass, const InputData &inp,
     cpu_res_params.pgreek[i - 1] = pgreek[i];
   }
 
-  cpu_res = ComputeOutput(inp, vals, cpu_res_params);
+  return ComputeOutput(inp, vals, cpu_res_params);
+}
+
+// Perform CRR solving using the CPU and compare FPGA resutls with CPU results
+// to test correctness.
+void TestCorrectness(int k, int n_crrs, bool &pass, const InputData &inp,
+                     CRRInParams &vals, const OutputRes &fpga_res) {
+  if (k == 0) {
+    std::cout << "\n============= Correctness Test ============= \n";
+    std::cout << "Running analytical correctness checks... \n";
+  }
+
+  // This CRR benchmark ensures a minimum 4 decimal points match between FPGA and CPU
+  // "threshold" is chosen to enforce this guarantee
+  float threshold = 0.00001;
+  OutputRes cpu_res = ComputeReference(inp, vals);
 
   if (abs(cpu_res.value - fpga_res.value) > threshold) {
     pass = false;
@@ -712,6 +824,334 @@ void TestThroughput(const double &time, const int &n_crrs) {
             << (n_crrs / time) << " assets/s\n";
 }
 
+// The state of one batch of options in the streaming pipeline. There are two
+// of these, so that the host can read and prepare one batch while the device
+// is processing the other.
+struct CRRStreamSlot {
+  // host data
+  vector<InputData> inp;
+  vector<CRRInParams> in_params;
+  vector<CRRArrayEles> array_params;
+  vector<CRRMeta> in_buff_params;
+  vector<CRRPerStepMeta> in_buff2_params;
+  vector<CRRResParams> res_params;
+
+  // device data, allocated once and reused by every batch in this slot
+  CRRMeta *in_buff_params_dev = nullptr;
+  CRRPerStepMeta *in_buff2_params_dev = nullptr;
+  CRRResParams *res_params_dev = nullptr;
+
+  // the batch that is in flight in this slot
+  bool busy = false;
+  event done;
+  std::chrono::steady_clock::time_point start;
+};
+
+// Waits for the batch in 'slot' to finish, then computes the premium and
+// Greeks of its options and writes them to the output file. The inputs and
+// results are appended to 'all_inp', 'all_in_params' and 'all_result' so they
+// can be checked once the stream is done. Returns the batch latency: the time
+// from when its first option was read until its results were written.
+double EmitStreamBatch(CRRStreamSlot &slot, ofstream &output_file,
+                       vector<InputData> &all_inp,
+                       vector<CRRInParams> &all_in_params,
+                       vector<OutputRes> &all_result) {
+  slot.done.wait();
+  slot.busy = false;
+
+  const int n_crrs = slot.inp.size();
+  vector<InterRes> process_res(n_crrs);
+  ProcessKernelResult(slot.res_params, process_res, n_crrs);
+
+  vector<OutputRes> result(n_crrs);
+  for (int i = 0; i < n_crrs; ++i) {
+    result[i] = ComputeOutput(slot.inp[i], slot.in_params[i], process_res[i]);
+  }
+
+  // emit the results as soon as they are ready
+  WriteOutputToFile(output_file, result);
+  output_file.flush();
+
+  auto end = std::chrono::steady_clock::now();
+
+  all_inp.insert(all_inp.end(), slot.inp.begin(), slot.inp.end());
+  all_in_params.insert(all_in_params.end(), slot.in_params.begin(),
+                       slot.in_params.begin() + n_crrs);
+  all_result.insert(all_result.end(), result.begin(), result.end());
+
+  return std::chrono::duration_cast<std::chrono::duration<double>>(
+             end - slot.start).count();
+}
+
+// Prices the options in the input file in batches of 'batch_size' through a
+// double-buffered pipeline. While the device processes one batch, the host
+// reads and prepares the next batch and writes out the results of the
+// previous one. Unlike CrrSolver, the device memory is allocated once for the
+// whole stream, and the input file is read incrementally. At most
+// 'max_options' options are read from the input. If 'n_steps' is not 0, it
+// overrides the number of time steps of every option.
+bool CrrStreamSolver(queue &q, ifstream &input_file, ofstream &output_file,
+                     const int batch_size, const size_t max_options,
+                     const int n_steps) {
+  // the kernel requires the number of CRRs to be a multiple of OUTER_UNROLL,
+  // so each batch is padded (with copies of its last option) up to a multiple
+  // of OUTER_UNROLL
+  const int max_crrs =
+      ((batch_size + (OUTER_UNROLL - 1)) / OUTER_UNROLL) * OUTER_UNROLL;
+
+  CRRStreamSlot slots[2];
+  for (auto &slot : slots) {
+    slot.in_params.resize(max_crrs);
+    slot.array_params.resize(max_crrs);
+    slot.in_buff_params.resize(max_crrs * 3);
+    slot.in_buff2_params.resize(max_crrs * 3);
+    slot.res_params.resize(max_crrs * 3);
+    AllocateCRRDeviceMemory(q, max_crrs * 3, slot.in_buff_params_dev,
+                            slot.in_buff2_params_dev, slot.res_params_dev);
+  }
+
+  OptionReader reader(input_file, max_options, n_steps);
+  vector<InputData> all_inp;
+  vector<CRRInParams> all_in_params;
+  vector<OutputRes> all_result;
+  vector<double> latency;
+
+  std::cout << "\n============= Streaming Test =============\n";
+  std::cout << "Streaming options in batches of " << batch_size << "\n";
+
+  auto start = std::chrono::steady_clock::now();
+
+  size_t batch = 0;
+  for (;; batch++) {
+    CRRStreamSlot &slot = slots[batch % 2];
+
+    // the batch from two iterations ago used this slot, wait for it to finish
+    // and write out its results before reusing the slot
+    if (slot.busy) {
+      latency.push_back(EmitStreamBatch(slot, output_file, all_inp,
+                                        all_in_params, all_result));
+    }
+
+    // read the next batch of options
+    slot.start = std::chrono::steady_clock::now();
+    const int n_items = reader.ReadBatch(slot.inp, batch_size);
+    if (n_items == 0) {
+      break;
+    }
+    const int n_crrs =
+        ((n_items + (OUTER_UNROLL - 1)) / OUTER_UNROLL) * OUTER_UNROLL;
+
+    // prepare the kernel data for the batch, while the device is working on
+    // the previous batch
+    for (int j = 0; j < n_crrs; ++j) {
+      const InputData &inp = slot.inp[std::min(j, n_items - 1)];
+      slot.in_params[j] = PrepareData(inp);
+      slot.array_params[j] = PrepareArrData(slot.in_params[j]);
+    }
+    PrepareKernelData(slot.in_params, slot.array_params, slot.in_buff_params,
+                      slot.in_buff2_params, n_crrs);
+
+    // copy the batch to the device, process it and copy back the results
+    auto copy_in =
+        q.memcpy(slot.in_buff_params_dev, slot.in_buff_params.data(),
+                 n_crrs * 3 * sizeof(CRRMeta));
+    auto copy_in2 =
+        q.memcpy(slot.in_buff2_params_dev, slot.in_buff2_params.data(),
+                 n_crrs * 3 * sizeof(CRRPerStepMeta));
+    auto kernel_event =
+        SubmitCRRKernel(q, slot.in_buff_params_dev, slot.in_buff2_params_dev,
+                        slot.res_params_dev, n_crrs * 3, {copy_in, copy_in2});
+    slot.done = q.submit([&](handler &h) {
+      h.depends_on(kernel_event);
+      h.memcpy(slot.res_params.data(), slot.res_params_dev,
+               n_crrs * 3 * sizeof(CRRResParams));
+    });
+    slot.busy = true;
+  }
+
+  // drain the pipeline. The slot of the last (empty) batch was emitted above,
+  // so only the other slot can still hold a batch.
+  CRRStreamSlot &last_slot = slots[(batch + 1) % 2];
+  if (last_slot.busy) {
+    latency.push_back(EmitStreamBatch(last_slot, output_file, all_inp,
+                                      all_in_params, all_result));
+  }
+
+  auto end = std::chrono::steady_clock::now();
+  double time =
+      std::chrono::duration_cast<std::chrono::duration<double>>(end - start)
+          .count();
+
+  for (auto &slot : slots) {
+    FreeCRRDeviceMemory(q, slot.in_buff_params_dev, slot.in_buff2_params_dev,
+                        slot.res_params_dev);
+  }
+
+  if (all_result.empty()) {
+    std::cerr << "ERROR: the input file does not contain any options\n";
+    return false;
+  }
+
+  // check the results against the CPU, outside of the timed stream
+  bool pass = true;
+  const int n_crrs = all_result.size();
+  for (int i = 0; i < n_crrs; ++i) {
+    TestCorrectness(i, n_crrs, pass, all_inp[i], all_in_params[i],
+                    all_result[i]);
+  }
+
+  const double min_latency = *std::min_element(latency.begin(), latency.end());
+  const double max_latency = *std::max_element(latency.begin(), latency.end());
+  const double avg_latency =
+      std::accumulate(latency.begin(), latency.end(), 0.0) / latency.size();
+
+  std::cout << "\n============= Streaming Performance =============\n";
+  std::cout << "   Options:          " << n_crrs << " in " << latency.size()
+            << " batches\n";
+  std::cout << "   Avg throughput:   " << std::fixed << std::setprecision(1)
+            << (n_crrs / time) << " options/s\n";
+  std::cout << "   Batch latency:    " << std::fixed << std::setprecision(3)
+            << "min " << min_latency * 1e3 << " ms, avg "
+            << avg_latency * 1e3 << " ms, max " << max_latency * 1e3
+            << " ms\n";
+
+  return pass;
+}
+
+// Prices the options in 'inp' on the FPGA with a single call to CrrSolver and
+// computes their premium and Greeks. 'in_params' is set to the prepared
+// parameters of each option. Returns the time taken by CrrSolver.
+double PriceOptions(queue &q, const vector<InputData> &inp,
+                    vector<CRRInParams> &in_params, vector<OutputRes> &result) {
+  const int n_items = inp.size();
+  // pad up to a multiple of OUTER_UNROLL with copies of the last option
+  const int n_crrs =
+      ((n_items + (OUTER_UNROLL - 1)) / OUTER_UNROLL) * OUTER_UNROLL;
+
+  in_params.resize(n_crrs);
+  vector<CRRArrayEles> array_params(n_crrs);
+  for (int j = 0; j < n_crrs; ++j) {
+    in_params[j] = PrepareData(inp[std::min(j, n_items - 1)]);
+    array_params[j] = PrepareArrData(in_params[j]);
+  }
+
+  vector<CRRMeta> in_buff_params(n_crrs * 3);
+  vector<CRRPerStepMeta> in_buff2_params(n_crrs * 3);
+  vector<CRRResParams> res_params(n_crrs * 3);
+  PrepareKernelData(in_params, array_params, in_buff_params, in_buff2_params,
+                    n_crrs);
+
+  double time =
+      CrrSolver(n_crrs, in_buff_params, res_params, in_buff2_params, q);
+
+  vector<InterRes> process_res(n_crrs);
+  ProcessKernelResult(res_params, process_res, n_crrs);
+
+  in_params.resize(n_items);
+  result.resize(n_items);
+  for (int i = 0; i < n_items; ++i) {
+    result[i] = ComputeOutput(inp[i], in_params[i], process_res[i]);
+  }
+  return time;
+}
+
+// Picks the number of time steps of each option in 'inp': the smallest
+// candidate number of steps from which the premium computed by the FPGA stays
+// within 'tolerance' of the CPU reference (see TestCorrectness) at the
+// option's requested number of steps. Every option is priced at each
+// candidate number of steps, from kMinAdaptiveNSteps doubling up to its
+// requested number of steps, in a single kernel launch. The options are then
+// priced at their chosen number of steps, and the results are checked and
+// written to 'output_file'.
+bool CrrAdaptiveSolver(queue &q, const vector<InputData> &inp,
+                       ofstream &output_file, const double tolerance) {
+  const int n_options = inp.size();
+
+  std::cout << "\n============= Adaptive Time Steps =============\n";
+  std::cout << "Premium tolerance: " << std::scientific << std::setprecision(1)
+            << tolerance << "\n";
+
+  // the reference result for each option, at its requested number of steps
+  vector<OutputRes> reference(n_options);
+  for (int i = 0; i < n_options; ++i) {
+    CRRInParams vals = PrepareData(inp[i]);
+    reference[i] = ComputeReference(inp[i], vals);
+  }
+
+  // Build the candidates, ordered by number of steps rather than by option,
+  // so that the CRRs that the kernel processes together have trees of about
+  // the same depth
+  vector<InputData> cand_inp;
+  vector<int> cand_option;
+  for (int n_steps = kMinAdaptiveNSteps;; n_steps *= 2) {
+    bool more = false;
+    for (int i = 0; i < n_options; ++i) {
+      const int requested = inp[i].n_steps;
+      if (n_steps == kMinAdaptiveNSteps || n_steps / 2 < requested) {
+        cand_inp.push_back(inp[i]);
+        cand_inp.back().n_steps = std::min(n_steps, requested);
+        cand_option.push_back(i);
+        more = true;
+      }
+    }
+    if (!more) {
+      break;
+    }
+  }
+
+  vector<CRRInParams> cand_in_params;
+  vector<OutputRes> cand_result;
+  PriceOptions(q, cand_inp, cand_in_params, cand_result);
+
+  // Choose the smallest number of steps from which every larger candidate is
+  // also within the tolerance. The error of the CRR model oscillates as the
+  // number of steps grows, so a small number of steps can be within the
+  // tolerance by chance. The candidates of each option are in increasing
+  // order.
+  vector<InputData> chosen(inp);
+  vector<bool> found(n_options, false);
+  for (size_t c = 0; c < cand_inp.size(); ++c) {
+    const int i = cand_option[c];
+    if (abs(cand_result[c].value - reference[i].value) > tolerance) {
+      chosen[i].n_steps = inp[i].n_steps;
+      found[i] = false;
+    } else if (!found[i]) {
+      chosen[i].n_steps = cand_inp[c].n_steps;
+      found[i] = true;
+    }
+  }
+
+  for (int i = 0; i < n_options; ++i) {
+    std::cout << "   Option " << i << ": " << std::fixed
+              << std::setprecision(0) << chosen[i].n_steps
+              << " steps (requested " << inp[i].n_steps << ")"
+              << (found[i] ? "" : ", tolerance not met") << "\n";
+  }
+
+  // compare the time taken at the chosen and requested numbers of steps
+  vector<CRRInParams> in_params, chosen_in_params;
+  vector<OutputRes> result, chosen_result;
+  double time = PriceOptions(q, inp, in_params, result);
+  double chosen_time = PriceOptions(q, chosen, chosen_in_params, chosen_result);
+
+  // check the FPGA results at the chosen numbers of steps
+  bool pass = true;
+  for (int i = 0; i < n_options; ++i) {
+    TestCorrectness(i, n_options, pass, chosen[i], chosen_in_params[i],
+                    chosen_result[i]);
+  }
+
+  WriteOutputToFile(output_file, chosen_result);
+
+  std::cout << "\n============= Throughput Test =============\n";
+  std::cout << "   Requested steps:  " << std::fixed << std::setprecision(1)
+            << (n_options / time) << " assets/s\n";
+  std::cout << "   Chosen steps:     " << std::fixed << std::setprecision(1)
+            << (n_options / chosen_time) << " assets/s\n";
+
+  return pass;
+}
+
 int main(int argc, char *argv[]) {
   string infilename = "";
   string outfilename = "";
@@ -719,13 +1159,58 @@ int main(int argc, char *argv[]) {
   const string default_ifile = "src/data/ordered_inputs.csv";
   const string default_ofile = "src/data/ordered_outputs.csv";
 
+  // streaming mode: price the options in batches through a double-buffered
+  // pipeline, rather than all at once
+  bool stream = false;
+  int batch_size = kDefaultStreamBatch;
+
+  // the number of time steps of every option, overriding the input file
+  // (0 to use the input file)
+  int n_steps = 0;
+
+  // adaptive mode: pick the number of time steps of each option
+  bool adaptive = false;
+  double tolerance = kDefaultAdaptiveTolerance;
+
   char str_buffer[kMaxStringLen] = {0};
+  char batch_buffer[kMaxStringLen] = {0};
+  char arg_buffer[kMaxStringLen] = {0};
   for (int i = 1; i < argc; i++) {
     if (argv[i][0] == '-') {
       string sarg(argv[i]);
 
       FindGetArgString(sarg, "-o=", str_buffer, kMaxStringLen);
       FindGetArgString(sarg, "--output-file=", str_buffer, kMaxStringLen);
+
+      if (sarg == "--stream") {
+        stream = true;
+      } else if (FindGetArgString(sarg, "--stream=", batch_buffer,
+                                  kMaxStringLen)) {
+        stream = true;
+        batch_size = atoi(batch_buffer);
+        if (batch_size <= 0) {
+          std::cerr << "ERROR: the streaming batch size must be positive\n";
+          return 1;
+        }
+      } else if (FindGetArgString(sarg, "--steps=", arg_buffer,
+                                  kMaxStringLen)) {
+        n_steps = atoi(arg_buffer);
+        if (n_steps < (int)kMinNSteps || n_steps > (int)kMaxNSteps) {
+          std::cerr << "ERROR: the number of time steps must be between "
+                    << kMinNSteps << " and " << kMaxNSteps << "\n";
+          return 1;
+        }
+      } else if (sarg == "--adaptive") {
+        adaptive = true;
+      } else if (FindGetArgString(sarg, "--adaptive=", arg_buffer,
+                                  kMaxStringLen)) {
+        adaptive = true;
+        tolerance = atof(arg_buffer);
+        if (tolerance <= 0) {
+          std::cerr << "ERROR: the adaptive tolerance must be positive\n";
+          return 1;
+        }
+      }
     } else {
       infilename = string(argv[i]);
     }
@@ -784,8 +1269,24 @@ int main(int argc, char *argv[]) {
       return 1;
     }
 
+    if (stream) {
+// Emulator mode only streams two batches to ensure fast runtime
+#if defined(FPGA_EMULATOR)
+      const size_t max_options = 2 * batch_size;
+#else
+      const size_t max_options = std::numeric_limits<size_t>::max();
+#endif
+      ofstream outputFile(outfilename);
+      bool pass = CrrStreamSolver(q, inputFile, outputFile, batch_size,
+                                  max_options, n_steps);
+      return pass ? 0 : 1;
+    }
+
     // Read inputs data from input file
     ReadInputFromFile(inputFile, inp);
+    for (auto &option : inp) {
+      SetNSteps(option, n_steps);
+    }
 
 // Get the number of data from the input file
 // Emulator mode only goes through one input (or through OUTER_UNROLL inputs) to
@@ -808,6 +1309,13 @@ int main(int argc, char *argv[]) {
 
     const int n_crrs = temp_crrs;
 
+    if (adaptive) {
+      ofstream outputFile(outfilename);
+      vector<InputData> options(inp.begin(), inp.begin() + n_crrs);
+      bool pass = CrrAdaptiveSolver(q, options, outputFile, tolerance);
+      return pass ? 0 : 1;
+    }
+
     vector<CRRInParams> in_params(n_crrs);
     vector<CRRArrayEles> array_params(n_crrs);
 
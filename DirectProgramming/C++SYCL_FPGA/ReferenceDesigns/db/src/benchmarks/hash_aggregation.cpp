@@ -0,0 +1,164 @@
+//==============================================================
+// Copyright Intel Corporation
+//
+// SPDX-License-Identifier: MIT
+// =============================================================
+
+//
+// Host benchmark for the HashAggregate operator (db_utils/HashAggregation.hpp)
+//
+// The operator is run on the CPU, exactly as written for the device, by
+// binding its pipes to host queues. For a range of group cardinalities it
+// reports the aggregation throughput (including the host pass over the
+// spilled rows), the fraction of rows that spilled out of the on-chip table,
+// and checks the result against std::unordered_map.
+//
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../dbdata.hpp"
+#include "../db_utils/HashAggregation.hpp"
+
+using namespace std::chrono;
+
+// operator configuration
+constexpr int kWinSize = 8;
+constexpr int kTableSize = 4096;
+constexpr int kMaxProbes = 4;
+
+//
+// A minimal row: a group key and a value to accumulate
+//
+class GroupRow {
+ public:
+  GroupRow() : valid(false), key(0), value(0) {}
+  GroupRow(bool v_valid, DBIdentifier v_key, DBDecimal v_value)
+      : valid(v_valid), key(v_key), value(v_value) {}
+
+  DBIdentifier PrimaryKey() const { return key; }
+  DBDecimal Value() const { return value; }
+
+  bool valid;
+  DBIdentifier key;
+  DBDecimal value;
+};
+
+using InWindow = StreamingData<GroupRow, kWinSize>;
+using OutWindow = StreamingData<AggregateRow<DBIdentifier, DBDecimal>, 1>;
+
+//
+// A host stand-in for a SYCL pipe with the same (static) read/write interface
+//
+template <typename Id, typename T>
+struct HostPipe {
+  static T read(bool& success) {
+    success = !q.empty();
+    if (!success) {
+      return T();
+    }
+    T ret = q.front();
+    q.pop_front();
+    return ret;
+  }
+  static T read() {
+    bool success;
+    return read(success);
+  }
+  static void write(const T& t) { q.push_back(t); }
+
+  static std::deque<T> q;
+};
+template <typename Id, typename T>
+std::deque<T> HostPipe<Id, T>::q;
+
+using InPipe = HostPipe<class InPipeId, InWindow>;
+using OutPipe = HostPipe<class OutPipeId, OutWindow>;
+using SpillPipe = HostPipe<class SpillPipeId, InWindow>;
+
+int main(int argc, char* argv[]) {
+  size_t rows = 1 << 22;
+  if (argc > 1) {
+    rows = std::max(1, atoi(argv[1]));
+  }
+
+  const std::vector<size_t> cardinalities = {16,    256,    1024,  4096,
+                                             16384, 65536, 1 << 20};
+
+  std::cout << "HashAggregate: " << rows << " rows, table size " << kTableSize
+            << ", max probes " << kMaxProbes << ", window size " << kWinSize
+            << "\n";
+  std::cout << std::setw(12) << "groups" << std::setw(16) << "Mrows/s"
+            << std::setw(14) << "spilled %" << std::setw(10) << "result"
+            << "\n";
+
+  bool passed = true;
+  std::mt19937 gen(0);
+
+  for (size_t groups : cardinalities) {
+    // generate the input windows and the reference result
+    std::uniform_int_distribution<DBIdentifier> key_dist(1, groups);
+    std::uniform_int_distribution<DBDecimal> val_dist(1, 1000);
+    std::unordered_map<DBIdentifier, DBDecimal> expected;
+
+    InPipe::q.clear();
+    for (size_t r = 0; r < rows; r += kWinSize) {
+      InWindow w(false, true);
+      UnrolledLoop<0, kWinSize>([&](auto j) {
+        bool valid = (r + j) < rows;
+        DBIdentifier key = key_dist(gen);
+        DBDecimal val = val_dist(gen);
+        w.data.template get<j>() = GroupRow(valid, key, val);
+        if (valid) expected[key] += val;
+      });
+      InPipe::write(w);
+    }
+    InPipe::write(InWindow(true, false));
+
+    // run the operator and the host spill pass
+    high_resolution_clock::time_point start = high_resolution_clock::now();
+
+    HashAggregate<InPipe, GroupRow, kWinSize, DBIdentifier, DBDecimal,
+                  kTableSize, kMaxProbes, OutPipe, SpillPipe>();
+
+    std::unordered_map<DBIdentifier, DBDecimal> result;
+    size_t spilled = 0;
+    for (auto& w : SpillPipe::q) {
+      if (w.done) break;
+      GroupRow spill_rows[kWinSize];
+      UnrolledLoop<0, kWinSize>([&](auto j) {
+        spill_rows[j] = w.data.template get<j>();
+        spilled += spill_rows[j].valid ? 1 : 0;
+      });
+      HashAggregateSpilled(spill_rows, kWinSize, result);
+    }
+    for (auto& w : OutPipe::q) {
+      if (w.done) break;
+      auto& row = w.data.template get<0>();
+      result[row.key] += row.value;
+    }
+
+    high_resolution_clock::time_point end = high_resolution_clock::now();
+    duration<double> diff = end - start;
+
+    SpillPipe::q.clear();
+    OutPipe::q.clear();
+
+    bool ok = (result == expected);
+    passed &= ok;
+
+    std::cout << std::setw(12) << groups << std::setw(16) << std::fixed
+              << std::setprecision(2) << (rows / diff.count()) * 1e-6
+              << std::setw(14) << (100.0 * spilled / rows) << std::setw(10)
+              << (ok ? "ok" : "MISMATCH") << "\n";
+  }
+
+  std::cout << (passed ? "PASSED" : "FAILED") << "\n";
+  return passed ? 0 : 1;
+}
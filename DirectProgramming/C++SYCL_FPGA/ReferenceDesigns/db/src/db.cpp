@@ -18,6 +18,7 @@
 #include <sycl/ext/intel/fpga_extensions.hpp>
 #include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <fstream>
 #include <functional>
 #include <iostream>
@@ -39,21 +40,27 @@ using namespace sycl;
 // include files depending on the query selected
 #if (QUERY == 1)
 #include "query1/query1_kernel.hpp"
-bool DoQuery1(queue& q, Database& dbinfo, std::string& db_root_dir,
-              std::string& args, bool test, bool print, double& kernel_latency,
-              double& total_latency);
+using QueryBuffers = Query1Buffers;
+bool DoQuery1(queue& q, Database& dbinfo, QueryBuffers& bufs,
+              std::string& db_root_dir, std::string& args, bool test,
+              bool print, double& kernel_latency, double& total_latency);
 #elif (QUERY == 11)
 #include "query11/query11_kernel.hpp"
-bool DoQuery11(queue& q, Database& dbinfo, std::string& db_root_dir,
-               std::string& args, bool test, bool print, double& kernel_latency,
-               double& total_latency);
+using QueryBuffers = Query11Buffers;
+bool DoQuery11(queue& q, Database& dbinfo, QueryBuffers& bufs,
+               std::string& db_root_dir, std::string& args, bool test,
+               bool print, double& kernel_latency, double& total_latency);
 #elif (QUERY == 12)
 #include "query12/query12_kernel.hpp"
-bool DoQuery12(queue& q, Database& dbinfo, std::string& db_root_dir,
-               std::string& args, bool test, bool print, double& kernel_latency,
-               double& total_latency);
+using QueryBuffers = Query12Buffers;
+bool DoQuery12(queue& q, Database& dbinfo, QueryBuffers& bufs,
+               std::string& db_root_dir, std::string& args, bool test,
+               bool print, double& kernel_latency, double& total_latency);
 #endif
 
+bool RunBatch(queue& q, Database& dbinfo, std::string& db_root_dir,
+              std::string& batch_file, bool test, bool print);
+
 //
 // print help for the program
 //
@@ -70,6 +77,12 @@ void Help() {
                "and uses default input from TPCH documents\n";
   std::cout << "\t--print   print the query results to stdout\n";
   std::cout << "\t--runs    how many iterations of the query to run\n";
+  std::cout << "\t--batch=<file>  run one query per line of <file> (use '-' "
+               "for stdin), where each line holds the '--args' for that query."
+               " The database is loaded once and the table columns stay "
+               "resident on the device between queries\n";
+  std::cout << "\t--cache   load the LINEITEM and ORDERS tables from a binary "
+               "columnar cache next to the '.tbl' files, creating it if needed\n";
   std::cout << "\t--help    print this help message\n";
   std::cout << "\n";
 
@@ -100,6 +113,11 @@ void Help() {
   std::cout << "\t ./db --dbroot=/path/to/database/files "
             << "--args=MAIL,SHIP,1994-01-10\n";
   std::cout << "\n";
+
+  std::cout << "./db --dbroot=/path/to/database/files --batch=<file|->\n";
+  std::cout << "\t printf '60\\n90\\n120\\n' | "
+            << "./db --dbroot=/path/to/database/files --batch=-\n";
+  std::cout << "\n";
 }
 
 //
@@ -117,6 +135,7 @@ int main(int argc, char* argv[]) {
   Database dbinfo;
   std::string db_root_dir = ".";
   std::string args = "";
+  std::string batch_file = "";
   unsigned int query = QUERY;
   bool test_query = false;
 #ifndef FPGA_EMULATOR
@@ -125,6 +144,7 @@ int main(int argc, char* argv[]) {
   unsigned int runs = 1;
 #endif
   bool print_result = false;
+  bool use_cache = false;
   bool need_help = false;
 
   // parse the command line arguments
@@ -142,10 +162,14 @@ int main(int argc, char* argv[]) {
         query = atoi(str_after_equals.c_str());
       } else if (StrStartsWith(arg, "--args=")) {
         args = str_after_equals;
+      } else if (StrStartsWith(arg, "--batch=")) {
+        batch_file = str_after_equals;
       } else if (StrStartsWith(arg, "--test")) {
         test_query = true;
       } else if (StrStartsWith(arg, "--print")) {
         print_result = true;
+      } else if (StrStartsWith(arg, "--cache")) {
+        use_cache = true;
       } else if (StrStartsWith(arg, "--runs")) {
 #ifndef FPGA_EMULATOR
         // for hardware, ensure at least two iterations to ensure we can run
@@ -197,11 +221,16 @@ int main(int argc, char* argv[]) {
     queue q(selector, fpga_tools::exception_handler, props);
 
     // parse the database files located in the 'db_root_dir' directory
-    bool success = dbinfo.Parse(db_root_dir);
+    auto parse_start = std::chrono::high_resolution_clock::now();
+    bool success = dbinfo.Parse(db_root_dir, use_cache);
     if (!success) {
       std::cerr << "ERROR: couldn't read the DB files\n";
       return 1;
     }
+    auto parse_end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double, std::milli> parse_time =
+        parse_end - parse_start;
+    std::cout << "Database load time: " << parse_time.count() << " ms\n";
 
     std::cout << "Database SF = " << kSF << "\n";
 
@@ -212,30 +241,42 @@ int main(int argc, char* argv[]) {
       return 1;
     }
 
+    // batch mode: run a stream of queries against the loaded database
+    if (!batch_file.empty()) {
+      success = RunBatch(q, dbinfo, db_root_dir, batch_file, test_query,
+                         print_result);
+      std::cout << (success ? "PASSED\n" : "FAILED\n");
+      return success ? 0 : 1;
+    }
+
     // track timing information for each run
     std::vector<double> total_latency(runs);
     std::vector<double> kernel_latency(runs);
 
     // run 'runs' iterations of the query
     for (unsigned int run = 0; run < runs && success; run++) {
+      // fresh input buffers for every run, so each run includes the
+      // transfer of the tables to the device
+      QueryBuffers bufs(dbinfo);
+
       // run the selected query
       if (query == 1) {
 #if (QUERY == 1)
-        success = DoQuery1(q, dbinfo, db_root_dir, args,
+        success = DoQuery1(q, dbinfo, bufs, db_root_dir, args,
                            test_query, print_result,
                            kernel_latency[run], total_latency[run]);
 #endif
       } else if (query == 11) {
         // query11
 #if (QUERY == 11)
-        success = DoQuery11(q, dbinfo, db_root_dir, args,
+        success = DoQuery11(q, dbinfo, bufs, db_root_dir, args,
                             test_query, print_result,
                             kernel_latency[run], total_latency[run]);
 #endif
       } else if (query == 12) {
         // query12
 #if (QUERY == 12)
-        success = DoQuery12(q, dbinfo, db_root_dir, args,
+        success = DoQuery12(q, dbinfo, bufs, db_root_dir, args,
                             test_query, print_result,
                             kernel_latency[run], total_latency[run]);
 #endif
@@ -288,9 +329,9 @@ int main(int argc, char* argv[]) {
 }
 
 #if (QUERY == 1)
-bool DoQuery1(queue& q, Database& dbinfo, std::string& db_root_dir,
-              std::string& args, bool test, bool print, double& kernel_latency,
-              double& total_latency) {
+bool DoQuery1(queue& q, Database& dbinfo, QueryBuffers& bufs,
+              std::string& db_root_dir, std::string& args, bool test,
+              bool print, double& kernel_latency, double& total_latency) {
   // NOTE: this is fixed based on the TPCH docs
   Date date = Date("1998-12-01");
   unsigned int DELTA = 90;
@@ -328,7 +369,7 @@ bool DoQuery1(queue& q, Database& dbinfo, std::string& db_root_dir,
 
   // perform the query
   bool success =
-      SubmitQuery1(q, dbinfo, low_date_compact, sum_qty, sum_base_price,
+      SubmitQuery1(q, bufs, low_date_compact, sum_qty, sum_base_price,
                    sum_disc_price, sum_charge, avg_qty, avg_price, avg_discount,
                    count, kernel_latency, total_latency);
 
@@ -352,9 +393,9 @@ bool DoQuery1(queue& q, Database& dbinfo, std::string& db_root_dir,
 #endif
 
 #if (QUERY == 11)
-bool DoQuery11(queue& q, Database& dbinfo, std::string& db_root_dir,
-               std::string& args, bool test, bool print, double& kernel_latency,
-               double& total_latency) {
+bool DoQuery11(queue& q, Database& dbinfo, QueryBuffers& bufs,
+               std::string& db_root_dir, std::string& args, bool test,
+               bool print, double& kernel_latency, double& total_latency) {
   // the default nation, based on the TPCH documents
   std::string nation = "GERMANY";
 
@@ -371,6 +412,12 @@ bool DoQuery11(queue& q, Database& dbinfo, std::string& db_root_dir,
   // convert the nation name to uppercase characters (convention)
   transform(nation.begin(), nation.end(), nation.begin(), ::toupper);
 
+  // check the query arguments
+  if (dbinfo.n.name_key_map.find(nation) == dbinfo.n.name_key_map.end()) {
+    std::cerr << "ERROR: unknown nation '" << nation << "'\n";
+    return false;
+  }
+
   std::cout << "Running Q11 for nation " << nation.c_str()
             << " (key=" << (int)(dbinfo.n.name_key_map[nation]) << ")"
             << std::endl;
@@ -380,8 +427,10 @@ bool DoQuery11(queue& q, Database& dbinfo, std::string& db_root_dir,
   std::vector<DBDecimal> partkey_values(kPartTableSize);
 
   // perform the query
-  bool success = SubmitQuery11(q, dbinfo, nation, partkeys, partkey_values,
-                               kernel_latency, total_latency);
+  FilterCounters filter_stats;
+  bool success =
+      SubmitQuery11(q, dbinfo, bufs, nation, partkeys, partkey_values,
+                    filter_stats, kernel_latency, total_latency);
 
   if (success) {
     // validate the results of the query, if requested
@@ -389,8 +438,15 @@ bool DoQuery11(queue& q, Database& dbinfo, std::string& db_root_dir,
       success = dbinfo.ValidateQ11(db_root_dir, partkeys, partkey_values);
     }
 
-    // print the results of the query, if requested
+    // print the results of the query, and how many rows the pre-join filter
+    // kept from reaching the join, if requested
     if (print) {
+      const FilterCounters& c = filter_stats;
+      std::cout << "Pre-join filter: " << c.rows_out << " of " << c.rows_in
+                << " PARTSUPPLIER rows (" << c.windows_out << " of "
+                << c.windows_in << " windows) reached the join ("
+                << (c.rows_in == 0 ? 0.0 : 100.0 * c.rows_out / c.rows_in)
+                << "%)\n";
       dbinfo.PrintQ11(partkeys, partkey_values);
     }
   }
@@ -400,9 +456,9 @@ bool DoQuery11(queue& q, Database& dbinfo, std::string& db_root_dir,
 #endif
 
 #if (QUERY == 12)
-bool DoQuery12(queue& q, Database& dbinfo, std::string& db_root_dir,
-               std::string& args, bool test, bool print, double& kernel_latency,
-               double& total_latency) {
+bool DoQuery12(queue& q, Database& dbinfo, QueryBuffers& bufs,
+               std::string& db_root_dir, std::string& args, bool test,
+               bool print, double& kernel_latency, double& total_latency) {
   // the default query date and shipmodes, based on the TPCH documents
   Date date = Date("1994-01-01");
   std::string shipmode1 = "MAIL", shipmode2 = "SHIP";
@@ -448,7 +504,7 @@ bool DoQuery12(queue& q, Database& dbinfo, std::string& db_root_dir,
 
   // perform the query
   bool success = SubmitQuery12(
-      q, dbinfo, low_date.ToCompact(), high_date.ToCompact(),
+      q, bufs, low_date.ToCompact(), high_date.ToCompact(),
       ShipmodeStrToInt(shipmode1), ShipmodeStrToInt(shipmode2), high_line_count,
       low_line_count, kernel_latency, total_latency);
 
@@ -468,3 +524,111 @@ bool DoQuery12(queue& q, Database& dbinfo, std::string& db_root_dir,
   return success;
 }
 #endif
+
+//
+// get the p-th percentile (p in [0,100]) of a set of latencies
+//
+double Percentile(std::vector<double> v, double p) {
+  if (v.empty()) {
+    return 0.0;
+  }
+  std::sort(v.begin(), v.end());
+  size_t idx = (size_t)std::ceil(p / 100.0 * v.size());
+  return v[std::min(v.size() - 1, idx == 0 ? 0 : idx - 1)];
+}
+
+//
+// print a summary of a set of latencies
+//
+void PrintLatencySummary(const std::string& name,
+                         const std::vector<double>& latency) {
+  double avg = std::accumulate(latency.begin(), latency.end(), 0.0) /
+               (double)latency.size();
+  std::cout << name << ": avg=" << avg
+            << " ms, p50=" << Percentile(latency, 50)
+            << " ms, p90=" << Percentile(latency, 90)
+            << " ms, p99=" << Percentile(latency, 99)
+            << " ms, max=" << Percentile(latency, 100) << " ms\n";
+}
+
+//
+// Batch mode: read one set of query arguments per line from 'batch_file'
+// ('-' for stdin) and run the query for each of them. The database was
+// loaded once by the caller and the device buffers are created once here,
+// so each query only pays for the kernels and the (small) output transfer.
+// Empty lines and lines starting with '#' are ignored.
+//
+bool RunBatch(queue& q, Database& dbinfo, std::string& db_root_dir,
+              std::string& batch_file, bool test, bool print) {
+  std::ifstream ifs;
+  if (batch_file != "-") {
+    ifs.open(batch_file);
+    if (!ifs.is_open()) {
+      std::cerr << "ERROR: could not open batch file '" << batch_file
+                << "'\n";
+      return false;
+    }
+  }
+  std::istream& in = (batch_file == "-") ? std::cin : ifs;
+
+  // the table columns stay resident on the device for the whole batch
+  QueryBuffers bufs(dbinfo);
+
+  std::vector<double> kernel_latency, total_latency;
+  bool success = true;
+  std::string line;
+  size_t n = 0;
+
+  while (std::getline(in, line)) {
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+
+    double kernel_ms = 0.0, total_ms = 0.0;
+#if (QUERY == 1)
+    bool ok = DoQuery1(q, dbinfo, bufs, db_root_dir, line, test, print,
+                       kernel_ms, total_ms);
+#elif (QUERY == 11)
+    bool ok = DoQuery11(q, dbinfo, bufs, db_root_dir, line, test, print,
+                        kernel_ms, total_ms);
+#elif (QUERY == 12)
+    bool ok = DoQuery12(q, dbinfo, bufs, db_root_dir, line, test, print,
+                        kernel_ms, total_ms);
+#endif
+
+    std::cout << "Batch query " << n << " (" << line << "): "
+              << (ok ? "" : "FAILED, ") << "kernel time " << kernel_ms
+              << " ms, processing time " << total_ms << " ms\n";
+
+    if (ok) {
+      kernel_latency.push_back(kernel_ms);
+      total_latency.push_back(total_ms);
+    }
+    success &= ok;
+    n++;
+  }
+
+  if (kernel_latency.empty()) {
+    std::cerr << "ERROR: no queries were run from the batch\n";
+    return false;
+  }
+
+  // the first query also transfers the tables to the device, report it on
+  // its own and keep it out of the percentiles when there is more than one
+  std::cout << "Batch queries run: " << n << "\n";
+  std::cout << "First query processing time (includes table transfer): "
+            << total_latency[0] << " ms\n";
+  if (kernel_latency.size() > 1) {
+    kernel_latency.erase(kernel_latency.begin());
+    total_latency.erase(total_latency.begin());
+  }
+  PrintLatencySummary("Kernel time", kernel_latency);
+  PrintLatencySummary("Processing time", total_latency);
+
+  double kernel_sum =
+      std::accumulate(kernel_latency.begin(), kernel_latency.end(), 0.0);
+  std::cout << "Throughput: " << (kernel_latency.size() / kernel_sum) * 1e3
+            << " queries/s\n";
+
+  return success;
+}
@@ -0,0 +1,219 @@
+#ifndef __HASHAGGREGATION_HPP__
+#define __HASHAGGREGATION_HPP__
+#pragma once
+
+#include <type_traits>
+#include <unordered_map>
+
+#include "Misc.hpp"
+#include "StreamingData.hpp"
+#include "Tuple.hpp"
+#include "Unroller.hpp"
+
+///////////////////////////////////////////////////////
+//
+// Hash-based accumulator
+// Accumulates values of type ValueType per group (key of type KeyType) in an
+// open addressing (linear probing) hash table with 'size' slots.
+//
+// Unlike the RegisterAccumulator, the keys do not have to be small and dense.
+// Each key inspects at most 'max_probes' slots, which bounds the work done per
+// element. A key that finds neither its group nor a free slot within
+// 'max_probes' slots overflows: Accumulate returns false and the caller must
+// handle that value elsewhere (see HashAggregate below).
+//
+template <typename KeyType, typename ValueType, int size, int max_probes = 4>
+class HashAccumulator {
+  // static asserts
+  static_assert(std::is_integral<KeyType>::value,
+                "KeyType must be an integral type");
+  static_assert(std::is_arithmetic<ValueType>::value,
+                "ValueType must be arithmetic to support accumulation");
+  static_assert(size > 0 && (size & (size - 1)) == 0,
+                "size must be a power of 2");
+  static_assert(max_probes > 0 && max_probes <= size,
+                "max_probes must be in the range [1, size]");
+
+ public:
+  static constexpr int kSize = size;
+
+  // mark every slot as free
+  void Init() {
+    for (int i = 0; i < size; i++) {
+      valid[i] = false;
+    }
+  }
+
+  // accumulate 'value' into the group of 'key'
+  // returns false if the group could not be placed in the table
+  bool Accumulate(KeyType key, ValueType value) {
+    const unsigned int base = Hash(key);
+    bool placed = false;
+
+    UnrolledLoop<0, max_probes>([&](auto p) {
+      const unsigned int slot = (base + p) & (size - 1);
+      if (!placed) {
+        if (!valid[slot]) {
+          // free slot, start a new group
+          valid[slot] = true;
+          keys[slot] = key;
+          values[slot] = value;
+          placed = true;
+        } else if (keys[slot] == key) {
+          // existing group
+          values[slot] += value;
+          placed = true;
+        }
+      }
+    });
+
+    return placed;
+  }
+
+  // is slot 'index' holding a group
+  bool Valid(unsigned int index) const { return valid[index]; }
+
+  // the key of the group in slot 'index'
+  KeyType Key(unsigned int index) const { return keys[index]; }
+
+  // the accumulated value of the group in slot 'index'
+  ValueType Get(unsigned int index) const { return values[index]; }
+
+  // multiplicative (Fibonacci) hash of the key onto the table
+  static unsigned int Hash(KeyType key) {
+    constexpr unsigned int kBits = Log2((unsigned int)size);
+    const unsigned int h = (unsigned int)key * 2654435761u;
+    return (kBits == 0) ? 0 : (h >> (32 - kBits));
+  }
+
+ private:
+  bool valid[size];
+  KeyType keys[size];
+  ValueType values[size];
+};
+///////////////////////////////////////////////////////
+
+//
+// A single group produced by HashAggregate
+//
+template <typename KeyType, typename ValueType>
+class AggregateRow {
+ public:
+  AggregateRow() : valid(false), key(0), value(0) {}
+  AggregateRow(bool v_valid, KeyType v_key, ValueType v_value)
+      : valid(v_valid), key(v_key), value(v_value) {}
+
+  KeyType PrimaryKey() const { return key; }
+
+  bool valid;
+  KeyType key;
+  ValueType value;
+};
+
+//
+// HashAggregate implementation
+//
+// Streams windows of 'in_win_size' rows from InPipe and accumulates
+// InData::Value() per InData::PrimaryKey() in a HashAccumulator of
+// 'table_size' slots. When the input is done, every group in the table is
+// written to OutPipe (as StreamingData<AggregateRow<KeyType, ValueType>, 1>).
+//
+// Rows whose group overflows the on-chip table are not dropped: they are
+// forwarded to SpillPipe (as StreamingData<InData, in_win_size>, with only the
+// spilled rows marked valid) so they can be aggregated in a second pass, for
+// example on the host with HashAggregateSpilled below. A group can therefore
+// appear both in OutPipe and in the spilled rows; the final result of a group
+// is the sum of both.
+//
+// Both OutPipe and SpillPipe are terminated with a 'done' StreamingData.
+//
+template <typename InPipe, typename InData, int in_win_size, typename KeyType,
+          typename ValueType, int table_size, int max_probes, typename OutPipe,
+          typename SpillPipe>
+void HashAggregate() {
+  //////////////////////////////////////////////////////////////////////////////
+  // static asserts
+  static_assert(in_win_size > 0,
+    "Input window size must be positive and non-zero");
+  static_assert(
+      std::is_same<KeyType, decltype(InData().PrimaryKey())>::value,
+      "InData must have 'PrimaryKey()' function that returns a 'KeyType'");
+  static_assert(
+      std::is_same<ValueType, decltype(InData().Value())>::value,
+      "InData must have 'Value()' function that returns a 'ValueType'");
+  static_assert(std::is_same<bool, decltype(InData().valid)>::value,
+    "InData must have a 'valid' boolean member");
+  //////////////////////////////////////////////////////////////////////////////
+
+  using OutRow = AggregateRow<KeyType, ValueType>;
+
+  HashAccumulator<KeyType, ValueType, table_size, max_probes> table;
+  table.Init();
+
+  bool done = false;
+
+  while (!done) {
+    // read from the input pipe
+    bool valid_pipe_read;
+    StreamingData<InData, in_win_size> in_data = InPipe::read(valid_pipe_read);
+
+    // check if the producer is done
+    done = in_data.done && valid_pipe_read;
+
+    if (!done && valid_pipe_read) {
+      // the rows of this window that did not fit in the table
+      StreamingData<InData, in_win_size> spill_data(false, false);
+
+      UnrolledLoop<0, in_win_size>([&](auto j) {
+        InData row = in_data.data.template get<j>();
+        bool spilled = false;
+
+        if (row.valid) {
+          spilled = !table.Accumulate(row.PrimaryKey(), row.Value());
+        }
+
+        row.valid = spilled;
+        spill_data.data.template get<j>() = row;
+        spill_data.valid |= spilled;
+      });
+
+      // only send windows that actually have spilled rows
+      if (spill_data.valid) {
+        SpillPipe::write(spill_data);
+      }
+    }
+  }
+
+  // tell the spill consumer we are done
+  SpillPipe::write(StreamingData<InData, in_win_size>(true, false));
+
+  // write out the groups held in the table
+  for (int i = 0; i < table_size; i++) {
+    if (table.Valid(i)) {
+      StreamingData<OutRow, 1> out_data(false, true);
+      out_data.data.template get<0>() =
+          OutRow(true, table.Key(i), table.Get(i));
+      OutPipe::write(out_data);
+    }
+  }
+
+  // tell downstream we are done
+  OutPipe::write(StreamingData<OutRow, 1>(true, false));
+}
+
+//
+// Host-side pass over the rows spilled by HashAggregate: accumulates the value
+// of each valid row into 'groups'. The groups produced by the device are
+// merged into the same map to get the final result.
+//
+template <typename InData, typename KeyType, typename ValueType>
+void HashAggregateSpilled(const InData* rows, size_t count,
+                          std::unordered_map<KeyType, ValueType>& groups) {
+  for (size_t i = 0; i < count; i++) {
+    if (rows[i].valid) {
+      groups[rows[i].PrimaryKey()] += rows[i].Value();
+    }
+  }
+}
+
+#endif /* __HASHAGGREGATION_HPP__ */
@@ -0,0 +1,132 @@
+#ifndef __PREJOINFILTER_HPP__
+#define __PREJOINFILTER_HPP__
+#pragma once
+
+#include <type_traits>
+#include <utility>
+
+#include "StreamingData.hpp"
+#include "Tuple.hpp"
+#include "Unroller.hpp"
+
+///////////////////////////////////////////////////////
+//
+// Exact bit-vector filter for keys in the dense range [0, max_key]
+// Keys are inserted with Insert() and looked up with MayContain(). There are
+// no false positives, but the key range must be known and small enough to fit
+// on chip (for example, SUPPKEY is in the range [1, kSF*10000]).
+//
+template <int max_key>
+class BitVectorFilter {
+  // static asserts
+  static_assert(max_key >= 0, "max_key must be non-negative");
+
+ public:
+  // clear all bits
+  void Init() {
+    for (int i = 0; i < max_key + 1; i++) {
+      bits[i] = false;
+    }
+  }
+
+  // add 'key' to the set
+  void Insert(unsigned int key) {
+    if (key <= max_key) {
+      bits[key] = true;
+    }
+  }
+
+  // check if 'key' is in the set
+  bool MayContain(unsigned int key) const {
+    return (key <= max_key) && bits[key];
+  }
+
+ private:
+  bool bits[max_key + 1];
+};
+///////////////////////////////////////////////////////
+
+//
+// Counters describing how selective a FilterJoinInput stage was
+//
+struct FilterCounters {
+  unsigned int rows_in;
+  unsigned int rows_out;
+  unsigned int windows_in;
+  unsigned int windows_out;
+};
+
+//
+// Pre-join filter stage
+//
+// Streams windows of 'win_size' rows from InPipe to OutPipe and invalidates
+// every row whose PrimaryKey() is not in 'filter' (a BitVectorFilter, or any
+// type with a 'bool MayContain(unsigned int)' function). Windows that are
+// left without any valid row are dropped, so the downstream join sees fewer
+// windows. The keys of invalidated rows are not modified, so a stream that is
+// sorted by key stays sorted and the stage can be put in front of either
+// MapJoin or MergeJoin.
+//
+// The 'done' window of the input is forwarded to OutPipe.
+//
+template <typename InPipe, typename InData, int win_size, typename OutPipe,
+          typename FilterType>
+FilterCounters FilterJoinInput(const FilterType& filter) {
+  //////////////////////////////////////////////////////////////////////////////
+  // static asserts
+  static_assert(win_size > 0, "Window size must be positive and non-zero");
+  static_assert(
+      std::is_same<unsigned int, decltype(InData().PrimaryKey())>::value,
+      "InData must have 'PrimaryKey()' function that returns an 'unsigned "
+      "int'");
+  static_assert(std::is_same<bool, decltype(InData().valid)>::value,
+                "InData must have a 'valid' boolean member");
+  //////////////////////////////////////////////////////////////////////////////
+
+  FilterCounters counters{0, 0, 0, 0};
+  bool done = false;
+
+  [[intel::initiation_interval(1)]]
+  while (!done) {
+    // read from the input pipe
+    bool valid_pipe_read;
+    StreamingData<InData, win_size> in_data = InPipe::read(valid_pipe_read);
+
+    // check if the producer is done
+    done = in_data.done && valid_pipe_read;
+
+    if (valid_pipe_read && !done && in_data.valid) {
+      unsigned int rows_in = 0, rows_out = 0;
+      bool any_valid = false;
+
+      UnrolledLoop<0, win_size>([&](auto j) {
+        const bool row_valid = in_data.data.template get<j>().valid;
+        const bool keep =
+            row_valid &&
+            filter.MayContain(in_data.data.template get<j>().PrimaryKey());
+
+        in_data.data.template get<j>().valid = keep;
+        rows_in += row_valid ? 1 : 0;
+        rows_out += keep ? 1 : 0;
+        any_valid |= keep;
+      });
+
+      counters.rows_in += rows_in;
+      counters.rows_out += rows_out;
+      counters.windows_in++;
+
+      // drop windows that have no rows left
+      if (any_valid) {
+        counters.windows_out++;
+        OutPipe::write(in_data);
+      }
+    }
+  }
+
+  // tell downstream we are done
+  OutPipe::write(StreamingData<InData, win_size>(true, false));
+
+  return counters;
+}
+
+#endif /* __PREJOINFILTER_HPP__ */
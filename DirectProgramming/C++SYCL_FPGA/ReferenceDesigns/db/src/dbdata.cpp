@@ -127,15 +127,19 @@ void trim(std::string& s) {
 //
 // the main parsing function
 // parses '*.tbl' files location in directory 'db_root_dir'
+// the LINEITEM and ORDERS tables are parsed by the parallel loader in
+// dbloader.cpp, which also reads/writes their binary cache if 'use_cache' is set
 //
-bool Database::Parse(std::string db_root_dir) {
+bool Database::Parse(std::string db_root_dir, bool use_cache) {
   std::cout << "Parsing database files in: " << db_root_dir << std::endl;
 
   bool success = true;
 
   // parse each table
-  success &= ParseLineItemTable(db_root_dir + kSeparator + "lineitem.tbl", l);
-  success &= ParseOrdersTable(db_root_dir + kSeparator +"orders.tbl", o);
+  success &= ParseLineItemTable(db_root_dir + kSeparator + "lineitem.tbl", l,
+                                use_cache);
+  success &= ParseOrdersTable(db_root_dir + kSeparator + "orders.tbl", o,
+                              use_cache);
   success &= ParsePartsTable(db_root_dir + kSeparator + "part.tbl", p);
   success &= ParseSupplierTable(db_root_dir + kSeparator + "supplier.tbl", s);
   success &= ParsePartSupplierTable(db_root_dir + kSeparator + "partsupp.tbl", ps);
@@ -144,128 +148,6 @@ bool Database::Parse(std::string db_root_dir) {
   return success;
 }
 
-//
-// parse the LINEITEM table
-//
-bool Database::ParseLineItemTable(std::string f, LineItemTable& tbl) {
-  std::cout << "Parsing LINEITEM table from: " << f << "\n";
-
-  // populate data row by row (as presented in the file)
-  std::ifstream ifs(f);
-  std::string line;
-  tbl.rows = 0;
-
-  if (!ifs.is_open()) {
-    std::cout << "Failed to parse LINEITEM table\n";
-    return false;
-  }
-
-  while (std::getline(ifs, line)) {
-    // split row into column strings by separator ('|')
-    std::vector<std::string> column_data = SplitRowStr(line);
-    assert(column_data.size() == 16);
-
-    tbl.orderkey.push_back(std::stoll(column_data[0]));
-    tbl.partkey.push_back(std::stoll(column_data[1]));
-    tbl.suppkey.push_back(std::stoll(column_data[2]));
-    tbl.linenumber.push_back(std::stoll(column_data[3]));
-    tbl.quantity.push_back(std::stoll(column_data[4]));
-
-    tbl.extendedprice.push_back(MoneyFloatToCents(column_data[5]));
-    tbl.discount.push_back(MoneyFloatToCents(column_data[6]));
-    tbl.tax.push_back(MoneyFloatToCents(column_data[7]));
-
-    tbl.returnflag.push_back(column_data[8].at(0));
-    tbl.linestatus.push_back(column_data[9].at(0));
-
-    tbl.shipdate.push_back(Date(column_data[10]).ToCompact());
-    tbl.commitdate.push_back(Date(column_data[11]).ToCompact());
-    tbl.receiptdate.push_back(Date(column_data[12]).ToCompact());
-
-    AppendStringToCharVec(tbl.shipinstruct, column_data[13], 25);
-    tbl.shipmode.push_back(ShipmodeStrToInt(column_data[14]));
-    AppendStringToCharVec(tbl.comment, column_data[15], 44);
-
-    tbl.rows++;
-  }
-
-  for (size_t i = 0; i < kPaddingRows; i++) {
-    tbl.orderkey.push_back(0);
-    tbl.partkey.push_back(0);
-    tbl.suppkey.push_back(0);
-    tbl.linenumber.push_back(0);
-    tbl.quantity.push_back(0);
-
-    tbl.extendedprice.push_back(0);
-    tbl.discount.push_back(0);
-    tbl.tax.push_back(0);
-
-    tbl.returnflag.push_back(0);
-    tbl.linestatus.push_back(0);
-
-    tbl.shipdate.push_back(0);
-    tbl.commitdate.push_back(0);
-    tbl.receiptdate.push_back(0);
-
-    tbl.shipmode.push_back(0);
-  }
-
-  std::cout << "Finished parsing LINEITEM table with " << tbl.rows << " rows\n";
-
-  return true;
-}
-
-//
-// parse the ORDERS table
-//
-bool Database::ParseOrdersTable(std::string f, OrdersTable& tbl) {
-  std::cout << "Parsing ORDERS table from: " << f << "\n";
-
-  // populate data row by row (as presented in the file)
-  std::ifstream ifs(f);
-  std::string line;
-  tbl.rows = 0;
-
-  if (!ifs.is_open()) {
-    std::cout << "Failed to parse ORDERS table\n";
-    return false;
-  }
-
-  while (std::getline(ifs, line)) {
-    // split row into column strings by separator ('|')
-    std::vector<std::string> column_data = SplitRowStr(line);
-    assert(column_data.size() == 9);
-
-    // store date for this row
-    tbl.orderkey.push_back(std::stoll(column_data[0]));
-    tbl.custkey.push_back(std::stoll(column_data[1]));
-    tbl.orderstatus.push_back(column_data[2][0]);
-    tbl.totalprice.push_back(MoneyFloatToCents(column_data[3]));
-    tbl.orderdate.push_back(Date(column_data[4]).ToCompact());
-    tbl.orderpriority.push_back((int)(column_data[5][0] - '0'));
-    AppendStringToCharVec(tbl.clerk, column_data[6], 15);
-    tbl.shippriority.push_back(std::stoi(column_data[7]));
-    AppendStringToCharVec(tbl.comment, column_data[8], 80);
-
-    tbl.rows++;
-  }
-
-  for (size_t i = 0; i < kPaddingRows; i++) {
-    tbl.orderkey.push_back(0);
-    tbl.custkey.push_back(0);
-    tbl.orderstatus.push_back(0);
-    tbl.totalprice.push_back(0);
-    tbl.orderdate.push_back(0);
-    tbl.orderpriority.push_back(0);
-    tbl.shippriority.push_back(0);
-  }
-
-
-  std::cout << "Finished parsing ORDERS table with " << tbl.rows << " rows\n";
-
-  return true;
-}
-
 //
 // parse the PARTS table
 //
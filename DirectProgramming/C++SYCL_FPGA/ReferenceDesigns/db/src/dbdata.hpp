@@ -166,7 +166,7 @@ struct Database {
   PartSupplierTable ps;
   NationTable n;
 
-  bool Parse(std::string db_root_dir);
+  bool Parse(std::string db_root_dir, bool use_cache = false);
 
   // validation functions
   bool ValidateSF();
@@ -206,8 +206,9 @@ struct Database {
                 std::array<DBDecimal, 2> low_line_count);
 
  private:
-  bool ParseLineItemTable(std::string f, LineItemTable& tbl);
-  bool ParseOrdersTable(std::string f, OrdersTable& tbl);
+  // defined in dbloader.cpp
+  bool ParseLineItemTable(std::string f, LineItemTable& tbl, bool use_cache);
+  bool ParseOrdersTable(std::string f, OrdersTable& tbl, bool use_cache);
   bool ParsePartsTable(std::string f, PartsTable& tbl);
   bool ParseSupplierTable(std::string f, SupplierTable& tbl);
   bool ParsePartSupplierTable(std::string f, PartSupplierTable& tbl);
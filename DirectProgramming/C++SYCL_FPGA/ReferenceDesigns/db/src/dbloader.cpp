@@ -0,0 +1,680 @@
+//
+// Fast loader for the two large TPC-H tables (LINEITEM and ORDERS).
+//
+// The '.tbl' files are memory mapped and split into one chunk per host
+// thread (on line boundaries). Each thread first counts the rows in its chunk
+// and then, once the row offsets of every chunk are known, parses its rows
+// directly into the (pre-sized) table columns. The tokenizer works on
+// std::string_view slices of the mapped file, so no memory is allocated
+// per row or per field.
+//
+// The parsed columns can optionally be written to a binary columnar cache
+// file ('<table>.tbl.cache') that sits next to the '.tbl' file. On later runs
+// the cache is mapped and each column is copied with a single memcpy into the
+// host vectors that back the query buffers, which skips parsing altogether.
+//
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#if defined(WIN32) || defined(_WIN32) || defined(_MSC_VER)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "dbdata.hpp"
+#include "db_utils/Date.hpp"
+
+namespace {
+
+//
+// A read-only memory mapping of an entire file
+//
+class MappedFile {
+ public:
+  MappedFile() = default;
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  ~MappedFile() { Close(); }
+
+  bool Open(const std::string& path) {
+    Close();
+#if defined(WIN32) || defined(_WIN32) || defined(_MSC_VER)
+    file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file_ == INVALID_HANDLE_VALUE) {
+      return false;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file_, &size)) {
+      Close();
+      return false;
+    }
+    size_ = (size_t)size.QuadPart;
+    FILETIME write_time;
+    if (!GetFileTime(file_, nullptr, nullptr, &write_time)) {
+      Close();
+      return false;
+    }
+    mtime_ = ((uint64_t)write_time.dwHighDateTime << 32) |
+             write_time.dwLowDateTime;
+    if (size_ == 0) {
+      return true;
+    }
+    mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping_ == nullptr) {
+      Close();
+      return false;
+    }
+    data_ = (const char*)MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+    if (data_ == nullptr) {
+      Close();
+      return false;
+    }
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+      close(fd);
+      return false;
+    }
+    size_ = (size_t)st.st_size;
+    mtime_ = (uint64_t)st.st_mtim.tv_sec * 1000000000ull +
+             (uint64_t)st.st_mtim.tv_nsec;
+    if (size_ > 0) {
+      void* addr = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (addr == MAP_FAILED) {
+        close(fd);
+        size_ = 0;
+        return false;
+      }
+      // the tables are read front to back exactly once
+      madvise(addr, size_, MADV_SEQUENTIAL);
+      data_ = (const char*)addr;
+    }
+    // the mapping stays valid after the descriptor is closed
+    close(fd);
+#endif
+    return true;
+  }
+
+  void Close() {
+#if defined(WIN32) || defined(_WIN32) || defined(_MSC_VER)
+    if (data_ != nullptr) UnmapViewOfFile(data_);
+    if (mapping_ != nullptr) CloseHandle(mapping_);
+    if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+    mapping_ = nullptr;
+    file_ = INVALID_HANDLE_VALUE;
+#else
+    if (data_ != nullptr) munmap((void*)data_, size_);
+#endif
+    data_ = nullptr;
+    size_ = 0;
+    mtime_ = 0;
+  }
+
+  const char* data() const { return data_; }
+  size_t size() const { return size_; }
+  // last modification time, in the units of the platform
+  uint64_t mtime() const { return mtime_; }
+
+ private:
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+  uint64_t mtime_ = 0;
+#if defined(WIN32) || defined(_WIN32) || defined(_MSC_VER)
+  HANDLE file_ = INVALID_HANDLE_VALUE;
+  HANDLE mapping_ = nullptr;
+#endif
+};
+
+//
+// walks the '|' separated fields of a single row
+//
+class FieldCursor {
+ public:
+  explicit FieldCursor(std::string_view row) : row_(row) {}
+
+  std::string_view Next() {
+    size_t end = row_.find('|', pos_);
+    if (end == std::string_view::npos) {
+      end = row_.size();
+    } else {
+      delimiters_++;
+    }
+    std::string_view field = row_.substr(pos_, end - pos_);
+    pos_ = std::min(end + 1, row_.size());
+    fields_++;
+    return field;
+  }
+
+  // true if every field read so far was terminated by a '|' and nothing
+  // follows the last one. The rows written by dbgen end with a '|', so this
+  // catches both short rows and rows with extra fields.
+  bool Complete() const {
+    return delimiters_ == fields_ && pos_ == row_.size();
+  }
+
+ private:
+  std::string_view row_;
+  size_t pos_ = 0;
+  size_t fields_ = 0;
+  size_t delimiters_ = 0;
+};
+
+//
+// parse an unsigned decimal integer
+//
+unsigned long long ParseUnsigned(std::string_view s) {
+  unsigned long long val = 0;
+  for (char c : s) {
+    if (c < '0' || c > '9') break;
+    val = val * 10 + (c - '0');
+  }
+  return val;
+}
+
+//
+// same as 'MoneyFloatToCents' in dbdata.cpp, without the std::string copies
+//
+DBDecimal ParseCents(std::string_view s) {
+  bool negative = !s.empty() && s[0] == '-';
+  if (negative) s.remove_prefix(1);
+
+  size_t dot = s.find('.');
+  DBDecimal dollars = (DBDecimal)ParseUnsigned(s.substr(0, dot));
+  DBDecimal cents = 0;
+  if (dot != std::string_view::npos) {
+    cents = (DBDecimal)ParseUnsigned(s.substr(dot + 1));
+  }
+
+  return (negative ? -dollars : dollars) * 100 + cents;
+}
+
+//
+// parse a 'YYYY-MM-DD' date directly into the compact format
+//
+DBDate ParseCompactDate(std::string_view s) {
+  size_t d0 = s.find('-');
+  size_t d1 = (d0 == std::string_view::npos) ? d0 : s.find('-', d0 + 1);
+  if (d1 == std::string_view::npos) {
+    return Date(std::string(s)).ToCompact();
+  }
+  int year = (int)ParseUnsigned(s.substr(0, d0));
+  int month = (int)ParseUnsigned(s.substr(d0 + 1, d1 - d0 - 1));
+  int day = (int)ParseUnsigned(s.substr(d1 + 1));
+  return Date(year, month, day).ToCompact();
+}
+
+//
+// convert a SHIPMODE string to the internal representation (integer)
+//
+int ParseShipmode(std::string_view s) {
+  if (s == "REG AIR") return 0;
+  if (s == "AIR") return 1;
+  if (s == "RAIL") return 2;
+  if (s == "SHIP") return 3;
+  if (s == "TRUCK") return 4;
+  if (s == "MAIL") return 5;
+  if (s == "FOB") return 6;
+
+  // let the slow path print the warning
+  std::string str(s);
+  return ShipmodeStrToInt(str);
+}
+
+//
+// copy 'n' characters of a field into a fixed-width slot, padding with '\0'
+//
+void CopyFixedWidth(char* dst, std::string_view s, const size_t n) {
+  const size_t len = std::min(s.size(), n);
+  std::memcpy(dst, s.data(), len);
+  std::memset(dst + len, '\0', n - len);
+}
+
+//
+// A slice of the mapped file that holds whole rows
+//
+struct Chunk {
+  const char* begin;
+  const char* end;
+  size_t first_row;
+  size_t rows;
+};
+
+//
+// Splits the mapped file into (at most) one chunk per thread and computes the
+// index of the first row of each chunk.
+//
+std::vector<Chunk> SplitIntoChunks(const char* data, size_t size,
+                                   size_t threads) {
+  std::vector<Chunk> chunks;
+  const char* file_end = data + size;
+  const size_t target = (size + threads - 1) / threads;
+
+  // cut the file at the first newline after each multiple of 'target'
+  const char* begin = data;
+  while (begin < file_end) {
+    const char* end = begin + std::min(target, (size_t)(file_end - begin));
+    if (end < file_end) {
+      const char* nl =
+          (const char*)std::memchr(end, '\n', (size_t)(file_end - end));
+      end = (nl == nullptr) ? file_end : nl + 1;
+    }
+    chunks.push_back({begin, end, 0, 0});
+    begin = end;
+  }
+
+  // count the rows of each chunk in parallel
+  std::vector<std::thread> workers;
+  for (auto& c : chunks) {
+    workers.emplace_back([&c] {
+      size_t rows = 0;
+      const char* p = c.begin;
+      while (p < c.end) {
+        const char* nl = (const char*)std::memchr(p, '\n', (size_t)(c.end - p));
+        const char* line_end = (nl == nullptr) ? c.end : nl;
+        // skip empty lines, like a trailing blank line at the end of the file
+        if (line_end > p && !(line_end - p == 1 && *p == '\r')) {
+          rows++;
+        }
+        p = line_end + 1;
+      }
+      c.rows = rows;
+    });
+  }
+  for (auto& w : workers) {
+    w.join();
+  }
+
+  // prefix sum to get the starting row of each chunk
+  size_t row = 0;
+  for (auto& c : chunks) {
+    c.first_row = row;
+    row += c.rows;
+  }
+
+  return chunks;
+}
+
+//
+// Calls 'parse_row(row_index, row_view)' for every row in the chunks, with
+// one thread per chunk. Returns false if any call to 'parse_row' failed.
+//
+template <typename RowParser>
+bool ParseChunks(const std::vector<Chunk>& chunks, RowParser&& parse_row) {
+  std::atomic<bool> ok(true);
+  std::vector<std::thread> workers;
+  for (auto& c : chunks) {
+    workers.emplace_back([&c, &ok, &parse_row] {
+      size_t row = c.first_row;
+      const char* p = c.begin;
+      while (p < c.end) {
+        const char* nl = (const char*)std::memchr(p, '\n', (size_t)(c.end - p));
+        const char* line_end = (nl == nullptr) ? c.end : nl;
+        std::string_view line(p, (size_t)(line_end - p));
+        if (!line.empty() && line.back() == '\r') {
+          line.remove_suffix(1);
+        }
+        if (!line.empty()) {
+          if (!parse_row(row, line)) {
+            ok = false;
+            return;
+          }
+          row++;
+        }
+        p = line_end + 1;
+      }
+    });
+  }
+  for (auto& w : workers) {
+    w.join();
+  }
+  return ok;
+}
+
+size_t LoaderThreads() {
+  size_t threads = std::thread::hardware_concurrency();
+  return std::max<size_t>(threads, 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Binary columnar cache
+//
+// Layout:
+//    CacheHeader
+//    CacheColumn[num_columns]
+//    column data, each column starting at a kCacheAlignment aligned offset
+//
+// The columns are stored exactly as they are held in the table vectors
+// (including the kPaddingRows padding rows).
+///////////////////////////////////////////////////////////////////////////////
+constexpr char kCacheMagic[8] = {'T', 'P', 'C', 'H', 'C', 'O', 'L', '2'};
+constexpr uint64_t kCacheAlignment = 4096;
+
+struct CacheHeader {
+  char magic[8];
+  uint64_t rows;
+  uint64_t source_size;   // size of the '.tbl' file the cache was built from
+  uint64_t source_mtime;  // and its last modification time
+  uint64_t num_columns;
+};
+
+struct CacheColumn {
+  uint64_t offset;
+  uint64_t bytes;
+};
+
+//
+// apply 'f' to every column (std::vector) of the table, in a fixed order
+//
+template <typename Func>
+void ForEachColumn(LineItemTable& t, Func&& f) {
+  f(t.orderkey);
+  f(t.partkey);
+  f(t.suppkey);
+  f(t.linenumber);
+  f(t.quantity);
+  f(t.extendedprice);
+  f(t.discount);
+  f(t.tax);
+  f(t.returnflag);
+  f(t.linestatus);
+  f(t.shipdate);
+  f(t.commitdate);
+  f(t.receiptdate);
+  f(t.shipinstruct);
+  f(t.shipmode);
+  f(t.comment);
+}
+
+template <typename Func>
+void ForEachColumn(OrdersTable& t, Func&& f) {
+  f(t.orderkey);
+  f(t.custkey);
+  f(t.orderstatus);
+  f(t.totalprice);
+  f(t.orderdate);
+  f(t.orderpriority);
+  f(t.clerk);
+  f(t.shippriority);
+  f(t.comment);
+}
+
+uint64_t AlignUp(uint64_t x) {
+  return (x + kCacheAlignment - 1) / kCacheAlignment * kCacheAlignment;
+}
+
+//
+// write the columns of a table to a cache file
+//
+template <typename TableT>
+bool WriteCache(const std::string& cache_path, const MappedFile& source,
+                TableT& tbl) {
+  std::vector<CacheColumn> columns;
+  uint64_t offset = 0;
+
+  // compute the column offsets
+  size_t num_columns = 0;
+  ForEachColumn(tbl, [&](auto&) { num_columns++; });
+  offset = AlignUp(sizeof(CacheHeader) + num_columns * sizeof(CacheColumn));
+  ForEachColumn(tbl, [&](auto& col) {
+    uint64_t bytes = col.size() * sizeof(col[0]);
+    columns.push_back({offset, bytes});
+    offset = AlignUp(offset + bytes);
+  });
+
+  std::ofstream ofs(cache_path, std::ios::binary | std::ios::trunc);
+  if (!ofs.is_open()) {
+    return false;
+  }
+
+  CacheHeader header;
+  std::memcpy(header.magic, kCacheMagic, sizeof(kCacheMagic));
+  header.rows = tbl.rows;
+  header.source_size = source.size();
+  header.source_mtime = source.mtime();
+  header.num_columns = columns.size();
+  ofs.write((const char*)&header, sizeof(header));
+  ofs.write((const char*)columns.data(), columns.size() * sizeof(CacheColumn));
+
+  // write the column data, zero filling up to each aligned offset
+  const std::vector<char> zeros(kCacheAlignment, '\0');
+  uint64_t pos = sizeof(header) + columns.size() * sizeof(CacheColumn);
+  size_t c = 0;
+  ForEachColumn(tbl, [&](auto& col) {
+    ofs.write(zeros.data(), columns[c].offset - pos);
+    ofs.write((const char*)col.data(), columns[c].bytes);
+    pos = columns[c].offset + columns[c].bytes;
+    c++;
+  });
+
+  return ofs.good();
+}
+
+//
+// read the columns of a table from a cache file. Returns false if the
+// cache does not exist or does not match the '.tbl' file.
+//
+template <typename TableT>
+bool ReadCache(const std::string& cache_path, const MappedFile& source,
+               TableT& tbl) {
+  MappedFile cache;
+  if (!cache.Open(cache_path) || cache.size() < sizeof(CacheHeader)) {
+    return false;
+  }
+
+  CacheHeader header;
+  std::memcpy(&header, cache.data(), sizeof(header));
+
+  size_t num_columns = 0;
+  ForEachColumn(tbl, [&](auto&) { num_columns++; });
+
+  if (std::memcmp(header.magic, kCacheMagic, sizeof(kCacheMagic)) != 0 ||
+      header.source_size != source.size() ||
+      header.source_mtime != source.mtime() ||
+      header.num_columns != num_columns ||
+      cache.size() < sizeof(header) + num_columns * sizeof(CacheColumn)) {
+    return false;
+  }
+
+  std::vector<CacheColumn> columns(num_columns);
+  std::memcpy(columns.data(), cache.data() + sizeof(header),
+              num_columns * sizeof(CacheColumn));
+  for (auto& c : columns) {
+    if (c.offset + c.bytes > cache.size()) {
+      return false;
+    }
+  }
+
+  size_t c = 0;
+  ForEachColumn(tbl, [&](auto& col) {
+    col.resize(columns[c].bytes / sizeof(col[0]));
+    std::memcpy(col.data(), cache.data() + columns[c].offset, columns[c].bytes);
+    c++;
+  });
+  tbl.rows = header.rows;
+
+  return true;
+}
+
+}  // namespace
+
+//
+// parse the LINEITEM table
+//
+bool Database::ParseLineItemTable(std::string f, LineItemTable& tbl,
+                                  bool use_cache) {
+  MappedFile file;
+  if (!file.Open(f)) {
+    std::cout << "Failed to parse LINEITEM table\n";
+    return false;
+  }
+
+  const std::string cache_path = f + ".cache";
+  if (use_cache && ReadCache(cache_path, file, tbl)) {
+    std::cout << "Loaded LINEITEM table from cache " << cache_path << " with "
+              << tbl.rows << " rows\n";
+    return true;
+  }
+
+  std::cout << "Parsing LINEITEM table from: " << f << "\n";
+
+  auto chunks = SplitIntoChunks(file.data(), file.size(), LoaderThreads());
+  tbl.rows = chunks.empty() ? 0 : chunks.back().first_row + chunks.back().rows;
+
+  // size every column for all rows plus the padding rows, the padding rows
+  // are left as zero
+  const size_t n = tbl.rows + kPaddingRows;
+  tbl.orderkey.assign(n, 0);
+  tbl.partkey.assign(n, 0);
+  tbl.suppkey.assign(n, 0);
+  tbl.linenumber.assign(n, 0);
+  tbl.quantity.assign(n, 0);
+  tbl.extendedprice.assign(n, 0);
+  tbl.discount.assign(n, 0);
+  tbl.tax.assign(n, 0);
+  tbl.returnflag.assign(n, 0);
+  tbl.linestatus.assign(n, 0);
+  tbl.shipdate.assign(n, 0);
+  tbl.commitdate.assign(n, 0);
+  tbl.receiptdate.assign(n, 0);
+  tbl.shipmode.assign(n, 0);
+  // the string columns are not padded
+  tbl.shipinstruct.assign(tbl.rows * 25, '\0');
+  tbl.comment.assign(tbl.rows * 44, '\0');
+
+  bool success = ParseChunks(chunks, [&tbl](size_t r, std::string_view line) {
+    FieldCursor fields(line);
+
+    tbl.orderkey[r] = ParseUnsigned(fields.Next());
+    tbl.partkey[r] = ParseUnsigned(fields.Next());
+    tbl.suppkey[r] = ParseUnsigned(fields.Next());
+    tbl.linenumber[r] = ParseUnsigned(fields.Next());
+    tbl.quantity[r] = ParseUnsigned(fields.Next());
+
+    tbl.extendedprice[r] = ParseCents(fields.Next());
+    tbl.discount[r] = ParseCents(fields.Next());
+    tbl.tax[r] = ParseCents(fields.Next());
+
+    std::string_view returnflag = fields.Next();
+    std::string_view linestatus = fields.Next();
+    if (returnflag.empty() || linestatus.empty()) return false;
+    tbl.returnflag[r] = returnflag[0];
+    tbl.linestatus[r] = linestatus[0];
+
+    tbl.shipdate[r] = ParseCompactDate(fields.Next());
+    tbl.commitdate[r] = ParseCompactDate(fields.Next());
+    tbl.receiptdate[r] = ParseCompactDate(fields.Next());
+
+    CopyFixedWidth(&tbl.shipinstruct[r * 25], fields.Next(), 25);
+    tbl.shipmode[r] = ParseShipmode(fields.Next());
+    CopyFixedWidth(&tbl.comment[r * 44], fields.Next(), 44);
+
+    return fields.Complete();
+  });
+
+  if (!success) {
+    std::cout << "Failed to parse LINEITEM table (malformed row)\n";
+    return false;
+  }
+
+  std::cout << "Finished parsing LINEITEM table with " << tbl.rows << " rows\n";
+
+  if (use_cache && !WriteCache(cache_path, file, tbl)) {
+    std::cerr << "WARNING: could not write LINEITEM cache " << cache_path
+              << "\n";
+  }
+
+  return true;
+}
+
+//
+// parse the ORDERS table
+//
+bool Database::ParseOrdersTable(std::string f, OrdersTable& tbl,
+                                bool use_cache) {
+  MappedFile file;
+  if (!file.Open(f)) {
+    std::cout << "Failed to parse ORDERS table\n";
+    return false;
+  }
+
+  const std::string cache_path = f + ".cache";
+  if (use_cache && ReadCache(cache_path, file, tbl)) {
+    std::cout << "Loaded ORDERS table from cache " << cache_path << " with "
+              << tbl.rows << " rows\n";
+    return true;
+  }
+
+  std::cout << "Parsing ORDERS table from: " << f << "\n";
+
+  auto chunks = SplitIntoChunks(file.data(), file.size(), LoaderThreads());
+  tbl.rows = chunks.empty() ? 0 : chunks.back().first_row + chunks.back().rows;
+
+  // size every column for all rows plus the padding rows, the padding rows
+  // are left as zero
+  const size_t n = tbl.rows + kPaddingRows;
+  tbl.orderkey.assign(n, 0);
+  tbl.custkey.assign(n, 0);
+  tbl.orderstatus.assign(n, 0);
+  tbl.totalprice.assign(n, 0);
+  tbl.orderdate.assign(n, 0);
+  tbl.orderpriority.assign(n, 0);
+  tbl.shippriority.assign(n, 0);
+  // the string columns are not padded
+  tbl.clerk.assign(tbl.rows * 15, '\0');
+  tbl.comment.assign(tbl.rows * 80, '\0');
+
+  bool success = ParseChunks(chunks, [&tbl](size_t r, std::string_view line) {
+    FieldCursor fields(line);
+
+    tbl.orderkey[r] = ParseUnsigned(fields.Next());
+    tbl.custkey[r] = ParseUnsigned(fields.Next());
+
+    std::string_view orderstatus = fields.Next();
+    if (orderstatus.empty()) return false;
+    tbl.orderstatus[r] = orderstatus[0];
+
+    tbl.totalprice[r] = ParseCents(fields.Next());
+    tbl.orderdate[r] = ParseCompactDate(fields.Next());
+
+    std::string_view orderpriority = fields.Next();
+    if (orderpriority.empty()) return false;
+    tbl.orderpriority[r] = (int)(orderpriority[0] - '0');
+
+    CopyFixedWidth(&tbl.clerk[r * 15], fields.Next(), 15);
+    tbl.shippriority[r] = (int)ParseUnsigned(fields.Next());
+    CopyFixedWidth(&tbl.comment[r * 80], fields.Next(), 80);
+
+    return fields.Complete();
+  });
+
+  if (!success) {
+    std::cout << "Failed to parse ORDERS table (malformed row)\n";
+    return false;
+  }
+
+  std::cout << "Finished parsing ORDERS table with " << tbl.rows << " rows\n";
+
+  if (use_cache && !WriteCache(cache_path, file, tbl)) {
+    std::cerr << "WARNING: could not write ORDERS cache " << cache_path << "\n";
+  }
+
+  return true;
+}
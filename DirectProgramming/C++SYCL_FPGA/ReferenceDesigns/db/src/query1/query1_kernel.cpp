@@ -25,13 +25,23 @@ bool SubmitQuery1(queue& q, Database& dbinfo, DBDate low_date,
                   std::array<DBDecimal, kQuery1OutSize>& count,
                   double& kernel_latency, double& total_latency) {
   // create space for input buffers
-  buffer quantity_buf(dbinfo.l.quantity);
-  buffer extendedprice_buf(dbinfo.l.extendedprice);
-  buffer discount_buf(dbinfo.l.discount);
-  buffer tax_buf(dbinfo.l.tax);
-  buffer returnflag_buf(dbinfo.l.returnflag);
-  buffer linestatus_buf(dbinfo.l.linestatus);
-  buffer shipdate_buf(dbinfo.l.shipdate);
+  Query1Buffers bufs(dbinfo);
+
+  return SubmitQuery1(q, bufs, low_date, sum_qty, sum_base_price,
+                      sum_disc_price, sum_charge, avg_qty, avg_price,
+                      avg_discount, count, kernel_latency, total_latency);
+}
+
+bool SubmitQuery1(queue& q, Query1Buffers& bufs, DBDate low_date,
+                  std::array<DBDecimal, kQuery1OutSize>& sum_qty,
+                  std::array<DBDecimal, kQuery1OutSize>& sum_base_price,
+                  std::array<DBDecimal, kQuery1OutSize>& sum_disc_price,
+                  std::array<DBDecimal, kQuery1OutSize>& sum_charge,
+                  std::array<DBDecimal, kQuery1OutSize>& avg_qty,
+                  std::array<DBDecimal, kQuery1OutSize>& avg_price,
+                  std::array<DBDecimal, kQuery1OutSize>& avg_discount,
+                  std::array<DBDecimal, kQuery1OutSize>& count,
+                  double& kernel_latency, double& total_latency) {
 
   // setup the output buffers
   buffer sum_qty_buf(sum_qty);
@@ -43,7 +53,7 @@ bool SubmitQuery1(queue& q, Database& dbinfo, DBDate low_date,
   buffer avg_discount_buf(avg_discount);
   buffer count_buf(count);
 
-  const int rows = dbinfo.l.rows; 
+  const int rows = bufs.rows;
   const size_t iters = (rows + kElementsPerCycle - 1) / kElementsPerCycle;
 
   // start timer
@@ -53,13 +63,13 @@ bool SubmitQuery1(queue& q, Database& dbinfo, DBDate low_date,
   //// Query1 Kernel
   auto event = q.submit([&](handler& h) {
     // read accessors
-    accessor quantity_accessor(quantity_buf, h, read_only);
-    accessor extendedprice_accessor(extendedprice_buf, h, read_only);
-    accessor discount_accessor(discount_buf, h, read_only);
-    accessor tax_accessor(tax_buf, h, read_only);
-    accessor returnflag_accessor(returnflag_buf, h, read_only);
-    accessor linestatus_accessor(linestatus_buf, h, read_only);
-    accessor shipdate_accessor(shipdate_buf, h, read_only);
+    accessor quantity_accessor(bufs.quantity, h, read_only);
+    accessor extendedprice_accessor(bufs.extendedprice, h, read_only);
+    accessor discount_accessor(bufs.discount, h, read_only);
+    accessor tax_accessor(bufs.tax, h, read_only);
+    accessor returnflag_accessor(bufs.returnflag, h, read_only);
+    accessor linestatus_accessor(bufs.linestatus, h, read_only);
+    accessor shipdate_accessor(bufs.shipdate, h, read_only);
 
     // write accessors
     accessor sum_qty_accessor(sum_qty_buf, h, write_only, no_init);
@@ -9,6 +9,43 @@
 
 using namespace sycl;
 
+//
+// The LINEITEM columns read by Query 1. A Query1Buffers object that outlives
+// several calls to SubmitQuery1 lets the runtime keep the columns resident
+// on the device instead of transferring them for every query.
+//
+struct Query1Buffers {
+  explicit Query1Buffers(Database& dbinfo)
+      : quantity(dbinfo.l.quantity),
+        extendedprice(dbinfo.l.extendedprice),
+        discount(dbinfo.l.discount),
+        tax(dbinfo.l.tax),
+        returnflag(dbinfo.l.returnflag),
+        linestatus(dbinfo.l.linestatus),
+        shipdate(dbinfo.l.shipdate),
+        rows(dbinfo.l.rows) {}
+
+  buffer<DBDecimal, 1> quantity;
+  buffer<DBDecimal, 1> extendedprice;
+  buffer<DBDecimal, 1> discount;
+  buffer<DBDecimal, 1> tax;
+  buffer<char, 1> returnflag;
+  buffer<char, 1> linestatus;
+  buffer<DBDate, 1> shipdate;
+  size_t rows;
+};
+
+bool SubmitQuery1(queue& q, Query1Buffers& bufs, DBDate low_date,
+                  std::array<DBDecimal, kQuery1OutSize>& sum_qty,
+                  std::array<DBDecimal, kQuery1OutSize>& sum_base_price,
+                  std::array<DBDecimal, kQuery1OutSize>& sum_disc_price,
+                  std::array<DBDecimal, kQuery1OutSize>& sum_charge,
+                  std::array<DBDecimal, kQuery1OutSize>& avg_qty,
+                  std::array<DBDecimal, kQuery1OutSize>& avg_price,
+                  std::array<DBDecimal, kQuery1OutSize>& avg_discount,
+                  std::array<DBDecimal, kQuery1OutSize>& count,
+                  double& kernel_latency, double& total_latency);
+
 bool SubmitQuery1(queue& q, Database& dbinfo, DBDate low_date,
                   std::array<DBDecimal, kQuery1OutSize>& sum_qty,
                   std::array<DBDecimal, kQuery1OutSize>& sum_base_price,
@@ -104,6 +104,9 @@ using SupplierPartSupplierJoinedPipeData =
 // pipes
 using ProducePartSupplierPipe =
   pipe<class ProducePartSupplierPipeClass, PartSupplierRowPipeData>;
+
+using FilteredPartSupplierPipe =
+  pipe<class FilteredPartSupplierPipeClass, PartSupplierRowPipeData>;
   
 using PartSupplierPartsPipe =
   pipe<class PartSupplierPartsPipeClass, SupplierPartSupplierJoinedPipeData>;
@@ -1,5 +1,6 @@
 #include <stdio.h>
 
+#include <array>
 #include <type_traits>
 
 #include "query11_kernel.hpp"
@@ -7,6 +8,7 @@
 #include "../db_utils/CachedMemory.hpp"
 #include "../db_utils/MapJoin.hpp"
 #include "../db_utils/Misc.hpp"
+#include "../db_utils/PreJoinFilter.hpp"
 #include "../db_utils/Tuple.hpp"
 #include "../db_utils/Unroller.hpp"
 #include "../db_utils/fifo_sort.hpp"
@@ -17,6 +19,7 @@ using namespace std::chrono;
 
 // kernel class names
 class ProducePartSupplier;
+class FilterPartSupplier;
 class JoinPartSupplierParts;
 class Compute;
 class FifoSort;
@@ -46,6 +49,20 @@ using SortOutPipe = pipe<class SortOutputPipe, SortType>;
 bool SubmitQuery11(queue& q, Database& dbinfo, std::string& nation,
                     std::vector<DBIdentifier>& partkeys,
                     std::vector<DBDecimal>& values,
+                    FilterCounters& filter_stats,
+                    double& kernel_latency, double& total_latency) {
+  // create space for the input buffers
+  Query11Buffers bufs(dbinfo);
+
+  return SubmitQuery11(q, dbinfo, bufs, nation, partkeys, values,
+                       filter_stats, kernel_latency, total_latency);
+}
+
+bool SubmitQuery11(queue& q, Database& dbinfo, Query11Buffers& bufs,
+                    std::string& nation,
+                    std::vector<DBIdentifier>& partkeys,
+                    std::vector<DBDecimal>& values,
+                    FilterCounters& filter_stats,
                     double& kernel_latency, double& total_latency) {
   // find the nationkey based on the nation name
   assert(dbinfo.n.name_key_map.find(nation) != dbinfo.n.name_key_map.end());
@@ -55,22 +72,16 @@ bool SubmitQuery11(queue& q, Database& dbinfo, std::string& nation,
   partkeys.resize(kPartTableSize);
   values.resize(kPartTableSize);
 
-  // create space for the input buffers
-  // SUPPLIER
-  buffer s_nationkey_buf(dbinfo.s.nationkey);
-  
-  // PARTSUPPLIER
-  buffer ps_partkey_buf(dbinfo.ps.partkey);
-  buffer ps_suppkey_buf(dbinfo.ps.suppkey);
-  buffer ps_availqty_buf(dbinfo.ps.availqty);
-  buffer ps_supplycost_buf(dbinfo.ps.supplycost);
-
   // setup the output buffers
   buffer partkeys_buf(partkeys);
   buffer values_buf(values);
 
+  // selectivity counters of the pre-join filter
+  std::array<FilterCounters, 1> filter_counters;
+  buffer filter_counters_buf(filter_counters);
+
   // number of producing iterations depends on the number of elements per cycle
-  const size_t ps_rows = dbinfo.ps.rows;
+  const size_t ps_rows = bufs.ps_rows;
   const size_t ps_iters = (ps_rows + kJoinWinSize - 1) / kJoinWinSize;
 
   // start timer
@@ -80,10 +91,10 @@ bool SubmitQuery11(queue& q, Database& dbinfo, std::string& nation,
   //// ProducePartSupplier Kernel
   auto produce_ps_event = q.submit([&](handler& h) {
     // PARTSUPPLIER table accessors
-    accessor ps_partkey_accessor(ps_partkey_buf, h, read_only);
-    accessor ps_suppkey_accessor(ps_suppkey_buf, h, read_only);
-    accessor ps_availqty_accessor(ps_availqty_buf, h, read_only);
-    accessor ps_supplycost_accessor(ps_supplycost_buf, h, read_only);
+    accessor ps_partkey_accessor(bufs.ps_partkey, h, read_only);
+    accessor ps_suppkey_accessor(bufs.ps_suppkey, h, read_only);
+    accessor ps_availqty_accessor(bufs.ps_availqty, h, read_only);
+    accessor ps_supplycost_accessor(bufs.ps_supplycost, h, read_only);
 
     // kernel to produce the PARTSUPPLIER table
     h.single_task<ProducePartSupplier>([=]() [[intel::kernel_args_restrict]] {
@@ -116,12 +127,48 @@ bool SubmitQuery11(queue& q, Database& dbinfo, std::string& nation,
   });
   ///////////////////////////////////////////////////////////////////////////
 
+  ///////////////////////////////////////////////////////////////////////////
+  //// FilterPartSupplier Kernel
+  // Only PARTSUPPLIER rows whose supplier is in the requested nation
+  // contribute to the result, so drop all other rows before the join. SUPPKEY
+  // is dense, so an exact bit-vector is used rather than a Bloom filter.
+  auto filter_event = q.submit([&](handler& h) {
+    // SUPPLIER table accessors
+    size_t s_rows = bufs.s_rows;
+    accessor s_nationkey_accessor(bufs.s_nationkey, h, read_only);
+
+    // selectivity counters output
+    accessor filter_counters_accessor(filter_counters_buf, h, write_only,
+                                      no_init);
+
+    h.single_task<FilterPartSupplier>([=]() [[intel::kernel_args_restrict]] {
+      // SUPPKEY is in the range [1,kSF*10000]
+      BitVectorFilter<kSupplierTableSize> nation_suppliers;
+      nation_suppliers.Init();
+
+      [[intel::initiation_interval(1)]]
+      for (size_t i = 0; i < s_rows; i++) {
+        // NOTE: based on TPCH docs, SUPPKEY is guaranteed to be unique
+        // in the range [1:kSF*10000]
+        if (s_nationkey_accessor[i] == nationkey) {
+          nation_suppliers.Insert(i + 1);
+        }
+      }
+
+      filter_counters_accessor[0] =
+          FilterJoinInput<ProducePartSupplierPipe, PartSupplierRow,
+                          kJoinWinSize, FilteredPartSupplierPipe>(
+              nation_suppliers);
+    });
+  });
+  ///////////////////////////////////////////////////////////////////////////
+
   ///////////////////////////////////////////////////////////////////////////
   //// JoinPartSupplierParts Kernel
   auto join_event = q.submit([&](handler& h) {
     // SUPPLIER table accessors
-    size_t s_rows = dbinfo.s.rows;
-    accessor s_nationkey_accessor(s_nationkey_buf, h, read_only);
+    size_t s_rows = bufs.s_rows;
+    accessor s_nationkey_accessor(bufs.s_nationkey, h, read_only);
 
     h.single_task<JoinPartSupplierParts>([=]() [[intel::kernel_args_restrict]] {
       // initialize the array map
@@ -146,7 +193,7 @@ bool SubmitQuery11(queue& q, Database& dbinfo, std::string& nation,
       }
 
       // MAPJOIN PARTSUPPLIER and SUPPLIER tables by suppkey
-      MapJoin<unsigned char, ProducePartSupplierPipe, PartSupplierRow,
+      MapJoin<unsigned char, FilteredPartSupplierPipe, PartSupplierRow,
               kJoinWinSize, PartSupplierPartsPipe,
               SupplierPartSupplierJoined>(nation_key_map_data,
                                           nation_key_map_valid);
@@ -252,6 +299,7 @@ bool SubmitQuery11(queue& q, Database& dbinfo, std::string& nation,
 
   // wait for kernels to finish
   produce_ps_event.wait();
+  filter_event.wait();
   join_event.wait();
   compute_event.wait();
   sort_event.wait();
@@ -273,5 +321,11 @@ bool SubmitQuery11(queue& q, Database& dbinfo, std::string& nation,
   kernel_latency = kernel_execution_time;
   total_latency = diff.count();
 
+  // the selectivity counters of the pre-join filter
+  {
+    host_accessor counters(filter_counters_buf, read_only);
+    filter_stats = counters[0];
+  }
+
   return true;
 }
@@ -6,13 +6,55 @@
 #include <sycl/ext/intel/fpga_extensions.hpp>
 
 #include "../dbdata.hpp"
+#include "../db_utils/PreJoinFilter.hpp"
 
 using namespace sycl;
 
+//
+// The SUPPLIER and PARTSUPPLIER columns read by Query 11. A Query11Buffers
+// object that outlives several calls to SubmitQuery11 lets the runtime keep
+// the columns resident on the device instead of transferring them for every
+// query.
+//
+struct Query11Buffers {
+  explicit Query11Buffers(Database& dbinfo)
+      : s_nationkey(dbinfo.s.nationkey),
+        ps_partkey(dbinfo.ps.partkey),
+        ps_suppkey(dbinfo.ps.suppkey),
+        ps_availqty(dbinfo.ps.availqty),
+        ps_supplycost(dbinfo.ps.supplycost),
+        s_rows(dbinfo.s.rows),
+        ps_rows(dbinfo.ps.rows) {}
+
+  // SUPPLIER
+  buffer<unsigned char, 1> s_nationkey;
+
+  // PARTSUPPLIER
+  buffer<DBIdentifier, 1> ps_partkey;
+  buffer<DBIdentifier, 1> ps_suppkey;
+  buffer<int, 1> ps_availqty;
+  buffer<DBDecimal, 1> ps_supplycost;
+
+  size_t s_rows;
+  size_t ps_rows;
+};
+
+//
+// Runs Query 11 for 'nation'. 'filter_stats' receives the selectivity
+// counters of the pre-join filter in front of the SUPPLIER join.
+//
+bool SubmitQuery11(queue& q, Database& dbinfo, Query11Buffers& bufs,
+                   std::string& nation,
+                   std::vector<DBIdentifier>& partkeys,
+                   std::vector<DBDecimal>& values,
+                   FilterCounters& filter_stats,
+                   double& kernel_latency, double& total_latency);
+
 bool SubmitQuery11(queue& q, Database& dbinfo,
                    std::string& nation,
                    std::vector<DBIdentifier>& partkeys,
                    std::vector<DBDecimal>& values,
+                   FilterCounters& filter_stats,
                    double& kernel_latency, double& total_latency);
 
 #endif  //__QUERY11_KERNEL_HPP__
@@ -23,26 +23,27 @@ bool SubmitQuery12(queue& q, Database& dbinfo, DBDate low_date,
                     std::array<DBDecimal, 2>& low_line_count,
                     double& kernel_latency, double& total_latency) {
   // create space for the input buffers
-  // LINEITEM table
-  buffer l_orderkey_buf(dbinfo.l.orderkey);
-  buffer l_shipmode_buf(dbinfo.l.shipmode);
-  buffer l_commitdate_buf(dbinfo.l.commitdate);
-  buffer l_shipdate_buf(dbinfo.l.shipdate);
-  buffer l_receiptdate_buf(dbinfo.l.receiptdate);
+  Query12Buffers bufs(dbinfo);
 
-  // ORDERS table
-  buffer o_orderkey_buf(dbinfo.o.orderkey);
-  buffer o_orderpriority_buf(dbinfo.o.orderpriority);
+  return SubmitQuery12(q, bufs, low_date, high_date, shipmode1, shipmode2,
+                       high_line_count, low_line_count, kernel_latency,
+                       total_latency);
+}
 
+bool SubmitQuery12(queue& q, Query12Buffers& bufs, DBDate low_date,
+                    DBDate high_date, int shipmode1, int shipmode2,
+                    std::array<DBDecimal, 2>& high_line_count,
+                    std::array<DBDecimal, 2>& low_line_count,
+                    double& kernel_latency, double& total_latency) {
   // setup the output buffers
   buffer high_line_count_buf(high_line_count);
   buffer low_line_count_buf(low_line_count);
 
   // number of producing iterations depends on the number of elements per cycle
-  const size_t l_rows = dbinfo.l.rows;
+  const size_t l_rows = bufs.l_rows;
   const size_t l_iters =
       (l_rows + kLineItemJoinWindowSize - 1) / kLineItemJoinWindowSize;
-  const size_t o_rows = dbinfo.o.rows;
+  const size_t o_rows = bufs.o_rows;
   const size_t o_iters =
       (o_rows + kOrderJoinWindowSize - 1) / kOrderJoinWindowSize;
 
@@ -52,12 +53,12 @@ bool SubmitQuery12(queue& q, Database& dbinfo, DBDate low_date,
   /////////////////////////////////////////////////////////////////////////////
   //// LineItemProducer Kernel: produce the LINEITEM table
   auto produce_lineitem_event = q.submit([&](handler& h) {
-    size_t l_rows = dbinfo.l.rows;
-    accessor l_orderkey_accessor(l_orderkey_buf, h, read_only);
-    accessor l_shipmode_accessor(l_shipmode_buf, h, read_only);
-    accessor l_commitdate_accessor(l_commitdate_buf, h, read_only);
-    accessor l_shipdate_accessor(l_shipdate_buf, h, read_only);
-    accessor l_receiptdate_accessor(l_receiptdate_buf, h, read_only);
+    size_t l_rows = bufs.l_rows;
+    accessor l_orderkey_accessor(bufs.l_orderkey, h, read_only);
+    accessor l_shipmode_accessor(bufs.l_shipmode, h, read_only);
+    accessor l_commitdate_accessor(bufs.l_commitdate, h, read_only);
+    accessor l_shipdate_accessor(bufs.l_shipdate, h, read_only);
+    accessor l_receiptdate_accessor(bufs.l_receiptdate, h, read_only);
 
     h.single_task<LineItemProducer>([=]() [[intel::kernel_args_restrict]] {
       [[intel::initiation_interval(1)]]
@@ -94,9 +95,9 @@ bool SubmitQuery12(queue& q, Database& dbinfo, DBDate low_date,
   /////////////////////////////////////////////////////////////////////////////
   //// OrdersProducer Kernel: produce the ORDERS table
   auto produce_orders_event = q.submit([&](handler& h) {
-    size_t o_rows = dbinfo.o.rows;
-    accessor o_orderkey_accessor(o_orderkey_buf, h, read_only);
-    accessor o_orderpriority_accessor(o_orderpriority_buf, h, read_only);
+    size_t o_rows = bufs.o_rows;
+    accessor o_orderkey_accessor(bufs.o_orderkey, h, read_only);
+    accessor o_orderpriority_accessor(bufs.o_orderpriority, h, read_only);
 
     h.single_task<OrdersProducer>([=]() [[intel::kernel_args_restrict]] {
       [[intel::initiation_interval(1)]]
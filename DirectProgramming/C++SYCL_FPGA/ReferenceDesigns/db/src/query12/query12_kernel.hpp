@@ -9,6 +9,46 @@
 
 using namespace sycl;
 
+//
+// The LINEITEM and ORDERS columns read by Query 12. A Query12Buffers object
+// that outlives several calls to SubmitQuery12 lets the runtime keep the
+// columns resident on the device instead of transferring them for every
+// query.
+//
+struct Query12Buffers {
+  explicit Query12Buffers(Database& dbinfo)
+      : l_orderkey(dbinfo.l.orderkey),
+        l_shipmode(dbinfo.l.shipmode),
+        l_commitdate(dbinfo.l.commitdate),
+        l_shipdate(dbinfo.l.shipdate),
+        l_receiptdate(dbinfo.l.receiptdate),
+        o_orderkey(dbinfo.o.orderkey),
+        o_orderpriority(dbinfo.o.orderpriority),
+        l_rows(dbinfo.l.rows),
+        o_rows(dbinfo.o.rows) {}
+
+  // LINEITEM table
+  buffer<DBIdentifier, 1> l_orderkey;
+  buffer<int, 1> l_shipmode;
+  buffer<DBDate, 1> l_commitdate;
+  buffer<DBDate, 1> l_shipdate;
+  buffer<DBDate, 1> l_receiptdate;
+
+  // ORDERS table
+  buffer<DBIdentifier, 1> o_orderkey;
+  buffer<int, 1> o_orderpriority;
+
+  size_t l_rows;
+  size_t o_rows;
+};
+
+bool SubmitQuery12(queue& q, Query12Buffers& bufs,
+                   DBDate low_date, DBDate high_date,
+                   int shipmode1, int shipmode2,
+                   std::array<DBDecimal, 2>& high_line_count,
+                   std::array<DBDecimal, 2>& low_line_count,
+                   double& kernel_latency, double& total_latency);
+
 bool SubmitQuery12(queue& q, Database& dbinfo,
                    DBDate low_date, DBDate high_date,
                    int shipmode1, int shipmode2,
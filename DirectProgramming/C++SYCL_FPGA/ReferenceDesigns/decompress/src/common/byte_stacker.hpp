@@ -124,8 +124,9 @@ void ByteStacker() {
 // Creates a kernel from the byte stacker kernel
 template <typename Id, typename InPipe, typename OutPipe,
           unsigned literals_per_cycle>
-sycl::event SubmitByteStacker(sycl::queue& q) {
-  return q.single_task<Id>([=] {
+sycl::event SubmitByteStacker(sycl::queue& q,
+                              const std::vector<sycl::event>& deps = {}) {
+  return q.single_task<Id>(deps, [=] {
     ByteStacker<InPipe, OutPipe, literals_per_cycle>();
   });
 }
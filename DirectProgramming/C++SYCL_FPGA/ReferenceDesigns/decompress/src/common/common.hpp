@@ -5,6 +5,7 @@
 #include <functional>
 #include <iostream>
 #include <optional>
+#include <vector>
 #include <sycl/ext/intel/ac_types/ac_int.hpp>
 #include <sycl/ext/intel/fpga_extensions.hpp>
 
@@ -232,6 +233,26 @@ void WriteOutputFile(const std::string& filename,
   fout.close();
 }
 
+//
+// Statistics for a batch of files decompressed with DecompressBatch (below)
+//
+struct BatchStats {
+  size_t num_files = 0;
+  size_t in_bytes = 0;   // total compressed bytes
+  size_t out_bytes = 0;  // total decompressed bytes
+  double time_ms = 0;    // from the first copy to the device to the last copy
+                         // back to the host
+
+  double FilesPerSecond() const { return num_files / (time_ms * 1e-3); }
+  double OutputGBPerSecond() const {
+    return out_bytes * 1e-9 / (time_ms * 1e-3);
+  }
+};
+
+// the default number of files in flight in DecompressBatch. Each one has its
+// own set of device buffers.
+constexpr int kDefaultBatchSlots = 4;
+
 //
 // A base class for a decmompressor
 // This class is purely virtual, i.e. another class must inherit from it and
@@ -250,6 +271,19 @@ class DecompressorBase {
   virtual std::optional<std::vector<unsigned char>> DecompressBytes(
       sycl::queue&, std::vector<unsigned char>&, int, bool) = 0;
 
+  //
+  // A virtual function that must be overriden by a deriving class.
+  // Decompresses a batch of independent compressed files and returns the
+  // decompressed files, in the same order. Up to 'num_slots' files are in
+  // flight at once, so that the copy of one file to the device, the
+  // decompression of another, and the copy of a third back to the host
+  // overlap. This matters most for small files, where the fixed cost of the
+  // transfers and kernel launches dominates. Timing is returned in 'stats'.
+  //
+  virtual std::optional<std::vector<std::vector<unsigned char>>>
+  DecompressBatch(sycl::queue&, std::vector<std::vector<unsigned char>>&, int,
+                  BatchStats&) = 0;
+
   //
   // Reads the bytes in 'in_filename', decompresses them, and writes the
   // output to 'out_filename' (if write_output == true). This function uses
@@ -307,23 +341,29 @@ class DecompressorBase {
 //      to the input pipe. In this design, we pad the size to be a multiple of
 //      literals_per_cycle.
 //    in_ptr: a pointer to the input data
+//    deps: events that must complete before the kernel starts (e.g., the copy
+//      of the input data to in_ptr)
 //
 template <typename Id, typename InPipe, unsigned literals_per_cycle>
 sycl::event SubmitProducer(sycl::queue& q, unsigned in_count_padded,
-                           unsigned char* in_ptr) {
+                           unsigned char* in_ptr,
+                           const std::vector<sycl::event>& deps = {}) {
   assert(in_count_padded % literals_per_cycle == 0);
   auto iteration_count = in_count_padded / literals_per_cycle;
-  return q.single_task<Id>([=] {
-    // Use the MemoryToPipe utility to read from in_ptr 'literals_per_cycle'
-    // elements at once and write them to 'InPipe'.
-    // The 'false' template argument is our way of guaranteeing to the library
-    // that 'literals_per_cycle is a multiple 'iteration_count'. In both the
-    // GZIP and SNAPPY designs, we guarantee this in the DecompressBytes
-    // functions in ../gzip/gzip_decompressor.hpp and
-    // ../snappy/snappy_decompressor.hpp respectively.
-    sycl::device_ptr<unsigned char> in(in_ptr);
-    fpga_tools::MemoryToPipe<InPipe, literals_per_cycle, false>(
-        in, iteration_count);
+  return q.submit([&](sycl::handler& h) {
+    h.depends_on(deps);
+    h.single_task<Id>([=] {
+      // Use the MemoryToPipe utility to read from in_ptr 'literals_per_cycle'
+      // elements at once and write them to 'InPipe'.
+      // The 'false' template argument is our way of guaranteeing to the library
+      // that 'literals_per_cycle is a multiple 'iteration_count'. In both the
+      // GZIP and SNAPPY designs, we guarantee this in the DecompressBytes
+      // functions in ../gzip/gzip_decompressor.hpp and
+      // ../snappy/snappy_decompressor.hpp respectively.
+      sycl::device_ptr<unsigned char> in(in_ptr);
+      fpga_tools::MemoryToPipe<InPipe, literals_per_cycle, false>(
+          in, iteration_count);
+    });
   });
 }
 
@@ -344,28 +384,33 @@ sycl::event SubmitProducer(sycl::queue& q, unsigned in_count_padded,
 //      write to out_ptr. In this design, we pad the size to be a multiple of
 //      literals_per_cycle.
 //    out_ptr: a pointer to the output data
+//    deps: events that must complete before the kernel starts
 //
 template <typename Id, typename OutPipe, unsigned literals_per_cycle>
 sycl::event SubmitConsumer(sycl::queue& q, unsigned out_count_padded,
-                           unsigned char* out_ptr) {
+                           unsigned char* out_ptr,
+                           const std::vector<sycl::event>& deps = {}) {
   assert(out_count_padded % literals_per_cycle == 0);
   auto iteration_count = out_count_padded / literals_per_cycle;
-  return q.single_task<Id>([=] {
-    // Use the PipeToMemory utility to read 'literals_per_cycle'
-    // elements at once from 'OutPipe' and write them to 'out_ptr'.
-    // For details about the 'false' template parameter, see the SubmitProducer
-    // function above.
-    sycl::device_ptr<unsigned char> out(out_ptr);
-    fpga_tools::PipeToMemory<OutPipe, literals_per_cycle, false>(
-        out, iteration_count);
-
-    // read the last 'done' signal
-    bool done = false;
-    while (!done) {
-      bool valid;
-      auto d = OutPipe::read(valid);
-      done = d.flag && valid;
-    }
+  return q.submit([&](sycl::handler& h) {
+    h.depends_on(deps);
+    h.single_task<Id>([=] {
+      // Use the PipeToMemory utility to read 'literals_per_cycle'
+      // elements at once from 'OutPipe' and write them to 'out_ptr'.
+      // For details about the 'false' template parameter, see the
+      // SubmitProducer function above.
+      sycl::device_ptr<unsigned char> out(out_ptr);
+      fpga_tools::PipeToMemory<OutPipe, literals_per_cycle, false>(
+          out, iteration_count);
+
+      // read the last 'done' signal
+      bool done = false;
+      while (!done) {
+        bool valid;
+        auto d = OutPipe::read(valid);
+        done = d.flag && valid;
+      }
+    });
   });
 }
 
@@ -475,8 +475,9 @@ void LZ77Decoder() {
 //
 template <typename Id, typename InPipe, typename OutPipe,
           size_t literals_per_cycle, size_t max_distance, size_t max_length>
-sycl::event SubmitLZ77Decoder(sycl::queue& q) {
-  return q.single_task<Id>([=] {
+sycl::event SubmitLZ77Decoder(sycl::queue& q,
+                              const std::vector<sycl::event>& deps = {}) {
+  return q.single_task<Id>(deps, [=] {
     return LZ77Decoder<InPipe, OutPipe, literals_per_cycle, max_distance,
                        max_length>();
   });
@@ -0,0 +1,179 @@
+#ifndef __GZIP_DATA_GEN_HPP__
+#define __GZIP_DATA_GEN_HPP__
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "../common/simple_crc32.hpp"
+
+//
+// A function to generate compressed GZIP data for testing purposes.
+// The data is written as a single statically compressed (BTYPE=01) DEFLATE
+// block, with the following content:
+//    'num_lit_strs' literal strings of length 'lit_str_len'
+//    'num_copies' of length 'copy_len' and distance min(32K, lit_str_len)
+//    'repeat' copies of the above.
+// If 'uncompressed_out' is not null, the uncompressed data is written to it.
+// This mirrors GenerateSnappyCompressedData in ../snappy/snappy_data_gen.hpp.
+//
+std::vector<unsigned char> GenerateGzipCompressedData(
+    unsigned lit_str_len, unsigned num_lit_strs, unsigned copy_len,
+    unsigned num_copies, unsigned repeats,
+    std::vector<unsigned char>* uncompressed_out = nullptr) {
+  // error checking the input arguments
+  if (lit_str_len <= 0) {
+    std::cerr << "ERROR: 'lit_str_len' must be greater than 0" << std::endl;
+    std::terminate();
+  }
+  if (num_lit_strs <= 0) {
+    std::cerr << "ERROR: 'num_lit_strs' must be greater than 0" << std::endl;
+    std::terminate();
+  }
+  if (num_copies > 0 && (copy_len < 3 || copy_len > 258)) {
+    std::cerr << "ERROR: if 'num_copies' is non-zero, then 'copy_len' must be "
+              << "in the range [3, 258]" << std::endl;
+    std::terminate();
+  }
+  if (repeats <= 0) {
+    std::cerr << "ERROR: 'repeats' must be greater than 0" << std::endl;
+    std::terminate();
+  }
+
+  std::vector<unsigned char> ret;
+
+  // the uncompressed data, used to compute the CRC in the GZIP footer
+  std::vector<unsigned char> uncompressed;
+
+  // the "smart" data we will fill our dummy buffer with ... ;)
+  constexpr unsigned char dummy_alphabet[] = {'I', 'N', 'T', 'E', 'L'};
+  constexpr unsigned dummy_alphabet_count =
+      sizeof(dummy_alphabet) / sizeof(dummy_alphabet[0]);
+
+  // the GZIP header: magic number, CM=8 (DEFLATE), no flags, no time, no extra
+  // flags and an unknown OS
+  constexpr unsigned char header[] = {0x1F, 0x8B, 8, 0, 0, 0, 0, 0, 0, 0xFF};
+  for (auto b : header) {
+    ret.push_back(b);
+  }
+
+  // DEFLATE data is written least significant bit first
+  unsigned long long bit_buf = 0;
+  unsigned bit_count = 0;
+  auto write_bits = [&](unsigned val, unsigned n) {
+    bit_buf |= (unsigned long long)val << bit_count;
+    bit_count += n;
+    while (bit_count >= 8) {
+      ret.push_back(bit_buf & 0xFF);
+      bit_buf >>= 8;
+      bit_count -= 8;
+    }
+  };
+
+  // Huffman codes are written most significant bit first
+  auto write_code = [&](unsigned code, unsigned n) {
+    unsigned reversed = 0;
+    for (unsigned i = 0; i < n; i++) {
+      reversed |= ((code >> i) & 0x1) << (n - 1 - i);
+    }
+    write_bits(reversed, n);
+  };
+
+  // write a symbol from the static literal/length tree
+  auto write_lit_len_symbol = [&](unsigned sym) {
+    if (sym < 144) {
+      write_code(0x30 + sym, 8);
+    } else if (sym < 256) {
+      write_code(0x190 + (sym - 144), 9);
+    } else if (sym < 280) {
+      write_code(sym - 256, 7);
+    } else {
+      write_code(0xC0 + (sym - 280), 8);
+    }
+  };
+
+  // the base values and extra bits of the length and distance codes
+  constexpr unsigned short len_base[] = {3,  4,  5,  6,   7,   8,   9,   10,
+                                         11, 13, 15, 17,  19,  23,  27,  31,
+                                         35, 43, 51, 59,  67,  83,  99,  115,
+                                         131, 163, 195, 227, 258};
+  constexpr unsigned char len_extra[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1,
+                                         1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+                                         4, 4, 4, 4, 5, 5, 5, 5, 0};
+  constexpr unsigned short dist_base[] = {
+      1,    2,    3,    4,    5,    7,     9,     13,    17,    25,
+      33,   49,   65,   97,   129,  193,   257,   385,   513,   769,
+      1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+  constexpr unsigned char dist_extra[] = {0, 0, 0, 0, 1, 1, 2, 2,
+                                          3, 3, 4, 4, 5, 5, 6, 6,
+                                          7, 7, 8, 8, 9, 9, 10, 10,
+                                          11, 11, 12, 12, 13, 13};
+
+  // the distance of every copy, and its code, does not change across the
+  // 'repeats' iterations of the loop to generate the data
+  unsigned distance = std::min(32768U, lit_str_len);
+  unsigned dist_code = 29;
+  while (dist_base[dist_code] > distance) {
+    dist_code--;
+  }
+  unsigned len_code = 28;
+  if (num_copies > 0) {
+    while (len_base[len_code] > copy_len) {
+      len_code--;
+    }
+  }
+
+  // the block header: BFINAL=1, BTYPE=01 (static Huffman)
+  write_bits(1, 1);
+  write_bits(1, 2);
+
+  // generate the compressed data
+  for (unsigned i = 0; i < repeats; i++) {
+    // literal strings
+    for (unsigned j = 0; j < num_lit_strs; j++) {
+      for (unsigned k = 0; k < lit_str_len; k++) {
+        auto c = dummy_alphabet[k % dummy_alphabet_count];
+        write_lit_len_symbol(c);
+        uncompressed.push_back(c);
+      }
+    }
+
+    // copies
+    for (unsigned j = 0; j < num_copies; j++) {
+      write_lit_len_symbol(257 + len_code);
+      write_bits(copy_len - len_base[len_code], len_extra[len_code]);
+      write_code(dist_code, 5);
+      write_bits(distance - dist_base[dist_code], dist_extra[dist_code]);
+
+      for (unsigned k = 0; k < copy_len; k++) {
+        uncompressed.push_back(uncompressed[uncompressed.size() - distance]);
+      }
+    }
+  }
+
+  // the end of block symbol, then pad to a byte boundary
+  write_lit_len_symbol(256);
+  if (bit_count > 0) {
+    write_bits(0, 8 - bit_count);
+  }
+
+  // the GZIP footer: the CRC-32 and size of the uncompressed data
+  unsigned crc = SimpleCRC32(0, uncompressed.data(), uncompressed.size());
+  unsigned size = uncompressed.size();
+  for (int i = 0; i < 4; i++) {
+    ret.push_back((crc >> (i * 8)) & 0xFF);
+  }
+  for (int i = 0; i < 4; i++) {
+    ret.push_back((size >> (i * 8)) & 0xFF);
+  }
+
+  if (uncompressed_out != nullptr) {
+    *uncompressed_out = std::move(uncompressed);
+  }
+
+  return ret;
+}
+
+#endif /* __GZIP_DATA_GEN_HPP__ */
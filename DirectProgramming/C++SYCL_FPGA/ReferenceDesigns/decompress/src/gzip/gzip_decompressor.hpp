@@ -11,18 +11,28 @@
 #include "../common/lz77_decoder.hpp"
 #include "../common/simple_crc32.hpp"
 #include "constexpr_math.hpp"  // included from ../../../../include
+#include "gzip_member_index.hpp"
 #include "gzip_metadata_reader.hpp"
 #include "huffman_decoder.hpp"
 #include "metaprogramming_utils.hpp"  // included from ../../../../include
+#include "unrolled_loop.hpp"          // included from ../../../../include
 
 // declare the kernel and pipe names globally to reduce name mangling
+// each GZIP decompression engine ('engine_id') has its own kernels and pipes
+template <unsigned engine_id>
 class GzipMetadataReaderKernelID;
+template <unsigned engine_id>
 class HuffmanDecoderKernelID;
+template <unsigned engine_id>
 class LZ77DecoderKernelID;
+template <unsigned engine_id>
 class ByteStackerKernelID;
 
+template <unsigned engine_id>
 class GzipMetadataToHuffmanPipeID;
+template <unsigned engine_id>
 class HuffmanToLZ77PipeID;
+template <unsigned engine_id>
 class LZ77ToByteStackerPipeID;
 
 // the depth of the pipe between the Huffman decoder and the LZ77 decoder.
@@ -41,6 +51,9 @@ constexpr int kHuffmanToLZ77PipeDepth = 64;
 //    literals_per_cycle: the maximum number of literals written to the output
 //      stream every cycle. This sets how many literals can be read from the
 //      LZ77 history buffer at once.
+//    engine_id: which instance of the engine to submit. Each instance has its
+//      own kernels and inter-kernel pipes, so different engines run in
+//      parallel.
 //
 //  Arguments:
 //    q: the SYCL queue
@@ -48,11 +61,14 @@ constexpr int kHuffmanToLZ77PipeDepth = 64;
 //    hdr_data_out: a output buffer for the GZIP header data
 //    crc_out: an output buffer for the CRC in the GZIP footer
 //    count_out: an output buffer for the uncompressed size in the GZIP footer
+//    deps: events that must complete before the kernels start (e.g., the
+//      previous launch of the same engine)
 //
-template <typename InPipe, typename OutPipe, unsigned literals_per_cycle>
+template <typename InPipe, typename OutPipe, unsigned literals_per_cycle,
+          unsigned engine_id = 0>
 std::vector<sycl::event> SubmitGzipDecompressKernels(
     sycl::queue &q, int in_count, GzipHeaderData *hdr_data_out, int *crc_out,
-    int *count_out) {
+    int *count_out, const std::vector<sycl::event> &deps = {}) {
   // check that the input and output pipe types are actually pipes
   static_assert(fpga_tools::is_sycl_pipe_v<InPipe>);
   static_assert(fpga_tools::is_sycl_pipe_v<OutPipe>);
@@ -63,67 +79,101 @@ std::vector<sycl::event> SubmitGzipDecompressKernels(
 
   // the inter-kernel pipes for the GZIP decompression engine
   using GzipMetadataToHuffmanPipe =
-      sycl::ext::intel::pipe<GzipMetadataToHuffmanPipeID,
+      sycl::ext::intel::pipe<GzipMetadataToHuffmanPipeID<engine_id>,
                              FlagBundle<ByteSet<1>>>;
   using HuffmanToLZ77Pipe =
-      sycl::ext::intel::pipe<HuffmanToLZ77PipeID, FlagBundle<GzipLZ77InputData>,
+      sycl::ext::intel::pipe<HuffmanToLZ77PipeID<engine_id>,
+                             FlagBundle<GzipLZ77InputData>,
                              kHuffmanToLZ77PipeDepth>;
 
   // submit the GZIP decompression kernels
   auto header_event =
-      SubmitGzipMetadataReader<GzipMetadataReaderKernelID, InPipe,
+      SubmitGzipMetadataReader<GzipMetadataReaderKernelID<engine_id>, InPipe,
                                GzipMetadataToHuffmanPipe>(
-          q, in_count, hdr_data_out, crc_out, count_out);
+          q, in_count, hdr_data_out, crc_out, count_out, deps);
   auto huffman_event =
-      SubmitHuffmanDecoder<HuffmanDecoderKernelID, GzipMetadataToHuffmanPipe,
-                           HuffmanToLZ77Pipe>(q);
+      SubmitHuffmanDecoder<HuffmanDecoderKernelID<engine_id>,
+                           GzipMetadataToHuffmanPipe, HuffmanToLZ77Pipe>(
+          q, deps);
 
   // the design only needs a ByteStacker kernel when literals_per_cycle > 1
   if constexpr (literals_per_cycle > 1) {
     using LZ77ToByteStackerPipe =
-        sycl::ext::intel::pipe<LZ77ToByteStackerPipeID,
+        sycl::ext::intel::pipe<LZ77ToByteStackerPipeID<engine_id>,
                                FlagBundle<BytePack<literals_per_cycle>>>;
 
     auto lz77_event =
-        SubmitLZ77Decoder<LZ77DecoderKernelID, HuffmanToLZ77Pipe,
+        SubmitLZ77Decoder<LZ77DecoderKernelID<engine_id>, HuffmanToLZ77Pipe,
                           LZ77ToByteStackerPipe, literals_per_cycle,
-                          kGzipMaxLZ77Distance, kGzipMaxLZ77Length>(q);
+                          kGzipMaxLZ77Distance, kGzipMaxLZ77Length>(q, deps);
     auto byte_stacker_event =
-        SubmitByteStacker<ByteStackerKernelID, LZ77ToByteStackerPipe, OutPipe,
-                          literals_per_cycle>(q);
+        SubmitByteStacker<ByteStackerKernelID<engine_id>,
+                          LZ77ToByteStackerPipe, OutPipe, literals_per_cycle>(
+            q, deps);
 
     return {header_event, huffman_event, lz77_event, byte_stacker_event};
   } else {
     auto lz77_event =
-        SubmitLZ77Decoder<LZ77DecoderKernelID, HuffmanToLZ77Pipe, OutPipe,
-                          literals_per_cycle, kGzipMaxLZ77Distance,
-                          kGzipMaxLZ77Length>(q);
+        SubmitLZ77Decoder<LZ77DecoderKernelID<engine_id>, HuffmanToLZ77Pipe,
+                          OutPipe, literals_per_cycle, kGzipMaxLZ77Distance,
+                          kGzipMaxLZ77Length>(q, deps);
     return {header_event, huffman_event, lz77_event};
   }
 }
 
 // declare kernel and pipe names at the global scope to reduce name mangling
+template <unsigned engine_id>
 class ProducerId;
+template <unsigned engine_id>
 class ConsumerId;
+template <unsigned engine_id>
 class InPipeId;
+template <unsigned engine_id>
 class OutPipeId;
 
-// the input and output pipe
-using InPipe = sycl::ext::intel::pipe<InPipeId, ByteSet<1>>;
-using OutPipe =
-    sycl::ext::intel::pipe<OutPipeId, FlagBundle<BytePack<kLiteralsPerCycle>>>;
+// the input and output pipe of each engine
+template <unsigned engine_id>
+using EngineInPipe = sycl::ext::intel::pipe<InPipeId<engine_id>, ByteSet<1>>;
+template <unsigned engine_id>
+using EngineOutPipe =
+    sycl::ext::intel::pipe<OutPipeId<engine_id>,
+                           FlagBundle<BytePack<kLiteralsPerCycle>>>;
+
+// the input and output pipe of the first engine, which is used for single
+// member files
+using InPipe = EngineInPipe<0>;
+using OutPipe = EngineOutPipe<0>;
 
 //
 // The GZIP decompressor. See ../common/common.hpp for more information.
+// 'num_engines' engines are instantiated. The members of a multi-member GZIP
+// file are spread over them and decompressed in parallel.
 //
-template <unsigned literals_per_cycle>
+template <unsigned literals_per_cycle, unsigned num_engines = 1>
 class GzipDecompressor : public DecompressorBase {
+  static_assert(num_engines > 0);
+
  public:
   std::optional<std::vector<unsigned char>> DecompressBytes(
       sycl::queue &q, std::vector<unsigned char> &in_bytes, int runs,
       bool print_stats) {
     int in_count = in_bytes.size();
 
+    // Multi-member files take a separate path that decompresses the members
+    // in parallel. Finding the members walks the DEFLATE blocks on the host,
+    // so it is only done when a cheap check finds that the file may have more
+    // than one member.
+    if (MayHaveMultipleGzipMembers(in_bytes)) {
+      auto members = IndexGzipMembers(in_bytes);
+      if (members == std::nullopt) {
+        return {};
+      }
+      if (members.value().size() > 1) {
+        return DecompressMembers(q, in_bytes, members.value(), runs,
+                                 print_stats);
+      }
+    }
+
     // read the expected output size from the last 4 bytes of the file
     std::vector<unsigned char> last_4_bytes(in_bytes.end() - 4, in_bytes.end());
     unsigned out_count = *(reinterpret_cast<unsigned *>(last_4_bytes.data()));
@@ -189,9 +239,9 @@ class GzipDecompressor : public DecompressorBase {
         std::cout << "Launching kernels for run " << i << std::endl;
 
         auto producer_event =
-            SubmitProducer<ProducerId, InPipe, 1>(q, in_count, in);
+            SubmitProducer<ProducerId<0>, InPipe, 1>(q, in_count, in);
         auto consumer_event =
-            SubmitConsumer<ConsumerId, OutPipe, literals_per_cycle>(
+            SubmitConsumer<ConsumerId<0>, OutPipe, literals_per_cycle>(
                 q, out_count_padded, out);
 
         auto gzip_decompress_events =
@@ -295,6 +345,422 @@ class GzipDecompressor : public DecompressorBase {
       return {};
     }
   }
+
+  std::optional<std::vector<std::vector<unsigned char>>> DecompressBatch(
+      sycl::queue &q, std::vector<std::vector<unsigned char>> &in_batch,
+      int num_slots, BatchStats &stats) {
+    int num_files = in_batch.size();
+    bool passed = true;
+
+    if (num_slots < 1) {
+      std::cerr << "ERROR: 'num_slots' must be greater than 0\n";
+      std::terminate();
+    }
+
+    // read the expected output size of every file from its last 4 bytes, and
+    // find the largest input and output, which set the size of the buffers
+    std::vector<unsigned> out_counts(num_files);
+    std::vector<std::vector<unsigned char>> out_batch(num_files);
+    size_t max_in_count = 1, max_out_count_padded = literals_per_cycle;
+    stats = BatchStats();
+    for (int f = 0; f < num_files; f++) {
+      auto &in_bytes = in_batch[f];
+      if (in_bytes.size() < 18) {
+        std::cerr << "ERROR: file " << f << " is too small to be a GZIP file\n";
+        return {};
+      }
+      out_counts[f] = *(reinterpret_cast<unsigned *>(in_bytes.data() +
+                                                     in_bytes.size() - 4));
+      out_batch[f].resize(out_counts[f]);
+      max_in_count = std::max(max_in_count, in_bytes.size());
+      max_out_count_padded = std::max<size_t>(
+          max_out_count_padded,
+          fpga_tools::RoundUpToMultiple(out_counts[f], literals_per_cycle));
+      stats.in_bytes += in_bytes.size();
+      stats.out_bytes += out_counts[f];
+    }
+    stats.num_files = num_files;
+
+    // the GZIP header and footer data of every file, copied back from the
+    // device and checked once the whole batch is done
+    std::vector<GzipHeaderData> hdr_data_h(num_files);
+    std::vector<unsigned int> crc_h(num_files), count_h(num_files);
+
+    // a set of device buffers for each file in flight
+    std::vector<unsigned char *> in(num_slots), out(num_slots);
+    std::vector<GzipHeaderData *> hdr_data(num_slots);
+    std::vector<int *> crc(num_slots), count(num_slots);
+
+    // the copies back to the host of the last file that used each slot. The
+    // slot can be reused once these are done.
+    std::vector<std::vector<sycl::event>> slot_events(num_slots);
+
+    try {
+      // allocate memory on the device
+      for (int s = 0; s < num_slots; s++) {
+        if ((in[s] = sycl::malloc_device<unsigned char>(max_in_count, q)) ==
+            nullptr) {
+          std::cerr << "ERROR: could not allocate space for 'in'\n";
+          std::terminate();
+        }
+        if ((out[s] = sycl::malloc_device<unsigned char>(max_out_count_padded,
+                                                         q)) == nullptr) {
+          std::cerr << "ERROR: could not allocate space for 'out'\n";
+          std::terminate();
+        }
+        if ((hdr_data[s] = sycl::malloc_device<GzipHeaderData>(1, q)) ==
+            nullptr) {
+          std::cerr << "ERROR: could not allocate space for 'hdr_data'\n";
+          std::terminate();
+        }
+        if ((crc[s] = sycl::malloc_device<int>(1, q)) == nullptr) {
+          std::cerr << "ERROR: could not allocate space for 'crc'\n";
+          std::terminate();
+        }
+        if ((count[s] = sycl::malloc_device<int>(1, q)) == nullptr) {
+          std::cerr << "ERROR: could not allocate space for 'count'\n";
+          std::terminate();
+        }
+      }
+
+      // The kernels of consecutive files are launched back to back, so the
+      // decompression engine starts on the next file as soon as it is done
+      // with the current one. The producer, consumer and decompression
+      // kernels depend on the previous launch of themselves, which keeps the
+      // files in order in the pipes even though the producer also waits for
+      // the copy of its own data.
+      sycl::event producer_event, consumer_event;
+      std::vector<sycl::event> gzip_decompress_events;
+
+      auto s = std::chrono::high_resolution_clock::now();
+      for (int f = 0; f < num_files; f++) {
+        int slot = f % num_slots;
+        int in_count = in_batch[f].size();
+        int out_count_padded =
+            fpga_tools::RoundUpToMultiple(out_counts[f], literals_per_cycle);
+
+        // wait for the last file that used this slot to be copied back
+        for (auto &e : slot_events[slot]) {
+          e.wait();
+        }
+
+        auto copy_in_event =
+            q.memcpy(in[slot], in_batch[f].data(), in_count);
+
+        std::vector<sycl::event> producer_deps = {copy_in_event};
+        std::vector<sycl::event> consumer_deps, gzip_decompress_deps;
+        if (f > 0) {
+          producer_deps.push_back(producer_event);
+          consumer_deps.push_back(consumer_event);
+          gzip_decompress_deps = gzip_decompress_events;
+        }
+
+        producer_event = SubmitProducer<ProducerId<0>, InPipe, 1>(
+            q, in_count, in[slot], producer_deps);
+        consumer_event =
+            SubmitConsumer<ConsumerId<0>, OutPipe, literals_per_cycle>(
+                q, out_count_padded, out[slot], consumer_deps);
+        gzip_decompress_events =
+            SubmitGzipDecompressKernels<InPipe, OutPipe, literals_per_cycle>(
+                q, in_count, hdr_data[slot], crc[slot], count[slot],
+                gzip_decompress_deps);
+
+        // copy the output back as soon as the consumer is done
+        slot_events[slot] = {
+            q.memcpy(out_batch[f].data(), out[slot], out_counts[f],
+                     consumer_event),
+            q.memcpy(&hdr_data_h[f], hdr_data[slot], sizeof(GzipHeaderData),
+                     gzip_decompress_events),
+            q.memcpy(&crc_h[f], crc[slot], sizeof(int),
+                     gzip_decompress_events),
+            q.memcpy(&count_h[f], count[slot], sizeof(int),
+                     gzip_decompress_events)};
+      }
+
+      // wait for the files still in flight
+      for (auto &events : slot_events) {
+        for (auto &e : events) {
+          e.wait();
+        }
+      }
+      auto e = std::chrono::high_resolution_clock::now();
+      stats.time_ms = std::chrono::duration<double, std::milli>(e - s).count();
+    } catch (sycl::exception const &e) {
+      std::cout << "Caught a synchronous SYCL exception: " << e.what() << "\n";
+      std::terminate();
+    }
+
+    // free the allocated device memory
+    for (int s = 0; s < num_slots; s++) {
+      sycl::free(in[s], q);
+      sycl::free(out[s], q);
+      sycl::free(hdr_data[s], q);
+      sycl::free(crc[s], q);
+      sycl::free(count[s], q);
+    }
+
+    // validate the output of every file, see DecompressBytes above
+    for (int f = 0; f < num_files; f++) {
+      if (hdr_data_h[f].MagicNumber() != 0x1f8b) {
+        std::cerr << "ERROR: Incorrect magic header value for file " << f
+                  << "\n";
+        passed = false;
+      }
+      if (count_h[f] != out_counts[f]) {
+        std::cerr << "ERROR: Out counts do not match for file " << f << ": "
+                  << count_h[f] << " != " << out_counts[f] << "\n";
+        passed = false;
+      }
+      if (SimpleCRC32(0, out_batch[f].data(), out_counts[f]) != crc_h[f]) {
+        std::cerr << "ERROR: output data CRC does not match the expected CRC "
+                  << "for file " << f << "\n";
+        passed = false;
+      }
+    }
+
+    if (passed) {
+      return out_batch;
+    } else {
+      return {};
+    }
+  }
+
+ private:
+  //
+  // Decompresses a multi-member GZIP file, given the index of its members
+  // (see gzip_member_index.hpp). Each member is sent to the engine with the
+  // fewest compressed bytes queued so far, and its output is written to its
+  // own region of the output buffer, so the engines run independently. The
+  // members are reassembled in order and the CRC-32 and size of every member
+  // are checked.
+  //
+  std::optional<std::vector<unsigned char>> DecompressMembers(
+      sycl::queue &q, std::vector<unsigned char> &in_bytes,
+      const std::vector<GzipMemberInfo> &members, int runs, bool print_stats) {
+    int num_members = members.size();
+    size_t in_count = in_bytes.size();
+
+    // where the output of each member goes, in the host output and in the
+    // device output buffer. The consumer writes whole 'literals_per_cycle'
+    // words, so each member starts at a padded offset in the device buffer.
+    std::vector<size_t> out_offset(num_members), out_offset_padded(num_members);
+    size_t out_count = 0, out_count_padded = 0;
+    for (int m = 0; m < num_members; m++) {
+      out_offset[m] = out_count;
+      out_offset_padded[m] = out_count_padded;
+      out_count += members[m].out_count;
+      out_count_padded += fpga_tools::RoundUpToMultiple(members[m].out_count,
+                                                        literals_per_cycle);
+    }
+    std::vector<unsigned char> out_bytes(out_count);
+
+    // assign the members to the engines
+    std::vector<unsigned> member_engine(num_members);
+    std::vector<size_t> engine_bytes(num_engines, 0);
+    for (int m = 0; m < num_members; m++) {
+      unsigned engine = 0;
+      for (unsigned e = 1; e < num_engines; e++) {
+        if (engine_bytes[e] < engine_bytes[engine]) engine = e;
+      }
+      member_engine[m] = engine;
+      engine_bytes[engine] += members[m].size;
+    }
+
+    std::cout << "Decompressing " << num_members << " GZIP members on "
+              << num_engines << ((num_engines == 1) ? " engine" : " engines")
+              << std::endl;
+
+    // the GZIP header and footer data of each member, from the device
+    std::vector<GzipHeaderData> hdr_data_h(num_members);
+    std::vector<unsigned int> crc_h(num_members), count_h(num_members);
+
+    // track timing information in ms
+    std::vector<double> time_ms(runs);
+
+    // device memory: the whole input file, the output of every member, and
+    // the header and footer data of every member
+    unsigned char *in, *out;
+    GzipHeaderData *hdr_data;
+    int *crc, *count;
+
+    bool passed = true;
+
+    try {
+      // allocate memory on the device
+      if ((in = sycl::malloc_device<unsigned char>(in_count, q)) == nullptr) {
+        std::cerr << "ERROR: could not allocate space for 'in'\n";
+        std::terminate();
+      }
+      if ((out = sycl::malloc_device<unsigned char>(
+               std::max<size_t>(out_count_padded, literals_per_cycle), q)) ==
+          nullptr) {
+        std::cerr << "ERROR: could not allocate space for 'out'\n";
+        std::terminate();
+      }
+      if ((hdr_data = sycl::malloc_device<GzipHeaderData>(num_members, q)) ==
+          nullptr) {
+        std::cerr << "ERROR: could not allocate space for 'hdr_data'\n";
+        std::terminate();
+      }
+      if ((crc = sycl::malloc_device<int>(num_members, q)) == nullptr) {
+        std::cerr << "ERROR: could not allocate space for 'crc'\n";
+        std::terminate();
+      }
+      if ((count = sycl::malloc_device<int>(num_members, q)) == nullptr) {
+        std::cerr << "ERROR: could not allocate space for 'count'\n";
+        std::terminate();
+      }
+
+      // copy the input data to the device memory and wait for the copy to
+      // finish
+      q.memcpy(in, in_bytes.data(), in_count * sizeof(unsigned char)).wait();
+
+      // run the design multiple times to increase the accuracy of the timing
+      for (int i = 0; i < runs; i++) {
+        std::cout << "Launching kernels for run " << i << std::endl;
+
+        std::vector<sycl::event> events;
+        auto s = std::chrono::high_resolution_clock::now();
+
+        // The queue is out of order, so each launch of a kernel of an engine
+        // depends on the previous launch of the same kernel on that engine.
+        // Otherwise the data of two members could interleave in the pipes of
+        // the engine. The members sent to one engine are decompressed one
+        // after the other, and different engines run in parallel.
+        std::vector<sycl::event> producer_event(num_engines),
+            consumer_event(num_engines);
+        std::vector<std::vector<sycl::event>> gzip_decompress_events(
+            num_engines);
+        std::vector<bool> engine_used(num_engines, false);
+
+        for (int m = 0; m < num_members; m++) {
+          int member_in_count = members[m].size;
+          unsigned member_out_count_padded = fpga_tools::RoundUpToMultiple(
+              members[m].out_count, literals_per_cycle);
+
+          // the engine is a template parameter, so pick it from the list of
+          // engines at compile time
+          fpga_tools::UnrolledLoop<num_engines>([&](auto engine) {
+            if (member_engine[m] == engine) {
+              std::vector<sycl::event> producer_deps, consumer_deps,
+                  gzip_decompress_deps;
+              if (engine_used[engine]) {
+                producer_deps.push_back(producer_event[engine]);
+                consumer_deps.push_back(consumer_event[engine]);
+                gzip_decompress_deps = gzip_decompress_events[engine];
+              }
+              engine_used[engine] = true;
+
+              producer_event[engine] =
+                  SubmitProducer<ProducerId<engine>, EngineInPipe<engine>, 1>(
+                      q, member_in_count, in + members[m].offset,
+                      producer_deps);
+              consumer_event[engine] =
+                  SubmitConsumer<ConsumerId<engine>, EngineOutPipe<engine>,
+                                 literals_per_cycle>(
+                      q, member_out_count_padded, out + out_offset_padded[m],
+                      consumer_deps);
+              gzip_decompress_events[engine] =
+                  SubmitGzipDecompressKernels<EngineInPipe<engine>,
+                                              EngineOutPipe<engine>,
+                                              literals_per_cycle, engine>(
+                      q, member_in_count, hdr_data + m, crc + m, count + m,
+                      gzip_decompress_deps);
+
+              events.push_back(producer_event[engine]);
+              events.push_back(consumer_event[engine]);
+              events.insert(events.end(),
+                            gzip_decompress_events[engine].begin(),
+                            gzip_decompress_events[engine].end());
+            }
+          });
+        }
+
+        for (auto &e : events) {
+          e.wait();
+        }
+        auto e = std::chrono::high_resolution_clock::now();
+
+        std::cout << "All kernels have finished for run " << i << std::endl;
+
+        // duration in milliseconds
+        time_ms[i] = std::chrono::duration<double, std::milli>(e - s).count();
+
+        // copy the output of every member back to its place in the output
+        for (int m = 0; m < num_members; m++) {
+          q.memcpy(out_bytes.data() + out_offset[m], out + out_offset_padded[m],
+                   members[m].out_count);
+        }
+        q.memcpy(hdr_data_h.data(), hdr_data,
+                 num_members * sizeof(GzipHeaderData));
+        q.memcpy(crc_h.data(), crc, num_members * sizeof(int));
+        q.memcpy(count_h.data(), count, num_members * sizeof(int));
+        q.wait();
+
+        // validate the output of every member, see DecompressBytes
+        for (int m = 0; m < num_members; m++) {
+          if (hdr_data_h[m].MagicNumber() != 0x1f8b) {
+            std::cerr << "ERROR: Incorrect magic header value for member " << m
+                      << "\n";
+            passed = false;
+          }
+          if (count_h[m] != members[m].out_count) {
+            std::cerr << "ERROR: Out counts do not match for member " << m
+                      << ": " << count_h[m] << " != " << members[m].out_count
+                      << "\n";
+            passed = false;
+          }
+          auto crc32_out = SimpleCRC32(0, out_bytes.data() + out_offset[m],
+                                       members[m].out_count);
+          if (crc32_out != crc_h[m]) {
+            std::cerr << "ERROR: output data CRC does not match the expected "
+                      << "CRC for member " << m << "\n";
+            passed = false;
+          }
+        }
+      }
+    } catch (sycl::exception const &e) {
+      std::cout << "Caught a synchronous SYCL exception: " << e.what() << "\n";
+      std::terminate();
+    }
+
+    // free the allocated device memory
+    sycl::free(in, q);
+    sycl::free(out, q);
+    sycl::free(hdr_data, q);
+    sycl::free(crc, q);
+    sycl::free(count, q);
+
+    // print the performance results
+    if (passed && print_stats) {
+      // NOTE: when run in emulation, these results do not accurately represent
+      // the performance of the kernels on real FPGA hardware
+      double avg_time_ms;
+      if (runs > 1) {
+        avg_time_ms = std::accumulate(time_ms.begin() + 1, time_ms.end(), 0.0) /
+                      (runs - 1);
+      } else {
+        avg_time_ms = time_ms[0];
+      }
+
+      double compression_ratio = (double)(out_count) / (double)(in_count);
+
+      // the number of output megabytes
+      double out_mb = out_count * sizeof(unsigned char) * 1e-6;
+
+      std::cout << "Execution time: " << avg_time_ms << " ms\n";
+      std::cout << "Output Throughput: " << (out_mb / (avg_time_ms * 1e-3))
+                << " MB/s\n";
+      std::cout << "Compression Ratio: " << compression_ratio << ":1"
+                << "\n";
+    }
+
+    if (passed) {
+      return out_bytes;
+    } else {
+      return {};
+    }
+  }
 };
 
-#endif /* __GZIP_DECOMPRESSOR_HPP__ */
\ No newline at end of file
+#endif /* __GZIP_DECOMPRESSOR_HPP__ */
\ No newline at end of file
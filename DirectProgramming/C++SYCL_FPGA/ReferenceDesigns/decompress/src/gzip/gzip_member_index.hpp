@@ -0,0 +1,378 @@
+#ifndef __GZIP_MEMBER_INDEX_HPP__
+#define __GZIP_MEMBER_INDEX_HPP__
+
+#include <cstring>
+#include <iostream>
+#include <optional>
+#include <vector>
+
+//
+// A GZIP file is a series of one or more members, each with its own header,
+// DEFLATE data and footer (e.g., 'cat a.gz b.gz > c.gz', or the output of
+// parallel compressors such as pigz and bgzip). The members are independent,
+// so they can be decompressed in parallel once we know where each one starts.
+//
+// This file builds that index on the host. A member does not store its
+// compressed size, so in general the only way to find where a member ends is
+// to walk its DEFLATE blocks. Files written by bgzip (BGZF) store the size of
+// every member in a 'BC' extra field of the header, which is used instead
+// when present. Most files have a single member, so MayHaveMultipleGzipMembers
+// first checks cheaply whether walking the blocks is needed at all.
+//
+
+//
+// The location and footer data of a member in a GZIP file
+//
+struct GzipMemberInfo {
+  size_t offset;       // offset of the member's header in the file
+  size_t size;         // compressed size, including the header and footer
+  unsigned crc;        // the CRC-32 from the member's footer
+  unsigned out_count;  // the uncompressed size from the member's footer
+};
+
+namespace gzip_member_index_detail {
+
+//
+// Parses the GZIP header starting at 'pos' and returns its length, or 0 if
+// it is not a valid header. 'bgzf_size' is set to the size of the member if
+// the header has a BGZF 'BC' extra field, and to 0 otherwise.
+//
+size_t ParseHeader(const std::vector<unsigned char>& in, size_t pos,
+                   size_t& bgzf_size) {
+  bgzf_size = 0;
+  size_t n = in.size();
+  if (pos + 10 > n || in[pos] != 0x1f || in[pos + 1] != 0x8b ||
+      in[pos + 2] != 8 || (in[pos + 3] & 0xE0) != 0) {
+    return 0;
+  }
+  unsigned char flags = in[pos + 3];
+  size_t i = pos + 10;
+
+  // FEXTRA
+  if (flags & 0x04) {
+    if (i + 2 > n) return 0;
+    size_t xlen = in[i] | (in[i + 1] << 8);
+    i += 2;
+    if (i + xlen > n) return 0;
+
+    // look for the BGZF subfield: SI1='B', SI2='C', SLEN=2, BSIZE
+    size_t j = i;
+    while (j + 4 <= i + xlen) {
+      size_t slen = in[j + 2] | (in[j + 3] << 8);
+      if (in[j] == 'B' && in[j + 1] == 'C' && slen == 2 &&
+          j + 6 <= i + xlen) {
+        bgzf_size = (in[j + 4] | (in[j + 5] << 8)) + 1;
+      }
+      j += 4 + slen;
+    }
+    i += xlen;
+  }
+
+  // FNAME and FCOMMENT, null-terminated strings
+  for (unsigned char flag : {0x08, 0x10}) {
+    if (flags & flag) {
+      while (i < n && in[i] != 0) i++;
+      if (i == n) return 0;
+      i++;
+    }
+  }
+
+  // FHCRC
+  if (flags & 0x02) i += 2;
+
+  return (i <= n) ? (i - pos) : 0;
+}
+
+//
+// Reads a DEFLATE stream, least significant bit first
+//
+class BitReader {
+ public:
+  BitReader(const std::vector<unsigned char>& in, size_t pos)
+      : in_(in), pos_(pos), bit_buf_(0), bit_count_(0), overrun_(false) {}
+
+  unsigned Bits(int n) {
+    while (bit_count_ < n) {
+      unsigned char b = 0;
+      if (pos_ < in_.size()) {
+        b = in_[pos_];
+      } else {
+        overrun_ = true;
+      }
+      pos_++;
+      bit_buf_ |= (unsigned long long)b << bit_count_;
+      bit_count_ += 8;
+    }
+    unsigned val = bit_buf_ & ((1ULL << n) - 1);
+    bit_buf_ >>= n;
+    bit_count_ -= n;
+    return val;
+  }
+
+  // discard the bits left in the current byte
+  void AlignToByte() {
+    bit_buf_ = 0;
+    bit_count_ = 0;
+  }
+
+  // the offset of the next unread byte (after AlignToByte)
+  size_t Pos() const { return pos_; }
+  void Skip(size_t n) { pos_ += n; }
+  bool Overrun() const { return overrun_ || pos_ > in_.size(); }
+
+ private:
+  const std::vector<unsigned char>& in_;
+  size_t pos_;
+  unsigned long long bit_buf_;
+  int bit_count_;
+  bool overrun_;
+};
+
+//
+// A canonical Huffman code, decoded one bit at a time. This is slow compared
+// to a table based decoder, but the index only needs to skip over symbols.
+//
+struct Huffman {
+  short count[16];  // number of codes of each length
+  short symbol[320];  // symbols ordered by code
+
+  // returns false if the code lengths are over-subscribed
+  bool Build(const unsigned char* lengths, int n) {
+    for (int len = 0; len < 16; len++) count[len] = 0;
+    for (int s = 0; s < n; s++) count[lengths[s]]++;
+    int left = 1;
+    for (int len = 1; len < 16; len++) {
+      left = (left << 1) - count[len];
+      if (left < 0) return false;
+    }
+    short offs[16];
+    offs[1] = 0;
+    for (int len = 1; len < 15; len++) offs[len + 1] = offs[len] + count[len];
+    for (int s = 0; s < n; s++) {
+      if (lengths[s] != 0) symbol[offs[lengths[s]]++] = s;
+    }
+    return true;
+  }
+
+  // returns the next symbol, or -1 on an invalid code
+  int Decode(BitReader& br) const {
+    int code = 0, first = 0, index = 0;
+    for (int len = 1; len < 16; len++) {
+      code |= br.Bits(1);
+      int c = count[len];
+      if (code - c < first) return symbol[index + (code - first)];
+      index += c;
+      first = (first + c) << 1;
+      code <<= 1;
+    }
+    return -1;
+  }
+};
+
+// the extra bits of the length (257..285) and distance (0..29) codes
+constexpr unsigned char kLengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1,
+                                            1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+                                            4, 4, 4, 4, 5, 5, 5, 5, 0};
+constexpr unsigned char kDistExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2,  3,  3,
+                                          4, 4, 5, 5, 6, 6, 7, 7,  8,  8,
+                                          9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+//
+// Skips over the symbols of a Huffman coded block, up to its end of block
+// code. Returns false if the block is invalid.
+//
+bool SkipCodes(BitReader& br, const Huffman& lit_len, const Huffman& dist) {
+  while (true) {
+    int sym = lit_len.Decode(br);
+    if (sym < 0 || sym > 285 || br.Overrun()) return false;
+    if (sym == 256) return true;
+    if (sym > 256) {
+      br.Bits(kLengthExtra[sym - 257]);
+      int dist_sym = dist.Decode(br);
+      if (dist_sym < 0 || dist_sym > 29) return false;
+      br.Bits(kDistExtra[dist_sym]);
+    }
+  }
+}
+
+//
+// Walks the DEFLATE blocks starting at 'pos' up to the end of the last block.
+// Returns the offset of the first byte after the DEFLATE data, or 0 if the
+// data is invalid.
+//
+size_t SkipDeflate(const std::vector<unsigned char>& in, size_t pos) {
+  BitReader br(in, pos);
+  bool last = false;
+
+  // the fixed trees, built once
+  static Huffman fixed_lit_len, fixed_dist;
+  static bool fixed_built = [] {
+    unsigned char lengths[288];
+    for (int s = 0; s < 288; s++) {
+      lengths[s] = (s < 144) ? 8 : (s < 256) ? 9 : (s < 280) ? 7 : 8;
+    }
+    fixed_lit_len.Build(lengths, 288);
+    for (int s = 0; s < 30; s++) lengths[s] = 5;
+    fixed_dist.Build(lengths, 30);
+    return true;
+  }();
+  (void)fixed_built;
+
+  while (!last) {
+    last = br.Bits(1);
+    unsigned type = br.Bits(2);
+
+    if (type == 0) {
+      // stored block: LEN and NLEN, then LEN bytes
+      br.AlignToByte();
+      size_t p = br.Pos();
+      if (p + 4 > in.size()) return 0;
+      unsigned len = in[p] | (in[p + 1] << 8);
+      unsigned nlen = in[p + 2] | (in[p + 3] << 8);
+      if ((len ^ 0xFFFF) != nlen) return 0;
+      br.Skip(4 + len);
+    } else if (type == 1) {
+      if (!SkipCodes(br, fixed_lit_len, fixed_dist)) return 0;
+    } else if (type == 2) {
+      // dynamic block: read the code lengths, then skip the codes
+      constexpr unsigned char kOrder[19] = {16, 17, 18, 0, 8,  7, 9,  6, 10, 5,
+                                            11, 4,  12, 3, 13, 2, 14, 1, 15};
+      int hlit = br.Bits(5) + 257;
+      int hdist = br.Bits(5) + 1;
+      int hclen = br.Bits(4) + 4;
+      if (hlit > 286 || hdist > 30) return 0;
+
+      unsigned char lengths[320] = {0};
+      for (int i = 0; i < hclen; i++) lengths[kOrder[i]] = br.Bits(3);
+      Huffman code_len;
+      if (!code_len.Build(lengths, 19)) return 0;
+
+      int i = 0;
+      while (i < hlit + hdist) {
+        int sym = code_len.Decode(br);
+        if (sym < 0 || br.Overrun()) return 0;
+        if (sym < 16) {
+          lengths[i++] = sym;
+        } else {
+          unsigned char len = 0;
+          int repeat;
+          if (sym == 16) {
+            if (i == 0) return 0;
+            len = lengths[i - 1];
+            repeat = 3 + br.Bits(2);
+          } else if (sym == 17) {
+            repeat = 3 + br.Bits(3);
+          } else {
+            repeat = 11 + br.Bits(7);
+          }
+          if (i + repeat > hlit + hdist) return 0;
+          while (repeat--) lengths[i++] = len;
+        }
+      }
+
+      Huffman lit_len, dist;
+      if (!lit_len.Build(lengths, hlit) || !dist.Build(lengths + hlit, hdist)) {
+        return 0;
+      }
+      if (!SkipCodes(br, lit_len, dist)) return 0;
+    } else {
+      return 0;
+    }
+
+    if (br.Overrun()) return 0;
+  }
+
+  br.AlignToByte();
+  return br.Pos();
+}
+
+}  // namespace gzip_member_index_detail
+
+//
+// Returns false if the GZIP file certainly has a single member, without
+// decoding it: either its BGZF size covers the whole file, or the GZIP magic
+// bytes do not appear again after its header. A true result can be a false
+// positive, since the magic bytes can also occur in the DEFLATE data, and
+// IndexGzipMembers then finds the actual members.
+//
+bool MayHaveMultipleGzipMembers(const std::vector<unsigned char>& in_bytes) {
+  using namespace gzip_member_index_detail;
+  size_t bgzf_size;
+  size_t hdr_len = ParseHeader(in_bytes, 0, bgzf_size);
+  if (hdr_len == 0) {
+    // not a valid GZIP file, the single member path reports the error
+    return false;
+  }
+  if (bgzf_size != 0) {
+    return bgzf_size < in_bytes.size();
+  }
+
+  // look for the ID1, ID2 and CM bytes of another member's header
+  const unsigned char* p = in_bytes.data() + hdr_len;
+  const unsigned char* end = in_bytes.data() + in_bytes.size();
+  while (p < end && (p = static_cast<const unsigned char*>(
+                         memchr(p, 0x1f, end - p))) != nullptr) {
+    if (end - p >= 10 && p[1] == 0x8b && p[2] == 8) return true;
+    p++;
+  }
+  return false;
+}
+
+//
+// Builds the index of the members in a GZIP file. Returns an empty optional
+// if the file is not a valid (possibly multi-member) GZIP file.
+//
+std::optional<std::vector<GzipMemberInfo>> IndexGzipMembers(
+    const std::vector<unsigned char>& in_bytes) {
+  using namespace gzip_member_index_detail;
+  std::vector<GzipMemberInfo> members;
+  size_t pos = 0;
+  size_t n = in_bytes.size();
+
+  while (pos < n) {
+    size_t bgzf_size;
+    size_t hdr_len = ParseHeader(in_bytes, pos, bgzf_size);
+    if (hdr_len == 0) {
+      // gzip ignores trailing zero padding after the last member
+      bool all_zero = !members.empty();
+      for (size_t i = pos; i < n && all_zero; i++) all_zero = in_bytes[i] == 0;
+      if (all_zero) break;
+      std::cerr << "ERROR: invalid GZIP header at offset " << pos << "\n";
+      return {};
+    }
+
+    // the end of the member: from the BGZF field, or by walking the blocks
+    size_t end;
+    if (bgzf_size != 0) {
+      end = pos + bgzf_size;
+    } else {
+      size_t deflate_end = SkipDeflate(in_bytes, pos + hdr_len);
+      end = (deflate_end == 0) ? n + 1 : deflate_end + 8;
+    }
+    if (end > n || end < pos + hdr_len + 8) {
+      std::cerr << "ERROR: invalid GZIP member at offset " << pos << "\n";
+      return {};
+    }
+
+    // the footer: CRC-32 and uncompressed size
+    GzipMemberInfo m;
+    m.offset = pos;
+    m.size = end - pos;
+    m.crc = 0;
+    m.out_count = 0;
+    for (int i = 0; i < 4; i++) {
+      m.crc |= (unsigned)in_bytes[end - 8 + i] << (i * 8);
+      m.out_count |= (unsigned)in_bytes[end - 4 + i] << (i * 8);
+    }
+    members.push_back(m);
+    pos = end;
+  }
+
+  if (members.empty()) {
+    std::cerr << "ERROR: no GZIP members found\n";
+    return {};
+  }
+  return members;
+}
+
+#endif /* __GZIP_MEMBER_INDEX_HPP__ */
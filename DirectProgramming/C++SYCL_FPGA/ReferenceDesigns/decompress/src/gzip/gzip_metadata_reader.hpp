@@ -280,10 +280,10 @@ void GzipMetadataReader(int in_count, GzipHeaderData& hdr_data, int& crc,
 // Creates a kernel from the GZIP metadata reader function
 //
 template <typename Id, typename InPipe, typename OutPipe>
-sycl::event SubmitGzipMetadataReader(sycl::queue& q, int in_count,
-                                     GzipHeaderData* hdr_data_ptr, int* crc_ptr,
-                                     int* out_count_ptr) {
-  return q.single_task<Id>([=]() [[intel::kernel_args_restrict]] {
+sycl::event SubmitGzipMetadataReader(
+    sycl::queue& q, int in_count, GzipHeaderData* hdr_data_ptr, int* crc_ptr,
+    int* out_count_ptr, const std::vector<sycl::event>& deps = {}) {
+  return q.single_task<Id>(deps, [=]() [[intel::kernel_args_restrict]] {
     sycl::device_ptr<GzipHeaderData> hdr_data(hdr_data_ptr);
     sycl::device_ptr<int> crc(crc_ptr);
     sycl::device_ptr<int> out_count(out_count_ptr);
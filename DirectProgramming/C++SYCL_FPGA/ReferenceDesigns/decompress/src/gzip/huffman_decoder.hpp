@@ -461,8 +461,9 @@ void HuffmanDecoder() {
 // Creates a kernel from the Huffman decoder function
 //
 template <typename Id, typename InPipe, typename OutPipe>
-sycl::event SubmitHuffmanDecoder(sycl::queue& q) {
-  return q.single_task<Id>([=] {
+sycl::event SubmitHuffmanDecoder(sycl::queue& q,
+                                 const std::vector<sycl::event>& deps = {}) {
+  return q.single_task<Id>(deps, [=] {
     HuffmanDecoder<InPipe, OutPipe>();
   });
 }
@@ -2,6 +2,7 @@
 #include <algorithm>
 #include <array>
 #include <fstream>
+#include <iomanip>
 #include <limits>
 #include <numeric>
 #include <optional>
@@ -46,8 +47,21 @@ constexpr unsigned kLiteralsPerCycle = LITERALS_PER_CYCLE;
 static_assert(kLiteralsPerCycle > 0);
 static_assert(fpga_tools::IsPow2(kLiteralsPerCycle));
 
+// the number of GZIP decompression engines can be set from the command line
+// use the macro -DGZIP_ENGINES=<num_engines>
+// The members of a multi-member GZIP file are decompressed in parallel by the
+// engines. Each engine is a full copy of the GZIP decompression kernels.
+#if defined(GZIP)
+#if not defined(GZIP_ENGINES)
+#define GZIP_ENGINES 1
+#endif
+constexpr unsigned kGzipEngines = GZIP_ENGINES;
+static_assert(kGzipEngines > 0);
+#endif
+
 // include files and aliases specific to GZIP and SNAPPY decompression
 #if defined(GZIP)
+#include "gzip/gzip_data_gen.hpp"
 #include "gzip/gzip_decompressor.hpp"
 #else
 #include "snappy/snappy_data_gen.hpp"
@@ -56,7 +70,7 @@ static_assert(fpga_tools::IsPow2(kLiteralsPerCycle));
 
 // aliases and testing functions specific to GZIP and SNAPPY decompression
 #if defined(GZIP)
-using GzipDecompressorT = GzipDecompressor<kLiteralsPerCycle>;
+using GzipDecompressorT = GzipDecompressor<kLiteralsPerCycle, kGzipEngines>;
 bool RunGzipTest(sycl::queue& q, GzipDecompressorT decompressor,
                  const std::string test_dir);
 std::string decompressor_name = "GZIP";
@@ -66,6 +80,8 @@ bool RunSnappyTest(sycl::queue& q, SnappyDecompressorT decompressor,
                    const std::string test_dir);
 std::string decompressor_name = "SNAPPY";
 #endif
+bool RunBatchTest(sycl::queue& q, DecompressorBase& decompressor,
+                  int files_per_size);
 
 using namespace sycl;
 
@@ -73,7 +89,8 @@ using namespace sycl;
 void PrintUsage(std::string exe_name) {
   std::cerr << "USAGE: \n"
             << exe_name << " <input filename> <output filename> [runs]\n"
-            << exe_name << " <test directory>" << std::endl;
+            << exe_name << " <test directory>\n"
+            << exe_name << " --batch [files per size]" << std::endl;
 }
 
 int main(int argc, char* argv[]) {
@@ -92,15 +109,37 @@ int main(int argc, char* argv[]) {
   std::string out_filename;
   int runs;
   bool default_test_mode = false;
+  bool batch_test_mode = false;
+
+  // default the number of files of each size for the batch test
+#if defined(FPGA_EMULATOR)
+  int files_per_size = 16;
+#elif defined(FPGA_SIMULATOR)
+  int files_per_size = 2;
+#else
+  int files_per_size = 1000;
+#endif
 
-  if (argc == 1 || argc == 2) {
+  if (argc > 1 && std::string(argv[1]) == "--batch") {
+    batch_test_mode = true;
+    if (argc > 3) {
+      PrintUsage(argv[0]);
+      return 1;
+    }
+  } else if (argc == 1 || argc == 2) {
     default_test_mode = true;
   } else if (argc > 4) {
     PrintUsage(argv[0]);
     return 1;
   }
 
-  if (default_test_mode) {
+  if (batch_test_mode) {
+    if (argc > 2) files_per_size = atoi(argv[2]);
+    if (files_per_size < 1) {
+      std::cerr << "ERROR: 'files per size' must be greater than 0\n";
+      std::terminate();
+    }
+  } else if (default_test_mode) {
     if (argc > 1) test_dir = argv[1];
   } else {
     // default the number of runs based on emulation, simulation, or hardware
@@ -145,7 +184,9 @@ int main(int argc, char* argv[]) {
 
   // perform the test or single file decompression
   bool passed;
-  if (default_test_mode) {
+  if (batch_test_mode) {
+    passed = RunBatchTest(q, decompressor, files_per_size);
+  } else if (default_test_mode) {
 #if defined(GZIP)
     passed = RunGzipTest(q, decompressor, test_dir);
 #else
@@ -203,6 +244,24 @@ bool RunGzipTest(sycl::queue& q, GzipDecompressorT decompressor,
   PrintTestResults("Dynamically Compressed File Test", dynamic_test_pass);
   std::cout << std::endl;
 
+  std::cout << ">>>>> Multi-Member File Test <<<<<" << std::endl;
+  // concatenate members of different sizes, like 'cat a.gz b.gz > c.gz'
+  std::vector<unsigned char> multi_member_bytes;
+  unsigned multi_member_out_count = 0;
+  for (unsigned repeats : {1, 40, 3, 17, 1, 64, 8, 2}) {
+    auto member = GenerateGzipCompressedData(512, 1, 256, 2, repeats);
+    multi_member_bytes.insert(multi_member_bytes.end(), member.begin(),
+                              member.end());
+    multi_member_out_count += repeats * 1024;
+  }
+  auto multi_member_ret =
+      decompressor.DecompressBytes(q, multi_member_bytes, 1, false);
+  bool multi_member_test_pass =
+      (multi_member_ret != std::nullopt) &&
+      (multi_member_ret.value().size() == multi_member_out_count);
+  PrintTestResults("Multi-Member File Test", multi_member_test_pass);
+  std::cout << std::endl;
+
   std::cout << ">>>>> Throughput Test <<<<<" << std::endl;
   constexpr int kTPTestRuns = 5;
   bool tp_test_pass = decompressor.DecompressFile(q, tp_test_filename, "",
@@ -211,7 +270,7 @@ bool RunGzipTest(sycl::queue& q, GzipDecompressorT decompressor,
   std::cout << std::endl;
 
   return uncompressed_test_pass && static_test_pass && dynamic_test_pass &&
-         tp_test_pass;
+         multi_member_test_pass && tp_test_pass;
 }
 #endif
 
@@ -268,3 +327,92 @@ bool RunSnappyTest(sycl::queue& q, SnappyDecompressorT decompressor,
   return test1_pass && test2_pass && test3_pass && test_tp_pass;
 }
 #endif
+
+//
+// Generates a compressed file of 'size' uncompressed bytes (rounded up to a
+// multiple of 1 KB) made of alternating literal strings and copies, which
+// compresses about 2:1. The uncompressed data is written to 'uncompressed'.
+//
+std::vector<unsigned char> GenerateBatchTestFile(
+    unsigned size, std::vector<unsigned char>& uncompressed) {
+  unsigned repeats = std::max(1U, size / 1024);
+#if defined(GZIP)
+  return GenerateGzipCompressedData(512, 1, 256, 2, repeats, &uncompressed);
+#else
+  return GenerateSnappyCompressedData(512, 1, 64, 8, repeats, &uncompressed);
+#endif
+}
+
+//
+// Decompresses batches of 'files_per_size' independent files for a range of
+// file sizes, one file at a time (a single slot, so nothing overlaps) and
+// with kDefaultBatchSlots files in flight, and reports the throughput of both
+// in files/s and GB/s of decompressed data.
+//
+bool RunBatchTest(sycl::queue& q, DecompressorBase& decompressor,
+                  int files_per_size) {
+  constexpr unsigned kFileSizes[] = {1 << 10,  4 << 10,   16 << 10,
+                                     64 << 10, 256 << 10, 1 << 20};
+
+  std::cout << ">>>>> Batch Throughput Test <<<<<" << std::endl;
+  std::cout << files_per_size << " files per size, " << kDefaultBatchSlots
+            << " files in flight when batched\n";
+  std::cout << std::setw(10) << "file size" << std::setw(18) << "serial files/s"
+            << std::setw(14) << "serial GB/s" << std::setw(18)
+            << "batched files/s" << std::setw(14) << "batched GB/s"
+            << std::setw(10) << "speedup" << std::endl;
+
+  bool passed = true;
+  for (auto size : kFileSizes) {
+    // the files are independent, but generating one and copying it is enough
+    // for a throughput test
+    std::vector<unsigned char> ref_bytes;
+    std::vector<std::vector<unsigned char>> in_batch(
+        files_per_size, GenerateBatchTestFile(size, ref_bytes));
+
+    BatchStats serial_stats, batched_stats;
+    auto serial_ret =
+        decompressor.DecompressBatch(q, in_batch, 1, serial_stats);
+    auto batched_ret = decompressor.DecompressBatch(
+        q, in_batch, kDefaultBatchSlots, batched_stats);
+
+    // both runs must succeed and every file must decompress to the data
+    // the generator produced
+    if (serial_ret == std::nullopt || batched_ret == std::nullopt) {
+      std::cerr << "ERROR: batch decompression of " << size
+                << " byte files failed\n";
+      passed = false;
+      continue;
+    }
+
+    auto matches_ref = [&](const std::vector<std::vector<unsigned char>>& out) {
+      return out.size() == in_batch.size() &&
+             std::all_of(out.begin(), out.end(),
+                         [&](const std::vector<unsigned char>& file) {
+                           return file == ref_bytes;
+                         });
+    };
+    if (!matches_ref(serial_ret.value()) || !matches_ref(batched_ret.value())) {
+      std::cerr << "ERROR: batch decompression of " << size
+                << " byte files does not match the uncompressed data\n";
+      passed = false;
+      continue;
+    }
+
+    // NOTE: when run in emulation, these results do not accurately represent
+    // the performance of the kernels on real FPGA hardware
+    auto save_flags = std::cout.flags();
+    std::cout << std::fixed << std::setprecision(3) << std::setw(10) << size
+              << std::setw(18) << serial_stats.FilesPerSecond() << std::setw(14)
+              << serial_stats.OutputGBPerSecond() << std::setw(18)
+              << batched_stats.FilesPerSecond() << std::setw(14)
+              << batched_stats.OutputGBPerSecond() << std::setw(10)
+              << (serial_stats.time_ms / batched_stats.time_ms) << std::endl;
+    std::cout.flags(save_flags);
+  }
+
+  PrintTestResults("Batch Throughput Test", passed);
+  std::cout << std::endl;
+
+  return passed;
+}
@@ -1,20 +1,21 @@
 #ifndef __SNAPPY_DATA_GEN_HPP__
 #define __SNAPPY_DATA_GEN_HPP__
 
+#include <algorithm>
 #include <vector>
 
 //
 // A function to generate compressed Snappy data for testing purposes.
 // Generates a file as follows:
 //    'num_lit_strs' literal strings of length 'lit_str_len'
-//    'num_copies' of length 'copy_len' and offset max(16k, lit_str_len)
+//    'num_copies' of length 'copy_len' and offset min(16k - 1, lit_str_len)
 //    'repeat' copies of the above.
+// If 'uncompressed_out' is not null, the uncompressed data is written to it.
 //
-std::vector<unsigned char> GenerateSnappyCompressedData(unsigned lit_str_len,
-                                                        unsigned num_lit_strs,
-                                                        unsigned copy_len,
-                                                        unsigned num_copies,
-                                                        unsigned repeats) {
+std::vector<unsigned char> GenerateSnappyCompressedData(
+    unsigned lit_str_len, unsigned num_lit_strs, unsigned copy_len,
+    unsigned num_copies, unsigned repeats,
+    std::vector<unsigned char>* uncompressed_out = nullptr) {
   // error checking the input arguments
   if (lit_str_len <= 0) {
     std::cerr << "ERROR: 'lit_str_len' must be greater than 0" << std::endl;
@@ -44,6 +45,7 @@ std::vector<unsigned char> GenerateSnappyCompressedData(unsigned lit_str_len,
       (lit_str_len * num_lit_strs + copy_len * num_copies) * repeats;
 
   std::vector<unsigned char> ret;
+  std::vector<unsigned char> uncompressed;
 
   // the "smart" data we will fill our dummy buffer with ... ;)
   constexpr unsigned char dummy_alphabet[] = {'I', 'N', 'T', 'E', 'L'};
@@ -134,7 +136,9 @@ std::vector<unsigned char> GenerateSnappyCompressedData(unsigned lit_str_len,
 
       // write the literals following the literal tag byte
       for (int k = 0; k < lit_str_len; k++) {
-        ret.push_back(dummy_alphabet[k % dummy_alphabet_count]);
+        auto c = dummy_alphabet[k % dummy_alphabet_count];
+        ret.push_back(c);
+        uncompressed.push_back(c);
       }
     }
 
@@ -145,14 +149,22 @@ std::vector<unsigned char> GenerateSnappyCompressedData(unsigned lit_str_len,
       unsigned char tag_byte = ((copy_len - 1) << 2) | copy_tag_type;
       ret.push_back(tag_byte);
 
-      // the extra 2 bytes for the offset
-      unsigned offset = std::min(16383U, lit_str_len - 1);
+      // the extra 2 bytes for the offset, as a little-endian integer
+      unsigned offset = std::min(16383U, lit_str_len);
       auto offset_bytes = unsigned_to_byte_array(offset);
-      ret.push_back(offset_bytes[1]);
       ret.push_back(offset_bytes[0]);
+      ret.push_back(offset_bytes[1]);
+
+      for (int k = 0; k < copy_len; k++) {
+        uncompressed.push_back(uncompressed[uncompressed.size() - offset]);
+      }
     }
   }
 
+  if (uncompressed_out != nullptr) {
+    *uncompressed_out = std::move(uncompressed);
+  }
+
   return ret;
 }
 
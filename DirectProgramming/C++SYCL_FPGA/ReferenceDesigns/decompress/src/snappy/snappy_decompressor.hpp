@@ -115,22 +115,7 @@ class SnappyDecompressor : public DecompressorBase {
 
     // read the expected output size from the start of the file
     // this is used to size the output buffer
-    unsigned out_count = 0;
-    unsigned byte_idx = 0;
-    unsigned shift = 0;
-    bool keep_reading_preamble = true;
-    while (keep_reading_preamble) {
-      if (byte_idx > 4) {
-        std::cerr << "ERROR: uncompressed length should not span more than 5"
-                  << " bytes\n";
-        std::terminate();
-      }
-      auto b = in_bytes[byte_idx];
-      keep_reading_preamble = (b >> 7) & 0x1;
-      out_count |= (b & 0x7F) << shift;
-      shift += 7;
-      byte_idx += 1;
-    }
+    unsigned out_count = ReadPreambleCount(in_bytes);
 
     std::vector<unsigned char> out_bytes(out_count);
 
@@ -258,6 +243,178 @@ class SnappyDecompressor : public DecompressorBase {
       return {};
     }
   }
+
+  std::optional<std::vector<std::vector<unsigned char>>> DecompressBatch(
+      sycl::queue& q, std::vector<std::vector<unsigned char>>& in_batch,
+      int num_slots, BatchStats& stats) {
+    int num_files = in_batch.size();
+    bool passed = true;
+
+    if (num_slots < 1) {
+      std::cerr << "ERROR: 'num_slots' must be greater than 0\n";
+      std::terminate();
+    }
+
+    // read the expected output size of every file from its preamble, and find
+    // the largest input and output, which set the size of the buffers
+    std::vector<unsigned> out_counts(num_files);
+    std::vector<std::vector<unsigned char>> out_batch(num_files);
+    size_t max_in_count_padded = kLiteralsPerCycle;
+    size_t max_out_count_padded = kLiteralsPerCycle;
+    stats = BatchStats();
+    for (int f = 0; f < num_files; f++) {
+      unsigned in_count = in_batch[f].size();
+      out_counts[f] = ReadPreambleCount(in_batch[f]);
+      out_batch[f].resize(out_counts[f]);
+      max_in_count_padded = std::max<size_t>(
+          max_in_count_padded,
+          fpga_tools::RoundUpToMultiple(in_count, kLiteralsPerCycle));
+      max_out_count_padded = std::max<size_t>(
+          max_out_count_padded,
+          fpga_tools::RoundUpToMultiple(out_counts[f], kLiteralsPerCycle));
+      stats.in_bytes += in_count;
+      stats.out_bytes += out_counts[f];
+    }
+    stats.num_files = num_files;
+
+    // the uncompressed size read by the device for every file, copied back and
+    // checked once the whole batch is done
+    std::vector<unsigned> preamble_count_host(num_files);
+
+    // a set of device buffers for each file in flight
+    std::vector<unsigned char*> in(num_slots), out(num_slots);
+    std::vector<unsigned*> preamble_count(num_slots);
+
+    // the copies back to the host of the last file that used each slot. The
+    // slot can be reused once these are done.
+    std::vector<std::vector<sycl::event>> slot_events(num_slots);
+
+    try {
+      // allocate memory on the device
+      for (int s = 0; s < num_slots; s++) {
+        if ((in[s] = sycl::malloc_device<unsigned char>(max_in_count_padded,
+                                                        q)) == nullptr) {
+          std::cerr << "ERROR: could not allocate space for 'in'\n";
+          std::terminate();
+        }
+        if ((out[s] = sycl::malloc_device<unsigned char>(max_out_count_padded,
+                                                         q)) == nullptr) {
+          std::cerr << "ERROR: could not allocate space for 'out'\n";
+          std::terminate();
+        }
+        if ((preamble_count[s] = sycl::malloc_device<unsigned>(1, q)) ==
+            nullptr) {
+          std::cerr << "ERROR: could not allocate space for 'preamble_count'\n";
+          std::terminate();
+        }
+      }
+
+      // See GzipDecompressor::DecompressBatch for how the launches of
+      // consecutive files are ordered.
+      sycl::event producer_event, consumer_event;
+
+      auto s = std::chrono::high_resolution_clock::now();
+      for (int f = 0; f < num_files; f++) {
+        int slot = f % num_slots;
+        unsigned in_count = in_batch[f].size();
+        int in_count_padded =
+            fpga_tools::RoundUpToMultiple(in_count, kLiteralsPerCycle);
+        int out_count_padded =
+            fpga_tools::RoundUpToMultiple(out_counts[f], kLiteralsPerCycle);
+
+        // wait for the last file that used this slot to be copied back
+        for (auto& e : slot_events[slot]) {
+          e.wait();
+        }
+
+        auto copy_in_event = q.memcpy(in[slot], in_batch[f].data(), in_count);
+
+        std::vector<sycl::event> producer_deps = {copy_in_event};
+        std::vector<sycl::event> consumer_deps;
+        if (f > 0) {
+          producer_deps.push_back(producer_event);
+          consumer_deps.push_back(consumer_event);
+        }
+
+        producer_event =
+            SubmitProducer<ProducerId, InPipe, literals_per_cycle>(
+                q, in_count_padded, in[slot], producer_deps);
+        consumer_event =
+            SubmitConsumer<ConsumerId, OutPipe, literals_per_cycle>(
+                q, out_count_padded, out[slot], consumer_deps);
+        auto snappy_decompress_events =
+            SubmitSnappyDecompressKernels<InPipe, OutPipe, kLiteralsPerCycle>(
+                q, in_count, preamble_count[slot]);
+
+        // copy the output back as soon as the consumer is done
+        slot_events[slot] = {
+            q.memcpy(out_batch[f].data(), out[slot], out_counts[f],
+                     consumer_event),
+            q.memcpy(&preamble_count_host[f], preamble_count[slot],
+                     sizeof(unsigned), snappy_decompress_events)};
+      }
+
+      // wait for the files still in flight
+      for (auto& events : slot_events) {
+        for (auto& e : events) {
+          e.wait();
+        }
+      }
+      auto e = std::chrono::high_resolution_clock::now();
+      stats.time_ms = std::chrono::duration<double, std::milli>(e - s).count();
+    } catch (sycl::exception const& e) {
+      std::cout << "Caught a synchronous SYCL exception: " << e.what() << "\n";
+      std::terminate();
+    }
+
+    // free the allocated device memory
+    for (int s = 0; s < num_slots; s++) {
+      sycl::free(in[s], q);
+      sycl::free(out[s], q);
+      sycl::free(preamble_count[s], q);
+    }
+
+    // validate the output of every file
+    for (int f = 0; f < num_files; f++) {
+      if (preamble_count_host[f] != out_counts[f]) {
+        std::cerr << "ERROR: Out counts do not match for file " << f << ": "
+                  << preamble_count_host[f] << " != " << out_counts[f] << "\n";
+        passed = false;
+      }
+    }
+
+    if (passed) {
+      return out_batch;
+    } else {
+      return {};
+    }
+  }
+
+ private:
+  //
+  // Reads the uncompressed length, a varint, from the preamble of a Snappy
+  // file. See the README for more information on what a varint is.
+  //
+  static unsigned ReadPreambleCount(
+      const std::vector<unsigned char>& in_bytes) {
+    unsigned out_count = 0;
+    unsigned byte_idx = 0;
+    unsigned shift = 0;
+    bool keep_reading_preamble = true;
+    while (keep_reading_preamble) {
+      if (byte_idx > 4 || byte_idx >= in_bytes.size()) {
+        std::cerr << "ERROR: uncompressed length should not span more than 5"
+                  << " bytes\n";
+        std::terminate();
+      }
+      auto b = in_bytes[byte_idx];
+      keep_reading_preamble = (b >> 7) & 0x1;
+      out_count |= (b & 0x7F) << shift;
+      shift += 7;
+      byte_idx += 1;
+    }
+    return out_count;
+  }
 };
 
-#endif /* __SNAPPY_DECOMPRESSOR_HPP__ */
\ No newline at end of file
+#endif /* __SNAPPY_DECOMPRESSOR_HPP__ */
\ No newline at end of file
@@ -1,57 +1,471 @@
 #include "CompareGzip.hpp"
 
-// returns 0 on success, otherwise failure
-int CompareGzipFiles(
-    const std::string
-        &original_file,  // original input file to compare gzip uncompressed
-    const std::string &input_gzfile)  // gzip file to check
-{
-#ifdef _MSC_VER
-  std::cout
-      << "Info: skipping output verification on Windows, no builtin gunzip\n";
-  return 0;
-#else
-  //------------------------------------------------------------------
-  // assume all good to start with.
+#include <string.h>
+
+#include <algorithm>
+#include <fstream>
+#include <utility>
+#include <vector>
+
+#include "crc32.hpp"
+
+//
+// In-process verification of the compressed output
+//
+// Rather than writing the decompressed data out and comparing files, the
+// deflate stream is decoded and every byte is compared against the original
+// data as it is produced. Since the output produced so far is known to be
+// equal to the original, back references are resolved against the original
+// buffer, so no output buffer is needed and the first differing byte is
+// reported with its offset.
+//
+namespace {
+
+// return codes, matching those of the previous gunzip + diff implementation
+constexpr int kVerifyOk = 0;
+constexpr int kVerifyInvalidStream = 3;
+constexpr int kVerifyMismatch = 4;
+constexpr int kVerifyBadTrailer = 5;
+
+constexpr int kMaxCodeBits = 15;  // longest Huffman code in deflate
+constexpr int kNumLitLenCodes = 288;
+constexpr int kNumDistCodes = 32;
+
+// base values and extra bits of the length codes 257..285
+constexpr unsigned short kLengthBase[29] = {
+    3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+    31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+constexpr unsigned char kLengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1,
+                                            1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+                                            4, 4, 4, 4, 5, 5, 5, 5, 0};
+
+// base values and extra bits of the distance codes 0..29
+constexpr unsigned short kDistBase[30] = {
+    1,    2,    3,    4,    5,    7,     9,     13,    17,  25,
+    33,   49,   65,   97,   129,  193,   257,   385,   513, 769,
+    1025, 1537, 2049, 3073, 4097, 6145,  8193, 12289, 16385, 24577};
+constexpr unsigned char kDistExtra[30] = {0, 0, 0, 0, 1, 1, 2,  2,  3,  3,
+                                          4, 4, 5, 5, 6, 6, 7,  7,  8,  8,
+                                          9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+// order in which the code length code lengths are stored in a dynamic block
+constexpr unsigned char kCodeLengthOrder[19] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+//
+// Reads the deflate bit stream, least significant bit first. Reads past the
+// end of the input return zeros; Overrun() tells if that happened.
+//
+class BitReader {
+ public:
+  BitReader(const unsigned char *data, size_t size)
+      : data_(data), size_(size) {}
+
+  uint32_t Peek(int n) {
+    while (count_ < n) {
+      uint64_t byte = (pos_ < size_) ? data_[pos_] : 0;
+      pos_++;
+      bits_ |= byte << count_;
+      count_ += 8;
+    }
+    return (uint32_t)(bits_ & ((1ull << n) - 1));
+  }
+  void Drop(int n) {
+    bits_ >>= n;
+    count_ -= n;
+  }
+  uint32_t Get(int n) {
+    uint32_t v = Peek(n);
+    Drop(n);
+    return v;
+  }
+  void AlignToByte() { Drop(count_ & 7); }
+
+  // bytes of input consumed so far (whole bytes, after AlignToByte)
+  size_t BytePos() const { return pos_ - count_ / 8; }
+  bool Overrun() const { return pos_ * 8 - count_ > size_ * 8; }
+
+ private:
+  const unsigned char *data_;
+  size_t size_;
+  size_t pos_ = 0;
+  uint64_t bits_ = 0;
+  int count_ = 0;
+};
+
+//
+// Canonical Huffman decoder with a single lookup table indexed by the next
+// kMaxCodeBits bits of the stream
+//
+class HuffmanDecoder {
+ public:
+  HuffmanDecoder() : table_(1 << kMaxCodeBits) {}
+
+  // builds the decoder from the code lengths of 'num_symbols' symbols
+  // returns false if the lengths do not describe a valid prefix code
+  bool Build(const unsigned char *lengths, int num_symbols) {
+    int count[kMaxCodeBits + 1] = {0};
+    for (int s = 0; s < num_symbols; s++) {
+      count[lengths[s]]++;
+    }
+    count[0] = 0;
+
+    // reject over-subscribed codes, incomplete codes are allowed (e.g. a
+    // single distance code)
+    int left = 1;
+    for (int len = 1; len <= kMaxCodeBits; len++) {
+      left = (left << 1) - count[len];
+      if (left < 0) return false;
+    }
+
+    int next_code[kMaxCodeBits + 1] = {0};
+    for (int len = 1, code = 0; len <= kMaxCodeBits; len++) {
+      code = (code + count[len - 1]) << 1;
+      next_code[len] = code;
+    }
+
+    std::fill(table_.begin(), table_.end(), 0);
+    for (int s = 0; s < num_symbols; s++) {
+      const int len = lengths[s];
+      if (len == 0) continue;
+
+      // deflate stores Huffman codes most significant bit first
+      unsigned int code = next_code[len]++;
+      unsigned int reversed = 0;
+      for (int b = 0; b < len; b++) {
+        reversed = (reversed << 1) | ((code >> b) & 1);
+      }
+      for (unsigned int i = reversed; i < table_.size(); i += (1u << len)) {
+        table_[i] = (uint32_t)(s << 4) | len;
+      }
+    }
+    return true;
+  }
+
+  // returns the next symbol, or -1 for a bit pattern that is not a code
+  int Decode(BitReader &br) const {
+    const uint32_t entry = table_[br.Peek(kMaxCodeBits)];
+    if (entry == 0) return -1;
+    br.Drop(entry & 0xf);
+    return (int)(entry >> 4);
+  }
+
+ private:
+  std::vector<uint32_t> table_;  // (symbol << 4) | code length, 0 = invalid
+};
+
+//
+// Result of decoding and comparing a stream
+//
+struct VerifyState {
+  const unsigned char *original;
+  size_t original_sz;
+  size_t pos;  // offset in 'original' of the next output byte
+};
+
+// compares the next output byte against the original
+inline bool Emit(VerifyState &st, unsigned char byte) {
+  if (st.pos >= st.original_sz || st.original[st.pos] != byte) {
+    return false;
+  }
+  st.pos++;
+  return true;
+}
+
+// decodes the symbols of a fixed or dynamic Huffman block
+int InflateCodes(BitReader &br, const HuffmanDecoder &lit_len,
+                 const HuffmanDecoder &dist, VerifyState &st) {
+  for (;;) {
+    const int sym = lit_len.Decode(br);
+    if (sym < 0 || br.Overrun()) return kVerifyInvalidStream;
+
+    if (sym < 256) {
+      if (!Emit(st, (unsigned char)sym)) return kVerifyMismatch;
+    } else if (sym == 256) {
+      return kVerifyOk;
+    } else {
+      if (sym > 285) return kVerifyInvalidStream;
+      const size_t len =
+          kLengthBase[sym - 257] + br.Get(kLengthExtra[sym - 257]);
+
+      const int dsym = dist.Decode(br);
+      if (dsym < 0 || dsym >= 30) return kVerifyInvalidStream;
+      const size_t d = kDistBase[dsym] + br.Get(kDistExtra[dsym]);
+      if (d > st.pos || br.Overrun()) return kVerifyInvalidStream;
+
+      // The output so far is equal to the original, so the match is correct
+      // if original[pos + i] == original[pos - d + i] for all i (this holds
+      // for overlapping matches too).
+      if (st.pos + len <= st.original_sz &&
+          memcmp(st.original + st.pos, st.original + st.pos - d, len) == 0) {
+        st.pos += len;
+      } else {
+        // find the offset of the first differing byte
+        for (size_t i = 0; i < len; i++) {
+          if (!Emit(st, st.original[st.pos - d])) return kVerifyMismatch;
+        }
+      }
+    }
+  }
+}
+
+// reads the code lengths of a dynamic block and builds its decoders
+int ReadDynamicTables(BitReader &br, HuffmanDecoder &lit_len,
+                      HuffmanDecoder &dist) {
+  const int hlit = br.Get(5) + 257;
+  const int hdist = br.Get(5) + 1;
+  const int hclen = br.Get(4) + 4;
+  if (hlit > 286 || hdist > 30) return kVerifyInvalidStream;
+
+  unsigned char cl_lengths[19] = {0};
+  for (int i = 0; i < hclen; i++) {
+    cl_lengths[kCodeLengthOrder[i]] = br.Get(3);
+  }
+  HuffmanDecoder cl_decoder;
+  if (!cl_decoder.Build(cl_lengths, 19)) return kVerifyInvalidStream;
 
-  int gzipstatus = 0;
+  unsigned char lengths[kNumLitLenCodes + kNumDistCodes] = {0};
+  for (int i = 0; i < hlit + hdist;) {
+    const int sym = cl_decoder.Decode(br);
+    if (sym < 0 || br.Overrun()) return kVerifyInvalidStream;
 
-  //------------------------------------------------------------------
-  // Create temporary output filename for gunzip
+    if (sym < 16) {
+      lengths[i++] = sym;
+      continue;
+    }
+
+    unsigned char value = 0;
+    int repeat = 0;
+    if (sym == 16) {
+      if (i == 0) return kVerifyInvalidStream;
+      value = lengths[i - 1];
+      repeat = 3 + br.Get(2);
+    } else if (sym == 17) {
+      repeat = 3 + br.Get(3);
+    } else {
+      repeat = 11 + br.Get(7);
+    }
+    if (i + repeat > hlit + hdist) return kVerifyInvalidStream;
+    while (repeat--) {
+      lengths[i++] = value;
+    }
+  }
+
+  // the block must be able to end
+  if (lengths[256] == 0) return kVerifyInvalidStream;
+
+  if (!lit_len.Build(lengths, hlit) || !dist.Build(lengths + hlit, hdist)) {
+    return kVerifyInvalidStream;
+  }
+  return kVerifyOk;
+}
 
-  char tmp_name[] = "/tmp/gzip_fpga.XXXXXX";
-  mkstemp(tmp_name);
-  std::string outputfile = tmp_name;
+// decodes one complete deflate stream (up to and including the final block)
+int InflateCompare(BitReader &br, VerifyState &st) {
+  static const auto fixed = [] {
+    std::pair<HuffmanDecoder, HuffmanDecoder> d;
+    unsigned char lengths[kNumLitLenCodes];
+    for (int s = 0; s < kNumLitLenCodes; s++) {
+      lengths[s] = (s < 144) ? 8 : (s < 256) ? 9 : (s < 280) ? 7 : 8;
+    }
+    d.first.Build(lengths, kNumLitLenCodes);
+    std::fill(lengths, lengths + kNumDistCodes, 5);
+    d.second.Build(lengths, kNumDistCodes);
+    return d;
+  }();
 
-  //------------------------------------------------------------------
-  // Check that the original file and gzipped file exist.
+  HuffmanDecoder lit_len, dist;
+  bool last = false;
+  while (!last) {
+    last = br.Get(1);
+    const int type = br.Get(2);
+    int status = kVerifyOk;
 
-  //------------------------------------------------------------------
-  // gunzip the file produced to stdout, capturing to the temp file.
+    if (type == 0) {
+      // stored block
+      br.AlignToByte();
+      const uint32_t len = br.Get(16);
+      const uint32_t nlen = br.Get(16);
+      if (len != (~nlen & 0xffff)) return kVerifyInvalidStream;
+      for (uint32_t i = 0; i < len && status == kVerifyOk; i++) {
+        const unsigned char byte = br.Get(8);
+        if (br.Overrun()) return kVerifyInvalidStream;
+        if (!Emit(st, byte)) status = kVerifyMismatch;
+      }
+    } else if (type == 1) {
+      status = InflateCodes(br, fixed.first, fixed.second, st);
+    } else if (type == 2) {
+      status = ReadDynamicTables(br, lit_len, dist);
+      if (status == kVerifyOk) status = InflateCodes(br, lit_len, dist, st);
+    } else {
+      status = kVerifyInvalidStream;
+    }
 
-  std::string cmd = "gunzip -c ";
-  cmd += input_gzfile;
-  cmd += " > " + outputfile;
+    if (status != kVerifyOk) return status;
+    if (br.Overrun()) return kVerifyInvalidStream;
+  }
+  return kVerifyOk;
+}
 
-  int gzout = ::system(cmd.c_str());
-  if (gzout != 0) {
-    gzipstatus = 3;
+// prints the outcome of a failed verification
+void Report(int status, const VerifyState &st, size_t compressed_pos) {
+  if (status == kVerifyMismatch) {
+    if (st.pos >= st.original_sz) {
+      std::cout << "Verification failed: decompressed data is longer than the "
+                   "input ("
+                << st.original_sz << " bytes)\n";
+    } else {
+      std::cout << "Verification failed: decompressed data differs from the "
+                   "input at offset "
+                << st.pos << "\n";
+    }
+  } else if (status == kVerifyInvalidStream) {
+    std::cout << "Verification failed: invalid compressed data near byte "
+              << compressed_pos << " (after " << st.pos
+              << " matching bytes)\n";
   }
+}
+
+uint32_t GetUlong(const unsigned char *pc) {
+  return (uint32_t)pc[0] | ((uint32_t)pc[1] << 8) | ((uint32_t)pc[2] << 16) |
+         ((uint32_t)pc[3] << 24);
+}
+
+}  // namespace
 
-  //------------------------------------------------------------------
-  // diff the temp file and the original.
+// returns 0 on success, otherwise failure
+int CompareDeflateBuffer(const char *original, size_t original_sz,
+                         const char *deflate_data, size_t deflate_sz,
+                         uint32_t crc, size_t *mismatch_offset) {
+  VerifyState st{(const unsigned char *)original, original_sz, 0};
+  BitReader br((const unsigned char *)deflate_data, deflate_sz);
 
-  cmd = "diff -q " + outputfile + " " + original_file;
-  int diffout = ::system(cmd.c_str());
-  if (diffout != 0) {
-    gzipstatus = 4;
+  int status = InflateCompare(br, st);
+  if (status == kVerifyOk && st.pos != original_sz) {
+    std::cout << "Verification failed: decompressed data is shorter than the "
+                 "input ("
+              << st.pos << " of " << original_sz << " bytes)\n";
+    status = kVerifyMismatch;
+  } else {
+    Report(status, st, br.BytePos());
   }
 
-  //------------------------------------------------------------------
-  // Cleanup, remove the temp file.
+  if (status == kVerifyOk && Crc32Host(original, original_sz, 0) != crc) {
+    std::cout << "Verification failed: CRC mismatch\n";
+    status = kVerifyBadTrailer;
+  }
 
-  (void)::remove(outputfile.c_str());
+  if (mismatch_offset) *mismatch_offset = st.pos;
+  return status;
+}
 
-  return gzipstatus;
-#endif
+// returns 0 on success, otherwise failure
+int CompareGzipBuffer(const char *original, size_t original_sz,
+                      const char *gzdata, size_t gz_sz,
+                      size_t *mismatch_offset) {
+  const unsigned char *gz = (const unsigned char *)gzdata;
+  VerifyState st{(const unsigned char *)original, original_sz, 0};
+  size_t offset = 0;
+  int status = kVerifyOk;
+
+  // a gzip file is a sequence of one or more members
+  do {
+    //------------------------------------------------------------------
+    // member header
+    const size_t member_start = st.pos;
+    if (gz_sz - offset < 18 || gz[offset] != 0x1f || gz[offset + 1] != 0x8b ||
+        gz[offset + 2] != 8) {
+      status = kVerifyInvalidStream;
+      Report(status, st, offset);
+      break;
+    }
+    const unsigned char flags = gz[offset + 3];
+    size_t hdr = offset + 10;
+    if (flags & 0x04) {  // extra field
+      hdr += 2 + (gz[hdr] | (gz[hdr + 1] << 8));
+    }
+    if (flags & 0x08) {  // original file name
+      while (hdr < gz_sz && gz[hdr]) hdr++;
+      hdr++;
+    }
+    if (flags & 0x10) {  // comment
+      while (hdr < gz_sz && gz[hdr]) hdr++;
+      hdr++;
+    }
+    if (flags & 0x02) {  // header crc
+      hdr += 2;
+    }
+    if (hdr >= gz_sz) {
+      status = kVerifyInvalidStream;
+      Report(status, st, offset);
+      break;
+    }
+
+    //------------------------------------------------------------------
+    // compressed data
+    BitReader br(gz + hdr, gz_sz - hdr);
+    status = InflateCompare(br, st);
+    if (status != kVerifyOk) {
+      Report(status, st, hdr + br.BytePos());
+      break;
+    }
+    br.AlignToByte();
+    offset = hdr + br.BytePos();
+
+    //------------------------------------------------------------------
+    // trailer: CRC and size (modulo 2^32) of the member's data
+    if (gz_sz - offset < 8) {
+      status = kVerifyInvalidStream;
+      Report(status, st, offset);
+      break;
+    }
+    const size_t member_sz = st.pos - member_start;
+    if (GetUlong(gz + offset) !=
+            Crc32Host(original + member_start, member_sz, 0) ||
+        GetUlong(gz + offset + 4) != (uint32_t)member_sz) {
+      std::cout << "Verification failed: bad CRC or size in the gzip member "
+                   "starting at input offset "
+                << member_start << "\n";
+      status = kVerifyBadTrailer;
+      break;
+    }
+    offset += 8;
+  } while (offset < gz_sz);
+
+  if (status == kVerifyOk && st.pos != original_sz) {
+    std::cout << "Verification failed: decompressed data is shorter than the "
+                 "input ("
+              << st.pos << " of " << original_sz << " bytes)\n";
+    status = kVerifyMismatch;
+  }
+
+  if (mismatch_offset) *mismatch_offset = st.pos;
+  return status;
+}
+
+// reads a whole file, returns false on failure
+static bool ReadFile(const std::string &filename, std::vector<char> &data) {
+  std::ifstream file(filename, std::ios::in | std::ios::binary | std::ios::ate);
+  if (!file.is_open()) {
+    std::cout << "Error: cannot open " << filename << "\n";
+    return false;
+  }
+  data.resize((size_t)file.tellg());
+  file.seekg(0, std::ios::beg);
+  file.read(data.data(), data.size());
+  return (bool)file;
+}
+
+// returns 0 on success, otherwise failure
+int CompareGzipFiles(
+    const std::string
+        &original_file,  // original input file to compare gzip uncompressed
+    const std::string &input_gzfile)  // gzip file to check
+{
+  std::vector<char> original, gzdata;
+  if (!ReadFile(original_file, original) || !ReadFile(input_gzfile, gzdata)) {
+    return 1;
+  }
+  return CompareGzipBuffer(original.data(), original.size(), gzdata.data(),
+                           gzdata.size());
 }
@@ -2,12 +2,40 @@
 #define __COMPAREGZIP_H__
 #pragma once
 
+#include <stdint.h>
+
 #include <iostream>
 #include <string>
 
+// Decompresses the gzip file and compares it with the original file, in
+// process. Multi-member gzip files are supported.
+// returns 0 on success, otherwise failure
 int CompareGzipFiles(
     const std::string
         &original_file,  // original input file to compare gzip uncompressed
     const std::string &input_gzfile);  // gzip file to check
 
+// Same as CompareGzipFiles, but on a gzip stream in memory. Also checks the
+// CRC and size in the trailer of every member.
+// returns 0 on success, otherwise failure. 'mismatch_offset' (if not null) is
+// set to the offset in 'original' where the decompressed data stopped
+// matching (original_sz when all of it matched).
+int CompareGzipBuffer(const char *original,  // original uncompressed data
+                      size_t original_sz,    // size of the original data
+                      const char *gzdata,    // gzip stream to check
+                      size_t gz_sz,          // size of the gzip stream
+                      size_t *mismatch_offset = nullptr);
+
+// Decompresses a raw deflate stream, as produced by the GZIP engine, and
+// compares it with the original data. 'crc' is the CRC that is written to the
+// gzip trailer for this data, and is checked too.
+// returns 0 on success, otherwise failure. See CompareGzipBuffer for
+// 'mismatch_offset'.
+int CompareDeflateBuffer(const char *original,      // original data
+                         size_t original_sz,        // size of the original data
+                         const char *deflate_data,  // compressed data
+                         size_t deflate_sz,         // size of compressed data
+                         uint32_t crc,              // CRC of the original data
+                         size_t *mismatch_offset = nullptr);
+
 #endif  //__COMPAREGZIP_H__
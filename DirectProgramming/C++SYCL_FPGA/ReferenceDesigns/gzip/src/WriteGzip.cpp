@@ -51,8 +51,8 @@ inline static void PutUlong(uint8_t *pc, unsigned long l) {
 
 // returns 0 on success, otherwise failure
 int WriteBlockGzip(
+    FILE *fo,                        // open output file
     std::string &original_filename,  // Original file name being compressed
-    std::string &out_filename,       // gzip filename
     char *obuf,                      // pointer to compressed data block
     size_t blen,                     // length of compressed data block
     size_t ilen,                     // original block length
@@ -108,28 +108,42 @@ int WriteBlockGzip(
   PutUlong(((unsigned char *)prolog), buffer_crc);
   PutUlong(((unsigned char *)&prolog[4]), ilen);
 
-  FILE *fo = fopen(out_filename.c_str(), "w+");
-  if (ferror(fo)) {
-    std::cout << "Cannot open file for output: " << out_filename << "\n";
-    free(pgziphdr);
-    return 1;
-  }
-
   fwrite(pgziphdr, 1, header_bytes, fo);
   fwrite(obuf, 1, blen, fo);
   fwrite(prolog, 1, 8, fo);
 
+  free(pgziphdr);
+
   if (ferror(fo)) {
     std::cout << "gzip output file write failure.\n";
-    free(pgziphdr);
+    return 1;
+  }
+  return 0;
+}
+
+// returns 0 on success, otherwise failure
+int WriteBlockGzip(
+    std::string &original_filename,  // Original file name being compressed
+    std::string &out_filename,       // gzip filename
+    char *obuf,                      // pointer to compressed data block
+    size_t blen,                     // length of compressed data block
+    size_t ilen,                     // original block length
+    uint32_t buffer_crc)             // the block's crc
+{
+  FILE *fo = fopen(out_filename.c_str(), "w+");
+  if (!fo || ferror(fo)) {
+    std::cout << "Cannot open file for output: " << out_filename << "\n";
+    return 1;
+  }
+
+  if (WriteBlockGzip(fo, original_filename, obuf, blen, ilen, buffer_crc)) {
+    fclose(fo);
     return 1;
   }
 
   if (fclose(fo)) {
     perror("close");
-    free(pgziphdr);
     return 1;
   }
-  free(pgziphdr);
   return 0;
 }
@@ -2,6 +2,9 @@
 #define __WRITEGZIP_H__
 #pragma once
 
+#include <stdint.h>
+#include <stdio.h>
+
 #include <iostream>
 #include <string>
 
@@ -14,4 +17,17 @@ int WriteBlockGzip(
     size_t ilen,                     // original block length
     uint32_t buffer_crc);            // the block's crc
 
+// Same as above, but appends the gzip member (header, compressed block and
+// trailer) to the already open file 'fo'. Writing several members to the
+// same file produces a multi-member gzip file, which gunzip decompresses to
+// the concatenation of the members.
+// returns 0 on success, otherwise failure
+int WriteBlockGzip(
+    FILE *fo,                        // open output file
+    std::string &original_filename,  // Original file name being compressed
+    char *obuf,                      // pointer to compressed data block
+    size_t blen,                     // length of compressed data block
+    size_t ilen,                     // original block length
+    uint32_t buffer_crc);            // the block's crc
+
 #endif  //__WRITEGZIP_H__
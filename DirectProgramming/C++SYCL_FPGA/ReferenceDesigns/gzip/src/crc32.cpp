@@ -1,5 +1,10 @@
 #include "crc32.hpp"
 
+#include <algorithm>
+#include <array>
+#include <thread>
+#include <vector>
+
 // This table is CRC32s for all single byte values created by using the
 // makecrc.c utility from gzip for compatibility with gzip. makecrc.c can be
 // found in the gzip source code project found at
@@ -62,24 +67,175 @@ const unsigned int crc32_table[] = {
     0x5d681b02L, 0x2a6f2b94L, 0xb40bbe37L, 0xc30c8ea1L, 0x5a05df1bL,
     0x2d02ef8dL};
 
+namespace {
+
+// The CRC-32 polynomial used by gzip (reversed representation)
+constexpr uint32_t kCrc32Poly = 0xedb88320;
+
+//
+// Tables for the slice-by-8 algorithm: table[0] is crc32_table above and
+// table[k][i] is the CRC of byte 'i' followed by 'k' zero bytes. This lets
+// the main loop consume 8 input bytes per iteration with 8 independent table
+// lookups instead of 8 dependent ones.
+//
+struct Crc32SliceTables {
+  uint32_t table[8][256];
+};
+
+constexpr Crc32SliceTables MakeSliceTables() {
+  Crc32SliceTables t{};
+  for (uint32_t i = 0; i < 256; i++) {
+    uint32_t c = i;
+    for (int k = 0; k < 8; k++) {
+      c = (c & 1) ? (c >> 1) ^ kCrc32Poly : (c >> 1);
+    }
+    t.table[0][i] = c;
+  }
+  for (uint32_t i = 0; i < 256; i++) {
+    for (int k = 1; k < 8; k++) {
+      uint32_t prev = t.table[k - 1][i];
+      t.table[k][i] = (prev >> 8) ^ t.table[0][prev & 0xff];
+    }
+  }
+  return t;
+}
+
+constexpr Crc32SliceTables kSliceTables = MakeSliceTables();
+
+// reads 4 bytes as a little-endian word, independent of host endianness
+// and alignment
+inline uint32_t LoadLE32(const unsigned char *p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+         ((uint32_t)p[3] << 24);
+}
+
+//
+// Multiply two polynomials modulo the CRC polynomial, where bit 31 is the
+// x^0 term (the reflected representation used by the CRC).
+//
+uint32_t MultModP(uint32_t a, uint32_t b) {
+  uint32_t m = 1u << 31;
+  uint32_t p = 0;
+  for (;;) {
+    if (a & m) {
+      p ^= b;
+      if ((a & (m - 1)) == 0) break;
+    }
+    m >>= 1;
+    b = (b & 1) ? (b >> 1) ^ kCrc32Poly : (b >> 1);
+  }
+  return p;
+}
+
+//
+// x^(n * 2^k) modulo the CRC polynomial
+//
+uint32_t X2nModP(size_t n, unsigned k) {
+  // x2n_table[i] = x^(2^i) mod p(x)
+  static const auto x2n_table = [] {
+    std::array<uint32_t, 32> t{};
+    uint32_t p = 1u << 30;  // x^1
+    t[0] = p;
+    for (int i = 1; i < 32; i++) {
+      t[i] = p = MultModP(p, p);
+    }
+    return t;
+  }();
+
+  uint32_t p = 1u << 31;  // x^0
+  while (n) {
+    if (n & 1) p = MultModP(x2n_table[k & 31], p);
+    n >>= 1;
+    k++;
+  }
+  return p;
+}
+
+}  // namespace
+
 //
 // This routine creates a Crc32 from a memory buffer (address, and length), and
 // a previous crc. This routine can be called iteratively on different portions
 // of the same buffer, using a previously returned crc value. The
 // value 0xffffffff is used for the first buffer invocation.
+//
+// It uses the slice-by-8 algorithm on the bulk of the buffer, and the
+// byte-at-a-time table loop on the unaligned tail.
 unsigned int Crc32Host(
     const char *pbuf,           // pointer to the buffer to crc
     size_t sz,                  // number of bytes
     unsigned int previous_crc)  // previous CRC, allows combining.
 {
-  unsigned int curr_crc = ~previous_crc;
-  if (sz) do {
-      curr_crc =
-          crc32_table[((int)curr_crc ^ (*pbuf++)) & 0xff] ^ (curr_crc >> 8);
-    } while (--sz);
+  const auto &t = kSliceTables.table;
+  const unsigned char *p = (const unsigned char *)pbuf;
+  uint32_t curr_crc = ~previous_crc;
+
+  while (sz >= 8) {
+    uint32_t lo = curr_crc ^ LoadLE32(p);
+    uint32_t hi = LoadLE32(p + 4);
+    curr_crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^
+               t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24] ^
+               t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^
+               t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+    p += 8;
+    sz -= 8;
+  }
+
+  while (sz--) {
+    curr_crc = crc32_table[(curr_crc ^ *p++) & 0xff] ^ (curr_crc >> 8);
+  }
   return curr_crc ^ 0xffffffffL;
 }
 
+//
+// Given crc1 = Crc32Host(A, sz1, prev) and crc2 = Crc32Host(B, sz2, 0),
+// returns Crc32Host(AB, sz1 + sz2, prev) (i.e. the same value as continuing
+// crc1 over B), without touching the data.
+unsigned int Crc32Combine(unsigned int crc1, unsigned int crc2, size_t len2) {
+  // multiplying by x^(8 * len2) appends len2 zero bytes to crc1
+  return MultModP(X2nModP(len2, 3), crc1) ^ crc2;
+}
+
+//
+// Same result as Crc32Host, but the buffer is split into chunks that are
+// CRC'd on 'num_threads' threads (0 = all hardware threads) and then merged
+// with Crc32Combine. Buffers that are too small to benefit are CRC'd on the
+// calling thread.
+unsigned int Crc32HostParallel(const char *pbuf, size_t sz,
+                               unsigned int previous_crc, int num_threads) {
+  constexpr size_t kMinChunk = 1 << 20;
+
+  size_t threads = (num_threads > 0) ? (size_t)num_threads
+                                     : std::thread::hardware_concurrency();
+  threads = std::max<size_t>(1, std::min(threads, sz / kMinChunk));
+  if (threads == 1) {
+    return Crc32Host(pbuf, sz, previous_crc);
+  }
+
+  const size_t chunk = sz / threads;
+  std::vector<unsigned int> crcs(threads);
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < threads; i++) {
+    workers.emplace_back([&, i] {
+      const size_t begin = i * chunk;
+      const size_t len = (i == threads - 1) ? sz - begin : chunk;
+      // only the first chunk continues the previous CRC, the others start
+      // from 0 as required by Crc32Combine
+      crcs[i] = Crc32Host(pbuf + begin, len, (i == 0) ? previous_crc : 0);
+    });
+  }
+  for (auto &w : workers) {
+    w.join();
+  }
+
+  unsigned int crc = crcs[0];
+  for (size_t i = 1; i < threads; i++) {
+    const size_t len = (i == threads - 1) ? sz - i * chunk : chunk;
+    crc = Crc32Combine(crc, crcs[i], len);
+  }
+  return crc;
+}
+
 unsigned int Crc32(const char *in, size_t buffer_sz,
                    unsigned int previous_crc) {
   const int num_nibbles_parallel = 64;
@@ -10,6 +10,16 @@ uint32_t Crc32Host(
     size_t sz,               // number of bytes
     uint32_t previous_crc);  // previous CRC, allows combining. First invocation
                              // would use 0xffffffff.
+uint32_t Crc32HostParallel(
+    const char *pbuf,        // pointer to the buffer to crc
+    size_t sz,               // number of bytes
+    uint32_t previous_crc,   // previous CRC, same as for Crc32Host
+    int num_threads = 0);    // threads to use, 0 uses all hardware threads
+uint32_t Crc32Combine(
+    uint32_t crc1,   // CRC of the first block (any previous CRC)
+    uint32_t crc2,   // CRC of the second block, computed with previous CRC 0
+    size_t len2);    // length of the second block in bytes. Returns the CRC
+                     // of the first block continued over the second block.
 uint32_t Crc32(const char *pbuf,        // pointer to the buffer to crc
                size_t sz,               // number of bytes
                uint32_t previous_crc);  // previous CRC, allows combining. First
@@ -1,5 +1,6 @@
 #include <sycl/sycl.hpp>
 #include <sycl/ext/intel/fpga_extensions.hpp>
+#include <algorithm>
 #include <chrono>
 #include <fstream>
 #include <string>
@@ -22,7 +23,14 @@ constexpr int minimum_filesize = kVec + 1;
 bool help = false;
 
 int CompressFile(queue &q, std::string &input_file, std::vector<std::string> outfilenames,
-                 int iterations, bool report);
+                 int iterations, bool report, bool dynamic_huffman);
+
+int StreamCompressFile(queue &q, std::string &input_file,
+                       std::string &outfilename, size_t chunk_size,
+                       bool report, bool dynamic_huffman);
+
+// Default size of the chunks the input is split into in streaming mode
+constexpr size_t kDefaultStreamChunkSize = 16 * 1024 * 1024;
 
 void Help(void) {
   // Command line arguments.
@@ -37,6 +45,18 @@ void Help(void) {
   std::cout << "  -h,--help                                : this help text\n";
   std::cout
       << "  -o=<filename>,--output-file=<filename>   : specify output file\n";
+  std::cout
+      << "  --stream                                 : compress the file in "
+         "fixed-size chunks with constant memory use, producing a "
+         "multi-member gzip file\n";
+  std::cout
+      << "  --chunk-size=<bytes>                     : chunk size for "
+         "--stream (default "
+      << kDefaultStreamChunkSize << ")\n";
+  std::cout
+      << "  --dynamic                                : use Huffman trees "
+         "built for the input (dynamic Huffman blocks) instead of the fixed "
+         "trees. Requires a design compiled with DYNAMIC_HUFFMAN=1\n";
 }
 
 bool FindGetArg(std::string &arg, const char *str, int defaultval, int *val) {
@@ -90,10 +110,15 @@ int main(int argc, char *argv[]) {
 
   char str_buffer[kMaxStringLen] = {0};
 
+  bool stream = false;
+  int chunk_size = kDefaultStreamChunkSize;
+  bool dynamic_huffman = false;
+
   // Check the number of arguments specified
-  if (argc != 3) {
+  if (argc < 3 || argc > 6) {
     std::cerr << "Incorrect number of arguments. Correct usage: " << argv[0]
-              << " <input-file> -o=<output-file>\n";
+              << " <input-file> -o=<output-file> [--stream] "
+                 "[--chunk-size=<bytes>] [--dynamic]\n";
     return 1;
   }
 
@@ -107,8 +132,16 @@ int main(int argc, char *argv[]) {
         help = true;
       }
 
+      if (std::string(argv[i]) == "--stream") {
+        stream = true;
+      }
+      if (std::string(argv[i]) == "--dynamic") {
+        dynamic_huffman = true;
+      }
+
       FindGetArgString(sarg, "-o=", str_buffer, kMaxStringLen);
       FindGetArgString(sarg, "--output-file=", str_buffer, kMaxStringLen);
+      FindGetArg(sarg, "--chunk-size=", kDefaultStreamChunkSize, &chunk_size);
     } else {
       infilename = std::string(argv[i]);
     }
@@ -151,21 +184,40 @@ int main(int argc, char *argv[]) {
       outfilenames[i] = outfilenames[0] + std::to_string(i+1);
     }
 
+    if (dynamic_huffman && !kDynamicHuffman) {
+      std::cout << "The dynamic Huffman encoder is not part of this design, "
+                   "rebuild with -DDYNAMIC_HUFFMAN=1\n";
+      return 1;
+    }
+
+    if (stream) {
+      if (chunk_size <= minimum_filesize) {
+        std::cout << "The chunk size must be larger than " << minimum_filesize
+                  << "\n";
+        return 1;
+      }
+      std::cout << "Launching streaming GZIP application with " << kNumEngines
+                << " engines and " << chunk_size << " byte chunks\n";
+      return StreamCompressFile(q, infilename, outfilenames[0], chunk_size,
+                                true, dynamic_huffman);
+    }
+
     std::cout << "Launching High-Bandwidth DMA GZIP application with " << kNumEngines
-              << " engines\n";
+              << " engines" << (dynamic_huffman ? " (dynamic Huffman)" : "")
+              << "\n";
 
 #ifdef FPGA_EMULATOR
-    CompressFile(q, infilename, outfilenames, 1, true);
+    CompressFile(q, infilename, outfilenames, 1, true, dynamic_huffman);
 #elif FPGA_SIMULATOR
-    CompressFile(q, infilename, outfilenames, 2, true);
+    CompressFile(q, infilename, outfilenames, 2, true, dynamic_huffman);
 #else
     // warmup run - use this run to warmup accelerator. There are some steps in
     // the runtime that are only executed on the first kernel invocation but not
     // on subsequent invocations. So execute all that stuff here before we
     // measure performance (in the next call to CompressFile().
-    CompressFile(q, infilename, outfilenames, 1, false);
+    CompressFile(q, infilename, outfilenames, 1, false, dynamic_huffman);
     // profile performance
-    CompressFile(q, infilename, outfilenames, 200, true);
+    CompressFile(q, infilename, outfilenames, 200, true, dynamic_huffman);
 #endif
   } catch (sycl::exception const &e) {
     // Catches exceptions in the host code
@@ -191,6 +243,7 @@ struct KernelInfo {
   buffer<unsigned, 1> *current_crc;
   buffer<char, 1> *pobuf;
   buffer<char, 1> *pibuf;
+  buffer<struct DistLen, 1> *huffman_tokens;  // nullptr for static Huffman
   char *pobuf_decompress;
 
   uint32_t buffer_crc[kMinBufferSize];
@@ -206,7 +259,7 @@ struct KernelInfo {
 
 // returns 0 on success, otherwise a non-zero failure code.
 int CompressFile(queue &q, std::string &input_file, std::vector<std::string> outfilenames,
-                 int iterations, bool report) {
+                 int iterations, bool report, bool dynamic_huffman) {
   size_t isz;
   char *pinbuf;
 
@@ -320,6 +373,11 @@ int CompressFile(queue &q, std::string &input_file, std::vector<std::string> out
                                 : new buffer<char, 1>(input_alloc_size);
       kinfo[eng][i].pobuf =
           i >= 3 ? kinfo[eng][i - 3].pobuf : new buffer<char, 1>(outputSize);
+      kinfo[eng][i].huffman_tokens =
+          i >= 3 ? kinfo[eng][i - 3].huffman_tokens
+                 : (dynamic_huffman
+                        ? new buffer<struct DistLen, 1>(isz / kVec + 1)
+                        : nullptr);
       kinfo[eng][i].pobuf_decompress = (char *)malloc(kinfo[eng][i].file_size);
     }
   }
@@ -361,7 +419,8 @@ int CompressFile(queue &q, std::string &input_file, std::vector<std::string> out
       SubmitGzipTasks(q, kinfo[eng][i].file_size, kinfo[eng][i].pibuf,
                       kinfo[eng][i].pobuf, kinfo[eng][i].gzip_out_buf,
                       kinfo[eng][i].current_crc, kinfo[eng][i].last_block,
-                      e_k_crc[eng][i], e_k_lz[eng][i], e_k_huff[eng][i], eng);
+                      e_k_crc[eng][i], e_k_lz[eng][i], e_k_huff[eng][i], eng,
+                      kinfo[eng][i].huffman_tokens);
 
       // Transfer the output (compressed) data from device to host.
       e_output_dma[eng][i] = q.submit([&](handler &h) {
@@ -428,6 +487,17 @@ int CompressFile(queue &q, std::string &input_file, std::vector<std::string> out
     }
   }
 
+  // Decompress the output from engine-0 in memory and compare it against the
+  // input data. Only engine-0's output is verified since all engines are fed
+  // the same input data.
+  if (report &&
+      CompareDeflateBuffer(pinbuf, isz, kinfo[0][0].poutput_buffer,
+                           kinfo[0][0].out_info[0].compression_sz,
+                           kinfo[0][0].buffer_crc[0])) {
+    std::cout << "FAILED\n";
+    return 1;
+  }
+
   // delete the file mapping now that all kernels are complete, and we've
   // snapped the time delta
   if (prepin) {
@@ -447,13 +517,6 @@ int CompressFile(queue &q, std::string &input_file, std::vector<std::string> out
     }        
   }
 
-  // Decompress the output from engine-0 and compare against the input file. Only engine-0's
-  // output is verified since all engines are fed the same input data.
-  if (report && CompareGzipFiles(input_file, outfilenames[0])) {
-    std::cout << "FAILED\n";
-    return 1;
-  }
-
   // Generate throughput report
   // First gather all the execution times.
   size_t time_k_crc[kNumEngines];
@@ -511,6 +574,7 @@ int CompressFile(queue &q, std::string &input_file, std::vector<std::string> out
         delete kinfo[eng][i].current_crc;
         delete kinfo[eng][i].pibuf;
         delete kinfo[eng][i].pobuf;
+        delete kinfo[eng][i].huffman_tokens;
         if (prepin) {
           free(kinfo[eng][i].poutput_buffer, q.get_context());
         } else {
@@ -525,3 +589,299 @@ int CompressFile(queue &q, std::string &input_file, std::vector<std::string> out
   if (report) std::cout << "PASSED\n";
   return 0;
 }
+
+
+//
+// State for one chunk in flight in the streaming mode
+//
+struct StreamSlot {
+  buffer<struct GzipOutInfo, 1> *gzip_out_buf;
+  buffer<unsigned, 1> *current_crc;
+  buffer<char, 1> *pobuf;
+  buffer<char, 1> *pibuf;
+  buffer<struct DistLen, 1> *huffman_tokens;  // nullptr for static Huffman
+
+  char *pinput_buffer;   // the chunk read from the input file
+  char *poutput_buffer;  // the compressed chunk
+  struct GzipOutInfo *out_info;
+  uint32_t *buffer_crc;
+
+  size_t chunk_size;  // bytes of input in this chunk
+  bool busy;          // a chunk was submitted and not written out yet
+
+  event e_input_dma;
+  event e_output_dma;
+  event e_size_dma;
+  event e_crc_dma;
+  event e_k_crc;
+  event e_k_lz;
+  event e_k_huff;
+};
+
+//
+// Streaming compression
+//
+// Reads the input file in chunks of 'chunk_size' bytes (the last chunk absorbs
+// a tail that is too small to be compressed on its own) and compresses each
+// chunk as an independent gzip member, so the output is a multi-member gzip
+// file that gunzip decompresses to the original file. Chunks are distributed
+// round-robin over the engines. With kNumEngines + 1 slots, chunk N+1 is read
+// from disk and chunk N-kNumEngines is written out while the device is busy
+// with chunks N-kNumEngines+1 .. N, so memory use only depends on the chunk
+// size, not on the size of the input file.
+//
+// returns 0 on success, otherwise a non-zero failure code.
+int StreamCompressFile(queue &q, std::string &input_file,
+                       std::string &outfilename, size_t chunk_size,
+                       bool report, bool dynamic_huffman) {
+#ifdef FPGA_SIMULATOR
+  bool prepin = false;
+#else
+  bool prepin = q.get_device().has(aspect::usm_host_allocations);
+#endif
+
+  // padding for the input and output buffers to deal with granularity of
+  // kernel reads and writes
+  constexpr size_t kInOutPadding = 16 * kVec;
+  constexpr size_t kNumSlots = kNumEngines + 1;
+
+  std::ifstream file(input_file,
+                     std::ios::in | std::ios::binary | std::ios::ate);
+  if (!file.is_open()) {
+    std::cout << "Error: cannot read specified input file\n";
+    return 1;
+  }
+  const size_t isz = file.tellg();
+  file.seekg(0, std::ios::beg);
+
+  if (isz < minimum_filesize) {
+    std::cout << "Minimum filesize for compression is " << minimum_filesize
+              << "\n";
+    return 1;
+  }
+
+  FILE *fo = fopen(outfilename.c_str(), "wb");
+  if (!fo) {
+    std::cout << "Cannot open file for output: " << outfilename << "\n";
+    return 1;
+  }
+
+  // A chunk can grow by up to kMinBufferSize bytes when it absorbs the tail of
+  // the file. Small tails are merged because a chunk of a few bytes can
+  // compress to more than its own size, which the engine does not support.
+  const size_t input_alloc_size = chunk_size + kMinBufferSize + kInOutPadding;
+  const size_t output_size = std::max<size_t>(input_alloc_size, kMinBufferSize);
+
+  StreamSlot slots[kNumSlots];
+  for (size_t s = 0; s < kNumSlots; s++) {
+    if (prepin) {
+      slots[s].pinput_buffer =
+          (char *)malloc_host(input_alloc_size, q.get_context());
+      slots[s].poutput_buffer =
+          (char *)malloc_host(output_size, q.get_context());
+    } else {
+      slots[s].pinput_buffer = (char *)malloc(input_alloc_size);
+      slots[s].poutput_buffer = (char *)malloc(output_size);
+    }
+    if (slots[s].pinput_buffer == NULL || slots[s].poutput_buffer == NULL) {
+      std::cout << "Cannot allocate stream buffers.\n";
+      fclose(fo);
+      return 1;
+    }
+    memset(slots[s].pinput_buffer, 0, input_alloc_size);
+
+    slots[s].out_info = new struct GzipOutInfo[kMinBufferSize];
+    slots[s].buffer_crc = new uint32_t[kMinBufferSize];
+    slots[s].gzip_out_buf = new buffer<struct GzipOutInfo, 1>(kMinBufferSize);
+    slots[s].current_crc = new buffer<unsigned, 1>(kMinBufferSize);
+    slots[s].pibuf = new buffer<char, 1>(input_alloc_size);
+    slots[s].pobuf = new buffer<char, 1>(output_size);
+    slots[s].huffman_tokens =
+        dynamic_huffman
+            ? new buffer<struct DistLen, 1>(input_alloc_size / kVec + 1)
+            : nullptr;
+    slots[s].busy = false;
+  }
+
+  size_t compressed_sz = 0;
+  size_t num_chunks = 0;
+  size_t time_kernels[kNumEngines] = {0};
+  bool failed = false;
+
+  // Waits for the chunk in slot 's' and appends it to the output file as a
+  // gzip member.
+  auto drain = [&](StreamSlot &slot, size_t eng) {
+    slot.e_output_dma.wait();
+    slot.e_size_dma.wait();
+    slot.e_crc_dma.wait();
+    slot.busy = false;
+
+    if (slot.out_info[0].compression_sz > slot.chunk_size) {
+      std::cerr << "Unsupported: compressed chunk larger than input chunk( "
+                << slot.out_info[0].compression_sz << " )\n";
+      failed = true;
+      return;
+    }
+
+    // The CRC kernel only covers whole 32 byte sections, finish the CRC of
+    // the chunk on the host.
+    slot.buffer_crc[0] =
+        Crc32(slot.pinput_buffer, slot.chunk_size, slot.buffer_crc[0]);
+
+    // verify the chunk in memory, while its input is still around
+    if (report && CompareDeflateBuffer(slot.pinput_buffer, slot.chunk_size,
+                                       slot.poutput_buffer,
+                                       slot.out_info[0].compression_sz,
+                                       slot.buffer_crc[0])) {
+      failed = true;
+      return;
+    }
+
+    if (WriteBlockGzip(fo, input_file, slot.poutput_buffer,
+                       slot.out_info[0].compression_sz, slot.chunk_size,
+                       slot.buffer_crc[0])) {
+      failed = true;
+      return;
+    }
+
+    compressed_sz += slot.out_info[0].compression_sz;
+    time_kernels[eng] += std::max({SyclGetExecTimeNs(slot.e_k_crc),
+                                   SyclGetExecTimeNs(slot.e_k_lz),
+                                   SyclGetExecTimeNs(slot.e_k_huff)});
+  };
+
+#ifdef FPGA_EMULATOR
+#elif FPGA_SIMULATOR
+#else
+  auto start = std::chrono::steady_clock::now();
+#endif
+
+  size_t offset = 0;
+  while (offset < isz && !failed) {
+    const size_t n = num_chunks++;
+    const size_t eng = n % kNumEngines;
+    StreamSlot &slot = slots[n % kNumSlots];
+
+    // the previous chunk in this slot (n - kNumSlots) was already written out
+    // in the previous iteration
+    if (slot.busy) {
+      drain(slot, (n - kNumSlots) % kNumEngines);
+      if (failed) break;
+    }
+
+    // read the next chunk, and merge a too small tail into it
+    size_t this_chunk = std::min(chunk_size, isz - offset);
+    if (isz - offset - this_chunk < kMinBufferSize) {
+      this_chunk = isz - offset;
+    }
+    file.read(slot.pinput_buffer, this_chunk);
+    if (!file) {
+      std::cout << "Error: cannot read specified input file\n";
+      failed = true;
+      break;
+    }
+    slot.chunk_size = this_chunk;
+    offset += this_chunk;
+
+    // Transfer the chunk from host to device.
+    slot.e_input_dma = q.submit([&](handler &h) {
+      auto in_data = slot.pibuf->get_access<access::mode::discard_write>(h);
+      h.copy(slot.pinput_buffer, in_data);
+    });
+
+    SubmitGzipTasks(q, slot.chunk_size, slot.pibuf, slot.pobuf,
+                    slot.gzip_out_buf, slot.current_crc, true, slot.e_k_crc,
+                    slot.e_k_lz, slot.e_k_huff, eng, slot.huffman_tokens);
+
+    // Transfer the compressed chunk, its size and its CRC back to the host.
+    slot.e_output_dma = q.submit([&](handler &h) {
+      auto out_data = slot.pobuf->get_access<access::mode::read>(h);
+      h.copy(out_data, slot.poutput_buffer);
+    });
+    slot.e_size_dma = q.submit([&](handler &h) {
+      auto out_data = slot.gzip_out_buf->get_access<access::mode::read>(h);
+      h.copy(out_data, slot.out_info);
+    });
+    slot.e_crc_dma = q.submit([&](handler &h) {
+      auto out_data = slot.current_crc->get_access<access::mode::read>(h);
+      h.copy(out_data, slot.buffer_crc);
+    });
+    slot.busy = true;
+
+    // write out the oldest chunk while the device works on the newer ones
+    if (n >= kNumEngines) {
+      StreamSlot &oldest = slots[(n - kNumEngines) % kNumSlots];
+      if (oldest.busy) {
+        drain(oldest, (n - kNumEngines) % kNumEngines);
+      }
+    }
+  }
+
+  // write out the chunks still in flight, in order
+  for (size_t n = (num_chunks > kNumSlots) ? num_chunks - kNumSlots : 0;
+       n < num_chunks; n++) {
+    StreamSlot &slot = slots[n % kNumSlots];
+    if (slot.busy && !failed) {
+      drain(slot, n % kNumEngines);
+    } else if (slot.busy) {
+      // still wait for the device before the buffers are released
+      slot.e_output_dma.wait();
+      slot.e_size_dma.wait();
+      slot.e_crc_dma.wait();
+    }
+  }
+
+#ifdef FPGA_EMULATOR
+#elif FPGA_SIMULATOR
+#else
+  auto end = std::chrono::steady_clock::now();
+  double diff_total =
+      std::chrono::duration_cast<std::chrono::duration<double>>(end - start)
+          .count();
+#endif
+
+  if (fclose(fo)) {
+    perror("close");
+    failed = true;
+  }
+
+  for (size_t s = 0; s < kNumSlots; s++) {
+    delete slots[s].gzip_out_buf;
+    delete slots[s].current_crc;
+    delete slots[s].pibuf;
+    delete slots[s].pobuf;
+    delete slots[s].huffman_tokens;
+    delete[] slots[s].out_info;
+    delete[] slots[s].buffer_crc;
+    if (prepin) {
+      free(slots[s].pinput_buffer, q.get_context());
+      free(slots[s].poutput_buffer, q.get_context());
+    } else {
+      free(slots[s].pinput_buffer);
+      free(slots[s].poutput_buffer);
+    }
+  }
+
+  if (failed) {
+    std::cout << "FAILED\n";
+    return 1;
+  }
+
+  if (report) {
+    std::cout << "Chunks: " << num_chunks << "\n";
+#ifdef FPGA_EMULATOR
+#elif FPGA_SIMULATOR
+#else
+    std::cout << "Throughput (including file I/O): "
+              << isz / diff_total / 1000000000.0 << " GB/s\n";
+    for (int eng = 0; eng < kNumEngines; eng++) {
+      std::cout << "Kernel time for engine #" << eng << ": "
+                << time_kernels[eng] / 1000000.0 << " ms\n";
+    }
+#endif
+    std::cout << "Compression Ratio " << (double)compressed_sz / isz * 100
+              << "%\n";
+    std::cout << "PASSED\n";
+  }
+  return 0;
+}
@@ -505,12 +505,19 @@ int CompressFile(queue &q, std::string &input_file,
     }
   }
 
-  // Decompress the output from engine-0 and compare against the input file.
-  // Only engine-0's output is verified since all engines are fed the same input
-  // data.
-  if (report && CompareGzipFiles(input_file, outfilenames[0])) {
-    std::cout << "FAILED\n";
-    return 1;
+  // Decompress the outputs from buffer set 0 of engine-0 in memory and compare
+  // them against the input data. Only engine-0's output is verified since all
+  // engines are fed the same input data.
+  for (int b = 0; report && b < BATCH_SIZE; b++) {
+    if (CompareDeflateBuffer(
+            kinfo[0][0].pref_buffer, kinfo[0][0].input_size,
+            kinfo[0][0].pobuf_ptr_array[b],
+            kinfo[0][0].gzip_out_buf[b].compression_sz,
+            Crc32(kinfo[0][0].pref_buffer, kinfo[0][0].input_size,
+                  kinfo[0][0].current_crc[b]))) {
+      std::cout << "FAILED\n";
+      return 1;
+    }
   }
 
   // Generate throughput report
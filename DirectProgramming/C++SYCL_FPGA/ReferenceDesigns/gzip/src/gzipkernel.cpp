@@ -598,17 +598,33 @@ int GetHuffBits(int len, int dist, unsigned char ch) {
   return bits;
 }
 
+// The fixed (static) Huffman trees of the deflate format
+struct StaticCoder {
+  int IsValid(int len, int dist, unsigned char ch) const {
+    return ::IsValid(len, dist, ch);
+  }
+  int Len(int len, int dist, unsigned char ch) const {
+    return GetHuffLen(len, dist, ch);
+  }
+  int Bits(int len, int dist, unsigned char ch) const {
+    return GetHuffBits(len, dist, ch);
+  }
+};
+
 // assembles up to kVecX2 unsigned char values based on given huffman encoding
 // writes up to kMaxHuffcodeBits * kVecX2 bits to memory
+// The Huffman codes come from 'coder' (StaticCoder or DynamicCoder).
+template <typename Coder>
 bool HufEnc(char *len, short *dist, unsigned char *data, unsigned int *outdata,
-            unsigned int *leftover, unsigned short *leftover_size) {
+            unsigned int *leftover, unsigned short *leftover_size,
+            const Coder &coder) {
   // array that contains the bit position of each symbol
   unsigned short bitpos[kVec + 1];
   bitpos[0] = 0;
 
   Unroller<0, kVec>::step([&](int i) {
-    bitpos[i + 1] = bitpos[i] + (IsValid(len[i], dist[i], data[i])
-                                     ? GetHuffLen(len[i], dist[i], data[i])
+    bitpos[i + 1] = bitpos[i] + (coder.IsValid(len[i], dist[i], data[i])
+                                     ? coder.Len(len[i], dist[i], data[i])
                                      : 0);
   });
 
@@ -642,14 +658,14 @@ bool HufEnc(char *len, short *dist, unsigned char *data, unsigned int *outdata,
 
   Unroller<0, kVec>::step([&](int i) {
     // Codes can be more than 16 bits, so use uint32
-    unsigned int curr_code = GetHuffBits(len[i], dist[i], data[i]);
+    unsigned int curr_code = coder.Bits(len[i], dist[i], data[i]);
     unsigned char bitpos_in_short = bitpos[i] & 0x01F;
 
     unsigned long long temp = (unsigned long long)curr_code << bitpos_in_short;
     unsigned int temp1 = (unsigned int)temp;
     unsigned int temp2 = temp >> 32ULL;
 
-    if (IsValid(len[i], dist[i], data[i])) {
+    if (coder.IsValid(len[i], dist[i], data[i])) {
       code[i].x = temp1;
       code[i].y = temp2;
     } else {
@@ -701,6 +717,368 @@ bool HufEnc(char *len, short *dist, unsigned char *data, unsigned int *outdata,
   return write;
 }
 
+//
+// Dynamic Huffman support
+//
+
+// Token used to write raw bits (the dynamic block header) through HufEnc: the
+// value is carried in 'dist' and the number of bits in 'data'.
+constexpr char kRawBitsToken = -4;
+
+// Maximum number of header tokens: block type, HLIT/HDIST/HCLEN, the code
+// length code lengths and one token per (run length encoded) code length.
+constexpr int kMaxHeaderTokens = 3 + 3 + kBLCodes + kLCodes + kDCodes;
+
+// order in which the code length code lengths are sent
+constexpr unsigned char kBLOrder[kBLCodes] = {16, 17, 18, 0, 8,  7, 9,
+                                              6,  10, 5,  11, 4, 12, 3,
+                                              13, 2,  14, 1,  15};
+
+static_assert(kLen <= 18,
+              "Matches longer than 18 bytes need more than one extra length "
+              "bit, which does not fit the dynamic code length limits");
+
+// index of the most significant set bit of 'x' (x > 0)
+unsigned int FloorLog2(unsigned int x) {
+  unsigned int ret = 0;
+  Unroller<0, 16>::step([&](int i) {
+    if (x >> (i + 1)) ret = i + 1;
+  });
+  return ret;
+}
+
+// length code (0..28, without the kLiterals + 1 offset) of a match length
+unsigned int LengthCode(int len) {
+  unsigned int lc = len - kMinMatch;
+  if (lc < 8) return lc;
+  if (lc == kMaxMatch - kMinMatch) return kLengthCodes - 1;
+  unsigned int e = FloorLog2(lc);
+  return 4 * (e - 1) + ((lc >> (e - 2)) & 3);
+}
+
+unsigned int LengthExtraBits(unsigned int code) {
+  return (code < 8 || code == kLengthCodes - 1) ? 0 : (code >> 2) - 1;
+}
+
+unsigned int LengthBase(unsigned int code) {
+  if (code == kLengthCodes - 1) return kMaxMatch - kMinMatch;
+  return (code < 8) ? code : ((4 + (code & 3)) << LengthExtraBits(code));
+}
+
+// distance code of a match distance (1..32768)
+unsigned int DistCode(int dist) {
+  unsigned int d = dist - 1;
+  if (d < 4) return d;
+  unsigned int e = FloorLog2(d);
+  return 2 * e + ((d >> (e - 1)) & 1);
+}
+
+unsigned int DistExtraBits(unsigned int code) {
+  return (code < 4) ? 0 : (code >> 1) - 1;
+}
+
+unsigned int DistBase(unsigned int code) {
+  return (code < 4) ? code : ((2 + (code & 1)) << DistExtraBits(code));
+}
+
+//
+// Computes Huffman code lengths for 'n' symbols with frequencies 'freq_in'
+// that are at most 'max_bits' long. The Huffman tree is built by repeatedly
+// merging the two lightest nodes; if it is too deep, the frequencies are
+// halved (keeping used symbols at a frequency of at least 1) and the tree is
+// rebuilt. At least two symbols get a code so that the code is complete.
+//
+template <int n>
+void BuildCodeLengths(const unsigned int *freq_in, int max_bits,
+                      unsigned char *lengths) {
+  unsigned int freq[n];
+  int used = 0;
+  for (int i = 0; i < n; i++) {
+    freq[i] = freq_in[i];
+    used += freq[i] ? 1 : 0;
+  }
+  for (int i = 0; i < n && used < 2; i++) {
+    if (!freq[i]) {
+      freq[i] = 1;
+      used++;
+    }
+  }
+
+  bool fits = false;
+  while (!fits) {
+    unsigned int weight[2 * n];
+    short parent[2 * n];
+    bool active[2 * n];
+    for (int i = 0; i < 2 * n; i++) {
+      weight[i] = (i < n) ? freq[i] : 0;
+      active[i] = (i < n) && freq[i];
+      parent[i] = -1;
+    }
+
+    int num_nodes = n;
+    for (int merges = 0; merges < used - 1; merges++) {
+      // find the two lightest active nodes
+      int a = -1, b = -1;
+      for (int i = 0; i < num_nodes; i++) {
+        if (!active[i]) continue;
+        if (a < 0 || weight[i] < weight[a]) {
+          b = a;
+          a = i;
+        } else if (b < 0 || weight[i] < weight[b]) {
+          b = i;
+        }
+      }
+      weight[num_nodes] = weight[a] + weight[b];
+      active[num_nodes] = true;
+      active[a] = false;
+      active[b] = false;
+      parent[a] = num_nodes;
+      parent[b] = num_nodes;
+      num_nodes++;
+    }
+
+    // the code length of a symbol is its depth in the tree
+    fits = true;
+    for (int i = 0; i < n; i++) {
+      int depth = 0;
+      for (int p = i; freq[i] && parent[p] >= 0; p = parent[p]) {
+        depth++;
+      }
+      lengths[i] = depth;
+      fits &= depth <= max_bits;
+    }
+
+    if (!fits) {
+      for (int i = 0; i < n; i++) {
+        freq[i] = freq[i] ? (freq[i] >> 1) | 1 : 0;
+      }
+    }
+  }
+}
+
+//
+// Assigns the canonical deflate codes for the given code lengths. The codes
+// are stored bit-reversed, ready to be written LSB first (like the codes in
+// static_ltree).
+//
+template <int n>
+void BuildCanonicalCodes(const unsigned char *lengths, unsigned short *codes) {
+  unsigned short bl_count[kMaxBits + 1];
+  unsigned short next_code[kMaxBits + 1];
+  for (int i = 0; i <= kMaxBits; i++) {
+    bl_count[i] = 0;
+  }
+  for (int i = 0; i < n; i++) {
+    bl_count[lengths[i]]++;
+  }
+  bl_count[0] = 0;
+
+  unsigned short code = 0;
+  for (int bits = 1; bits <= kMaxBits; bits++) {
+    code = (code + bl_count[bits - 1]) << 1;
+    next_code[bits] = code;
+  }
+
+  for (int i = 0; i < n; i++) {
+    int len = lengths[i];
+    unsigned short c = len ? next_code[len]++ : 0;
+    unsigned short reversed = 0;
+    for (int b = 0; b < len; b++) {
+      reversed = (reversed << 1) | ((c >> b) & 1);
+    }
+    codes[i] = reversed;
+  }
+}
+
+//
+// Huffman trees built for the current block, and the HufEnc interface to them
+//
+struct DynamicCoder {
+  unsigned short lit_code[kLCodes];
+  unsigned char lit_len[kLCodes];
+  unsigned short dist_code[kDCodes];
+  unsigned char dist_len[kDCodes];
+
+  int IsValid(int len, int dist, unsigned char ch) const {
+    return len != -1;
+  }
+
+  int Len(int len, int dist, unsigned char ch) const {
+    if (len == kRawBitsToken) return ch;
+    if (len == -3) return lit_len[kEndBlock];
+    if (len == -2) return 3;
+    if (len == -1) return 0;
+    if (len == 0) return lit_len[ch];
+    unsigned int lc = LengthCode(len);
+    unsigned int dc = DistCode(dist);
+    return lit_len[lc + kLiterals + 1] + LengthExtraBits(lc) + dist_len[dc] +
+           DistExtraBits(dc);
+  }
+
+  int Bits(int len, int dist, unsigned char ch) const {
+    if (len == kRawBitsToken) return (unsigned short)dist;
+    if (len == -3) return lit_code[kEndBlock];
+    if (len == -2) return ch;
+    if (len == -1) return 0;
+    if (len == 0) return lit_code[ch];
+
+    unsigned int lc = LengthCode(len);
+    unsigned int dc = DistCode(dist);
+    unsigned int bits = lit_code[lc + kLiterals + 1];
+    unsigned int pos = lit_len[lc + kLiterals + 1];
+    bits |= (len - kMinMatch - LengthBase(lc)) << pos;
+    pos += LengthExtraBits(lc);
+    bits |= (unsigned int)dist_code[dc] << pos;
+    pos += dist_len[dc];
+    bits |= (unsigned int)(dist - 1 - DistBase(dc)) << pos;
+    return bits;
+  }
+};
+
+//
+// Builds the trees for a block from its symbol frequencies, and the tokens of
+// the dynamic block header (RFC 1951, section 3.2.7). Returns the number of
+// header tokens written to 'hdr_bits'/'hdr_nbits'.
+//
+// If the block would not be smaller with its own trees (e.g. a small block,
+// where the header does not pay for itself), 'coder' gets the fixed trees
+// instead and the header is the 3 bit static block header.
+//
+int BuildDynamicTrees(const unsigned int *lit_freq,
+                      const unsigned int *dist_freq, bool last_block,
+                      DynamicCoder &coder, unsigned short *hdr_bits,
+                      unsigned char *hdr_nbits) {
+  BuildCodeLengths<kLCodes>(lit_freq, kMaxLitLenCodeBits, coder.lit_len);
+  BuildCodeLengths<kDCodes>(dist_freq, kMaxDistCodeBits, coder.dist_len);
+  BuildCanonicalCodes<kLCodes>(coder.lit_len, coder.lit_code);
+  BuildCanonicalCodes<kDCodes>(coder.dist_len, coder.dist_code);
+
+  int hlit = kLCodes;
+  while (hlit > kLiterals + 1 && coder.lit_len[hlit - 1] == 0) hlit--;
+  int hdist = kDCodes;
+  while (hdist > 1 && coder.dist_len[hdist - 1] == 0) hdist--;
+
+  // run length encode the code lengths of both trees as one sequence, into
+  // (symbol, extra bits value) pairs
+  unsigned char rle_sym[kLCodes + kDCodes];
+  unsigned char rle_extra[kLCodes + kDCodes];
+  int num_rle = 0;
+  unsigned int bl_freq[kBLCodes];
+  for (int i = 0; i < kBLCodes; i++) {
+    bl_freq[i] = 0;
+  }
+
+  const int total = hlit + hdist;
+  for (int i = 0; i < total;) {
+    auto length_at = [&](int k) {
+      return (k < hlit) ? coder.lit_len[k] : coder.dist_len[k - hlit];
+    };
+    const unsigned char cur = length_at(i);
+    int run = 1;
+    while (i + run < total && length_at(i + run) == cur) run++;
+    i += run;
+
+    if (cur != 0) {
+      // send the length once, then repeat it 3..6 times with code 16
+      rle_sym[num_rle] = cur;
+      rle_extra[num_rle++] = 0;
+      bl_freq[cur]++;
+      run--;
+      while (run >= 3) {
+        int r = (run < 6) ? run : 6;
+        rle_sym[num_rle] = 16;
+        rle_extra[num_rle++] = r - 3;
+        bl_freq[16]++;
+        run -= r;
+      }
+    } else {
+      // runs of zeros: code 17 (3..10) and code 18 (11..138)
+      while (run >= 3) {
+        int r;
+        if (run >= 11) {
+          r = (run < 138) ? run : 138;
+          rle_sym[num_rle] = 18;
+          rle_extra[num_rle++] = r - 11;
+          bl_freq[18]++;
+        } else {
+          r = run;
+          rle_sym[num_rle] = 17;
+          rle_extra[num_rle++] = r - 3;
+          bl_freq[17]++;
+        }
+        run -= r;
+      }
+    }
+    while (run > 0) {
+      rle_sym[num_rle] = cur;
+      rle_extra[num_rle++] = 0;
+      bl_freq[cur]++;
+      run--;
+    }
+  }
+
+  unsigned char bl_len[kBLCodes];
+  unsigned short bl_code[kBLCodes];
+  BuildCodeLengths<kBLCodes>(bl_freq, kMaxBLCodeBits, bl_len);
+  BuildCanonicalCodes<kBLCodes>(bl_len, bl_code);
+
+  int hclen = kBLCodes;
+  while (hclen > 4 && bl_len[kBLOrder[hclen - 1]] == 0) hclen--;
+
+  // the header tokens
+  int t = 0;
+  auto put = [&](unsigned int bits, unsigned int nbits) {
+    hdr_bits[t] = bits;
+    hdr_nbits[t++] = nbits;
+  };
+  put((2 << 1) | (last_block ? 1 : 0), 3);  // BFINAL, BTYPE = 2
+  put(hlit - (kLiterals + 1), 5);
+  put(hdist - 1, 5);
+  put(hclen - 4, 4);
+  for (int i = 0; i < hclen; i++) {
+    put(bl_len[kBLOrder[i]], 3);
+  }
+  for (int i = 0; i < num_rle; i++) {
+    const unsigned char sym = rle_sym[i];
+    const unsigned int extra_bits = (sym == 16) ? 2 : (sym == 17) ? 3
+                                  : (sym == 18) ? 7 : 0;
+    put(bl_code[sym] | (rle_extra[i] << bl_len[sym]),
+        bl_len[sym] + extra_bits);
+  }
+
+  // compare the size of the block with these trees and with the fixed trees
+  // (the extra bits of lengths and distances are the same for both)
+  unsigned char fixed_lit_len[kLCodes];
+  unsigned long long dynamic_bits = 0, static_bits = 3;
+  for (int i = 0; i < t; i++) {
+    dynamic_bits += hdr_nbits[i];
+  }
+  for (int i = 0; i < kLCodes; i++) {
+    fixed_lit_len[i] = (i < 144) ? 8 : (i < 256) ? 9 : (i < 280) ? 7 : 8;
+    dynamic_bits += (unsigned long long)lit_freq[i] * coder.lit_len[i];
+    static_bits += (unsigned long long)lit_freq[i] * fixed_lit_len[i];
+  }
+  for (int i = 0; i < kDCodes; i++) {
+    dynamic_bits += (unsigned long long)dist_freq[i] * coder.dist_len[i];
+    static_bits += (unsigned long long)dist_freq[i] * 5;
+  }
+
+  if (static_bits <= dynamic_bits) {
+    for (int i = 0; i < kLCodes; i++) {
+      coder.lit_len[i] = fixed_lit_len[i];
+    }
+    for (int i = 0; i < kDCodes; i++) {
+      coder.dist_len[i] = 5;
+    }
+    BuildCanonicalCodes<kLCodes>(coder.lit_len, coder.lit_code);
+    BuildCanonicalCodes<kDCodes>(coder.dist_len, coder.dist_code);
+
+    t = 0;
+    put((kStaticTrees << 1) | (last_block ? 1 : 0), 3);  // BTYPE = 1
+  }
+  return t;
+}
+
 template <int engineID>
 class CRC;
 template <int engineID>
@@ -708,13 +1086,15 @@ class LZReduction;
 template <int engineID>
 class StaticHuffman;
 template <int engineID>
+class DynamicHuffman;
+template <int engineID>
 void SubmitGzipTasksSingleEngine(
     queue &q,
     size_t block_size,  // size of block to compress.
     buffer<char, 1> *pibuf, buffer<char, 1> *pobuf,
     buffer<struct GzipOutInfo, 1> *gzip_out_buf,
     buffer<unsigned, 1> *result_crc, bool last_block, event &e_crc, event &e_lz,
-    event &e_huff) {
+    event &e_huff, buffer<struct DistLen, 1> *huffman_tokens) {
   using acc_dist_channel = ext::intel::pipe<class some_pipe, struct DistLen>;
   using acc_dist_channel_last = ext::intel::pipe<class some_pipe2, struct DistLen>;
 
@@ -2282,6 +2662,120 @@ void SubmitGzipTasksSingleEngine(
     });
   });
 
+#if DYNAMIC_HUFFMAN
+  if (huffman_tokens != nullptr) {
+    e_huff = q.submit([&](handler &h) {
+      auto accessor_isz = block_size;
+      auto acc_gzip_out =
+          gzip_out_buf->get_access<access::mode::discard_write>(h);
+      auto accessor_output = pobuf->get_access<access::mode::discard_write>(h);
+      auto acc_tokens =
+          huffman_tokens->get_access<access::mode::read_write>(h);
+      auto acc_eof = last_block ? 1 : 0;
+      h.single_task<DynamicHuffman<engineID>>([=
+      ]() [[intel::kernel_args_restrict]] {
+        //-------------------------------------
+        // Pass 1: store the LZ output and count the symbols
+        //-------------------------------------
+        unsigned int lit_freq[kLCodes];
+        unsigned int dist_freq[kDCodes];
+        for (int i = 0; i < kLCodes; i++) lit_freq[i] = 0;
+        for (int i = 0; i < kDCodes; i++) dist_freq[i] = 0;
+
+        // same number of LZ outputs as read by the StaticHuffman kernel
+        const int num_tokens = (accessor_isz / kVec) + 1;
+        for (int t = 0; t < num_tokens; t++) {
+          struct DistLen in = (t < num_tokens - 1)
+                                  ? acc_dist_channel::read()
+                                  : acc_dist_channel_last::read();
+          acc_tokens[t] = in;
+
+          Unroller<0, kVec>::step([&](int i) {
+            if (in.len[i] == 0) {
+              lit_freq[in.data[i]]++;
+            } else if (in.len[i] > 0) {
+              lit_freq[LengthCode(in.len[i]) + kLiterals + 1]++;
+              dist_freq[DistCode(in.dist[i])]++;
+            }
+          });
+        }
+        lit_freq[kEndBlock] = 1;
+
+        //-------------------------------------
+        // Build the trees and the block header
+        //-------------------------------------
+        DynamicCoder coder;
+        unsigned short hdr_bits[kMaxHeaderTokens];
+        unsigned char hdr_nbits[kMaxHeaderTokens];
+        const int num_hdr = BuildDynamicTrees(lit_freq, dist_freq, acc_eof,
+                                              coder, hdr_bits, hdr_nbits);
+        const int hdr_steps = (num_hdr + kVec - 1) / kVec;
+
+        //-------------------------------------
+        // Pass 2: encode the header, the stored LZ output, the end of block
+        // marker, and flush the remaining bits
+        //-------------------------------------
+        unsigned int leftover[kVec] = {0};
+        Unroller<0, kVec>::step([&](int i) { leftover[i] = 0; });
+        unsigned short leftover_size = 0;
+        unsigned int outpos_huffman = 0;
+        int odx = 0;
+
+        const int num_steps = hdr_steps + num_tokens + 2;
+        for (int step = 0; step < num_steps; step++) {
+          struct DistLen in;
+          Unroller<0, kVec>::step([&](int i) {
+            in.len[i] = -1;
+            in.dist[i] = -1;
+            in.data[i] = 0;
+          });
+
+          const int t = step - hdr_steps;
+          if (step < hdr_steps) {
+            Unroller<0, kVec>::step([&](int i) {
+              const int k = step * kVec + i;
+              if (k < num_hdr) {
+                in.len[i] = kRawBitsToken;
+                in.dist[i] = hdr_bits[k];
+                in.data[i] = hdr_nbits[k];
+              }
+            });
+          } else if (t < num_tokens) {
+            in = acc_tokens[t];
+          } else if (t == num_tokens) {
+            in.len[0] = -3;
+          }
+          const bool flush = (step == num_steps - 1);
+
+          struct HuffmanOutput outdata;
+          outdata.write = HufEnc(in.len, in.dist, in.data, outdata.data,
+                                 leftover, &leftover_size, coder);
+
+          // prevent out of bounds write
+          if ((flush || outdata.write) && (odx < accessor_isz)) {
+            Unroller<0, kVec * sizeof(unsigned int)>::step([&](int i) {
+              accessor_output[odx + i] =
+                  flush ? (unsigned char)(leftover[(i >> 2) & 0xf] >>
+                                          ((i & 3) << 3))
+                        : (unsigned char)(outdata.data[(i >> 2) & 0xf] >>
+                                          ((i & 3) << 3));
+            });
+          }
+
+          outpos_huffman = outdata.write ? outpos_huffman + 1 : outpos_huffman;
+          odx += outdata.write ? (sizeof(unsigned int) << kVecPow) : 0;
+        }
+
+        // Store summary values from lz and huffman
+        acc_gzip_out[0].compression_sz =
+            (outpos_huffman * sizeof(unsigned int) * kVec) +
+            (leftover_size + 7) / 8;
+      });
+    });
+    return;
+  }
+#endif
+
   e_huff = q.submit([&](handler &h) {
     auto accessor_isz = block_size;
     auto acc_gzip_out =
@@ -2321,7 +2815,7 @@ void SubmitGzipTasksSingleEngine(
 
         struct HuffmanOutput outdata;
         outdata.write = HufEnc(in.len, in.dist, in.data, outdata.data, leftover,
-                               &leftover_size);
+                               &leftover_size, StaticCoder());
 
         // prevent out of bounds write
         if (((ctr == 0) || outdata.write) && (odx < accessor_isz)) {
@@ -2353,19 +2847,22 @@ void SubmitGzipTasks(queue &q,
                      buffer<struct GzipOutInfo, 1> *gzip_out_buf,
                      buffer<unsigned, 1> *result_crc, bool last_block,
                      event &e_crc, event &e_lz, event &e_huff,
-                     size_t engineID) {
+                     size_t engineID,
+                     buffer<struct DistLen, 1> *huffman_tokens) {
   // Statically declare the engines so that the hardware is created for them.
   // But at run time, the host can dynamically select which engine(s) to use via
   // engineID.
   if (engineID == 0) {
     SubmitGzipTasksSingleEngine<0>(q, block_size, pibuf, pobuf, gzip_out_buf,
-                                   result_crc, last_block, e_crc, e_lz, e_huff);
+                                   result_crc, last_block, e_crc, e_lz, e_huff,
+                                   huffman_tokens);
   }
 
   #if NUM_ENGINES > 1
     if (engineID == 1) {
       SubmitGzipTasksSingleEngine<1>(q, block_size, pibuf, pobuf, gzip_out_buf,
-                                     result_crc, last_block, e_crc, e_lz, e_huff);
+                                     result_crc, last_block, e_crc, e_lz, e_huff,
+                                     huffman_tokens);
     }
   #endif
 
@@ -6,12 +6,18 @@
 
 using namespace sycl;
 
+// 'huffman_tokens' selects the Huffman encoder: nullptr uses the static
+// (fixed) Huffman trees. Otherwise it must hold (block_size / kVec) + 1
+// DistLen elements, which the dynamic Huffman encoder uses to store the LZ77
+// output while it builds Huffman trees for the block. The dynamic encoder is
+// only available when the design is compiled with DYNAMIC_HUFFMAN=1.
 extern "C" void SubmitGzipTasks(
     queue &sycl_device,
     size_t block_size,  // size of block to compress.
     buffer<char, 1> *pibuf, buffer<char, 1> *pobuf,
     buffer<struct GzipOutInfo, 1> *gzip_out_buf,
     buffer<unsigned, 1> *current_crc, bool last_block, event &e_crc,
-    event &e_lz, event &e_huff, size_t engineID);
+    event &e_lz, event &e_huff, size_t engineID,
+    buffer<struct DistLen, 1> *huffman_tokens = nullptr);
 
 #endif  //__GZIPKERNEL_H__
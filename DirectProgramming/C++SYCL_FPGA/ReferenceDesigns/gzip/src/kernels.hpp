@@ -6,6 +6,12 @@
   #define NUM_ENGINES 1
 #endif
 
+// Build the optional dynamic Huffman encoder (see DynamicHuffman in
+// gzipkernel.cpp). It is left out by default as it adds area to every engine.
+#ifndef DYNAMIC_HUFFMAN
+  #define DYNAMIC_HUFFMAN 0
+#endif
+
 // BATCH_SIZE is the number of input files the kernel should be capable of
 // compressing per invocation of the GZIP engine. This is a compile time
 // constant so that hardware is built to support this number. To ensure maximum
@@ -21,6 +27,7 @@
 #endif
 
 constexpr int kNumEngines = NUM_ENGINES;
+constexpr bool kDynamicHuffman = DYNAMIC_HUFFMAN;
 
 constexpr int kCRCIndex = 0;
 constexpr int kLZReductionIndex = 1;
@@ -125,6 +132,13 @@ constexpr int kDCodes = 30;
 // number of codes used to transfer the bit lengths
 constexpr int kBLCodes = 19;
 
+// Length limits of the codes built by the dynamic Huffman encoder. HufEnc
+// places at most 32 bits per symbol, so a match (length code and its extra
+// bit, plus distance code and up to 13 extra bits) must fit in 32 bits.
+constexpr int kMaxLitLenCodeBits = 12;
+constexpr int kMaxDistCodeBits = 6;
+constexpr int kMaxBLCodeBits = 7;
+
 constexpr int kMaxDistance = ((32 * 1024));
 
 constexpr int kMinBufferSize = 16384;
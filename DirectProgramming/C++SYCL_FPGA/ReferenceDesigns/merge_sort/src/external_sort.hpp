@@ -0,0 +1,434 @@
+#ifndef __EXTERNAL_SORT_HPP__
+#define __EXTERNAL_SORT_HPP__
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <sycl/sycl.hpp>
+
+using namespace sycl;
+
+//
+// An external (out-of-core) sort for inputs that do not fit in device memory.
+// The input is split into device-sized 'runs', which are sorted one at a time
+// by the merge sort kernels and written to a RunStore (host memory or files
+// on disk). Once all of the runs are sorted, they are merged on the host with
+// a loser tree (a k-way tournament tree).
+//
+// Sorting the runs is double-buffered: while the device sorts run 'r', the
+// input of run 'r+1' is copied to the device and run 'r-1' is copied back and
+// written to the RunStore. Reading the runs from disk during the final merge
+// is double-buffered too: while the loser tree consumes a block of a run, the
+// next block of that run is read in the background.
+//
+
+//
+// Stores the sorted runs, either in host memory or, if 'spill_dir' is not
+// empty, in one file per run in the 'spill_dir' directory.
+// Different runs can be written concurrently from different threads.
+//
+template <typename ValueT>
+class RunStore {
+ public:
+  RunStore(size_t num_runs, const std::string& spill_dir = "")
+      : spill_dir_(spill_dir), counts_(num_runs, 0) {
+    if (OnDisk()) {
+      for (size_t r = 0; r < num_runs; r++) {
+        paths_.push_back(spill_dir_ + "/merge_sort_run_" + std::to_string(r) +
+                         ".bin");
+      }
+    } else {
+      runs_.resize(num_runs);
+    }
+  }
+
+  ~RunStore() {
+    for (auto& path : paths_) {
+      std::remove(path.c_str());
+    }
+  }
+
+  RunStore(const RunStore&) = delete;
+  RunStore& operator=(const RunStore&) = delete;
+
+  bool OnDisk() const { return !spill_dir_.empty(); }
+  size_t NumRuns() const { return counts_.size(); }
+  size_t Count(size_t r) const { return counts_[r]; }
+
+  //
+  // For runs kept in host memory: returns the (resized) storage for run 'r'
+  // so that it can be written directly, e.g. by a device to host copy.
+  // Returns nullptr for runs that are stored on disk.
+  //
+  ValueT* Buffer(size_t r, size_t count) {
+    if (OnDisk()) {
+      return nullptr;
+    }
+    runs_[r].resize(count);
+    counts_[r] = count;
+    return runs_[r].data();
+  }
+
+  // the contents of run 'r', for runs kept in host memory
+  const ValueT* Data(size_t r) const { return runs_[r].data(); }
+
+  //
+  // Writes 'count' elements to run 'r'
+  //
+  void Write(size_t r, const ValueT* data, size_t count) {
+    counts_[r] = count;
+    if (!OnDisk()) {
+      runs_[r].assign(data, data + count);
+      return;
+    }
+
+    std::ofstream f(paths_[r], std::ios::binary | std::ios::trunc);
+    f.write(reinterpret_cast<const char*>(data), count * sizeof(ValueT));
+    if (!f) {
+      std::cerr << "ERROR: could not write run " << r << " to '" << paths_[r]
+                << "'\n";
+      std::terminate();
+    }
+  }
+
+  //
+  // Reads up to 'count' elements of run 'r', starting at element 'offset',
+  // into 'dst' using the stream 'f'. Returns the number of elements read.
+  //
+  size_t Read(size_t r, std::ifstream& f, size_t offset, ValueT* dst,
+              size_t count) const {
+    count = std::min(count, counts_[r] - std::min(offset, counts_[r]));
+    if (count == 0) {
+      return 0;
+    }
+    if (!OnDisk()) {
+      std::copy_n(runs_[r].data() + offset, count, dst);
+      return count;
+    }
+    if (!f.is_open()) {
+      f.open(paths_[r], std::ios::binary);
+    }
+    f.seekg(offset * sizeof(ValueT));
+    f.read(reinterpret_cast<char*>(dst), count * sizeof(ValueT));
+    if (!f) {
+      std::cerr << "ERROR: could not read run " << r << " from '" << paths_[r]
+                << "'\n";
+      std::terminate();
+    }
+    return count;
+  }
+
+ private:
+  std::string spill_dir_;
+  std::vector<size_t> counts_;
+  std::vector<std::string> paths_;
+  std::vector<std::vector<ValueT>> runs_;
+};
+
+//
+// Streams the elements of a single run out of a RunStore. Runs kept in host
+// memory are read in place. Runs on disk are read in blocks of 'block_count'
+// elements into two buffers, so that the next block is read while the current
+// one is consumed.
+//
+template <typename ValueT>
+class RunReader {
+ public:
+  RunReader(const RunStore<ValueT>& store, size_t r, size_t block_count)
+      : store_(store), r_(r), block_count_(block_count) {
+    if (!store_.OnDisk()) {
+      cur_ = store_.Data(r_);
+      cur_count_ = store_.Count(r_);
+      return;
+    }
+
+    for (auto& block : blocks_) {
+      block.resize(block_count_);
+    }
+    cur_count_ = store_.Read(r_, file_, 0, blocks_[0].data(), block_count_);
+    cur_ = blocks_[0].data();
+    next_offset_ = cur_count_;
+    Prefetch();
+  }
+
+  RunReader(RunReader&&) = default;
+
+  bool Empty() const { return pos_ == cur_count_; }
+  const ValueT& Peek() const { return cur_[pos_]; }
+
+  void Pop() {
+    if (++pos_ == cur_count_ && store_.OnDisk()) {
+      // swap to the block that was read in the background, then start
+      // reading the one after it into the buffer we just finished
+      cur_count_ = pending_.get();
+      block_idx_ ^= 1;
+      cur_ = blocks_[block_idx_].data();
+      next_offset_ += cur_count_;
+      pos_ = 0;
+      if (cur_count_ > 0) {
+        Prefetch();
+      }
+    }
+  }
+
+ private:
+  // start reading the next block into the buffer that is not being consumed
+  void Prefetch() {
+    ValueT* dst = blocks_[block_idx_ ^ 1].data();
+    size_t offset = next_offset_;
+    pending_ = std::async(std::launch::async, [this, dst, offset] {
+      return store_.Read(r_, file_, offset, dst, block_count_);
+    });
+  }
+
+  const RunStore<ValueT>& store_;
+  size_t r_;
+  size_t block_count_;
+
+  std::ifstream file_;
+  std::array<std::vector<ValueT>, 2> blocks_;
+  unsigned block_idx_ = 0;
+  std::future<size_t> pending_;
+  size_t next_offset_ = 0;
+
+  const ValueT* cur_ = nullptr;
+  size_t cur_count_ = 0;
+  size_t pos_ = 0;
+};
+
+//
+// A loser tree to merge 'k' sorted sources. Each internal node of the tree
+// holds the loser of the match played at that node and the overall winner
+// is kept at the root, so replacing the winner replays only the lg(k) matches
+// on the path from its leaf to the root, with one comparison per level.
+// Sources need Empty(), Peek() and Pop(). Ties go to the lower source index,
+// so the merge is stable with respect to the order of the sources.
+//
+template <typename Source, typename Compare>
+class LoserTree {
+ public:
+  LoserTree(std::vector<Source>& sources, Compare comp)
+      : sources_(sources), comp_(comp), k_(sources.size()), tree_(k_) {
+    if (k_ == 0) {
+      return;
+    }
+
+    // play the initial matches bottom-up. The leaves are the nodes
+    // [k, 2k) and the internal nodes are [1, k).
+    std::vector<size_t> winner(2 * k_);
+    for (size_t i = 0; i < k_; i++) {
+      winner[k_ + i] = i;
+    }
+    for (size_t node = k_ - 1; node >= 1; node--) {
+      size_t a = winner[2 * node];
+      size_t b = winner[2 * node + 1];
+      winner[node] = Beats(a, b) ? a : b;
+      tree_[node] = Beats(a, b) ? b : a;
+    }
+    tree_[0] = winner[1];
+  }
+
+  bool Empty() const { return k_ == 0 || sources_[tree_[0]].Empty(); }
+  const auto& Peek() const { return sources_[tree_[0]].Peek(); }
+
+  void Pop() {
+    size_t w = tree_[0];
+    sources_[w].Pop();
+    for (size_t node = (k_ + w) / 2; node >= 1; node /= 2) {
+      if (Beats(tree_[node], w)) {
+        std::swap(tree_[node], w);
+      }
+    }
+    tree_[0] = w;
+  }
+
+ private:
+  // whether source 'a' wins against source 'b'. Empty sources always lose.
+  bool Beats(size_t a, size_t b) const {
+    if (sources_[b].Empty()) return !sources_[a].Empty() || a < b;
+    if (sources_[a].Empty()) return false;
+    const auto& va = sources_[a].Peek();
+    const auto& vb = sources_[b].Peek();
+    return comp_(va, vb) || (!comp_(vb, va) && a < b);
+  }
+
+  std::vector<Source>& sources_;
+  Compare comp_;
+  size_t k_;
+  std::vector<size_t> tree_;
+};
+
+//
+// Merges all of the runs in 'store' into 'out' with a loser tree.
+// 'block_count' is the number of elements read at a time from runs on disk.
+//
+template <typename ValueT, typename Compare>
+void MergeRuns(const RunStore<ValueT>& store, ValueT* out, size_t block_count,
+               Compare comp) {
+  std::vector<RunReader<ValueT>> readers;
+  readers.reserve(store.NumRuns());
+  for (size_t r = 0; r < store.NumRuns(); r++) {
+    readers.emplace_back(store, r, block_count);
+  }
+
+  LoserTree<RunReader<ValueT>, Compare> tree(readers, comp);
+  size_t i = 0;
+  while (!tree.Empty()) {
+    out[i++] = tree.Peek();
+    tree.Pop();
+  }
+}
+
+//
+// Timing information for an external sort, in milliseconds
+//
+struct ExternalSortStats {
+  size_t num_runs = 0;
+  double run_time_ms = 0;    // sorting the runs on the device
+  double merge_time_ms = 0;  // the final k-way merge on the host
+  double TotalMs() const { return run_time_ms + merge_time_ms; }
+};
+
+//
+// Sorts the 'count' elements of 'in' into 'out' (both host memory) as a series
+// of runs of at most 'run_count' elements, which are written to 'store' and
+// then merged. 'run_count' must be a size the merge sort kernels can sort.
+//
+// 'submit_sort(in, out, n, deps)' launches the sort of the 'n' elements of
+// the device buffer 'in' into the device buffer 'out', with the kernels that
+// read 'in' waiting on 'deps', and returns the events of all of the kernels.
+// The device buffers are allocated here with 'malloc_host' when
+// 'use_usm_host_alloc' is true and 'malloc_device' otherwise.
+//
+template <typename ValueT, bool use_usm_host_alloc, typename SubmitSortFn,
+          typename Compare>
+ExternalSortStats ExternalSort(queue& q, const ValueT* in, ValueT* out,
+                               size_t count, size_t run_count,
+                               RunStore<ValueT>& store, size_t block_count,
+                               SubmitSortFn&& submit_sort, Compare comp) {
+  using namespace std::chrono;
+  ExternalSortStats stats;
+  stats.num_runs = store.NumRuns();
+  if (stats.num_runs != (count + run_count - 1) / run_count) {
+    std::cerr << "ERROR: the RunStore does not have the right number of runs "
+              << "for 'count' and 'run_count'\n";
+    std::terminate();
+  }
+
+  // the double-buffered device input and output buffers for the runs, and
+  // the host staging buffers for the runs that are written to disk
+  std::array<ValueT*, 2> in_dev, out_dev;
+  std::array<std::vector<ValueT>, 2> staging;
+  for (int slot = 0; slot < 2; slot++) {
+    if constexpr (use_usm_host_alloc) {
+      in_dev[slot] = malloc_host<ValueT>(run_count, q);
+      out_dev[slot] = malloc_host<ValueT>(run_count, q);
+    } else {
+      in_dev[slot] = malloc_device<ValueT>(run_count, q);
+      out_dev[slot] = malloc_device<ValueT>(run_count, q);
+    }
+    if (in_dev[slot] == nullptr || out_dev[slot] == nullptr) {
+      std::cerr << "ERROR: could not allocate space for the external sort "
+                << "run buffers\n";
+      std::terminate();
+    }
+    if (store.OnDisk()) {
+      staging[slot].resize(run_count);
+    }
+  }
+
+  auto run_size = [&](size_t r) {
+    return std::min(run_count, count - r * run_count);
+  };
+
+  // copy the input of run 'r' to its device buffer
+  auto copy_in = [&](size_t r) {
+    return q.memcpy(in_dev[r & 1], in + r * run_count,
+                    run_size(r) * sizeof(ValueT));
+  };
+
+  auto start = high_resolution_clock::now();
+
+  // the events of the copies in and out of each slot, and the writes of the
+  // staging buffers to disk
+  std::array<event, 2> copy_in_events, copy_out_events;
+  std::array<std::future<void>, 2> spills;
+  copy_in_events[0] = copy_in(0);
+
+  for (size_t r = 0; r < stats.num_runs; r++) {
+    const int slot = r & 1;
+
+    // start copying the input of the next run. Its slot was last used by run
+    // r-1, which has finished.
+    if (r + 1 < stats.num_runs) {
+      copy_in_events[slot ^ 1] = copy_in(r + 1);
+    }
+
+    // the output buffer of this slot is free once run r-2 was copied out
+    if (r >= 2) {
+      copy_out_events[slot].wait();
+    }
+
+    // sort this run on the device
+    auto sort_events =
+        submit_sort(in_dev[slot], out_dev[slot], run_size(r),
+                    std::vector<event>{copy_in_events[slot]});
+    for (auto& e : sort_events) {
+      e.wait();
+    }
+
+    // copy the sorted run back to the host. Runs in host memory are copied
+    // straight into the store. Runs on disk go through the staging buffer of
+    // this slot, which is written to disk in the background once run r-2 was
+    // written from it.
+    if (!store.OnDisk()) {
+      copy_out_events[slot] = q.memcpy(store.Buffer(r, run_size(r)),
+                                       out_dev[slot],
+                                       run_size(r) * sizeof(ValueT));
+    } else {
+      if (spills[slot].valid()) {
+        spills[slot].get();
+      }
+      copy_out_events[slot] = q.memcpy(staging[slot].data(), out_dev[slot],
+                                       run_size(r) * sizeof(ValueT));
+      spills[slot] = std::async(
+          std::launch::async, [&store, &staging, slot, r, n = run_size(r),
+                               e = copy_out_events[slot]]() mutable {
+            e.wait();
+            store.Write(r, staging[slot].data(), n);
+          });
+    }
+  }
+
+  // wait for the last runs to be copied out and written
+  for (int slot = 0; slot < 2; slot++) {
+    copy_out_events[slot].wait();
+    if (spills[slot].valid()) {
+      spills[slot].get();
+    }
+  }
+  auto runs_done = high_resolution_clock::now();
+
+  // merge the sorted runs
+  MergeRuns(store, out, block_count, comp);
+  auto end = high_resolution_clock::now();
+
+  for (int slot = 0; slot < 2; slot++) {
+    sycl::free(in_dev[slot], q);
+    sycl::free(out_dev[slot], q);
+  }
+
+  stats.run_time_ms =
+      duration<double, std::milli>(runs_done - start).count();
+  stats.merge_time_ms = duration<double, std::milli>(end - runs_done).count();
+  return stats;
+}
+
+#endif /* __EXTERNAL_SORT_HPP__ */
@@ -0,0 +1,131 @@
+#ifndef __KEY_VALUE_HPP__
+#define __KEY_VALUE_HPP__
+
+#include <iostream>
+#include <limits>
+#include <type_traits>
+
+//
+// Record types to sort key/value pairs by key with the merge sort kernels.
+// The payload travels through the same pipes and sorting networks as the key,
+// so no separate index sort or gather is needed.
+//
+// The merge sort is not stable: records with equal keys may come out in any
+// order. 'StableKeyValue' also carries the record's position in the input.
+// Comparing records by (key, position) makes every record distinct, so the
+// sort's output is the stable order (i.e., what std::stable_sort produces).
+// The position is filled in by the kernel that feeds the sorter.
+//
+template <typename KeyT, typename PayloadT>
+struct KeyValue {
+  KeyT key;
+  PayloadT payload;
+};
+
+template <typename KeyT, typename PayloadT, typename PositionT>
+struct StableKeyValue {
+  KeyT key;
+  PayloadT payload;
+  PositionT position;
+};
+
+template <typename T>
+struct IsStableKeyValue : std::false_type {};
+template <typename KeyT, typename PayloadT, typename PositionT>
+struct IsStableKeyValue<StableKeyValue<KeyT, PayloadT, PositionT>>
+    : std::true_type {};
+
+///////////////////////////////////////////////////////////////
+// Comparators for the records
+struct KeyLessThan {
+  template <class T>
+  bool operator()(T const& a, T const& b) const {
+    return a.key < b.key;
+  }
+};
+
+struct KeyGreaterThan {
+  template <class T>
+  bool operator()(T const& a, T const& b) const {
+    return a.key > b.key;
+  }
+};
+
+// NOTE: the position breaks ties in input order for both directions
+struct StableKeyLessThan {
+  template <class T>
+  bool operator()(T const& a, T const& b) const {
+    return (a.key < b.key) || (a.key == b.key && a.position < b.position);
+  }
+};
+
+struct StableKeyGreaterThan {
+  template <class T>
+  bool operator()(T const& a, T const& b) const {
+    return (a.key > b.key) || (a.key == b.key && a.position < b.position);
+  }
+};
+///////////////////////////////////////////////////////////////
+
+//
+// The element that sorts after every other element when sorting from smallest
+// to largest, used to pad the input up to a power of 2.
+// NOTE: without a position, a padding record ties with the real records whose
+// key is the maximum key. Those records could be swapped for padding in the
+// output, so the unstable key/value sort must not be given the maximum key.
+//
+template <typename T>
+T MaxElement() {
+  if constexpr (std::is_arithmetic_v<T>) {
+    return std::numeric_limits<T>::max();
+  } else if constexpr (IsStableKeyValue<T>::value) {
+    T ret{};
+    ret.key = std::numeric_limits<decltype(ret.key)>::max();
+    ret.position = std::numeric_limits<decltype(ret.position)>::max();
+    return ret;
+  } else {
+    T ret{};
+    ret.key = std::numeric_limits<decltype(ret.key)>::max();
+    return ret;
+  }
+}
+
+///////////////////////////////////////////////////////////////
+// Operators used by the host code to check and print results
+template <typename KeyT, typename PayloadT>
+bool operator==(const KeyValue<KeyT, PayloadT>& a,
+                const KeyValue<KeyT, PayloadT>& b) {
+  return a.key == b.key && a.payload == b.payload;
+}
+
+template <typename KeyT, typename PayloadT>
+bool operator!=(const KeyValue<KeyT, PayloadT>& a,
+                const KeyValue<KeyT, PayloadT>& b) {
+  return !(a == b);
+}
+
+template <typename KeyT, typename PayloadT, typename PositionT>
+bool operator==(const StableKeyValue<KeyT, PayloadT, PositionT>& a,
+                const StableKeyValue<KeyT, PayloadT, PositionT>& b) {
+  return a.key == b.key && a.payload == b.payload;
+}
+
+template <typename KeyT, typename PayloadT, typename PositionT>
+bool operator!=(const StableKeyValue<KeyT, PayloadT, PositionT>& a,
+                const StableKeyValue<KeyT, PayloadT, PositionT>& b) {
+  return !(a == b);
+}
+
+template <typename KeyT, typename PayloadT>
+std::ostream& operator<<(std::ostream& os, const KeyValue<KeyT, PayloadT>& r) {
+  return os << "{" << r.key << ", " << r.payload << "}";
+}
+
+template <typename KeyT, typename PayloadT, typename PositionT>
+std::ostream& operator<<(std::ostream& os,
+                         const StableKeyValue<KeyT, PayloadT, PositionT>& r) {
+  return os << "{" << r.key << ", " << r.payload << "}";
+}
+///////////////////////////////////////////////////////////////
+
+#endif /* __KEY_VALUE_HPP__ */
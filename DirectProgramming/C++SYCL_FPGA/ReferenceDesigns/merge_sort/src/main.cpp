@@ -3,6 +3,7 @@
 #include <chrono>
 #include <limits>
 #include <numeric>
+#include <string>
 #include <type_traits>
 #include <utility>
 #include <vector>
@@ -12,6 +13,8 @@
 
 #include "exception_handler.hpp"
 
+#include "external_sort.hpp"
+#include "key_value.hpp"
 #include "merge_sort.hpp"
 
 // Included from DirectProgramming/C++SYCL_FPGA/include/
@@ -50,19 +53,47 @@ constexpr size_t kSortWidth = SORT_WIDTH;
 static_assert(kSortWidth >= 1);
 static_assert(fpga_tools::IsPow2(kSortWidth));
 
+// The type of the elements to sort and how to compare them.
+// Defining the preprocessor macro 'KEY_VALUE' sorts key/value records by key,
+// and defining 'STABLE_SORT' sorts key/value records stably
+// (see key_value.hpp). Otherwise, plain integers are sorted.
+#if defined(STABLE_SORT)
+using SortValueT = StableKeyValue<int, int, unsigned int>;
+using SortCompare = StableKeyLessThan;
+constexpr const char *kSortMode = "stable key/value";
+#elif defined(KEY_VALUE)
+using SortValueT = KeyValue<int, int>;
+using SortCompare = KeyLessThan;
+constexpr const char *kSortMode = "key/value";
+#else
+using SortValueT = int;
+using SortCompare = LessThan;
+constexpr const char *kSortMode = "value";
+#endif
+
 ////////////////////////////////////////////////////////////////////////////////
 // Forward declare functions used in this file by main()
 template <typename ValueT, typename IndexT, typename KernelPtrType>
 double FPGASort(queue &q, ValueT *in_vec, ValueT *out_vec, IndexT count);
 
+template <typename ValueT, typename IndexT, typename KernelPtrType>
+bool RunExternalSort(queue &q, size_t count, IndexT run_count,
+                     const std::string &spill_dir, int runs, int seed);
+
+template <typename T>
+void GenerateData(std::vector<T> &in_vec, std::vector<T> &ref, int seed);
+
+template <typename T>
+bool CheckOutput(std::vector<T> &out_vec, std::vector<T> &ref);
+
 template <typename T>
-bool Validate(T *val, T *ref, unsigned int count);
+bool Validate(T *val, T *ref, size_t count);
 ////////////////////////////////////////////////////////////////////////////////
 
 
 int main(int argc, char *argv[]) {
   // the type to sort, needs a compare function!
-  using ValueT = int;
+  using ValueT = SortValueT;
 
   // the type used to index in the sorter
   // below we do a runtime check to make sure this type has enough bits to
@@ -82,19 +113,52 @@ int main(int argc, char *argv[]) {
 #endif
   int seed = 777;
 
+  // '--external[=<run size>]' sorts the input as a series of runs of
+  // <run size> elements that are merged on the host (see external_sort.hpp),
+  // so that 'count' is not limited by the device memory.
+  // '--spill-dir=<dir>' writes those runs to files in <dir> instead of keeping
+  // them in host memory.
+  bool external = false;
+#ifdef FPGA_EMULATOR
+  IndexT run_count = 64;
+#else
+  IndexT run_count = 1 << 24;
+#endif
+  std::string spill_dir;
+
+  // the remaining arguments are positional
+  std::vector<std::string> args;
+  for (int i = 1; i < argc; i++) {
+    std::string arg(argv[i]);
+    if (arg == "--external") {
+      external = true;
+    } else if (arg.rfind("--external=", 0) == 0) {
+      external = true;
+      run_count = atoi(arg.substr(11).c_str());
+    } else if (arg.rfind("--spill-dir=", 0) == 0) {
+      spill_dir = arg.substr(12);
+    } else {
+      args.push_back(arg);
+    }
+  }
+
+  // by default, sort 4.5 runs worth of data in external mode
+  size_t external_count = size_t(run_count) * 4 + run_count / 2;
+
   // get the size of the input as the first command line argument
-  if (argc > 1) {
-    count = atoi(argv[1]);
+  if (args.size() > 0) {
+    count = atoi(args[0].c_str());
+    external_count = strtoull(args[0].c_str(), nullptr, 10);
   }
 
   // get the number of runs as the second command line argument
-  if (argc > 2) {
-    runs = atoi(argv[2]);
+  if (args.size() > 1) {
+    runs = atoi(args[1].c_str());
   }
 
   // get the random number generator seed as the third command line argument
-  if (argc > 3) {
-    seed = atoi(argv[3]);
+  if (args.size() > 2) {
+    seed = atoi(args[2].c_str());
   }
 
   // enforce at least two runs
@@ -104,7 +168,9 @@ int main(int argc, char *argv[]) {
   }
 
   // check args
-  if (count <= kMergeUnits) {
+  if (external) {
+    // checked by RunExternalSort
+  } else if (count <= kMergeUnits) {
     std::cerr << "ERROR: 'count' must be greater than number of merge units\n";
     std::terminate();
   } else if (count > std::numeric_limits<IndexT>::max()) {
@@ -143,16 +209,30 @@ int main(int argc, char *argv[]) {
     std::terminate();
   }
 
+  // the pointer type for the kernel depends on whether data is coming from
+  // USM host or device allocations
+  using KernelPtrType =
+      typename std::conditional_t<kUseUSMHostAllocation, host_ptr<ValueT>,
+                                  device_ptr<ValueT>>;
+
+  // the external sort generates and checks its own data
+  if (external) {
+    try {
+      passed = RunExternalSort<ValueT, IndexT, KernelPtrType>(
+          q, external_count, run_count, spill_dir, runs, seed);
+    } catch (exception const &e) {
+      std::cout << "Caught a synchronous SYCL exception: " << e.what() << "\n";
+      std::terminate();
+    }
+    std::cout << (passed ? "PASSED\n" : "FAILED\n");
+    return passed ? 0 : 1;
+  }
+
   // the input, output, and reference data
   std::vector<ValueT> in_vec(count), out_vec(count), ref(count);
 
-  // generate some random input data
-  srand(seed);
-  std::generate(in_vec.begin(), in_vec.end(), [] { return rand() % 100; });
-
-  // copy the input to the output reference and compute the expected result
-  std::copy(in_vec.begin(), in_vec.end(), ref.begin());
-  std::sort(ref.begin(), ref.end());
+  // generate some random input data and compute the expected result
+  GenerateData(in_vec, ref, seed);
 
   // allocate the input and output data either in USM host or device allocations
   ValueT *in, *out;
@@ -198,18 +278,13 @@ int main(int argc, char *argv[]) {
   std::vector<double> time(runs);
 
   try {
-    std::cout << "Running sort " << runs << " times for an "
-              << "input size of " << count << " using " << kMergeUnits
-              << " " << kSortWidth << "-way merge units\n";
+    std::cout << "Running " << kSortMode << " sort " << runs << " times for "
+              << "an input size of " << count << " (" << sizeof(ValueT)
+              << " bytes per element) using " << kMergeUnits << " "
+              << kSortWidth << "-way merge units\n";
     std::cout << "Streaming data from "
               << (kUseUSMHostAllocation ? "host" : "device") << " memory\n";
 
-    // the pointer type for the kernel depends on whether data is coming from
-    // USM host or device allocations
-    using KernelPtrType =
-        typename std::conditional_t<kUseUSMHostAllocation, host_ptr<ValueT>,
-                                    device_ptr<ValueT>>;
-
     // run the sort multiple times to increase the accuracy of the timing
     for (int i = 0; i < runs; i++) {
       // run the sort
@@ -223,7 +298,7 @@ int main(int argc, char *argv[]) {
       q.memcpy(out_vec.data(), out, count * sizeof(ValueT)).wait();
 
       // validate the output
-      passed &= Validate(out_vec.data(), ref.data(), count);
+      passed &= CheckOutput(out_vec, ref);
     }
   } catch (exception const &e) {
     std::cout << "Caught a synchronous SYCL exception: " << e.what() << "\n";
@@ -245,7 +320,9 @@ int main(int argc, char *argv[]) {
 
     std::cout << "Execution time: " << avg_time_ms << " ms\n";
     std::cout << "Throughput: " << (input_count_mega / (avg_time_ms * 1e-3))
-              << " Melements/s\n";
+              << " Melements/s ("
+              << (count * sizeof(ValueT) * 1e-6 / (avg_time_ms * 1e-3))
+              << " MB/s)\n";
 
     std::cout << "PASSED\n";
     return 0;
@@ -262,47 +339,39 @@ class SortInPipeID;
 class SortOutPipeID;
 
 //
-// perform the actual sort on the FPGA.
+// submit the kernels to sort 'count' elements from 'in_ptr' into 'out_ptr',
+// using 'buf_0' and 'buf_1' (of 'sorter_count' elements each) as temporary
+// storage for the merge sort. The input kernel waits on 'deps' before reading
+// 'in_ptr'. Returns the events of the input kernel, the output kernel and
+// then all of the merge sort kernels.
 //
 template <typename ValueT, typename IndexT, typename KernelPtrType>
-double FPGASort(queue &q, ValueT *in_ptr, ValueT *out_ptr, IndexT count) {
+std::vector<event> SubmitFPGASort(queue &q, ValueT *in_ptr, ValueT *out_ptr,
+                                  IndexT count, IndexT sorter_count,
+                                  ValueT *buf_0, ValueT *buf_1,
+                                  const std::vector<event> &deps = {}) {
   // the input and output pipe for the sorter
   using SortInPipe =
-      sycl::ext::intel::pipe<SortInPipeID, sycl::vec<ValueT, kSortWidth>>;
+      sycl::ext::intel::pipe<SortInPipeID, SortVec<ValueT, kSortWidth>>;
   using SortOutPipe =
-      sycl::ext::intel::pipe<SortOutPipeID, sycl::vec<ValueT, kSortWidth>>;
-
-  // the sorter must sort a power of 2, so round up the requested count
-  // to the nearest power of 2; we will pad the input to make sure the
-  // output is still correct
-  const IndexT sorter_count = fpga_tools::RoundUpPow2(count);
-
-  // allocate some memory for the merge sort to use as temporary storage
-  ValueT *buf_0, *buf_1;
-  if ((buf_0 = malloc_device<ValueT>(sorter_count, q)) == nullptr) {
-    std::cerr << "ERROR: could not allocate memory for 'buf_0'\n";
-    std::terminate();
-  }
-  if ((buf_1 = malloc_device<ValueT>(sorter_count, q)) == nullptr) {
-    std::cerr << "ERROR: could not allocate memory for 'buf_1'\n";
-    std::terminate();
-  }
+      sycl::ext::intel::pipe<SortOutPipeID, SortVec<ValueT, kSortWidth>>;
 
   // This is the element we will pad the input with. In the case of this design,
   // we are sorting from smallest to largest and we want the last elements out
   // to be this element, so pad with MAX. If you are sorting from largest to
   // smallest, make this the MIN element. If you are sorting custom types
-  // which are not supported by std::numeric_limits, then you will have to set
-  // this padding element differently.
-  const auto padding_element = std::numeric_limits<ValueT>::max();
+  // which are not supported by MaxElement (see key_value.hpp), then you will
+  // have to set this padding element differently.
+  const auto padding_element = MaxElement<ValueT>();
 
   // We are sorting kSortWidth elements per cycle, so we will have 
   // sorter_count/kSortWidth pipe reads/writes from/to the sorter
   const IndexT total_pipe_accesses = sorter_count / kSortWidth;
 
   // launch the kernel that provides data into the sorter
-  auto input_kernel_event =
-    q.single_task<InputKernelID>([=]() [[intel::kernel_args_restrict]] {
+  auto input_kernel_event = q.submit([&](handler &h) {
+    h.depends_on(deps);
+    h.single_task<InputKernelID>([=]() [[intel::kernel_args_restrict]] {
       // read from the input pointer and write it to the sorter's input pipe
       KernelPtrType in(in_ptr);
 
@@ -311,16 +380,24 @@ double FPGASort(queue &q, ValueT *in_ptr, ValueT *out_ptr, IndexT count) {
         bool in_range = i * kSortWidth < count;
 
         // build the input pipe data
-        sycl::vec<ValueT, kSortWidth> data;
+        SortVec<ValueT, kSortWidth> data;
         #pragma unroll
         for (unsigned char j = 0; j < kSortWidth; j++) {
           data[j] = in_range ? in[i * kSortWidth + j] : padding_element;
+
+          // stable records are tagged with their position in the input
+          if constexpr (IsStableKeyValue<ValueT>::value) {
+            if (in_range) {
+              data[j].position = i * kSortWidth + j;
+            }
+          }
         }
 
         // write it into the sorter
         SortInPipe::write(data);
       }
     });
+  });
 
   // launch the kernel that reads out data from the sorter
   auto output_kernel_event =
@@ -349,16 +426,47 @@ double FPGASort(queue &q, ValueT *in_ptr, ValueT *out_ptr, IndexT count) {
   // launch the merge sort kernels
   auto merge_sort_events =
       SubmitMergeSort<ValueT, IndexT, SortInPipe, SortOutPipe, kSortWidth,
-                      kMergeUnits>(q, sorter_count, buf_0, buf_1);
+                      kMergeUnits>(q, sorter_count, buf_0, buf_1,
+                                   SortCompare());
+
+  std::vector<event> ret = {input_kernel_event, output_kernel_event};
+  ret.insert(ret.end(), merge_sort_events.begin(), merge_sort_events.end());
+  return ret;
+}
+
+//
+// perform the actual sort on the FPGA.
+//
+template <typename ValueT, typename IndexT, typename KernelPtrType>
+double FPGASort(queue &q, ValueT *in_ptr, ValueT *out_ptr, IndexT count) {
+  // the sorter must sort a power of 2, so round up the requested count
+  // to the nearest power of 2; we will pad the input to make sure the
+  // output is still correct
+  const IndexT sorter_count = fpga_tools::RoundUpPow2(count);
+
+  // allocate some memory for the merge sort to use as temporary storage
+  ValueT *buf_0, *buf_1;
+  if ((buf_0 = malloc_device<ValueT>(sorter_count, q)) == nullptr) {
+    std::cerr << "ERROR: could not allocate memory for 'buf_0'\n";
+    std::terminate();
+  }
+  if ((buf_1 = malloc_device<ValueT>(sorter_count, q)) == nullptr) {
+    std::cerr << "ERROR: could not allocate memory for 'buf_1'\n";
+    std::terminate();
+  }
+
+  // launch the input, output and merge sort kernels
+  auto events = SubmitFPGASort<ValueT, IndexT, KernelPtrType>(
+      q, in_ptr, out_ptr, count, sorter_count, buf_0, buf_1);
 
   // wait for the input and output kernels to finish
   auto start = high_resolution_clock::now();
-  input_kernel_event.wait();
-  output_kernel_event.wait();
+  events[0].wait();
+  events[1].wait();
   auto end = high_resolution_clock::now();
 
   // wait for the merge sort kernels to finish
-  for (auto &e : merge_sort_events) {
+  for (auto &e : events) {
     e.wait();
   }
 
@@ -371,12 +479,160 @@ double FPGASort(queue &q, ValueT *in_ptr, ValueT *out_ptr, IndexT count) {
   return diff.count();
 }
 
+//
+// Sort 'count' elements, which may be more than fit in device memory, with an
+// external sort: the input is sorted in runs of 'run_count' elements on the
+// FPGA and the sorted runs are merged on the host. See external_sort.hpp.
+// The runs are kept in host memory, or written to files in 'spill_dir' if it
+// is not empty. Returns true if every iteration produced the right result.
+//
+template <typename ValueT, typename IndexT, typename KernelPtrType>
+bool RunExternalSort(queue &q, size_t count, IndexT run_count,
+                     const std::string &spill_dir, int runs, int seed) {
+  // check args
+  if (!fpga_tools::IsPow2(run_count)) {
+    std::cerr << "ERROR: the external sort run size must be a power of 2\n";
+    std::terminate();
+  } else if (run_count < 4 * kMergeUnits ||
+             (run_count / kMergeUnits) <= kSortWidth) {
+    std::cerr << "ERROR: the external sort run size must be at least 4x the "
+              << "number of merge units and more than " << kSortWidth
+              << " elements per merge unit\n";
+    std::terminate();
+  } else if ((count % kSortWidth) != 0) {
+    std::cerr << "ERROR: 'count' must be a multiple of the sorter width\n";
+    std::terminate();
+  }
+
+  // the input, output, and reference data
+  std::vector<ValueT> in_vec(count), out_vec(count), ref(count);
+  GenerateData(in_vec, ref, seed);
+
+  // the merge sort temporary buffers are shared by all of the runs
+  ValueT *buf_0, *buf_1;
+  if ((buf_0 = malloc_device<ValueT>(run_count, q)) == nullptr) {
+    std::cerr << "ERROR: could not allocate memory for 'buf_0'\n";
+    std::terminate();
+  }
+  if ((buf_1 = malloc_device<ValueT>(run_count, q)) == nullptr) {
+    std::cerr << "ERROR: could not allocate memory for 'buf_1'\n";
+    std::terminate();
+  }
+
+  // sort a single run on the FPGA
+  auto submit_sort = [&](ValueT *in, ValueT *out, size_t n,
+                         const std::vector<event> &deps) {
+    return SubmitFPGASort<ValueT, IndexT, KernelPtrType>(
+        q, in, out, IndexT(n), run_count, buf_0, buf_1, deps);
+  };
+
+  // read the runs from disk 1 MB at a time during the merge
+  constexpr size_t kMergeBlockCount = (1 << 20) / sizeof(ValueT);
+
+  const size_t num_runs = (count + run_count - 1) / run_count;
+  std::cout << "Running external " << kSortMode << " sort " << runs
+            << " times for an input size of " << count << " in " << num_runs
+            << " runs of " << run_count << " elements using " << kMergeUnits
+            << " " << kSortWidth << "-way merge units\n";
+  std::cout << "Storing the sorted runs in "
+            << (spill_dir.empty() ? "host memory" : "'" + spill_dir + "'")
+            << "\n";
+
+  // The positions of stable records are relative to their run, so the runs
+  // are merged by key only. The loser tree breaks ties in run order, which
+  // keeps the merge stable.
+  using MergeCompare =
+      std::conditional_t<IsStableKeyValue<ValueT>::value, KeyLessThan,
+                         SortCompare>;
+
+  bool passed = true;
+  std::vector<ExternalSortStats> stats(runs);
+  for (int i = 0; i < runs; i++) {
+    RunStore<ValueT> store(num_runs, spill_dir);
+    stats[i] = ExternalSort<ValueT, kUseUSMHostAllocation>(
+        q, in_vec.data(), out_vec.data(), count, run_count, store,
+        kMergeBlockCount, submit_sort, MergeCompare());
+    passed &= CheckOutput(out_vec, ref);
+  }
+
+  sycl::free(buf_0, q);
+  sycl::free(buf_1, q);
+
+  // print the performance results, skipping the first iteration
+  if (passed) {
+    double run_ms = 0, merge_ms = 0;
+    for (int i = 1; i < runs; i++) {
+      run_ms += stats[i].run_time_ms / (runs - 1);
+      merge_ms += stats[i].merge_time_ms / (runs - 1);
+    }
+    double total_ms = run_ms + merge_ms;
+    std::cout << "Run generation time: " << run_ms << " ms\n";
+    std::cout << "Merge time: " << merge_ms << " ms\n";
+    std::cout << "Execution time: " << total_ms << " ms\n";
+    std::cout << "Throughput: " << ((count * 1e-6) / (total_ms * 1e-3))
+              << " Melements/s\n";
+  }
+  return passed;
+}
+
+//
+// Generate random input data and the expected output of the sort.
+// Keys are in [0, 100), so there are many equal keys. The payload of a
+// key/value record is its position in the input, so that the order of the
+// records with equal keys can be checked.
+//
+template <typename T>
+void GenerateData(std::vector<T> &in_vec, std::vector<T> &ref, int seed) {
+  srand(seed);
+  for (size_t i = 0; i < in_vec.size(); i++) {
+    if constexpr (!std::is_arithmetic_v<T>) {
+      in_vec[i] = T{};
+      in_vec[i].key = rand() % 100;
+      in_vec[i].payload = i;
+    } else {
+      in_vec[i] = rand() % 100;
+    }
+  }
+
+  // copy the input to the output reference and compute the expected result
+  std::copy(in_vec.begin(), in_vec.end(), ref.begin());
+  if constexpr (!std::is_arithmetic_v<T>) {
+    std::stable_sort(ref.begin(), ref.end(), KeyLessThan());
+  } else {
+    std::sort(ref.begin(), ref.end());
+  }
+}
+
+//
+// Check the output of the sort against the reference
+//
+template <typename T>
+bool CheckOutput(std::vector<T> &out_vec, std::vector<T> &ref) {
+  if constexpr (!std::is_arithmetic_v<T> && !IsStableKeyValue<T>::value) {
+    // The unstable sort may put records with equal keys in any order, so put
+    // them back in input order (i.e., by payload) to compare with 'ref'.
+    // This does not hide a bad sort, since it only reorders records with
+    // equal keys.
+    auto first = out_vec.begin();
+    while (first != out_vec.end()) {
+      auto last = std::find_if(first, out_vec.end(), [&](const T &r) {
+        return r.key != first->key;
+      });
+      std::sort(first, last, [](const T &a, const T &b) {
+        return a.payload < b.payload;
+      });
+      first = last;
+    }
+  }
+  return Validate(out_vec.data(), ref.data(), out_vec.size());
+}
+
 //
 // simple function to check if two regions of memory contain the same values
 //
 template <typename T>
-bool Validate(T *val, T *ref, unsigned int count) {
-  for (unsigned int i = 0; i < count; i++) {
+bool Validate(T *val, T *ref, size_t count) {
+  for (size_t i = 0; i < count; i++) {
     if (val[i] != ref[i]) {
       std::cout << "ERROR: mismatch at entry " << i << "\n";
       std::cout << "\t" << val[i] << " != " << ref[i]
@@ -32,7 +32,7 @@ event Merge(queue& q, IndexT total_count, IndexT in_count,
 
   return q.single_task<Id>([=] {
     // the two input and feedback buffers
-    sycl::vec<ValueT, k_width> a, b, network_feedback;
+    SortVec<ValueT, k_width> a, b, network_feedback;
 
     bool drain_a = false;
     bool drain_b = false;
@@ -90,7 +90,7 @@ event Merge(queue& q, IndexT total_count, IndexT in_count,
       auto chosen_data_in = choose_a ? a : b;
 
       // create input for merge sort network sorter network
-      sycl::vec<ValueT, k_width * 2> merge_sort_network_data;
+      SortVec<ValueT, k_width * 2> merge_sort_network_data;
       #pragma unroll
       for (unsigned char i = 0; i < k_width; i++) {
         // populate the k_width*2 sized input for the merge sort network
@@ -115,7 +115,7 @@ event Merge(queue& q, IndexT total_count, IndexT in_count,
         b_valid = choose_a;
         first_in_buffer = false;
       } else {
-        sycl::vec<ValueT, k_width> out_data;
+        SortVec<ValueT, k_width> out_data;
         if (written_out_inner == out_count - k_width) {
           // on the last iteration for a set of sublists, the feedback
           // is the only data left that is valid, so it goes to the output
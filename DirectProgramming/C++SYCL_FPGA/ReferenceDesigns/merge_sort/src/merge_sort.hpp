@@ -95,7 +95,7 @@ std::vector<event> SubmitMergeSort(queue& q, size_t count, ValueT* buf_0,
   constexpr size_t kDefPipeDepth = 0;
 
   // the type that is passed around the pipes
-  using PipeType = sycl::vec<ValueT, k_width>;
+  using PipeType = SortVec<ValueT, k_width>;
 
   // the pipes connecting the different kernels of each merge unit
   // one set of pipes for each 'units' merge units
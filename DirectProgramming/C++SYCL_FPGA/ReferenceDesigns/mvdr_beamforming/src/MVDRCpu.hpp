@@ -0,0 +1,416 @@
+#ifndef __MVDR_CPU_HPP__
+#define __MVDR_CPU_HPP__
+
+#define _USE_MATH_DEFINES
+#include <cmath>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// utility classes
+#include "mvdr_complex.hpp"
+#include "tuple.hpp"  // DirectProgramming/C++SYCL_FPGA/include
+
+// The timing of a run of the CPU engine
+// The latency is the time taken to process one training matrix and its xrx
+// vectors, from the start of its QRD to its last output.
+struct MVDRCpuStats {
+  size_t matrices = 0;          // training matrices processed
+  double time_s = 0.0;          // wall clock time of the whole run
+  double min_latency_ms = 0.0;
+  double avg_latency_ms = 0.0;
+  double max_latency_ms = 0.0;
+};
+
+// MVDRCpu
+// A multithreaded host (CPU) implementation of the MVDR processing done by the
+// kernels launched by SubmitMVDRKernels (MVDR.hpp), for systems without an
+// FPGA. It consumes the same input stream as the DataInPipe (training and xrx
+// data, with the same headers), and produces the same output as the
+// DataOutPipe, so the data of the FakeIOPipes producer and consumer can be
+// used as is.
+//
+// Each stage is a function named after the kernel it replaces. The stream is
+// split into 'sets' (a training matrix and the xrx vectors it is used for) by
+// InputDemux, and the sets are shared between the threads, each set being
+// processed by a single thread.
+// Complex vectors are stored as separate arrays of real and imaginary parts,
+// so the inner loops of the stages can be vectorized by the compiler.
+template <
+    size_t k_num_sensor_inputs,     // number of sensor array inputs
+    size_t k_rmb_factor,            // Reed-Mallett-Brennan rule
+                                    // Number of 'rows' of sensor data used
+                                    // by the QRD is k_num_sensor_inputs *
+                                    // k_rmb_factor (generally 2-5)
+    size_t k_num_steering_vectors,  // number of steering vectors to apply to
+                                    // each input sample
+    size_t k_num_complex_per_xrx_read  // Number of complex numbers (contained
+                                       // in NTuple) per word of the input
+                                       // stream
+    >
+class MVDRCpu {
+ public:
+  static constexpr size_t kN = k_num_sensor_inputs;
+  static constexpr size_t kNumTrainingRows = k_num_sensor_inputs * k_rmb_factor;
+  static constexpr size_t kTrainingMatrixSize = kNumTrainingRows * kN;
+  static constexpr size_t kPipeWidth = k_num_complex_per_xrx_read;
+
+  using XrxPipeType = fpga_tools::NTuple<ComplexType, kPipeWidth>;
+
+  // A training matrix and the xrx vectors it is used for
+  struct DataSet {
+    const XrxPipeType* training;  // kTrainingMatrixSize complex, row order
+    const XrxPipeType* xrx;       // num_xrx_per_weights vectors of kN complex
+  };
+
+  MVDRCpu(short num_xrx_per_weights,  // Number of xrx vectors to process with
+                                      // each set of Weight vectors.
+          int threads = 0)            // 0 to use all the CPUs
+      : num_xrx_per_weights_(num_xrx_per_weights),
+        threads_(threads > 0 ? threads
+                             : std::max(1u, std::thread::hardware_concurrency())) {
+    static_assert(kN % kPipeWidth == 0,
+                  "k_num_sensor_inputs must be evenly divisible by "
+                  "k_num_complex_per_xrx_read");
+  }
+
+  int Threads() const { return threads_; }
+
+  // Generate the steering vectors from the sin(theta) values, like the
+  // SteeringVectorGenerator kernel
+  void SteeringVectorGenerator(const float* sin_theta) {
+    for (size_t v = 0; v < k_num_steering_vectors; v++) {
+      for (size_t n = 0; n < kN; n++) {
+        // steering_vector[n] = e^-(i * pi * n * sin(theta))
+        float pi_n_sintheta = (float)M_PI * n * sin_theta[v];
+        steer_re_[v][n] = std::cos(pi_n_sintheta);
+        steer_im_[v][n] = -std::sin(pi_n_sintheta);
+      }
+    }
+  }
+
+  // Process the input stream 'in' of 'in_count' words, and write the output
+  // of each set to 'out'. 'out' must have room for the output of every set.
+  MVDRCpuStats Run(const XrxPipeType* in, size_t in_count, ComplexType* out) {
+    using namespace std::chrono;
+    MVDRCpuStats stats;
+
+    auto start = high_resolution_clock::now();
+
+    std::vector<DataSet> sets = InputDemux(in, in_count);
+    std::vector<double> latency_ms(sets.size());
+
+    // the threads take the sets in order from a shared counter, so they stay
+    // balanced even if the sets take different times
+    std::atomic<size_t> next_set{0};
+    auto worker = [&] {
+      // the working storage of a set is too large for the stack of a thread
+      // with large sensor arrays
+      auto st = std::make_unique<SetState>();
+      for (size_t s = next_set++; s < sets.size(); s = next_set++) {
+        auto set_start = high_resolution_clock::now();
+        ProcessSet(sets[s], *st,
+                   out + s * num_xrx_per_weights_ * k_num_steering_vectors);
+        duration<double, std::milli> l = high_resolution_clock::now() -
+                                         set_start;
+        latency_ms[s] = l.count();
+      }
+    };
+
+    std::vector<std::thread> workers;
+    for (int t = 1; t < threads_; t++) {
+      workers.emplace_back(worker);
+    }
+    worker();
+    for (auto& t : workers) {
+      t.join();
+    }
+
+    duration<double> time = high_resolution_clock::now() - start;
+    stats.matrices = sets.size();
+    stats.time_s = time.count();
+    if (!sets.empty()) {
+      stats.min_latency_ms =
+          *std::min_element(latency_ms.begin(), latency_ms.end());
+      stats.max_latency_ms =
+          *std::max_element(latency_ms.begin(), latency_ms.end());
+      for (auto l : latency_ms) {
+        stats.avg_latency_ms += l / sets.size();
+      }
+    }
+    return stats;
+  }
+
+ private:
+  // the state of one set while it is processed by a thread
+  struct SetState {
+    // training matrix, one column (sensor) at a time, as received by the QRD
+    float a_re[kN][kNumTrainingRows], a_im[kN][kNumTrainingRows];
+
+    // R matrix, stored both by row (r[row][col]) and by column
+    // (rt[col][row]), so both substitutions have unit stride inner loops
+    float r_re[kN][kN], r_im[kN][kN];
+    float rt_re[kN][kN], rt_im[kN][kN];
+    float r_diag_recip[kN];
+
+    // forward/backward substitution results, and the weights (conjugated and
+    // in the order they are applied by the Beamformer)
+    float x_re[kN], x_im[kN];
+    float y_re[kN], y_im[kN];
+    float w_re[k_num_steering_vectors][kN], w_im[k_num_steering_vectors][kN];
+  };
+
+  // Split the input stream into sets of training and xrx data, like the
+  // InputDemux kernel: data is discarded until a training header is found,
+  // a training matrix must be followed by an xrx data header, and an
+  // unexpected header discards the current set.
+  std::vector<DataSet> InputDemux(const XrxPipeType* in, size_t in_count) {
+    enum class RxState {
+      wait_training_header,
+      receiving_training_data,
+      expect_xrx_data_header,
+      receiving_xrx_data
+    };
+
+    const size_t reads_per_training = kTrainingMatrixSize / kPipeWidth;
+    const size_t reads_per_xrx = num_xrx_per_weights_ * kN / kPipeWidth;
+
+    // the NTuple holds the complex numbers of a word one after the other
+    const ComplexType* words = reinterpret_cast<const ComplexType*>(in);
+
+    std::vector<DataSet> sets;
+    RxState state = RxState::wait_training_header;
+    DataSet set{};
+    size_t count = 0;
+    for (size_t i = 0; i < in_count; i++) {
+      const ComplexType& first = words[i * kPipeWidth];
+      bool is_header = std::isnan(first.real());
+      bool header_is_training = (first.imag() == 0.0f);
+
+      switch (state) {
+        case RxState::wait_training_header:
+          if (is_header && header_is_training) {
+            state = RxState::receiving_training_data;
+            set.training = in + i + 1;
+            count = 0;
+          }
+          break;
+        case RxState::receiving_training_data:
+          if (is_header) {
+            state = RxState::wait_training_header;
+          } else if (++count == reads_per_training) {
+            state = RxState::expect_xrx_data_header;
+          }
+          break;
+        case RxState::expect_xrx_data_header:
+          if (is_header && !header_is_training) {
+            state = RxState::receiving_xrx_data;
+            set.xrx = in + i + 1;
+            count = 0;
+          } else {
+            state = RxState::wait_training_header;
+          }
+          break;
+        case RxState::receiving_xrx_data:
+          if (is_header) {
+            state = RxState::wait_training_header;
+          } else if (++count == reads_per_xrx) {
+            sets.push_back(set);
+            state = RxState::wait_training_header;
+          }
+          break;
+      }
+    }
+    return sets;
+  }
+
+  void ProcessSet(const DataSet& set, SetState& st, ComplexType* out) {
+    Transpose(set.training, st);
+    StreamingQRD(st);
+    DiagReciprocal(st);
+    for (size_t v = 0; v < k_num_steering_vectors; v++) {
+      ForwardSubstitution(v, st);
+      BackwardSubstitution(st);
+      CalcWeights(v, st);
+    }
+    Beamformer(set.xrx, st, out);
+  }
+
+  // Store the training matrix (received in row order) by column, like the
+  // Transpose kernel
+  static void Transpose(const XrxPipeType* training, SetState& st) {
+    const ComplexType* a = reinterpret_cast<const ComplexType*>(training);
+    for (size_t row = 0; row < kNumTrainingRows; row++) {
+      for (size_t col = 0; col < kN; col++) {
+        st.a_re[col][row] = a[row * kN + col].real();
+        st.a_im[col][row] = a[row * kN + col].imag();
+      }
+    }
+  }
+
+  // Compute R of the QR decomposition of the training matrix A, like the
+  // StreamingQRD kernel (modified Gram-Schmidt). The diagonal of R is real
+  // and positive. Q is not used by MVDR, so it is not kept.
+  static void StreamingQRD(SetState& st) {
+    for (size_t i = 0; i < kN; i++) {
+      float* ai_re = st.a_re[i];
+      float* ai_im = st.a_im[i];
+
+      float norm_sqr = 0.0f;
+      for (size_t k = 0; k < kNumTrainingRows; k++) {
+        norm_sqr += ai_re[k] * ai_re[k] + ai_im[k] * ai_im[k];
+      }
+      float norm = std::sqrt(norm_sqr);
+      float recip_norm = 1.0f / norm;
+      st.r_re[i][i] = norm;
+      st.r_im[i][i] = 0.0f;
+      for (size_t j = 0; j < i; j++) {
+        st.r_re[i][j] = st.r_im[i][j] = 0.0f;
+      }
+
+      // q_i = a_i / |a_i|
+      for (size_t k = 0; k < kNumTrainingRows; k++) {
+        ai_re[k] *= recip_norm;
+        ai_im[k] *= recip_norm;
+      }
+
+      for (size_t j = i + 1; j < kN; j++) {
+        float* aj_re = st.a_re[j];
+        float* aj_im = st.a_im[j];
+
+        // R[i][j] = conj(q_i) . a_j
+        float dot_re = 0.0f, dot_im = 0.0f;
+        for (size_t k = 0; k < kNumTrainingRows; k++) {
+          dot_re += ai_re[k] * aj_re[k] + ai_im[k] * aj_im[k];
+          dot_im += ai_re[k] * aj_im[k] - ai_im[k] * aj_re[k];
+        }
+        st.r_re[i][j] = dot_re;
+        st.r_im[i][j] = dot_im;
+
+        // a_j -= R[i][j] * q_i
+        for (size_t k = 0; k < kNumTrainingRows; k++) {
+          aj_re[k] -= dot_re * ai_re[k] - dot_im * ai_im[k];
+          aj_im[k] -= dot_re * ai_im[k] + dot_im * ai_re[k];
+        }
+      }
+    }
+
+    for (size_t row = 0; row < kN; row++) {
+      for (size_t col = 0; col < kN; col++) {
+        st.rt_re[col][row] = st.r_re[row][col];
+        st.rt_im[col][row] = st.r_im[row][col];
+      }
+    }
+  }
+
+  // Compute the reciprocals of the diagonal of R, like the DiagReciprocal
+  // kernel
+  static void DiagReciprocal(SetState& st) {
+    for (size_t i = 0; i < kN; i++) {
+      st.r_diag_recip[i] = 1.0f / std::fabs(st.r_re[i][i]);
+    }
+  }
+
+  // Solve L x = c, with L = Rtranspose (conjugate transpose of R) and c the
+  // steering vector 'v', like the ForwardSubstitution kernel
+  void ForwardSubstitution(size_t v, SetState& st) const {
+    float y_re[kN], y_im[kN];
+    std::copy_n(steer_re_[v], kN, y_re);
+    std::copy_n(steer_im_[v], kN, y_im);
+
+    for (size_t col = 0; col < kN; col++) {
+      float x_re = y_re[col] * st.r_diag_recip[col];
+      float x_im = y_im[col] * st.r_diag_recip[col];
+      st.x_re[col] = x_re;
+      st.x_im[col] = x_im;
+
+      // L[row][col] = conj(R[col][row])
+      const float* l_re = st.r_re[col];
+      const float* l_im = st.r_im[col];
+      for (size_t row = col + 1; row < kN; row++) {
+        y_re[row] -= x_re * l_re[row] + x_im * l_im[row];
+        y_im[row] -= x_im * l_re[row] - x_re * l_im[row];
+      }
+    }
+  }
+
+  // Solve R y = x, like the BackwardSubstitution kernel
+  static void BackwardSubstitution(SetState& st) {
+    float x_re[kN], x_im[kN];
+    std::copy_n(st.x_re, kN, x_re);
+    std::copy_n(st.x_im, kN, x_im);
+
+    for (size_t col = kN; col-- > 0;) {
+      float y_re = x_re[col] * st.r_diag_recip[col];
+      float y_im = x_im[col] * st.r_diag_recip[col];
+      st.y_re[col] = y_re;
+      st.y_im[col] = y_im;
+
+      const float* u_re = st.rt_re[col];
+      const float* u_im = st.rt_im[col];
+      for (size_t row = 0; row < col; row++) {
+        x_re[row] -= y_re * u_re[row] - y_im * u_im[row];
+        x_im[row] -= y_re * u_im[row] + y_im * u_re[row];
+      }
+    }
+  }
+
+  // Calculate the weights w = y / (Ctranspose * y) for steering vector 'v',
+  // like the CalcWeights kernel. The weights are stored conjugated and in the
+  // element order used by the Beamformer kernel (which loads them in
+  // reverse order).
+  void CalcWeights(size_t v, SetState& st) const {
+    float ct_y_re = 0.0f, ct_y_im = 0.0f;
+    for (size_t i = 0; i < kN; i++) {
+      ct_y_re += steer_re_[v][i] * st.y_re[i] + steer_im_[v][i] * st.y_im[i];
+      ct_y_im += steer_re_[v][i] * st.y_im[i] - steer_im_[v][i] * st.y_re[i];
+    }
+
+    // y / ct_y = y * conj(ct_y) / |ct_y|^2
+    float recip_norm = 1.0f / (ct_y_re * ct_y_re + ct_y_im * ct_y_im);
+    for (size_t i = 0; i < kN; i++) {
+      float w_re = (st.y_re[i] * ct_y_re + st.y_im[i] * ct_y_im) * recip_norm;
+      float w_im = (st.y_im[i] * ct_y_re - st.y_re[i] * ct_y_im) * recip_norm;
+      st.w_re[v][kN - 1 - i] = w_re;
+      st.w_im[v][kN - 1 - i] = -w_im;
+    }
+  }
+
+  // Apply every weight vector to each xrx vector, like the Beamformer kernel
+  void Beamformer(const XrxPipeType* xrx, const SetState& st,
+                  ComplexType* out) const {
+    const ComplexType* x = reinterpret_cast<const ComplexType*>(xrx);
+    for (int n = 0; n < num_xrx_per_weights_; n++) {
+      float x_re[kN], x_im[kN];
+      for (size_t e = 0; e < kN; e++) {
+        x_re[e] = x[n * kN + e].real();
+        x_im[e] = x[n * kN + e].imag();
+      }
+
+      for (size_t v = 0; v < k_num_steering_vectors; v++) {
+        // sum of xrx * conj(w), st.w is already conjugated
+        float acc_re = 0.0f, acc_im = 0.0f;
+        for (size_t e = 0; e < kN; e++) {
+          acc_re += x_re[e] * st.w_re[v][e] - x_im[e] * st.w_im[v][e];
+          acc_im += x_re[e] * st.w_im[v][e] + x_im[e] * st.w_re[v][e];
+        }
+        out[n * k_num_steering_vectors + v] = ComplexType(acc_re, acc_im);
+      }
+    }
+  }
+
+  short num_xrx_per_weights_;
+  int threads_;
+
+  // the steering vectors
+  float steer_re_[k_num_steering_vectors][kN];
+  float steer_im_[k_num_steering_vectors][kN];
+};
+
+#endif  // ifndef __MVDR_CPU_HPP__
@@ -0,0 +1,238 @@
+#ifndef __UDP_LOCAL_HPP__
+#define __UDP_LOCAL_HPP__
+
+//
+// A stand-in for the UDP offload engine of the real IO pipes BSP (UDP.hpp)
+// that uses the sockets of the host's loopback interface (127.0.0.1).
+// The packets have the same format (UDPPackets.hpp), so the IO code can be
+// developed and benchmarked on any Linux system, without the BSP.
+//
+// Packets are sent and received in batches with sendmmsg and recvmmsg, which
+// amortizes the cost of a system call over many packets.
+//
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "UDPPackets.hpp"
+
+using namespace std::chrono;
+
+// The size of the receive buffer requested for each socket, in packets.
+// Linux caps this at net.core.rmem_max, so the actual size may be smaller;
+// see LocalUDPSocket::BufferPackets.
+constexpr size_t kUDPLocalBufferPackets = 4096;
+
+// how long Receive waits for a packet before giving up
+constexpr int kUDPLocalTimeoutMs = 2000;
+
+// The receive buffer is charged with the 'truesize' of each packet, not its
+// payload. The data of a packet is allocated from a power of 2 size class
+// with room for the network headers and the skb_shared_info, and the sk_buff
+// that describes it is charged as well.
+constexpr size_t kUDPLocalSkbHeadroom = 512;  // headers and skb_shared_info
+constexpr size_t kUDPLocalSkbOverhead = 512;  // the sk_buff
+
+constexpr size_t UDPLocalPacketTrueSize() {
+  size_t data_bytes = 1;
+  while (data_bytes < kUDPTotalSize + kUDPLocalSkbHeadroom) data_bytes *= 2;
+  return data_bytes + kUDPLocalSkbOverhead;
+}
+
+//
+// A UDP socket bound to a port on the loopback interface
+//
+class LocalUDPSocket {
+ public:
+  // Bind to 'port' on 127.0.0.1, or to any free port if 'port' is 0
+  explicit LocalUDPSocket(unsigned int port = 0) {
+    if ((sock_ = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)) < 0) {
+      std::cerr << "ERROR: failed to open socket: " << strerror(errno)
+                << "\n";
+      std::terminate();
+    }
+
+    // Request a large receive buffer. Nothing on the loopback interface
+    // slows down the sender, so packets that do not fit in the buffer are
+    // dropped.
+    int buf_bytes = kUDPLocalBufferPackets * kUDPTotalSize;
+    setsockopt(sock_, SOL_SOCKET, SO_RCVBUF, &buf_bytes, sizeof(buf_bytes));
+
+    // don't wait forever for packets that were dropped
+    struct timeval tv;
+    tv.tv_sec = kUDPLocalTimeoutMs / 1000;
+    tv.tv_usec = (kUDPLocalTimeoutMs % 1000) * 1000;
+    setsockopt(sock_, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (bind(sock_, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+      std::cerr << "ERROR: failed to bind to port " << port << ": "
+                << strerror(errno) << "\n";
+      std::terminate();
+    }
+
+    socklen_t len = sizeof(addr);
+    getsockname(sock_, (struct sockaddr *)&addr, &len);
+    port_ = ntohs(addr.sin_port);
+  }
+
+  LocalUDPSocket(const LocalUDPSocket &) = delete;
+  LocalUDPSocket &operator=(const LocalUDPSocket &) = delete;
+
+  ~LocalUDPSocket() { close(sock_); }
+
+  unsigned int Port() const { return port_; }
+
+  // The number of packets that the receive buffer of the socket can hold.
+  // SO_RCVBUF reports the size that the kernel charges the packets against,
+  // and each packet is charged its UDPLocalPacketTrueSize. 1/8 of the buffer
+  // is kept as a safety margin, since the exact overhead depends on the
+  // kernel version and configuration.
+  size_t BufferPackets() const {
+    int buf_bytes = 0;
+    socklen_t len = sizeof(buf_bytes);
+    getsockopt(sock_, SOL_SOCKET, SO_RCVBUF, &buf_bytes, &len);
+    size_t usable_bytes = (size_t)buf_bytes - (size_t)buf_bytes / 8;
+    return std::max<size_t>(1, usable_bytes / UDPLocalPacketTrueSize());
+  }
+
+  // Send 'packets' packets from 'data' to 127.0.0.1:'port', with up to
+  // 'batch' packets per system call. If 't_in' is not null, the time that
+  // each packet was sent is stored in it.
+  void Send(unsigned int port, const unsigned char *data, size_t packets,
+            size_t batch, high_resolution_clock::time_point *t_in = nullptr) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+
+    Prepare(batch);
+    size_t sent = 0;
+    while (sent < packets) {
+      unsigned int n = std::min(batch, packets - sent);
+      for (unsigned int i = 0; i < n; i++) {
+        iov_[i].iov_base =
+            const_cast<unsigned char *>(data + (sent + i) * kUDPTotalSize);
+        iov_[i].iov_len = kUDPTotalSize;
+        msgs_[i].msg_hdr.msg_name = &addr;
+        msgs_[i].msg_hdr.msg_namelen = sizeof(addr);
+      }
+
+      int res = sendmmsg(sock_, msgs_.data(), n, 0);
+      if (res < 0) {
+        if (errno == EINTR || errno == EAGAIN || errno == ENOBUFS) {
+          continue;
+        }
+        std::cerr << "ERROR: sendmmsg failed: " << strerror(errno) << "\n";
+        std::terminate();
+      }
+
+      if (t_in) {
+        std::fill_n(t_in + sent, res, high_resolution_clock::now());
+      }
+      sent += res;
+    }
+  }
+
+  // Receive up to 'max_packets' packets into 'data' with one system call.
+  // This waits for a packet and then also takes the packets that are
+  // already queued, so the batches are only as large as the backlog of the
+  // socket. If 't_out' is not null, the time that each packet was received
+  // is stored in it.
+  // Returns the number of packets received, which is 0 if no packet arrived
+  // for kUDPLocalTimeoutMs.
+  size_t ReceiveBatch(unsigned char *data, size_t max_packets,
+                      high_resolution_clock::time_point *t_out = nullptr) {
+    Prepare(max_packets);
+    for (size_t i = 0; i < max_packets; i++) {
+      iov_[i].iov_base = data + i * kUDPTotalSize;
+      iov_[i].iov_len = kUDPTotalSize;
+    }
+
+    int res;
+    do {
+      res = recvmmsg(sock_, msgs_.data(), max_packets, MSG_WAITFORONE,
+                     nullptr);
+    } while (res < 0 && errno == EINTR);
+
+    if (res < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return 0;  // timed out
+      }
+      std::cerr << "ERROR: recvmmsg failed: " << strerror(errno) << "\n";
+      std::terminate();
+    }
+
+    for (int i = 0; i < res; i++) {
+      if (msgs_[i].msg_len != kUDPTotalSize) {
+        std::cerr << "ERROR: received a packet of " << msgs_[i].msg_len
+                  << " bytes, expected " << kUDPTotalSize << "\n";
+      }
+    }
+
+    if (t_out) {
+      std::fill_n(t_out, res, high_resolution_clock::now());
+    }
+    return res;
+  }
+
+  // Receive 'packets' packets into 'data', with up to 'batch' packets per
+  // system call. Returns the number of packets received, which is less than
+  // 'packets' if no packet arrived for kUDPLocalTimeoutMs.
+  size_t Receive(unsigned char *data, size_t packets, size_t batch,
+                 high_resolution_clock::time_point *t_out = nullptr) {
+    size_t received = 0;
+    while (received < packets) {
+      size_t res = ReceiveBatch(data + received * kUDPTotalSize,
+                                std::min(batch, packets - received),
+                                t_out ? t_out + received : nullptr);
+      if (res == 0) {
+        break;
+      }
+      received += res;
+    }
+    return received;
+  }
+
+ private:
+  // make sure there are 'batch' message headers
+  void Prepare(size_t batch) {
+    if (msgs_.size() < batch) {
+      msgs_.resize(batch);
+      iov_.resize(batch);
+    }
+    for (size_t i = 0; i < batch; i++) {
+      memset(&msgs_[i], 0, sizeof(msgs_[i]));
+      msgs_[i].msg_hdr.msg_iov = &iov_[i];
+      msgs_[i].msg_hdr.msg_iovlen = 1;
+    }
+  }
+
+  int sock_;
+  unsigned int port_;
+  std::vector<struct mmsghdr> msgs_;
+  std::vector<struct iovec> iov_;
+};
+
+// true if the packet starts with the 0xABCD header (see ToPackets)
+bool HasPacketHeader(const unsigned char *packet) {
+  return packet[0] == 0xAB && packet[1] == 0xCD;
+}
+
+#endif /* __UDP_LOCAL_HPP__ */
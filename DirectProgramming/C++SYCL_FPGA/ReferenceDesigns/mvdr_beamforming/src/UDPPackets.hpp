@@ -0,0 +1,76 @@
+#ifndef __UDP_PACKETS_HPP__
+#define __UDP_PACKETS_HPP__
+
+//
+// The format of the UDP packets sent to and received from the IO pipes.
+// Each packet is a kUDPHeaderSize byte header (0xABCD) followed by
+// kUDPDataSize bytes of data. This is shared by the real IO pipes (UDP.hpp)
+// and the localhost stand-in (UDPLocal.hpp).
+//
+
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+
+#include <sys/mman.h>
+
+// constants
+constexpr size_t kUDPDataSize = 4096;                            // bytes
+constexpr size_t kUDPHeaderSize = 2;                             // bytes
+constexpr size_t kUDPTotalSize = kUDPDataSize + kUDPHeaderSize;  // bytes
+
+unsigned char *AllocatePackets(size_t packets) {
+  // allocate aligned memory
+  auto ret = static_cast<unsigned char *>(
+      aligned_alloc(1024, kUDPTotalSize * packets));
+
+  // pin the memory
+  mlock(ret, kUDPTotalSize * packets);
+
+  return ret;
+}
+
+void FreePackets(unsigned char *ptr, size_t packets) {
+  // unpin the memory
+  munlock(ptr, kUDPTotalSize * packets);
+
+  // free the memory
+  free(ptr);
+}
+
+// convert an array of elements into packets including adding header
+template <typename T>
+void ToPackets(unsigned char *udp_bytes, T *data, size_t count) {
+  assert(kUDPDataSize % sizeof(T) == 0);
+  assert((count * sizeof(T)) % kUDPDataSize == 0);
+  size_t count_per_packet = kUDPDataSize / sizeof(T);
+  assert((count % count_per_packet) == 0);
+  size_t iterations = count / count_per_packet;
+
+  size_t packet_stride = kUDPDataSize + 2;
+  for (int i = 0; i < iterations; i++) {
+    udp_bytes[i * packet_stride] = 0xAB;
+    udp_bytes[i * packet_stride + 1] = 0xCD;
+
+    memcpy(&udp_bytes[i * packet_stride + 2], &data[i * count_per_packet],
+           kUDPDataSize);
+  }
+}
+
+// convert the bytes of packets into an array of elements
+template <typename T>
+void FromPackets(unsigned char *udp_bytes, T *data, size_t count) {
+  assert((kUDPDataSize % sizeof(T)) == 0);
+  assert((count * sizeof(T)) % kUDPDataSize == 0);
+  size_t count_per_packet = kUDPDataSize / sizeof(T);
+  assert((count % count_per_packet) == 0);
+  size_t iterations = count / count_per_packet;
+
+  size_t packet_stride = kUDPDataSize + 2;
+  for (int i = 0; i < iterations; i++) {
+    memcpy(&data[i * count_per_packet], &udp_bytes[i * packet_stride + 2],
+           kUDPDataSize);
+  }
+}
+
+#endif /* __UDP_PACKETS_HPP__ */
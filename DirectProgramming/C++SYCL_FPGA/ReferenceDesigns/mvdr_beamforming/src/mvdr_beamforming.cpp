@@ -3,23 +3,32 @@
 
 #include <chrono>
 #include <cstring>
+#include <fstream>
 #include <iomanip>
+#include <iostream>
+#include <string>
 #include <thread>
 #include <vector>
 
+#if not defined(CPU_FALLBACK)
 #include <sycl/sycl.hpp>
 #include <sycl/ext/intel/fpga_extensions.hpp>
+#endif
 
 #include "tuple.hpp"  // DirectProgramming/C++SYCL_FPGA/include
 #include "mvdr_complex.hpp"
 
-#if not defined(REAL_IO_PIPES)
+#if not defined(REAL_IO_PIPES) && not defined(CPU_FALLBACK)
 #include "exception_handler.hpp"
 #endif
 
 #include "Constants.hpp"
+#if defined(CPU_FALLBACK)
+#include "MVDRCpu.hpp"
+#else
 #include "FakeIOPipes.hpp"
 #include "MVDR.hpp"
+#endif
 
 #if defined(REAL_IO_PIPES) && defined(FPGA_EMULATOR)
 static_assert(false, "Real IO pipes cannot be emulated for this design");
@@ -29,21 +38,29 @@ static_assert(false, "Real IO pipes cannot be emulated for this design");
 static_assert(false, "Real IO pipes cannot be used in windows");
 #endif
 
+#if defined(REAL_IO_PIPES) && defined(CPU_FALLBACK)
+static_assert(false, "Real IO pipes cannot be used with the CPU fallback");
+#endif
+
 #if defined(REAL_IO_PIPES)
 #include <sys/mman.h>
 #include "UDP.hpp"
 #endif
 
+#if not defined(CPU_FALLBACK)
 using namespace sycl;
+#endif
 using namespace std::chrono_literals;
 using namespace std::chrono;
 
+#if not defined(CPU_FALLBACK)
 // We will have the producer and consumer use USM host allocations
 // if they are enabled, otherwise they use device allocations
 template <typename Id, typename T, size_t min_capacity = 0>
 using MyProducer = Producer<Id, T, kUseUSMHostAllocation, min_capacity>;
 template <typename Id, typename T, size_t min_capacity = 0>
 using MyConsumer = Consumer<Id, T, kUseUSMHostAllocation, min_capacity>;
+#endif
 
 ////////////////////////////////////////////////////////////////////////////////
 // utility functions
@@ -95,7 +112,12 @@ constexpr size_t kDataOutSize = kNumInputVectors * kNumSteer;
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 // host producer and consumers
-#if defined(REAL_IO_PIPES)
+#if defined(CPU_FALLBACK)
+// No pipes: the CPU engine (MVDRCpu.hpp) reads the input data and writes the
+// output data directly
+using MVDRCpuEngine = MVDRCpu<kNumSensorInputs, kRMBFactor, kNumSteer,
+                              kNumComplexPerXrxPipe>;
+#elif defined(REAL_IO_PIPES)
 // REAL IO PIPES
 struct ReadIOPipeID {
   static constexpr unsigned id = 1;
@@ -120,8 +142,10 @@ using DataOutConsumer =
 using DataOutPipe = DataOutConsumer::Pipe;
 #endif
 
+#if not defined(CPU_FALLBACK)
 using SinThetaProducer = MyProducer<SinThetaProducerID, float, kNumSteer * 2>;
 using SinThetaPipe = SinThetaProducer::Pipe;
+#endif
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -132,6 +156,14 @@ bool ReadInputData(std::string in_dir, ComplexType *data_in,
 bool WriteOutputData(std::string out_dir, ComplexType *data_out);
 bool CheckOutputData(std::string in_dir, ComplexType *data_out,
                      int num_matrix_copies, bool print_diffs);
+void SinThetaValues(float *sin_theta);
+////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////////////
+// CPU fallback
+#if defined(CPU_FALLBACK)
+bool RunMVDRCpu(int num_matrix_copies, std::string in_dir, int threads);
+#endif
 ////////////////////////////////////////////////////////////////////////////////
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -147,7 +179,8 @@ struct UDPArgs {
 
 // arguments
 bool ParseArgs(int argc, char *argv[], int &num_matrix_copies,
-               std::string &in_dir, std::string &out_dir, UDPArgs *udp_args);
+               std::string &in_dir, std::string &out_dir, int &cpu_threads,
+               UDPArgs *udp_args);
 void PrintUsage();
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -157,9 +190,11 @@ int main(int argc, char *argv[]) {
   int num_matrix_copies = 1024;
   std::string in_dir = "../data";
   std::string out_dir = ".";
+  int cpu_threads = 0;  // 0 to use all the CPUs
 
   // parse the command line arguments
-  if (!ParseArgs(argc, argv, num_matrix_copies, in_dir, out_dir, &udp_args)) {
+  if (!ParseArgs(argc, argv, num_matrix_copies, in_dir, out_dir, cpu_threads,
+                 &udp_args)) {
     PrintUsage();
     std::terminate();
   }
@@ -179,6 +214,15 @@ int main(int argc, char *argv[]) {
   printf("Output Directory: '%s'\n", out_dir.c_str());
   printf("\n");
 
+#if defined(CPU_FALLBACK)
+  if (RunMVDRCpu(num_matrix_copies, in_dir, cpu_threads)) {
+    std::cout << "PASSED\n";
+    return 0;
+  } else {
+    std::cout << "FAILED\n";
+    return 1;
+  }
+#else
   bool passed = true;
 
   const size_t in_count = kInputDataSize * num_matrix_copies;
@@ -256,11 +300,7 @@ int main(int argc, char *argv[]) {
 #endif
 
     // calculate the sin(theta) values for each steering vector
-    constexpr float degree_unit = 120.0f / (kNumSteer - 1);
-    for (int i = 0; i < kNumSteer; i++) {
-      float degree = -60.0f + i * degree_unit;
-      SinThetaProducer::Data()[i] = sin(degree / 180.0f * M_PI);
-    }
+    SinThetaValues(SinThetaProducer::Data());
 
     // launch the mvdr kernels
     MVDREventArray mvdr_events;
@@ -401,6 +441,8 @@ int main(int argc, char *argv[]) {
     double throughput = num_full_matrix_copies / latency_s;
 
     std::cout << "Throughput: " << throughput << " matrices/second\n";
+    std::cout << "Throughput: " << throughput * kNumInputVectors
+              << " vectors/second\n";
 
     // copy the output back from the consumer
 #if defined(REAL_IO_PIPES)
@@ -460,8 +502,82 @@ int main(int argc, char *argv[]) {
     std::cout << "FAILED\n";
     return 1;
   }
+#endif
+}
+
+// calculate the sin(theta) values for each steering vector
+void SinThetaValues(float *sin_theta) {
+  constexpr float degree_unit = 120.0f / (kNumSteer - 1);
+  for (int i = 0; i < kNumSteer; i++) {
+    float degree = -60.0f + i * degree_unit;
+    sin_theta[i] = sin(degree / 180.0f * M_PI);
+  }
 }
 
+#if defined(CPU_FALLBACK)
+// Run the same test as the FPGA design with the CPU engine, on the same input
+// data and with the same output check. The DataProducer and DataOutConsumer
+// of FakeIOPipes.hpp stream their buffers through SYCL pipes, which only
+// kernels can access, so the CPU engine reads and writes host arrays with the
+// same layout as the DataProducer and DataOutConsumer buffers instead.
+bool RunMVDRCpu(int num_matrix_copies, std::string in_dir, int threads) {
+  const size_t in_count = kInputDataSize * num_matrix_copies;
+  const size_t out_count = kDataOutSize * num_matrix_copies;
+  std::vector<XrxPipeType> in_data(in_count);
+  std::vector<ComplexType> out_data(out_count);
+
+  if (!ReadInputData(in_dir, (ComplexType *)in_data.data(),
+                     num_matrix_copies)) {
+    return false;
+  }
+
+  MVDRCpuEngine mvdr(kNumInputVectors, threads);
+  float sin_theta[kNumSteer];
+  SinThetaValues(sin_theta);
+  mvdr.SteeringVectorGenerator(sin_theta);
+
+  std::cout << std::endl
+            << "*** Launching CPU throughput test of " << num_matrix_copies
+            << " matrices ***" << std::endl;
+
+  std::cout << "Sensor inputs                 : " << kNumSensorInputs
+            << std::endl;
+  std::cout << "Training matrix rows          : " << kTrainingMatrixNumRows
+            << std::endl;
+  std::cout << "Data rows per training matrix : " << kNumInputVectors
+            << std::endl;
+  std::cout << "Steering vectors              : " << kNumSteer << std::endl;
+  std::cout << "CPU threads                   : " << mvdr.Threads()
+            << std::endl;
+
+  MVDRCpuStats stats = mvdr.Run(in_data.data(), in_count, out_data.data());
+
+  double throughput = stats.matrices / stats.time_s;
+  std::cout << "Throughput: " << throughput << " matrices/second\n";
+  std::cout << "Throughput: " << throughput * kNumInputVectors
+            << " vectors/second\n";
+  std::cout << "Latency per matrix (min/avg/max): " << stats.min_latency_ms
+            << " / " << stats.avg_latency_ms << " / " << stats.max_latency_ms
+            << " ms\n";
+
+  if (stats.matrices != (size_t)num_matrix_copies) {
+    std::cout << "Expected " << num_matrix_copies << " matrices but "
+              << stats.matrices << " were processed" << std::endl;
+    return false;
+  }
+
+  // check one instance of output data
+  bool passed = CheckOutputData(in_dir, out_data.data(), num_matrix_copies,
+                                true);
+  if (passed) {
+    std::cout << "Output data check succeeded" << std::endl;
+  } else {
+    std::cout << "Output data check failed" << std::endl;
+  }
+  return passed;
+}
+#endif
+
 bool ReadInputData(std::string in_dir, ComplexType *data_in,
                    int num_matrix_copies) {
   // file paths relative the the base directory
@@ -526,7 +642,7 @@ bool ReadInputData(std::string in_dir, ComplexType *data_in,
   data_offset += kNumComplexPerXrxPipe;
 
   // load the first matrix
-  for (size_t i = 0; i < kInputDataSize * kNumComplexPerXrxPipe; i++) {
+  for (size_t i = 0; i < kXrxDataSize * kNumComplexPerXrxPipe; i++) {
     x_real_is >> data_in[data_offset + i].real();
     x_imag_is >> data_in[data_offset + i].imag();
   }
@@ -650,7 +766,8 @@ bool WriteOutputData(std::string out_dir, ComplexType *data_out) {
 }
 
 bool ParseArgs(int argc, char *argv[], int &num_matrix_copies,
-               std::string &in_dir, std::string &out_dir, UDPArgs *udp_args) {
+               std::string &in_dir, std::string &out_dir, int &cpu_threads,
+               UDPArgs *udp_args) {
 #if defined(REAL_IO_PIPES)
   if (argc < 8) {
     return false;
@@ -694,6 +811,11 @@ bool ParseArgs(int argc, char *argv[], int &num_matrix_copies,
   if (argc > 3) {
     out_dir = argv[3];
   }
+#if defined(CPU_FALLBACK)
+  if (argc > 4) {
+    cpu_threads = atoi(argv[4]);
+  }
+#endif
   return true;
 #endif
 }
@@ -706,6 +828,10 @@ void PrintUsage() {
   std::cout << "EXAMPLE: ./mvdr_beamforming.fpga 64:4C:36:00:2F:20 "
             << "192.168.0.11 34543 255.255.255.0 94:40:C9:71:8D:10 "
             << " 192.168.0.10 34543 1024 ../data .\n";
+#elif defined(CPU_FALLBACK)
+  std::cout << "USAGE: ./mvdr_beamforming.cpu "
+            << "[num_matrices] [in directory] [out directory] [threads]\n";
+  std::cout << "EXAMPLE: ./mvdr_beamforming.cpu 1024 ../data . 8\n";
 #else
   std::cout << "USAGE: ./mvdr_beamforming.fpga "
             << "[num_matrices] [in directory] [out directory]\n";
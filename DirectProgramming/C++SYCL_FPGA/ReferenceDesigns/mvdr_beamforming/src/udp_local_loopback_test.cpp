@@ -0,0 +1,338 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sycl/sycl.hpp>
+#include <sycl/ext/intel/fpga_extensions.hpp>
+
+#include "exception_handler.hpp"
+
+#include "Constants.hpp"
+#include "FakeIOPipes.hpp"
+#include "UDPLocal.hpp"
+
+//
+// The loopback test of udp_loopback_test.cpp, without the real IO pipes BSP.
+//
+// The UDP offload engine of the FPGA is replaced by a 'device' thread with
+// a socket on localhost (UDPLocal.hpp). It receives the packets from the
+// host in batches, strips their headers, and streams the data through a
+// loopback kernel with the fake IO pipes (FakeIOPipes.hpp). It then adds the
+// headers to the output of the kernel and sends it back to the host.
+//
+//  sender --UDP--> device thread --producer--> kernel --consumer--> device
+//  thread --UDP--> receiver
+//
+// With 'use_kernel' set to 0, the device thread sends the packets straight
+// back, which measures the packet rate of the sockets alone.
+//
+
+using WordType = unsigned long long;
+static_assert(sizeof(WordType) <= kUDPDataSize);
+static_assert((kUDPDataSize % sizeof(WordType)) == 0);
+constexpr size_t kWordsPerPacket = kUDPDataSize / sizeof(WordType);
+
+using namespace sycl;
+using namespace std::chrono;
+using namespace std::chrono_literals;
+
+// declare kernel and pipe IDs globally to reduce name mangling
+class LocalLoopbackKernel;
+class DataProducerID;
+class DataConsumerID;
+
+using DataProducer = Producer<DataProducerID, WordType, kUseUSMHostAllocation>;
+using DataConsumer = Consumer<DataConsumerID, WordType, kUseUSMHostAllocation>;
+
+// submits the loopback kernel, templated on the input and output pipes
+template <typename PipeIn, typename PipeOut>
+event SubmitLoopbackKernel(queue &q, size_t count) {
+  return q.submit([&](handler &h) {
+    h.single_task<LocalLoopbackKernel>([=] {
+      for (size_t i = 0; i < count; i++) {
+        auto data = PipeIn::read();
+        PipeOut::write(data);
+      }
+    });
+  });
+}
+
+// The stand-in for the FPGA: receives packets on 'sock', passes them through
+// the loopback kernel (if 'use_kernel' is true), and sends them to
+// 'host_port'. Returns the number of packets with a bad header.
+size_t DeviceLoop(queue &q, LocalUDPSocket &sock, unsigned int host_port,
+                  size_t packets, size_t batch, bool use_kernel) {
+  unsigned char *rx_packets = AllocatePackets(batch);
+  unsigned char *tx_packets = AllocatePackets(batch);
+  size_t bad_headers = 0;
+
+  size_t done = 0;
+  while (done < packets) {
+    size_t n = sock.ReceiveBatch(rx_packets, std::min(batch, packets - done));
+    if (n == 0) {
+      std::cerr << "ERROR: device timed out after " << done << " packets\n";
+      break;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+      if (!HasPacketHeader(rx_packets + i * kUDPTotalSize)) {
+        bad_headers++;
+      }
+    }
+
+    if (use_kernel) {
+      const size_t count = n * kWordsPerPacket;
+      FromPackets(rx_packets, DataProducer::Data(), count);
+
+      event consume_dma_event, consume_kernel_event;
+      event produce_dma_event, produce_kernel_event;
+      std::tie(consume_dma_event, consume_kernel_event) =
+          DataConsumer::Start(q, count);
+      auto kernel_event =
+          SubmitLoopbackKernel<DataProducer::Pipe, DataConsumer::Pipe>(q,
+                                                                       count);
+      std::tie(produce_dma_event, produce_kernel_event) =
+          DataProducer::Start(q, count);
+
+      produce_kernel_event.wait();
+      kernel_event.wait();
+      consume_kernel_event.wait();
+      consume_dma_event.wait();
+
+      ToPackets(tx_packets, DataConsumer::Data(), count);
+      sock.Send(host_port, tx_packets, n, batch);
+    } else {
+      sock.Send(host_port, rx_packets, n, batch);
+    }
+
+    done += n;
+  }
+
+  FreePackets(rx_packets, batch);
+  FreePackets(tx_packets, batch);
+  return bad_headers;
+}
+
+int main(int argc, char **argv) {
+  size_t packets = 100000;
+  size_t batch = 32;
+  size_t window = 256;
+  bool use_kernel = true;
+
+  if (argc > 1) {
+    packets = atoi(argv[1]);
+  }
+  if (argc > 2) {
+    batch = atoi(argv[2]);
+  }
+  if (argc > 3) {
+    window = atoi(argv[3]);
+  }
+  if (argc > 4) {
+    use_kernel = atoi(argv[4]) != 0;
+  }
+
+  if (packets == 0 || batch == 0 || window == 0) {
+    std::cout << "USAGE: ./udp_local_loopback_test.fpga_emu [packets] "
+              << "[batch] [window] [use_kernel]\n";
+    std::cout << "EXAMPLE: ./udp_local_loopback_test.fpga_emu 100000 32 256 1"
+              << "\n";
+    return 1;
+  }
+
+  // bind the sockets before starting the threads, so that no packets are
+  // sent to a port that is not open yet
+  LocalUDPSocket device_sock;
+  LocalUDPSocket host_rx_sock;
+  LocalUDPSocket host_tx_sock;
+
+  // Nothing slows down the sender on the loopback interface, so the number
+  // of packets in flight is limited to what the socket buffers can hold.
+  // Otherwise, packets would be dropped.
+  size_t max_window =
+      std::min(device_sock.BufferPackets(), host_rx_sock.BufferPackets());
+  if (window > max_window) {
+    std::cout << "Limiting the window to the socket buffer size of "
+              << max_window << " packets (see net.core.rmem_max)\n";
+    window = max_window;
+  }
+  batch = std::min(batch, window);
+
+  std::cout << "\n";
+  std::cout << "Device UDP Port:  " << device_sock.Port() << "\n";
+  std::cout << "Host UDP Port:    " << host_rx_sock.Port() << "\n";
+  std::cout << "Packets:          " << packets << "\n";
+  std::cout << "Batch:            " << batch << " packets\n";
+  std::cout << "Window:           " << window << " packets\n";
+  std::cout << "Loopback kernel:  " << (use_kernel ? "yes" : "no") << "\n";
+  std::cout << "\n";
+
+  bool passed = true;
+
+  try {
+    // device selector
+#if defined(FPGA_EMULATOR)
+    ext::intel::fpga_emulator_selector selector;
+#else
+    ext::intel::fpga_selector selector;
+#endif
+
+    queue q(selector, fpga_tools::exception_handler);
+
+    // the fake IO pipes hold one batch of packets at a time
+    DataProducer::Init(q, batch * kWordsPerPacket);
+    DataConsumer::Init(q, batch * kWordsPerPacket);
+
+    // input and output packet words
+    const size_t total_elements = kWordsPerPacket * packets;
+    std::vector<WordType> input(total_elements);
+    std::vector<WordType> output(total_elements);
+
+    // fill input, set output
+    std::iota(input.begin(), input.end(), 0);
+    std::fill(output.begin(), output.end(), 0);
+
+    // allocate aligned memory for input and output data
+    // total bytes including the 2-byte header per packet
+    unsigned char *input_data = AllocatePackets(packets);
+    unsigned char *output_data = AllocatePackets(packets);
+
+    // prepare data to be transferred, added check header 0xABCD
+    std::cout << "Creating packets from input data" << std::endl;
+    ToPackets(input_data, input.data(), total_elements);
+
+    // these are used to track the latency of each packet
+    std::vector<high_resolution_clock::time_point> time_in(packets);
+    std::vector<high_resolution_clock::time_point> time_out(packets);
+
+    // the number of packets that have made it back to the host
+    std::atomic<size_t> received{0};
+
+    // start the device stand-in
+    size_t bad_headers = 0;
+    std::thread device_thread([&] {
+      bad_headers = DeviceLoop(q, device_sock, host_rx_sock.Port(), packets,
+                               batch, use_kernel);
+    });
+
+    // start the receiver
+    std::thread receiver_thread([&] {
+      size_t count = 0;
+      while (count < packets) {
+        size_t n = host_rx_sock.ReceiveBatch(
+            output_data + count * kUDPTotalSize,
+            std::min(batch, packets - count), time_out.data() + count);
+        if (n == 0) {
+          break;
+        }
+        count += n;
+        received.store(count, std::memory_order_release);
+      }
+    });
+
+    // send the packets in batches, keeping at most 'window' in flight
+    auto start = high_resolution_clock::now();
+    size_t sent = 0;
+    while (sent < packets) {
+      size_t n = std::min(batch, packets - sent);
+      auto wait_start = high_resolution_clock::now();
+      while (sent + n - received.load(std::memory_order_acquire) > window) {
+        if (high_resolution_clock::now() - wait_start >
+            milliseconds(kUDPLocalTimeoutMs)) {
+          break;  // packets were lost, the receiver will time out
+        }
+        std::this_thread::yield();
+      }
+      host_tx_sock.Send(device_sock.Port(), input_data + sent * kUDPTotalSize,
+                        n, batch, time_in.data() + sent);
+      sent += n;
+    }
+
+    device_thread.join();
+    receiver_thread.join();
+    auto end = high_resolution_clock::now();
+
+    const size_t packets_received = received.load();
+    if (packets_received != packets) {
+      std::cerr << "ERROR: " << (packets - packets_received) << " of "
+                << packets << " packets were lost\n";
+      passed = false;
+    }
+    if (bad_headers != 0) {
+      std::cerr << "ERROR: " << bad_headers << " packets had a bad header\n";
+      passed = false;
+    }
+
+    // packet rate and throughput
+    duration<double> diff(end - start);
+    double packet_rate = packets_received / diff.count();
+    std::cout << "Packet rate: " << packet_rate << " packets/s\n";
+    std::cout << "Throughput:  " << (packet_rate * kUDPTotalSize * 1e-6)
+              << " MB/s\n";
+
+    // compute the end-to-end latency (ignore the first couple of packets)
+    constexpr size_t kWarmupPackets = 8;
+    if (packets_received > kWarmupPackets) {
+      std::vector<double> latency;
+      latency.reserve(packets_received - kWarmupPackets);
+      for (size_t i = kWarmupPackets; i < packets_received; i++) {
+        duration<double, std::milli> l(time_out[i] - time_in[i]);
+        latency.push_back(l.count());
+      }
+      std::sort(latency.begin(), latency.end());
+      double avg_latency =
+          std::accumulate(latency.begin(), latency.end(), 0.0) /
+          latency.size();
+      std::cout << "End-to-end packet latency (ms): average " << avg_latency
+                << ", median " << latency[latency.size() / 2] << ", 99th "
+                << latency[latency.size() * 99 / 100] << ", max "
+                << latency.back() << "\n";
+    }
+
+    // convert the output bytes to data (drop the headers)
+    std::cout << "Getting output data from packets" << std::endl;
+    FromPackets(output_data, output.data(), total_elements);
+
+    // validate results
+    for (size_t i = 0; i < packets_received * kWordsPerPacket && passed; i++) {
+      if (output[i] != input[i]) {
+        std::cerr << "ERROR: output mismatch at index " << i << ", "
+                  << output[i] << " != " << input[i]
+                  << " (output != input)\n";
+        passed = false;
+      }
+    }
+
+    FreePackets(input_data, packets);
+    FreePackets(output_data, packets);
+    DataProducer::Destroy(q);
+    DataConsumer::Destroy(q);
+  } catch (exception const &e) {
+    // Catches exceptions in the host code
+    std::cerr << "Caught a SYCL host exception:\n" << e.what() << "\n";
+
+    // Most likely the runtime couldn't find FPGA hardware!
+    if (e.code().value() == CL_DEVICE_NOT_FOUND) {
+      std::cerr << "If you are targeting an FPGA, please ensure that your "
+                   "system has a correctly configured FPGA board.\n";
+      std::cerr << "Run sys_check in the oneAPI root directory to verify.\n";
+      std::cerr << "If you are targeting the FPGA emulator, compile with "
+                   "-DFPGA_EMULATOR.\n";
+    }
+    std::terminate();
+  }
+
+  if (passed) {
+    std::cout << "PASSED\n";
+    return 0;
+  } else {
+    std::cout << "FAILED\n";
+    return 1;
+  }
+}
@@ -25,6 +25,110 @@ class APipe;
 class QPipe;
 class RPipe;
 
+/*
+  The kernels of the QR decomposition design, shared by QRDecompositionImpl
+  (below) and by the batched API (qrd_batched.hpp), so that the FPGA image
+  contains a single copy of each kernel.
+  Can be configured by datatype, matrix size and works with square or
+  rectangular matrices, real and complex.
+*/
+template <unsigned columns,     // Number of columns in the input matrix
+          unsigned rows,        // Number of rows in the input matrix
+          unsigned raw_latency, // RAW latency for triangular loop optimization
+          bool is_complex,      // Selects between ac_complex<T> and T datatype
+          typename T,           // The datatype for the computation
+          typename TT = std::conditional_t<is_complex, ac_complex<T>, T>
+                        // TT will be ac_complex<T> or T depending on is_complex
+         >
+struct QRDKernels {
+  static constexpr int kAMatrixSize = columns * rows;
+  static constexpr int kQMatrixSize = columns * rows;
+  static constexpr int kRMatrixSize = columns * (columns + 1) / 2;
+  static constexpr int kNumElementsPerDDRBurst = is_complex ? 4 : 8;
+
+  using PipeType = fpga_tools::NTuple<TT, kNumElementsPerDDRBurst>;
+
+  // Pipes to communicate the A, Q and R matrices between kernels
+  using AMatrixPipe = sycl::ext::intel::pipe<APipe, PipeType, 3>;
+  using QMatrixPipe = sycl::ext::intel::pipe<QPipe, PipeType, 3>;
+  using RMatrixPipe = sycl::ext::intel::pipe<RPipe, TT,
+                                                  kNumElementsPerDDRBurst * 4>;
+
+  // Launch the kernel that reads the A matrices from the AMatrixPipe pipe and
+  // computes their QR decomposition. It writes the Q and R output matrices to
+  // the QMatrixPipe and RMatrixPipe pipes.
+  // The kernel never exits, so it is only launched once: later calls do
+  // nothing and the running kernel keeps serving the pipes.
+  static void LaunchQRD(sycl::queue &q) {
+    static bool launched = false;
+    if (!launched) {
+      q.single_task<QRD>(
+          fpga_linalg::StreamingQRD<T, is_complex, rows, columns, raw_latency,
+                       kNumElementsPerDDRBurst,
+                       AMatrixPipe, QMatrixPipe, RMatrixPipe>());
+      launched = true;
+    }
+  }
+
+  // Read matrix_count A matrices from the FPGA DDR to the AMatrixPipe pipe,
+  // 'repetitions' times
+  static sycl::event SubmitReadA(sycl::queue &q, TT *a_device,
+                                 int matrix_count, int repetitions,
+                                 const std::vector<sycl::event> &deps = {}) {
+    return q.submit([&](sycl::handler &h) {
+      h.depends_on(deps);
+      h.single_task<QRDDDRToLocalMem>([=]() [[intel::kernel_args_restrict]] {
+        MatrixReadFromDDRToPipe<TT, rows, columns, kNumElementsPerDDRBurst,
+                              AMatrixPipe>(a_device, matrix_count, repetitions);
+      });
+    });
+  }
+
+  // Read the Q matrix from the QMatrixPipe pipe and copy it to the
+  // FPGA DDR
+  static sycl::event SubmitWriteQ(sycl::queue &q, TT *q_device,
+                                  int matrix_count, int repetitions,
+                                  const std::vector<sycl::event> &deps = {}) {
+    return q.submit([&](sycl::handler &h) {
+      h.depends_on(deps);
+      h.single_task<QRDLocalMemToDDRQ>([=
+                                    ]() [[intel::kernel_args_restrict]] {
+        MatrixReadPipeToDDR<TT, rows, columns, kNumElementsPerDDRBurst,
+                            QMatrixPipe>(q_device, matrix_count, repetitions);
+      });
+    });
+  }
+
+  // Read the R matrix from the RMatrixPipe pipe and copy it to the
+  // FPGA DDR
+  static sycl::event SubmitWriteR(sycl::queue &q, TT *r_device,
+                                  int matrix_count, int repetitions,
+                                  const std::vector<sycl::event> &deps = {}) {
+    return q.submit([&](sycl::handler &h) {
+      h.depends_on(deps);
+      h.single_task<QRDLocalMemToDDRR>([=
+                                    ]() [[intel::kernel_args_restrict]] {
+        sycl::device_ptr<TT> vector_ptr_device(r_device);
+
+        // Repeat matrix_count complete R matrix pipe reads
+        // for as many repetitions as needed
+        for (int repetition_index = 0; repetition_index < repetitions;
+             repetition_index++) {
+
+          [[intel::loop_coalesce(2)]]  // NO-FORMAT: Attribute
+          for (int matrix_index = 0; matrix_index < matrix_count;
+               matrix_index++) {
+            for (int r_idx = 0; r_idx < kRMatrixSize; r_idx++) {
+              vector_ptr_device[matrix_index * kRMatrixSize + r_idx] =
+                  RMatrixPipe::read();
+            }  // end of r_idx
+          }    // end of matrix_index
+        }      // end of repetition_index
+      });
+    });
+  }
+};
+
 /*
   Implementation of the QR decomposition using multiple streaming kernels
   Can be configured by datatype, matrix size and works with square or
@@ -46,19 +150,10 @@ void QRDecompositionImpl(
   int matrix_count,          // Number of matrices to decompose
   int repetitions           // Number of repetitions, for performance evaluation
 ) {
-
-  constexpr int kAMatrixSize = columns * rows;
-  constexpr int kQMatrixSize = columns * rows;
-  constexpr int kRMatrixSize = columns * (columns + 1) / 2;
-  constexpr int kNumElementsPerDDRBurst = is_complex ? 4 : 8;
-
-  using PipeType = fpga_tools::NTuple<TT, kNumElementsPerDDRBurst>;
-
-  // Pipes to communicate the A, Q and R matrices between kernels
-  using AMatrixPipe = sycl::ext::intel::pipe<APipe, PipeType, 3>;
-  using QMatrixPipe = sycl::ext::intel::pipe<QPipe, PipeType, 3>;
-  using RMatrixPipe = sycl::ext::intel::pipe<RPipe, TT,
-                                                  kNumElementsPerDDRBurst * 4>;
+  using Kernels = QRDKernels<columns, rows, raw_latency, is_complex, T, TT>;
+  constexpr int kAMatrixSize = Kernels::kAMatrixSize;
+  constexpr int kQMatrixSize = Kernels::kQMatrixSize;
+  constexpr int kRMatrixSize = Kernels::kRMatrixSize;
 
   // Allocate FPGA DDR memory.
   TT *a_device = sycl::malloc_device<TT>(kAMatrixSize * matrix_count, q);
@@ -69,49 +164,10 @@ void QRDecompositionImpl(
                                                           * sizeof(TT)).wait();
 
   auto ddr_write_event =
-  q.submit([&](sycl::handler &h) {
-    h.single_task<QRDDDRToLocalMem>([=]() [[intel::kernel_args_restrict]] {
-      MatrixReadFromDDRToPipe<TT, rows, columns, kNumElementsPerDDRBurst,
-                            AMatrixPipe>(a_device, matrix_count, repetitions);
-    });
-  });
-
-  // Read the A matrix from the AMatrixPipe pipe and compute the QR
-  // decomposition. Write the Q and R output matrices to the QMatrixPipe
-  // and RMatrixPipe pipes.
-  q.single_task<QRD>(
-      fpga_linalg::StreamingQRD<T, is_complex, rows, columns, raw_latency,
-                   kNumElementsPerDDRBurst,
-                   AMatrixPipe, QMatrixPipe, RMatrixPipe>());
-
-  auto q_event = q.single_task<QRDLocalMemToDDRQ>([=
-                                    ]() [[intel::kernel_args_restrict]] {
-    // Read the Q matrix from the QMatrixPipe pipe and copy it to the
-    // FPGA DDR
-    MatrixReadPipeToDDR<TT, rows, columns, kNumElementsPerDDRBurst,
-                        QMatrixPipe>(q_device, matrix_count, repetitions);
-  });
-
-  auto r_event = q.single_task<QRDLocalMemToDDRR>([=
-                                    ]() [[intel::kernel_args_restrict]] {
-    // Read the R matrix from the RMatrixPipe pipe and copy it to the
-    // FPGA DDR
-    sycl::device_ptr<TT> vector_ptr_device(r_device);
-
-    // Repeat matrix_count complete R matrix pipe reads
-    // for as many repetitions as needed
-    for (int repetition_index = 0; repetition_index < repetitions;
-         repetition_index++) {
-      
-      [[intel::loop_coalesce(2)]]  // NO-FORMAT: Attribute
-      for (int matrix_index = 0; matrix_index < matrix_count; matrix_index++) {
-        for (int r_idx = 0; r_idx < kRMatrixSize; r_idx++) {
-          vector_ptr_device[matrix_index * kRMatrixSize + r_idx] =
-              RMatrixPipe::read();
-        }  // end of r_idx
-      }    // end of repetition_index
-    }      // end of li
-  });
+      Kernels::SubmitReadA(q, a_device, matrix_count, repetitions);
+  Kernels::LaunchQRD(q);
+  auto q_event = Kernels::SubmitWriteQ(q, q_device, matrix_count, repetitions);
+  auto r_event = Kernels::SubmitWriteR(q, r_device, matrix_count, repetitions);
 
   q_event.wait();
   r_event.wait();
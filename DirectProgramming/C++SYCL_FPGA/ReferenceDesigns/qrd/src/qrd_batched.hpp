@@ -0,0 +1,244 @@
+#ifndef __QRD_BATCHED_HPP__
+#define __QRD_BATCHED_HPP__
+
+#include <sycl/sycl.hpp>
+#include <sycl/ext/intel/fpga_extensions.hpp>
+#include <sycl/ext/intel/ac_types/ac_complex.hpp>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "qrd.hpp"
+
+/*
+  A batched API for the QR decomposition of many small independent matrices
+  that arrive over time (e.g., in bursts).
+
+  The matrices are submitted one at a time with Submit(). They are packed into
+  batches of 'batch_size' matrices in pinned host memory, and a batch is sent
+  to the device as soon as it is full (or when Flush() is called). Each batch
+  is one pass of the QRD kernels of qrd.hpp with repetitions=1, so the
+  persistent StreamingQRD kernel is shared by all the batches.
+
+  There are 'buffers' batch slots, each with its own host and device memory,
+  so the transfers of one batch overlap the decomposition of the batch before
+  it. Submit() only blocks when all the slots are in use.
+
+  When the Q and R matrices of a batch are back on the host, the callback of
+  each of its requests is called with the request's Q matrix (column by
+  column, like the input) and R matrix (the upper triangular elements, row by
+  row). The pointers are only valid for the duration of the callback.
+  The callbacks are called in submission order, from an internal completion
+  thread.
+
+  NOTE: Submit, Flush and Wait must be called from a single thread.
+*/
+template <unsigned columns,     // Number of columns in the input matrix
+          unsigned rows,        // Number of rows in the input matrix
+          unsigned raw_latency, // RAW latency for triangular loop optimization
+          bool is_complex,      // Selects between ac_complex<T> and T datatype
+          typename T,           // The datatype for the computation
+          typename TT = std::conditional_t<is_complex, ac_complex<T>, T>
+                        // TT will be ac_complex<T> or T depending on is_complex
+         >
+class BatchedQRD {
+  using Kernels = QRDKernels<columns, rows, raw_latency, is_complex, T, TT>;
+
+ public:
+  static constexpr int kAMatrixSize = Kernels::kAMatrixSize;
+  static constexpr int kQMatrixSize = Kernels::kQMatrixSize;
+  static constexpr int kRMatrixSize = Kernels::kRMatrixSize;
+
+  using Callback = std::function<void(const TT *q_matrix, const TT *r_matrix)>;
+
+  BatchedQRD(sycl::queue &q, int batch_size, int buffers = 2)
+      : q_(q), batch_size_(batch_size), batches_(buffers) {
+    if (batch_size_ < 1) {
+      std::cerr << "ERROR: the batch size must be at least 1\n";
+      std::terminate();
+    }
+    if (buffers < 1) {
+      std::cerr << "ERROR: at least 1 batch buffer is required\n";
+      std::terminate();
+    }
+
+    for (auto &b : batches_) {
+      b.a_host = sycl::malloc_host<TT>(kAMatrixSize * batch_size_, q_);
+      b.q_host = sycl::malloc_host<TT>(kQMatrixSize * batch_size_, q_);
+      b.r_host = sycl::malloc_host<TT>(kRMatrixSize * batch_size_, q_);
+      b.a_device = sycl::malloc_device<TT>(kAMatrixSize * batch_size_, q_);
+      b.q_device = sycl::malloc_device<TT>(kQMatrixSize * batch_size_, q_);
+      b.r_device = sycl::malloc_device<TT>(kRMatrixSize * batch_size_, q_);
+      if (b.a_host == nullptr || b.q_host == nullptr || b.r_host == nullptr ||
+          b.a_device == nullptr || b.q_device == nullptr ||
+          b.r_device == nullptr) {
+        std::cerr << "ERROR: failed to allocate space for a batch of "
+                  << batch_size_ << " matrices\n";
+        std::terminate();
+      }
+      b.callbacks.reserve(batch_size_);
+      free_.push_back(&b);
+    }
+
+    Kernels::LaunchQRD(q_);
+    completion_thread_ = std::thread(&BatchedQRD::CompletionThread, this);
+  }
+
+  BatchedQRD(const BatchedQRD &) = delete;
+  BatchedQRD &operator=(const BatchedQRD &) = delete;
+
+  ~BatchedQRD() {
+    Wait();
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      stop_ = true;
+    }
+    cv_.notify_all();
+    completion_thread_.join();
+
+    for (auto &b : batches_) {
+      sycl::free(b.a_host, q_);
+      sycl::free(b.q_host, q_);
+      sycl::free(b.r_host, q_);
+      sycl::free(b.a_device, q_);
+      sycl::free(b.q_device, q_);
+      sycl::free(b.r_device, q_);
+    }
+  }
+
+  // Add the A matrix 'a_matrix' (kAMatrixSize elements, column by column) to
+  // the current batch. 'callback' is called with its Q and R matrices.
+  void Submit(const TT *a_matrix, Callback callback) {
+    if (current_ == nullptr) {
+      // wait for a batch slot to be free
+      std::unique_lock<std::mutex> lock(mtx_);
+      cv_.wait(lock, [&] { return !free_.empty(); });
+      current_ = free_.front();
+      free_.pop_front();
+    }
+
+    std::copy_n(a_matrix, kAMatrixSize,
+                current_->a_host + current_->callbacks.size() * kAMatrixSize);
+    current_->callbacks.push_back(std::move(callback));
+
+    if (current_->callbacks.size() == size_t(batch_size_)) {
+      Launch();
+    }
+  }
+
+  // Send the current batch to the device, even if it is not full
+  void Flush() {
+    if (current_ != nullptr && !current_->callbacks.empty()) {
+      Launch();
+    }
+  }
+
+  // Flush, and wait for the callbacks of all the submitted matrices
+  void Wait() {
+    Flush();
+    std::unique_lock<std::mutex> lock(mtx_);
+    cv_.wait(lock, [&] {
+      return free_.size() + (current_ != nullptr ? 1 : 0) == batches_.size();
+    });
+  }
+
+  int BatchSize() const { return batch_size_; }
+  size_t BatchesLaunched() const { return batches_launched_; }
+
+ private:
+  struct Batch {
+    TT *a_host, *q_host, *r_host;
+    TT *a_device, *q_device, *r_device;
+    std::vector<Callback> callbacks;  // one per matrix in the batch
+    std::vector<sycl::event> done;    // the copies of Q and R to the host
+  };
+
+  void Launch() {
+    Batch *b = current_;
+    int count = b->callbacks.size();
+
+    // All the batches go through the same pipes, so each kernel must process
+    // the batches in order.
+    auto copy_a = q_.memcpy(b->a_device, b->a_host,
+                            kAMatrixSize * count * sizeof(TT));
+    last_read_a_ = Kernels::SubmitReadA(q_, b->a_device, count, 1,
+                                        {copy_a, last_read_a_});
+    last_write_q_ = Kernels::SubmitWriteQ(q_, b->q_device, count, 1,
+                                          {last_write_q_});
+    last_write_r_ = Kernels::SubmitWriteR(q_, b->r_device, count, 1,
+                                          {last_write_r_});
+
+    auto copy_q = q_.memcpy(b->q_host, b->q_device,
+                            kQMatrixSize * count * sizeof(TT), last_write_q_);
+    auto copy_r = q_.memcpy(b->r_host, b->r_device,
+                            kRMatrixSize * count * sizeof(TT), last_write_r_);
+    b->done = {copy_q, copy_r};
+
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      launched_.push_back(b);
+      current_ = nullptr;
+    }
+    cv_.notify_all();
+    batches_launched_++;
+  }
+
+  // Waits for the batches in the order they were launched, calls the
+  // callbacks of their requests and frees their slots
+  void CompletionThread() {
+    while (true) {
+      Batch *b;
+      {
+        std::unique_lock<std::mutex> lock(mtx_);
+        cv_.wait(lock, [&] { return !launched_.empty() || stop_; });
+        if (launched_.empty()) {
+          return;
+        }
+        b = launched_.front();
+        launched_.pop_front();
+      }
+
+      sycl::event::wait(b->done);
+      for (size_t i = 0; i < b->callbacks.size(); i++) {
+        b->callbacks[i](b->q_host + i * kQMatrixSize,
+                        b->r_host + i * kRMatrixSize);
+      }
+      b->callbacks.clear();
+      b->done.clear();
+
+      {
+        std::lock_guard<std::mutex> lock(mtx_);
+        free_.push_back(b);
+      }
+      cv_.notify_all();
+    }
+  }
+
+  sycl::queue &q_;
+  int batch_size_;
+  std::vector<Batch> batches_;
+  size_t batches_launched_ = 0;
+
+  // the batch being filled by Submit (only used by the submitting thread)
+  Batch *current_ = nullptr;
+
+  // the last kernels of the previous batch
+  sycl::event last_read_a_, last_write_q_, last_write_r_;
+
+  // the slots that are free and the batches waiting for completion, in order
+  std::mutex mtx_;
+  std::condition_variable cv_;
+  std::deque<Batch *> free_;
+  std::deque<Batch *> launched_;
+  bool stop_ = false;
+  std::thread completion_thread_;
+};
+
+#endif /* __QRD_BATCHED_HPP__ */
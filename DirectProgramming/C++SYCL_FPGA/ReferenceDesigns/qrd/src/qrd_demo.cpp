@@ -4,11 +4,17 @@
 #include <sycl/ext/intel/fpga_extensions.hpp>
 #include <sycl/ext/intel/ac_types/ac_complex.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
 #include <list>
+#include <string>
 
 #include "exception_handler.hpp"
 
 #include "qrd.hpp"
+#include "qrd_batched.hpp"
 
 #ifdef FPGA_SIMULATOR
 #define ROWS_COMPONENT_V 8
@@ -60,6 +66,79 @@ void QRDecomposition(std::vector<ac_complex<float> > &a_matrix,
 }
 #endif
 
+/*
+  The batched QR decomposition API (qrd_batched.hpp), for the same design
+  parameters as QRDecomposition
+*/
+using BatchedQRDDesign =
+    BatchedQRD<COLS_COMPONENT_V, ROWS_COMPONENT_V, FIXED_ITERATIONS,
+               COMPLEX != 0, float>;
+
+/*
+  Decomposes 'total' matrices, one at a time, with the batched API for each of
+  the batch sizes in 'batch_sizes', and prints the throughput for each batch
+  size. Request i decomposes the input matrix i % matrix_count of a_matrix.
+  The Q and R matrices of the first matrix_count requests are copied to
+  q_matrix and r_matrix (to be verified by the caller), and the results of the
+  other requests must be identical to them. Returns false if they are not.
+*/
+template <typename TT>
+bool BatchedQRDecomposition(std::vector<TT> &a_matrix,
+                            std::vector<TT> &q_matrix,
+                            std::vector<TT> &r_matrix, sycl::queue &q,
+                            int matrix_count, int total,
+                            const std::vector<int> &batch_sizes) {
+  constexpr int kAMatrixSize = BatchedQRDDesign::kAMatrixSize;
+  constexpr int kQMatrixSize = BatchedQRDDesign::kQMatrixSize;
+  constexpr int kRMatrixSize = BatchedQRDDesign::kRMatrixSize;
+  size_t mismatches = 0;
+
+  std::cout << std::setw(12) << "Batch size" << std::setw(14) << "Batches"
+            << std::setw(14) << "Time (s)" << std::setw(26)
+            << "Throughput (k matrices/s)" << std::endl;
+
+  for (int batch_size : batch_sizes) {
+    double diff;
+    size_t batches;
+    {
+      BatchedQRDDesign qrd(q, batch_size);
+
+      auto start = std::chrono::high_resolution_clock::now();
+      for (int i = 0; i < total; i++) {
+        int m = i % matrix_count;
+        qrd.Submit(a_matrix.data() + m * kAMatrixSize,
+                   [&, i, m](const TT *q_out, const TT *r_out) {
+          TT *q_ref = q_matrix.data() + m * kQMatrixSize;
+          TT *r_ref = r_matrix.data() + m * kRMatrixSize;
+          if (i < matrix_count) {
+            std::copy_n(q_out, kQMatrixSize, q_ref);
+            std::copy_n(r_out, kRMatrixSize, r_ref);
+          } else if (!std::equal(q_out, q_out + kQMatrixSize, q_ref) ||
+                     !std::equal(r_out, r_out + kRMatrixSize, r_ref)) {
+            mismatches++;
+          }
+        });
+      }
+      qrd.Wait();
+      auto end = std::chrono::high_resolution_clock::now();
+
+      diff = std::chrono::duration<double>(end - start).count();
+      batches = qrd.BatchesLaunched();
+    }
+
+    std::cout << std::setw(12) << batch_size << std::setw(14) << batches
+              << std::setw(14) << diff << std::setw(26)
+              << total / diff * 1e-3 << std::endl;
+  }
+
+  if (mismatches != 0) {
+    std::cout << "ERROR: " << mismatches << " matrices decomposed with the "
+              << "batched API differ from the first decomposition of the same "
+              << "input" << std::endl;
+  }
+  return mismatches == 0;
+}
+
 /*
   returns if both the real and complex parts of the given ac_complex
   value are finite
@@ -89,15 +168,31 @@ int main(int argc, char *argv[]) {
   std::cout << "Using 32x32 matrices for simulation to reduce runtime" << std::endl;
 #endif
 
+  // With --batched, the decomposition uses the batched API for a range of
+  // batch sizes, instead of decomposing all the matrices at once.
+  bool batched = false;
+  const char *repetitions_arg = nullptr;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--batched") == 0) {
+      batched = true;
+    } else {
+      repetitions_arg = argv[i];
+    }
+  }
+
   // Get the number of times we want to repeat the decomposition
   // from the command line.
+  // The batched API launches the kernels for every batch, so it uses fewer
+  // repetitions by default to keep the small batch sizes from taking too long.
 #if defined(FPGA_EMULATOR)
-  int repetitions = argc > 1 ? atoi(argv[1]) : 16;
+  int default_repetitions = batched ? 4 : 16;
 #elif defined(FPGA_SIMULATOR)
-  int repetitions = argc > 1 ? atoi(argv[1]) : 1;
+  int default_repetitions = 1;
 #else
-  int repetitions = argc > 1 ? atoi(argv[1]) : 819200;
+  int default_repetitions = batched ? 8192 : 819200;
 #endif
+  int repetitions = repetitions_arg != nullptr ? atoi(repetitions_arg)
+                                               : default_repetitions;
   if (repetitions < 1) {
     std::cout << "Number of repetitions given is lower that 1." << std::endl;
     std::cout << "The decomposition must occur at least 1 time." << std::endl;
@@ -188,12 +283,38 @@ int main(int argc, char *argv[]) {
 
     } // end of matrix_index
 
-    std::cout << "Running QR decomposition of " << kMatricesToDecompose
-              << " matri" << (kMatricesToDecompose > 1 ? "ces " : "x ")
-              << repetitions << " times" << std::endl;
+    if (batched) {
+      // Both the host and the device hold 'buffers' batches of A, Q and R
+      // matrices, so the largest batches are limited to the large matrices
+      // of the hardware flow
+#if defined(FPGA_EMULATOR) || defined(FPGA_SIMULATOR)
+      constexpr int kMaxBatchSize = 64;
+#else
+      constexpr int kMaxBatchSize = 1024;
+#endif
+      int total = repetitions * kMatricesToDecompose;
+      std::vector<int> batch_sizes;
+      for (int b = 1; b <= std::min(total, kMaxBatchSize); b *= 4) {
+        batch_sizes.push_back(b);
+      }
+
+      std::cout << "Running batched QR decomposition of " << total
+                << " matri" << (total > 1 ? "ces" : "x")
+                << " submitted one at a time" << std::endl;
 
-    QRDecomposition(a_matrix, q_matrix, r_matrix, q, kMatricesToDecompose,
+      if (!BatchedQRDecomposition(a_matrix, q_matrix, r_matrix, q,
+                                  kMatricesToDecompose, total, batch_sizes)) {
+        std::cout << std::endl << "FAILED" << std::endl;
+        return 1;
+      }
+    } else {
+      std::cout << "Running QR decomposition of " << kMatricesToDecompose
+                << " matri" << (kMatricesToDecompose > 1 ? "ces " : "x ")
+                << repetitions << " times" << std::endl;
+
+      QRDecomposition(a_matrix, q_matrix, r_matrix, q, kMatricesToDecompose,
                                                                   repetitions);
+    }
 
     // For output post-processing (op)
     T q_matrix_op[kRows][kColumns];
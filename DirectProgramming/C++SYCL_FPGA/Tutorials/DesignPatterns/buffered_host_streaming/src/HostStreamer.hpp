@@ -18,12 +18,14 @@
 #include <sycl/sycl.hpp>
 #include <sycl/ext/intel/fpga_extensions.hpp>
 
+#include "spsc_queue.hpp"
+
 using namespace sycl;
 
 //
 // A thread safe wrapper around std::queue.
-// FUTURE WORK: We  could probably use conditional variables to improve
-//              lock performance.
+// Every call takes a lock. See SPSCQueue (spsc_queue.hpp) for a lock-free
+// alternative.
 //
 template<typename T>
 class ConcurrentQueue {
@@ -32,6 +34,12 @@ private:
   std::mutex mtx_;
 
 public:
+  // empty the queue. The capacity is ignored, since the queue is unbounded.
+  void Reset(size_t /*capacity*/) {
+    std::scoped_lock lock(mtx_);
+    q_ = std::queue<T>();
+  }
+
   bool Empty() {
     std::scoped_lock lock(mtx_);
     return q_.size() == 0;
@@ -64,6 +72,28 @@ public:
   void Unlock() { mtx_.unlock(); }
 };
 
+//
+// The queues used by the HostStreamer to pass requests between the user's
+// threads and the KernelLaunchAndWaitThread.
+//
+// LockFreeQueues: bounded lock-free single-producer/single-consumer queues.
+// With these, the Producer APIs (AcquireProducerBuffer and
+// ReleaseProducerBuffer) must be called from a single thread, and
+// RequestConsumer must be called from a single (possibly different) thread.
+//
+// MutexQueues: the mutex based ConcurrentQueue, which has no restrictions on
+// the calling threads but takes a lock on every access.
+//
+struct LockFreeQueues {
+  template <typename T>
+  using Queue = SPSCQueue<T, BackoffWait>;
+};
+
+struct MutexQueues {
+  template <typename T>
+  using Queue = ConcurrentQueue<T>;
+};
+
 // Declare these out of the HostStreamer to reduce name mangling
 template<typename Id>
 class ProducerKernelId;
@@ -88,6 +118,8 @@ class ConsumerPipeId;
 //    ConsumerType:           The datatype to stream from the device to the host
 //    min_producer_capacity:  The minimum capacity of the ProducerPipe
 //    min_consumer_capacity:  The minimum capacity of the ConsumerPipe
+//    QueuePolicy:            The type of the internal request queues
+//                            (LockFreeQueues or MutexQueues, see above)
 //
 //  Using the HostStreamer results in a CPU-FPGA system that looks like this:
 //
@@ -110,7 +142,8 @@ class ConsumerPipeId;
 // device to the host through the ConsumerPipe (HostStreamer<...>::ProducerPipe)
 // 
 template <typename Id, typename ProducerType, typename ConsumerType,
-          size_t min_producer_capacity=0, size_t min_consumer_capacity=0>
+          size_t min_producer_capacity=0, size_t min_consumer_capacity=0,
+          typename QueuePolicy=LockFreeQueues>
 class HostStreamer {
 private:
   // The constructor is private to avoid creating an instance of the class
@@ -152,8 +185,10 @@ private:
   //      <size_t: index into producer_buffer or consumer buffer,
   //       size_t: the count of elements to be produced/consumer>
   using producer_consumer_tuple = std::tuple<size_t, size_t>;
-  static inline ConcurrentQueue<producer_consumer_tuple> produce_q_{};
-  static inline ConcurrentQueue<producer_consumer_tuple> consume_q_{};
+  template <typename T>
+  using RequestQueue = typename QueuePolicy::template Queue<T>;
+  static inline RequestQueue<producer_consumer_tuple> produce_q_{};
+  static inline RequestQueue<producer_consumer_tuple> consume_q_{};
 
   // The KernelLaunchAndWaitThread grabs requests from the Producer and Consumer
   // queues (declared above) and places them into the launch queue. From there
@@ -167,7 +202,7 @@ private:
   //       event: the SYCL event for the launched kernel
   //       bool: true for producer, false for consumer>
   using launch_queue_tuple = std::tuple<size_t, size_t, event, bool>;
-  static inline ConcurrentQueue<launch_queue_tuple> launch_q_{};
+  static inline RequestQueue<launch_queue_tuple> launch_q_{};
 
   // A pointer to the SYCL queue which launches the actual kernels to do the
   // producing and consuming. We don't use a reference here due to static
@@ -222,11 +257,20 @@ private:
   // queue (sycl_q_) to perform the request. It also performs the callbacks
   // to the user code when the requests have been completed.
   static void KernelLaunchAndWaitThread() {
+    // back off when there is nothing to do, so that this thread does not
+    // compete for the CPU with the threads producing the requests
+    BackoffWait backoff;
+    size_t idle_iterations = 0;
+
     // Do this loop until told (by main thread) to stop via the
     // 'kill_kernel_thread_flag_' atomic shared variable.
     while (!kill_kernel_thread_flag_) {
+      bool did_work = false;
+
       // If there is a Produce request to launch, do it
       if (!ProducerQueueEmpty()) {
+        did_work = true;
+
         // grab the oldest request from the produce queue
         size_t buf_idx;
         size_t count;
@@ -242,6 +286,8 @@ private:
 
       // If there is a Consume request to launch, do it
       if (!ConsumerQueueEmpty()) {
+        did_work = true;
+
         // grab the oldest request from the consume queue
         size_t buf_idx;
         size_t count;
@@ -262,6 +308,8 @@ private:
       //       launch queue is not empty (i.e. flush_ && launch_q_.size() != 0)
       if ((launch_q_.Size() >= wait_threshold_) ||
           (flush_ && !LaunchQueueEmpty())) {
+        did_work = true;
+
         // grab the oldest request from the launch queue
         size_t buf_idx;
         size_t count;
@@ -314,6 +362,12 @@ private:
           ////////////////////////////////////////
         }
       }
+
+      if (did_work) {
+        idle_iterations = 0;
+      } else {
+        backoff(idle_iterations++);
+      }
     }
   }
 
@@ -425,6 +479,13 @@ public:
     consume_requests_outstanding_ = 0;
     //////////////////////////////////////////////
 
+    // Size the request queues. There can be at most one request per buffer
+    // in the Producer and Consumer queues, and one per outstanding request
+    // in the launch queue.
+    produce_q_.Reset(num_producer_buffers_);
+    consume_q_.Reset(num_consumer_buffers_);
+    launch_q_.Reset(num_producer_buffers_ + num_consumer_buffers_);
+
     // start the KernelLaunchAndWaitThread
     flush_ = false;
     kill_kernel_thread_flag_ = false;
@@ -614,7 +675,10 @@ public:
     Flush();
 
     // wait until the launch queue is empty
-    while (!LaunchQueueEmpty()){}
+    BackoffWait backoff;
+    for (size_t attempt = 0; !LaunchQueueEmpty(); attempt++) {
+      backoff(attempt);
+    }
   }
   //////////////////////////////////////////////////////////////////////////////
 
@@ -16,6 +16,7 @@
 
 #include "streaming_without_api.hpp"
 #include "streaming_with_api.hpp"
+#include "queue_latency_benchmark.hpp"
 
 using namespace sycl;
 
@@ -51,6 +52,7 @@ int main(int argc, char* argv[]) {
 
   size_t buffers = 2;
   bool need_help = false;
+  bool queue_benchmark = false;
 
   // parse the command line arguments
   for (int i = 1; i < argc; i++) {
@@ -58,6 +60,8 @@ int main(int argc, char* argv[]) {
 
     if (arg == "--help" || arg == "-h") {
       need_help = true;
+    } else if (arg == "--queue_benchmark") {
+      queue_benchmark = true;
     } else {
       std::string str_after_equals = arg.substr(arg.find("=") + 1);
 
@@ -85,7 +89,8 @@ int main(int argc, char* argv[]) {
               << "[--buffers=<int>] "
               << "[--buffer_count=<int>] "
               << "[--iterations=<int>] "
-              << "[--threads=<int>]\n";
+              << "[--threads=<int>] "
+              << "[--queue_benchmark]\n";
     return 0;
   }
 
@@ -144,6 +149,23 @@ int main(int argc, char* argv[]) {
       std::terminate();
     }
 
+    ///////////////////////////////////////////////////////////////////////////
+    // compare the latency of the HostStreamer's queues across buffer sizes
+    // (see queue_latency_benchmark.hpp)
+    if (queue_benchmark) {
+#if defined(FPGA_EMULATOR)
+      std::vector<size_t> buffer_counts = {16, 256, 4096};
+#else
+      std::vector<size_t> buffer_counts = {16, 64, 256, 1024, 4096, 16384};
+#endif
+      std::cout << "Running the HostStreamer queue latency benchmark\n";
+      passed &= DoQueueLatencyBenchmark<Type>(q, buffers, reps, iterations,
+                                              threads, buffer_counts);
+      std::cout << (passed ? "PASSED\n" : "FAILED\n");
+      return passed ? 0 : 1;
+    }
+    ///////////////////////////////////////////////////////////////////////////
+
     ///////////////////////////////////////////////////////////////////////////
     // find the bandwidth of each processing component in our design
     std::cout << "Running the roofline analysis\n";
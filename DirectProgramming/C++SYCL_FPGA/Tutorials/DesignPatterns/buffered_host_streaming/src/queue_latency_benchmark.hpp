@@ -0,0 +1,98 @@
+#ifndef __QUEUE_LATENCY_BENCHMARK_HPP__
+#define __QUEUE_LATENCY_BENCHMARK_HPP__
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <vector>
+
+#include <sycl/sycl.hpp>
+#include <sycl/ext/intel/fpga_extensions.hpp>
+
+#include "common.hpp"
+#include "streaming_with_api.hpp"
+
+using namespace sycl;
+using namespace std::chrono;
+
+//
+// Runs the design with the API (streaming_with_api.hpp) with the given
+// HostStreamer QueuePolicy and buffer size. Returns the average latency of a
+// buffer, in ms, from the time it is released by the Producer to the time the
+// Consumer callback receives its output. 'errors' is incremented by the
+// number of errors in the output.
+//
+template<typename T, typename QueuePolicy>
+double MeasureAPILatency(queue& q, size_t buffers, size_t buffer_count,
+                         size_t reps, size_t iterations, size_t threads,
+                         size_t& errors) {
+  std::vector<high_resolution_clock::time_point> time_in(reps);
+  std::vector<high_resolution_clock::time_point> time_out(reps);
+
+  size_t total_count = buffer_count * reps;
+  std::vector<T> in_stream(total_count);
+  std::vector<T> out_stream(total_count);
+  std::generate_n(in_stream.begin(), total_count, [] { return rand() % 100; });
+
+  // the first iteration is a warmup and is not included in the average
+  double latency_ms = 0.0;
+  for (size_t i = 0; i < iterations; i++) {
+    std::fill_n(out_stream.begin(), total_count, 0);
+
+    high_resolution_clock::time_point start, end;
+    DoOneIterationAPI<T, QueuePolicy>(q, buffers, buffer_count, reps,
+                                      iterations, threads, in_stream.data(),
+                                      out_stream.data(), time_in, time_out,
+                                      start, end);
+    errors += CountErrors(out_stream.data(), total_count, in_stream.data());
+
+    if (i > 0) {
+      for (size_t j = 0; j < reps; j++) {
+        duration<double, std::milli> l = time_out[j] - time_in[j];
+        latency_ms += l.count();
+      }
+    }
+  }
+
+  return latency_ms / (reps * (iterations - 1));
+}
+
+//
+// Compares the latency of the HostStreamer with the mutex based
+// ConcurrentQueue (MutexQueues) and the lock-free SPSCQueue (LockFreeQueues)
+// across a range of buffer sizes. The kernel launch latency dominates for
+// large buffers, so the difference between the queues shows up with small
+// buffers, where requests are handed between the threads most often.
+//
+template<typename T>
+bool DoQueueLatencyBenchmark(queue& q, size_t buffers, size_t reps,
+                             size_t iterations, size_t threads,
+                             const std::vector<size_t>& buffer_counts) {
+  size_t errors = 0;
+
+  std::cout << std::fixed << std::setprecision(4);
+  std::cout << std::setw(14) << "Buffer Count" << std::setw(14)
+            << "Buffer (KB)" << std::setw(16) << "Mutex (ms)"
+            << std::setw(16) << "Lock-free (ms)" << std::setw(10)
+            << "Speedup" << "\n";
+
+  for (auto buffer_count : buffer_counts) {
+    double mutex_ms = MeasureAPILatency<T, MutexQueues>(
+        q, buffers, buffer_count, reps, iterations, threads, errors);
+    double lock_free_ms = MeasureAPILatency<T, LockFreeQueues>(
+        q, buffers, buffer_count, reps, iterations, threads, errors);
+
+    std::cout << std::setw(14) << buffer_count << std::setw(14)
+              << (buffer_count * sizeof(T)) / 1024.0 << std::setw(16)
+              << mutex_ms << std::setw(16) << lock_free_ms << std::setw(10)
+              << (mutex_ms / lock_free_ms) << "\n";
+  }
+
+  if (errors != 0) {
+    std::cerr << "ERROR: " << errors << " errors in the benchmark output\n";
+  }
+  return errors == 0;
+}
+
+#endif /* __QUEUE_LATENCY_BENCHMARK_HPP__ */
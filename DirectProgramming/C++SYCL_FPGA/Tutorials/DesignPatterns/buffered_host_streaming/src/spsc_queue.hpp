@@ -0,0 +1,162 @@
+#ifndef __SPSC_QUEUE_HPP__
+#define __SPSC_QUEUE_HPP__
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || \
+    defined(_M_IX86)
+#include <immintrin.h>
+#define SPSC_CPU_RELAX() _mm_pause()
+#else
+#define SPSC_CPU_RELAX()
+#endif
+
+//
+// Wait policies, used by a thread that is waiting on another thread (e.g.,
+// for a queue to become non-empty). They are called with the number of times
+// the caller has already waited, so the policy can back off the longer the
+// wait goes on.
+//
+// SpinWait: always busy-wait. This has the lowest latency, but burns a CPU
+// core, which may be shared with the thread that is being waited on.
+//
+struct SpinWait {
+  void operator()(size_t /*attempt*/) const { SPSC_CPU_RELAX(); }
+};
+
+//
+// BackoffWait: busy-wait for a short time, then yield the CPU, and finally
+// sleep. Short waits (the common case when the queues are busy) get the
+// latency of spinning, while long waits do not starve the other threads.
+//
+struct BackoffWait {
+  static constexpr size_t kSpinAttempts = 64;
+  static constexpr size_t kYieldAttempts = 1024;
+
+  void operator()(size_t attempt) const {
+    if (attempt < kSpinAttempts) {
+      SPSC_CPU_RELAX();
+    } else if (attempt < kYieldAttempts) {
+      std::this_thread::yield();
+    } else {
+      std::this_thread::sleep_for(std::chrono::microseconds(10));
+    }
+  }
+};
+
+//
+// A bounded, lock-free, single-producer/single-consumer queue.
+// Exactly one thread may call Push/TryPush and exactly one (possibly
+// different) thread may call Front/Pop. Empty and Size may be called from
+// any thread. It has the same interface as ConcurrentQueue (HostStreamer.hpp)
+// so that HostStreamer can use either one.
+//
+// The producer owns 'tail_' and the consumer owns 'head_'. Each side keeps a
+// cached copy of the other side's index, so it only reads the other side's
+// cache line when the queue looks full (producer) or empty (consumer).
+//
+template <typename T, typename WaitPolicy = BackoffWait>
+class SPSCQueue {
+ public:
+  SPSCQueue() { Reset(1); }
+
+  SPSCQueue(const SPSCQueue&) = delete;
+  SPSCQueue& operator=(const SPSCQueue&) = delete;
+
+  // Set the capacity of the queue and empty it.
+  // NOTE: this is NOT thread safe. No other thread may be using the queue.
+  void Reset(size_t capacity) {
+    capacity_ = (capacity == 0) ? 1 : capacity;
+
+    // round the ring size up to a power of 2 so that the indices can
+    // be masked instead of using a modulo
+    size_t ring_size = 1;
+    while (ring_size < capacity_) {
+      ring_size <<= 1;
+    }
+    mask_ = ring_size - 1;
+    ring_.clear();
+    ring_.resize(ring_size);
+
+    head_.store(0, std::memory_order_relaxed);
+    tail_.store(0, std::memory_order_relaxed);
+    head_cache_ = 0;
+    tail_cache_ = 0;
+  }
+
+  size_t Capacity() const { return capacity_; }
+
+  bool Empty() const { return Size() == 0; }
+
+  size_t Size() const {
+    // read head first, so that tail >= head
+    size_t head = head_.load(std::memory_order_acquire);
+    size_t tail = tail_.load(std::memory_order_acquire);
+    return tail - head;
+  }
+
+  // Producer: add 'data' to the queue if it is not full.
+  // Returns false if the queue was full.
+  bool TryPush(const T& data) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_cache_ == capacity_) {
+      head_cache_ = head_.load(std::memory_order_acquire);
+      if (tail - head_cache_ == capacity_) {
+        return false;
+      }
+    }
+    ring_[tail & mask_] = data;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Producer: add 'data' to the queue, waiting for room if it is full
+  void Push(const T& data) {
+    for (size_t attempt = 0; !TryPush(data); attempt++) {
+      wait_(attempt);
+    }
+  }
+
+  // Consumer: the oldest element in the queue. The queue must not be empty.
+  T& Front() {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_cache_) {
+      tail_cache_ = tail_.load(std::memory_order_acquire);
+    }
+    return ring_[head & mask_];
+  }
+
+  // Consumer: remove the oldest element. The queue must not be empty.
+  void Pop() {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_cache_) {
+      tail_cache_ = tail_.load(std::memory_order_acquire);
+    }
+
+    // release anything held by the element (e.g., a SYCL event)
+    ring_[head & mask_] = T();
+    head_.store(head + 1, std::memory_order_release);
+  }
+
+ private:
+  // keep the producer and consumer indices on separate cache lines to avoid
+  // false sharing between the two threads
+  static constexpr size_t kCacheLineSize = 64;
+
+  std::vector<T> ring_;
+  size_t capacity_;
+  size_t mask_;
+  WaitPolicy wait_;
+
+  alignas(kCacheLineSize) std::atomic<size_t> head_{0};
+  size_t tail_cache_{0};  // the consumer's copy of 'tail_'
+
+  alignas(kCacheLineSize) std::atomic<size_t> tail_{0};
+  size_t head_cache_{0};  // the producer's copy of 'head_'
+};
+
+#endif /* __SPSC_QUEUE_HPP__ */
@@ -18,7 +18,8 @@ using namespace std::chrono;
 
 ////////////////////////////////////////////////////////////////////////////////
 // forward declare functions
-template<typename T>
+// 'QueuePolicy' selects the HostStreamer's internal queues (HostStreamer.hpp)
+template<typename T, typename QueuePolicy=LockFreeQueues>
 void DoOneIterationAPI(queue& q, size_t buffers, size_t buffer_count,
                        size_t reps, size_t iterations, size_t threads,
                        T *in_stream, T *out_stream,
@@ -27,13 +28,16 @@ void DoOneIterationAPI(queue& q, size_t buffers, size_t buffer_count,
                        high_resolution_clock::time_point& start,
                        high_resolution_clock::time_point& end);
 
-template<typename T>
+template<typename T, typename QueuePolicy=LockFreeQueues>
 bool DoWorkAPI(queue& q, size_t buffers, size_t buffer_count, size_t reps,
                size_t iterations, size_t threads);
 ////////////////////////////////////////////////////////////////////////////////
 
-// Forward declare the kernel and HostStreamer name to reduce name mangling
+// Forward declare the kernel and HostStreamer name to reduce name mangling.
+// There is one of each for every QueuePolicy that is used.
+template<typename QueuePolicy>
 class APIKernel;
+template<typename QueuePolicy>
 class MyStreamerId;
 
 //
@@ -42,7 +46,7 @@ class MyStreamerId;
 // call this function multiple times to increase the performance
 // measurement accuracy.
 // 
-template<typename T>
+template<typename T, typename QueuePolicy>
 void DoOneIterationAPI(queue& q, size_t buffers, size_t buffer_count,
                        size_t reps, size_t iterations, size_t threads,
                        T *in_stream, T *out_stream,
@@ -63,9 +67,11 @@ void DoOneIterationAPI(queue& q, size_t buffers, size_t buffer_count,
   //        Id:                     MyStreamerId
   //        ProducerType:           T
   //        ConsumerType:           T
-  //        min_producer_capacity:  0 (implicit)
-  //        min_consumer_capacity:  0 (implicit)
-  using MyStreamer = HostStreamer<MyStreamerId, T, T>;
+  //        min_producer_capacity:  0
+  //        min_consumer_capacity:  0
+  //        QueuePolicy:            QueuePolicy
+  using MyStreamer =
+      HostStreamer<MyStreamerId<QueuePolicy>, T, T, 0, 0, QueuePolicy>;
 
   // Initialize the streamer
   //    # of Producer buffers      = 'buffers'
@@ -115,7 +121,7 @@ void DoOneIterationAPI(queue& q, size_t buffers, size_t buffer_count,
   // therefore we can easily bound the computation of this kernel. In other
   // cases, this may not be possible and an infinite loop may be required (i.e.
   // read from the Producer pipe and produce to the Consumer pipe, forever).
-  auto kernel_event = q.single_task<APIKernel>([=] {
+  auto kernel_event = q.single_task<APIKernel<QueuePolicy>>([=] {
     // process ALL of the possible data
     for (size_t i = 0; i < total_count; i++) {
       // read from the producer pipe
@@ -211,7 +217,7 @@ void DoOneIterationAPI(queue& q, size_t buffers, size_t buffer_count,
 // checking errors, and running multiple iterations to improve performance
 // accuracy.
 //
-template<typename T>
+template<typename T, typename QueuePolicy>
 bool DoWorkAPI(queue& q, size_t buffers, size_t buffer_count, size_t reps,
                size_t iterations, size_t threads) {
   // track how many errors we detect in the output
@@ -239,9 +245,10 @@ bool DoWorkAPI(queue& q, size_t buffers, size_t buffer_count, size_t reps,
 
     // do the iteration
     high_resolution_clock::time_point start, end;
-    DoOneIterationAPI(q, buffers, buffer_count, reps, iterations, threads,
-                      in_stream.data(), out_stream.data(),
-                      time_in, time_out, start, end);
+    DoOneIterationAPI<T, QueuePolicy>(q, buffers, buffer_count, reps,
+                                      iterations, threads, in_stream.data(),
+                                      out_stream.data(), time_in, time_out,
+                                      start, end);
 
     // validate the results
     total_errors += CountErrors(out_stream.data(), total_count,